@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Benchmark.hpp"
+#include "MockVulkan.hpp"
+#include "render/RangeAllocator.hpp"
+#include "render/vulkan/Allocator.hpp"
+
+using render::RangeAllocator;
+using render::vulkan::Allocation;
+using render::vulkan::Allocator;
+using render::vulkan::ResourceKind;
+
+namespace {
+const size_t kOperationCount = 200000;
+const size_t kLiveTarget = 8000;  ///< resources loaded at once, on average
+
+struct Operation {
+  bool allocate;
+  size_t slot;  ///< of the resource, in the live set
+  VkMemoryRequirements requirements;
+  ResourceKind kind;
+};
+
+// Loads and unloads around kLiveTarget resources from 1 KiB to 1 MiB, with
+// the alignments buffers and images usually require.
+std::vector<Operation> GenerateOperations() {
+  std::mt19937 rng(42);
+  std::vector<Operation> operations;
+  operations.reserve(kOperationCount);
+  size_t live_count = 0;
+  for (size_t i = 0; i < kOperationCount; ++i) {
+    bool allocate = live_count == 0 ||
+                    rng() % (2 * kLiveTarget) >= live_count;
+    Operation operation{allocate, 0, {}, ResourceKind::kLinear};
+    if (allocate) {
+      operation.slot = live_count++;
+      VkDeviceSize size = VkDeviceSize{1024} << (rng() % 11);
+      size += rng() % size;
+      operation.kind = rng() % 2 ? ResourceKind::kLinear
+                                 : ResourceKind::kOptimal;
+      VkDeviceSize alignment =
+          operation.kind == ResourceKind::kLinear ? 256 : 65536;
+      operation.requirements = VkMemoryRequirements{size, alignment, 0x1};
+    } else {
+      operation.slot = rng() % live_count--;
+    }
+    operations.push_back(operation);
+  }
+  return operations;
+}
+
+// Live sets are kept packed: the freed slot takes the last resource.
+template <typename T>
+T TakeSlot(std::vector<T>& live, size_t slot) {
+  T taken = live[slot];
+  live[slot] = live.back();
+  live.pop_back();
+  return taken;
+}
+
+void RunDedicatedAllocations(const std::vector<Operation>& operations,
+                             size_t& peak_allocations) {
+  VkDevice device = mock::GetDevice();
+  std::vector<VkDeviceMemory> live;
+  peak_allocations = 0;
+  for (const Operation& operation : operations) {
+    if (operation.allocate) {
+      VkMemoryAllocateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      info.allocationSize = operation.requirements.size;
+      info.memoryTypeIndex = 0;
+      VkDeviceMemory memory;
+      vkAllocateMemory(device, &info, nullptr, &memory);
+      live.push_back(memory);
+      peak_allocations = std::max(peak_allocations, live.size());
+    } else {
+      vkFreeMemory(device, TakeSlot(live, operation.slot), nullptr);
+    }
+  }
+  for (VkDeviceMemory memory : live) {
+    vkFreeMemory(device, memory, nullptr);
+  }
+}
+
+void RunAllocator(const std::vector<Operation>& operations,
+                  size_t& peak_allocations,
+                  Allocator::Stats& final_stats) {
+  Allocator allocator(mock::GetPhysicalDevice(), mock::GetDevice());
+  std::vector<Allocation> live;
+  peak_allocations = 0;
+  for (const Operation& operation : operations) {
+    if (operation.allocate) {
+      live.push_back(allocator.Allocate(operation.requirements,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                        operation.kind));
+      peak_allocations = std::max(peak_allocations,
+                                  mock::GetMemoryStats().live_allocations);
+    } else {
+      allocator.Free(TakeSlot(live, operation.slot));
+    }
+  }
+  final_stats = allocator.GetStats();
+  for (const Allocation& allocation : live) {
+    allocator.Free(allocation);
+  }
+}
+
+void RunRangeAllocator(const std::vector<Operation>& operations) {
+  RangeAllocator allocator(uint64_t{64} << 30);
+  std::vector<RangeAllocator::Range> live;
+  for (const Operation& operation : operations) {
+    if (operation.allocate) {
+      live.push_back(allocator
+                         .Allocate(operation.requirements.size,
+                                   operation.requirements.alignment)
+                         .value());
+    } else {
+      allocator.Free(TakeSlot(live, operation.slot));
+    }
+  }
+}
+}  // namespace
+
+int main() {
+  const int kRepetitions = 5;
+  std::vector<Operation> operations = GenerateOperations();
+  std::cout << operations.size() << " operations, around " << kLiveTarget
+            << " resources live\n";
+
+  // The mock allocates in nanoseconds where drivers take microseconds, and
+  // caps nothing where they allow as few as 4096 live allocations: the peak
+  // counts matter more than the timings here.
+  size_t dedicated_peak = 0;
+  double dedicated_ms = benchmark::Measure(kRepetitions, [&] {
+    RunDedicatedAllocations(operations, dedicated_peak);
+  });
+  benchmark::Report("vkAllocateMemory per resource", dedicated_ms,
+                    operations.size());
+  std::cout << "\tpeak live allocations: " << dedicated_peak << '\n';
+
+  size_t allocator_peak = 0;
+  Allocator::Stats stats = {};
+  double allocator_ms = benchmark::Measure(kRepetitions, [&] {
+    RunAllocator(operations, allocator_peak, stats);
+  });
+  benchmark::Report("Allocator", allocator_ms, operations.size());
+  std::cout << "\tpeak live allocations: " << allocator_peak << '\n';
+  std::cout << "\tfinal blocks: " << stats.block_count << ", occupancy "
+            << 100.0 * static_cast<double>(stats.used) /
+                   static_cast<double>(stats.reserved)
+            << "%, fragmentation " << 100.0f * stats.fragmentation << "%\n";
+
+  double range_ms = benchmark::Measure(
+      kRepetitions, [&] { RunRangeAllocator(operations); });
+  benchmark::Report("RangeAllocator alone", range_ms, operations.size());
+  return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+namespace benchmark {
+// Best of `repetitions` runs of `run`, in milliseconds: the fastest run is
+// the one the rest of the system disturbed the least.
+template <typename Function>
+double Measure(int repetitions, Function run) {
+  double best_ms = 0.0;
+  for (int i = 0; i < repetitions; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    best_ms = i == 0 ? ms : std::min(best_ms, ms);
+  }
+  return best_ms;
+}
+
+inline void Report(const std::string& name,
+                   double ms,
+                   size_t operation_count) {
+  std::cout << name << ": " << ms << " ms, "
+            << ms * 1e6 / static_cast<double>(operation_count)
+            << " ns per operation\n";
+}
+}  // namespace benchmark
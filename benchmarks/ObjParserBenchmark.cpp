@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.hpp"
+// ParseObj is compared with the tinyobj parser it replaced, built here only.
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "render/ObjParser.hpp"
+
+namespace {
+// A `size` by `size` grid of quads with positions, normals and texture
+// coordinates, written with six decimals like most exporters do.
+void WriteGrid(const std::string& path, int size) {
+  std::ofstream file(path, std::ios::binary);
+  char line[128];
+  for (int y = 0; y <= size; ++y) {
+    for (int x = 0; x <= size; ++x) {
+      float u = static_cast<float>(x) / static_cast<float>(size);
+      float v = static_cast<float>(y) / static_cast<float>(size);
+      std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", u * 2 - 1,
+                    0.1f * u * v, v * 2 - 1);
+      file << line;
+      std::snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", 0.0f, 1.0f,
+                    0.0f);
+      file << line;
+      std::snprintf(line, sizeof(line), "vt %.6f %.6f\n", u, v);
+      file << line;
+    }
+  }
+  for (int y = 0; y < size; ++y) {
+    file << "g row" << y << "\nusemtl material" << y % 4 << '\n';
+    for (int x = 0; x < size; ++x) {
+      int i = y * (size + 1) + x + 1;
+      int j = i + size + 1;
+      std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d", i, i, i,
+                    i + 1, i + 1, i + 1);
+      file << line;
+      std::snprintf(line, sizeof(line), " %d/%d/%d %d/%d/%d\n", j + 1, j + 1,
+                    j + 1, j, j, j);
+      file << line;
+    }
+  }
+}
+}  // namespace
+
+// Parses the file given on the command line, or a generated 1000 by 1000
+// grid of quads.
+int main(int argc, char** argv) {
+  const int kRepetitions = 3;
+  std::string path;
+  if (argc > 1) {
+    path = argv[1];
+  } else {
+    path = (std::filesystem::temp_directory_path() / "obj_benchmark.obj")
+               .string();
+    WriteGrid(path, 1000);
+  }
+  std::cout << path << ": " << std::filesystem::file_size(path) / 1000000
+            << " MB, " << std::thread::hardware_concurrency()
+            << " hardware threads\n";
+
+  size_t index_count = 0;
+  double tinyobj_ms = benchmark::Measure(kRepetitions, [&] {
+    tinyobj::attrib_t attributes;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string error;
+    tinyobj::LoadObj(&attributes, &shapes, &materials, &error, path.c_str(),
+                     nullptr, true);
+    index_count = 0;
+    for (const tinyobj::shape_t& shape : shapes) {
+      index_count += shape.mesh.indices.size();
+    }
+  });
+  benchmark::Report("tinyobj::LoadObj", tinyobj_ms, index_count / 3);
+
+  double parse_ms = benchmark::Measure(kRepetitions, [&] {
+    tinyobj::attrib_t attributes;
+    std::vector<tinyobj::index_t> indices;
+    std::vector<render::ObjGroup> groups;
+    std::string error;
+    if (!render::ParseObj(path, attributes, indices, groups, error)) {
+      std::cerr << "ParseObj failed: " << error << '\n';
+    }
+  });
+  benchmark::Report("ParseObj", parse_ms, index_count / 3);
+  std::cout << "\tspeedup: " << tinyobj_ms / parse_ms << "x\n";
+
+  if (argc <= 1) {
+    std::filesystem::remove(path);
+  }
+  return 0;
+}
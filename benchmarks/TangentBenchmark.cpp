@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.hpp"
+#include "render/TangentGenerator.hpp"
+
+using render::Vertex;
+
+namespace {
+const float kPi = 3.14159265358979f;
+
+// A uv sphere of `segments` by `rings` quads, split in two triangles each,
+// the uvs wrapping once around it with a seam of duplicated vertices.
+void MakeSphere(int segments,
+                int rings,
+                std::vector<uint32_t>& indices,
+                std::vector<Vertex>& vertices) {
+  for (int ring = 0; ring <= rings; ++ring) {
+    float v = static_cast<float>(ring) / static_cast<float>(rings);
+    for (int segment = 0; segment <= segments; ++segment) {
+      float u = static_cast<float>(segment) / static_cast<float>(segments);
+      glm::vec3 position(std::sin(v * kPi) * std::cos(u * 2.0f * kPi),
+                         std::cos(v * kPi),
+                         std::sin(v * kPi) * std::sin(u * 2.0f * kPi));
+      vertices.push_back(Vertex{position, position, glm::vec3(1.0f),
+                                glm::vec2(u, v), glm::vec4(0.0f)});
+    }
+  }
+  for (int ring = 0; ring < rings; ++ring) {
+    for (int segment = 0; segment < segments; ++segment) {
+      uint32_t i = static_cast<uint32_t>(ring * (segments + 1) + segment);
+      uint32_t j = i + static_cast<uint32_t>(segments + 1);
+      indices.insert(indices.end(), {i, j, i + 1, i + 1, j, j + 1});
+    }
+  }
+}
+
+// The previous path, once run while welding: each vertex takes the flat
+// tangent of the first triangle using it, and a bitangent built from the
+// wrong uv deltas.
+void GenerateFlatTangents(const std::vector<uint32_t>& indices,
+                          std::vector<Vertex>& vertices,
+                          std::vector<glm::vec3>& bitangents) {
+  std::vector<bool> is_set(vertices.size(), false);
+  bitangents.resize(vertices.size());
+  for (size_t offset = 0; offset < indices.size(); offset += 3) {
+    const uint32_t* corners = &indices[offset];
+    if (is_set[corners[0]] && is_set[corners[1]] && is_set[corners[2]]) {
+      continue;
+    }
+    const Vertex& v1 = vertices[corners[0]];
+    const Vertex& v2 = vertices[corners[1]];
+    const Vertex& v3 = vertices[corners[2]];
+    glm::vec3 dp1 = v2.position - v1.position;
+    glm::vec3 dp2 = v3.position - v1.position;
+    glm::vec2 duv1 = v2.uv - v1.uv;
+    glm::vec2 duv2 = v3.uv - v1.uv;
+    float f = 1.0f / (duv1.x * duv2.y - duv2.x * duv1.y);
+    glm::vec3 tangent = glm::normalize((dp1 * duv2.y - dp2 * duv1.y) * f);
+    glm::vec3 bitangent = glm::normalize((dp2 * duv1.y - dp1 * duv2.y) * f);
+    for (size_t i = 0; i < 3; ++i) {
+      if (!is_set[corners[i]]) {
+        is_set[corners[i]] = true;
+        vertices[corners[i]].tangent = glm::vec4(tangent, 1.0f);
+        bitangents[corners[i]] = bitangent;
+      }
+    }
+  }
+}
+
+// GenerateTangents' algorithm one triangle, then one vertex, at a time.
+void GenerateScalarTangents(const std::vector<uint32_t>& indices,
+                            std::vector<Vertex>& vertices) {
+  std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f));
+  std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.0f));
+  for (size_t offset = 0; offset < indices.size(); offset += 3) {
+    const uint32_t* corners = &indices[offset];
+    const Vertex& v0 = vertices[corners[0]];
+    const Vertex& v1 = vertices[corners[1]];
+    const Vertex& v2 = vertices[corners[2]];
+    glm::vec3 dp1 = v1.position - v0.position;
+    glm::vec3 dp2 = v2.position - v0.position;
+    glm::vec2 duv1 = v1.uv - v0.uv;
+    glm::vec2 duv2 = v2.uv - v0.uv;
+    glm::vec3 tangent = dp1 * duv2.y - dp2 * duv1.y;
+    glm::vec3 bitangent = dp2 * duv1.x - dp1 * duv2.x;
+    float determinant = duv1.x * duv2.y - duv2.x * duv1.y;
+    float area = glm::length(glm::cross(dp1, dp2)) *
+                 (determinant > 0.0f ? 1.0f : determinant < 0.0f ? -1.0f
+                                                                 : 0.0f);
+    tangent = tangent * (area / std::max(glm::length(tangent), 1e-30f));
+    bitangent = bitangent * (area / std::max(glm::length(bitangent), 1e-30f));
+    for (size_t i = 0; i < 3; ++i) {
+      tangents[corners[i]] += tangent;
+      bitangents[corners[i]] += bitangent;
+    }
+  }
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    glm::vec3 normal = glm::normalize(vertices[i].normal);
+    glm::vec3 tangent =
+        tangents[i] - normal * glm::dot(normal, tangents[i]);
+    tangent = tangent / std::max(glm::length(tangent), 1e-30f);
+    if (glm::dot(tangent, tangent) < 0.5f) {
+      glm::vec3 axis = std::abs(normal.x) < 0.9f
+                           ? glm::vec3(1.0f, 0.0f, 0.0f)
+                           : glm::vec3(0.0f, 1.0f, 0.0f);
+      tangent = glm::normalize(glm::cross(normal, axis));
+    }
+    float handedness = glm::dot(glm::cross(normal, tangent), bitangents[i]);
+    vertices[i].tangent = glm::vec4(tangent, handedness < 0.0f ? -1.0f : 1.0f);
+  }
+}
+}  // namespace
+
+int main() {
+  const int kRepetitions = 5;
+  std::vector<uint32_t> indices;
+  std::vector<Vertex> vertices;
+  MakeSphere(1000, 500, indices, vertices);
+  const size_t triangle_count = indices.size() / 3;
+  std::cout << triangle_count << " triangles, " << vertices.size()
+            << " vertices, " << std::thread::hardware_concurrency()
+            << " hardware threads\n";
+
+  std::vector<Vertex> flat = vertices;
+  std::vector<glm::vec3> flat_bitangents;
+  double flat_ms = benchmark::Measure(kRepetitions, [&] {
+    GenerateFlatTangents(indices, flat, flat_bitangents);
+  });
+  benchmark::Report("flat, first triangle (previous)", flat_ms,
+                    triangle_count);
+
+  std::vector<Vertex> scalar = vertices;
+  double scalar_ms = benchmark::Measure(
+      kRepetitions, [&] { GenerateScalarTangents(indices, scalar); });
+  benchmark::Report("smooth, scalar", scalar_ms, triangle_count);
+
+  std::vector<Vertex> smooth = vertices;
+  double smooth_ms = benchmark::Measure(
+      kRepetitions, [&] { render::GenerateTangents(indices, smooth); });
+  benchmark::Report("GenerateTangents", smooth_ms, triangle_count);
+  std::cout << "\tspeedup: " << flat_ms / smooth_ms << "x over flat, "
+            << scalar_ms / smooth_ms << "x over scalar\n";
+
+  // Both smooth variants sum in the same order and should agree but for
+  // rounding.
+  float max_difference = 0.0f;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    max_difference = std::max(
+        max_difference, glm::length(smooth[i].tangent - scalar[i].tangent));
+  }
+  std::cout << "\tlargest difference from scalar: " << max_difference << '\n';
+  return max_difference < 1e-3f ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "Benchmark.hpp"
+#include "hash.hpp"
+#include "render/Vertex.hpp"
+#include "render/VertexWelder.hpp"
+
+using render::Vertex;
+using render::VertexWelder;
+
+namespace {
+struct VertexHash {
+  size_t operator()(const Vertex& vertex) const noexcept {
+    size_t seed = 0;
+    hash_combine(seed, vertex.position);
+    hash_combine(seed, vertex.normal);
+    hash_combine(seed, vertex.uv);
+    return seed;
+  }
+};
+
+struct VertexEqual {
+  bool operator()(const Vertex& a, const Vertex& b) const {
+    return a.position == b.position && a.normal == b.normal && a.uv == b.uv;
+  }
+};
+
+struct IndexHash {
+  size_t operator()(const tinyobj::index_t& index) const noexcept {
+    size_t seed = 0;
+    hash_combine(seed, index.vertex_index);
+    hash_combine(seed, index.normal_index);
+    hash_combine(seed, index.texcoord_index);
+    return seed;
+  }
+};
+
+struct IndexEqual {
+  bool operator()(const tinyobj::index_t& a,
+                  const tinyobj::index_t& b) const {
+    return a.vertex_index == b.vertex_index &&
+           a.normal_index == b.normal_index &&
+           a.texcoord_index == b.texcoord_index;
+  }
+};
+
+// The corners of a `size` by `size` grid of quads split in two triangles,
+// each vertex with a position, normal and uv of its own, as exporters write
+// smooth meshes.
+void MakeGrid(int size,
+              tinyobj::attrib_t& attributes,
+              std::vector<tinyobj::index_t>& corners) {
+  for (int y = 0; y <= size; ++y) {
+    for (int x = 0; x <= size; ++x) {
+      float u = static_cast<float>(x) / static_cast<float>(size);
+      float v = static_cast<float>(y) / static_cast<float>(size);
+      attributes.vertices.insert(attributes.vertices.end(), {u, 0.0f, v});
+      attributes.normals.insert(attributes.normals.end(), {0.0f, 1.0f, u});
+      attributes.texcoords.insert(attributes.texcoords.end(), {u, v});
+    }
+  }
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      int i = y * (size + 1) + x;
+      int j = i + size + 1;
+      for (int corner : {i, i + 1, j + 1, i, j + 1, j}) {
+        corners.push_back(tinyobj::index_t{corner, corner, corner});
+      }
+    }
+  }
+}
+
+Vertex MakeVertex(const tinyobj::attrib_t& attributes,
+                  const tinyobj::index_t& index) {
+  const float* position = &attributes.vertices[index.vertex_index * 3];
+  const float* normal = &attributes.normals[index.normal_index * 3];
+  const float* uv = &attributes.texcoords[index.texcoord_index * 2];
+  return Vertex{glm::vec3{position[0], position[1], position[2]},
+                glm::vec3{normal[0], normal[1], normal[2]},
+                glm::vec3{1.0f, 1.0f, 1.0f}, glm::vec2{uv[0], uv[1]},
+                glm::vec4(0.0f)};
+}
+}  // namespace
+
+int main() {
+  const int kRepetitions = 5;
+  tinyobj::attrib_t attributes;
+  std::vector<tinyobj::index_t> corners;
+  MakeGrid(1000, attributes, corners);
+  std::vector<uint32_t> indices(corners.size());
+  std::vector<Vertex> vertices;
+  std::cout << corners.size() << " corners, "
+            << attributes.vertices.size() / 3 << " vertices\n";
+
+  // What ConsolidateIndices did before welding on index triples: every
+  // corner expanded and hashed by value.
+  double value_ms = benchmark::Measure(kRepetitions, [&] {
+    std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> ids;
+    vertices.clear();
+    for (size_t i = 0; i < corners.size(); ++i) {
+      Vertex vertex = MakeVertex(attributes, corners[i]);
+      auto inserted =
+          ids.emplace(vertex, static_cast<uint32_t>(vertices.size()));
+      if (inserted.second) {
+        vertices.push_back(vertex);
+      }
+      indices[i] = inserted.first->second;
+    }
+  });
+  benchmark::Report("std::unordered_map on values", value_ms,
+                    corners.size());
+  const size_t expected_count = vertices.size();
+
+  double triple_ms = benchmark::Measure(kRepetitions, [&] {
+    std::unordered_map<tinyobj::index_t, uint32_t, IndexHash, IndexEqual> ids;
+    vertices.clear();
+    for (size_t i = 0; i < corners.size(); ++i) {
+      auto inserted = ids.emplace(corners[i],
+                                  static_cast<uint32_t>(vertices.size()));
+      if (inserted.second) {
+        vertices.push_back(MakeVertex(attributes, corners[i]));
+      }
+      indices[i] = inserted.first->second;
+    }
+  });
+  benchmark::Report("std::unordered_map on index triples", triple_ms,
+                    corners.size());
+
+  // Sized like ConsolidateIndices sizes it.
+  double welder_ms = benchmark::Measure(kRepetitions, [&] {
+    VertexWelder welder(corners.size() / 4);
+    vertices.clear();
+    for (size_t i = 0; i < corners.size(); ++i) {
+      auto id = welder.Insert(corners[i]);
+      if (id.second) {
+        vertices.push_back(MakeVertex(attributes, corners[i]));
+      }
+      indices[i] = id.first;
+    }
+  });
+  benchmark::Report("VertexWelder", welder_ms, corners.size());
+  if (vertices.size() != expected_count) {
+    std::cerr << "vertex counts differ\n";
+    return 1;
+  }
+  std::cout << "\tspeedup: " << value_ms / welder_ms
+            << "x over values, " << triple_ms / welder_ms
+            << "x over triples\n";
+  return 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads draining a FIFO of jobs. Jobs still queued
+// when the pool is destroyed are dropped; the ones already running are
+// waited for.
+class ThreadPool {
+ public:
+  // A thread count of 0 picks one worker per hardware thread, minus the
+  // main one.
+  explicit ThreadPool(size_t thread_count = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  const ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  void Submit(std::function<void()> job);
+  size_t GetThreadCount() const { return threads_.size(); }
+
+ private:
+  void Work();
+
+  std::mutex mutex_ = {};
+  std::condition_variable condition_ = {};
+  std::deque<std::function<void()>> jobs_ = {};
+  bool stop_ = false;
+  std::vector<std::thread> threads_ = {};
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -54,3 +56,22 @@ void hash_combine(std::size_t& seed, const T& x) {
   std::size_t hash = std::hash<T>{}(x);
   seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 }
+
+// Hashes a whole buffer 8 bytes at a time, for identifying file contents.
+// Not meant to resist deliberate collisions.
+inline uint64_t hash_bytes(const void* data, size_t size) {
+  const uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  uint64_t hash = 0xcbf29ce484222325ull ^ size;
+  size_t offset = 0;
+  for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + offset, sizeof(word));
+    hash = (hash ^ word) * kMultiplier;
+    hash ^= hash >> 32;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, bytes + offset, size - offset);
+  hash = (hash ^ tail) * kMultiplier;
+  return hash ^ (hash >> 29);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace render {
+enum class CookResult {
+  kCooked,
+  kUpToDate,  ///< outputs were already cooked from the same contents
+  kFailed,
+};
+
+// Path of the texture the asset cooker writes for an image file: a KTX2 file
+// holding the full sRGB RGBA8 mip chain, which uploads without conversion.
+std::string GetCookedTexturePath(const std::string& source_path);
+
+// Cooks an OBJ or GLB file into a mesh per vertex format, next to it, see
+// GetCookedMeshPath. Outputs recording the same source hash, loader version
+// and settings are kept unless `force` is set. A nonzero `import_budget`
+// streams the file through, see MeshLoader.
+CookResult CookMesh(const std::string& source_path,
+                    bool optimize,
+                    size_t import_budget,
+                    bool force);
+// Cooks an image file SDL_image can decode into GetCookedTexturePath, with
+// the same rules as CookMesh.
+CookResult CookTexture(const std::string& source_path, bool force);
+}  // namespace render
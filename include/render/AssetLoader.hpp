@@ -0,0 +1,161 @@
+#pragma once
+
+#include <SDL.h>
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "ThreadPool.hpp"
+#include "base.hpp"
+#include "render/AssetPack.hpp"
+#include "render/MeshSimplifier.hpp"
+#include "render/Meshlet.hpp"
+#include "render/SubMesh.hpp"
+#include "render/Vertex.hpp"
+#include "span.hpp"
+#include "system.hpp"
+
+namespace render {
+// Reads, parses and decodes assets on worker threads. Results wait in a
+// queue until the render thread collects them, since it is the only one
+// allowed to create and upload GPU resources.
+class AssetLoader {
+ public:
+  // Meshes read from a cooked file or their cache point into its mapping,
+  // those from an asset pack into the pack or `file_storage`, and freshly
+  // parsed ones into the storage vectors, whose buffers survive moving the
+  // struct. Meshes in the packed format only fill
+  // `packed_vertices` and `bounds` out of the vertex data. `indices` holds
+  // every level of detail of every sub-mesh, `lods` has a range for each,
+  // level by level.
+  struct MeshData {
+    ResourceId id;
+    VertexFormat format;
+    Span<const Vertex> vertices;
+    Span<const PackedVertex> packed_vertices;
+    Span<const uint32_t> indices;
+    std::vector<Vertex> vertex_storage;
+    std::vector<PackedVertex> packed_vertex_storage;
+    std::vector<uint32_t> index_storage;
+    std::unique_ptr<MappedFile> cache_file;
+    std::vector<uint8_t> file_storage;
+    MeshBounds bounds;
+    std::vector<SubMesh> sub_meshes;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    glm::vec4 bounding_sphere;  ///< xyz center, w radius
+  };
+
+  // Image files decoded by SDL_image come as a surface in whatever format
+  // the decoder produced, top row first; whoever takes it is responsible for
+  // converting it with WriteRgba32Rows and freeing it. KTX2 files and
+  // CPU-built mip chains come as packed levels.
+  struct ImageData {
+    ResourceId id;
+    std::string path;
+    uint64_t content_hash;  ///< hash_bytes of the whole file
+    uint32_t width;
+    uint32_t height;
+    VkFormat format;
+    uint32_t mip_levels;
+    uint32_t level_count;  ///< levels provided, the rest are blitted
+    SDL_Surface* surface;
+    std::vector<uint8_t> pixels;
+    float load_time_ms;
+  };
+
+  // When `generate_mips` is set, decoded images come with their full mip
+  // chain, for devices that can't blit their format with linear filtering.
+  // Compressed textures in a format missing from `sampled_formats` are
+  // decoded to RGBA8 when possible. With `use_cooked_assets`, the files the
+  // asset cooker left next to sources are loaded instead of them, see
+  // AssetCooker.hpp. With `use_mesh_cache`, other meshes go through their
+  // binary cache, see MeshCache.hpp. With `optimize_meshes`, freshly parsed
+  // meshes are reordered for the GPU, see MeshOptimizer.hpp. A nonzero
+  // `mesh_import_budget` streams OBJ files through, see MeshLoader.
+  AssetLoader(bool generate_mips,
+              std::unordered_set<VkFormat> sampled_formats,
+              bool use_cooked_assets,
+              bool use_mesh_cache,
+              bool optimize_meshes,
+              size_t mesh_import_budget);
+  ~AssetLoader();
+
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader(AssetLoader&&) = delete;
+  const AssetLoader& operator=(const AssetLoader&) = delete;
+  AssetLoader& operator=(AssetLoader&&) = delete;
+
+  // Serves the cooked assets under `mount_point` from the pack at
+  // `pack_path` when it opens, to be called before loading anything. Packs
+  // are ignored along with other cooked assets without `use_cooked_assets`.
+  // With `record_access_order`, the names of the files first requested
+  // under `mount_point` are written in order to `pack_path` + ".order" on
+  // destruction, whether the pack exists or not, for the asset cooker to
+  // lay out the next pack.
+  void MountPack(const std::string& pack_path,
+                 const std::string& mount_point,
+                 bool record_access_order);
+
+  void LoadMesh(ResourceId id, const std::string& path, VertexFormat format);
+  void LoadImage(ResourceId id, const std::string& path);
+
+  // Converts rows [first_row, first_row + row_count) of a decoded surface to
+  // tightly packed RGBA32 at `dst`.
+  static void WriteRgba32Rows(SDL_Surface* surface,
+                              uint8_t* dst,
+                              uint32_t first_row,
+                              uint32_t row_count);
+
+  std::vector<MeshData> TakeMeshes();
+  std::vector<ImageData> TakeImages();
+  // Ids of the assets that failed to load, reported once, the errors having
+  // been logged already.
+  std::vector<ResourceId> TakeFailedMeshIds();
+  std::vector<ResourceId> TakeFailedImageIds();
+  // Jobs queued or running, not counting results waiting to be taken.
+  size_t GetPendingCount() const;
+
+ private:
+  bool LoadMeshData(const std::string& path, MeshData& mesh) const;
+  bool LoadCookedMesh(const std::string& path, MeshData& mesh) const;
+  // Maps a GLB file and draws it as is, with a level of detail per
+  // primitive and no meshlets: those come from cooking it. See Glb.hpp.
+  bool LoadGlbMesh(const std::string& path, MeshData& mesh) const;
+  bool DecodeImage(ImageData& image, Span<const uint8_t> file) const;
+  bool LoadCompressedImage(ImageData& image, Span<const uint8_t> file) const;
+  // Reads a file under the mount point from the pack, see MountPack.
+  bool ReadPackedFile(const std::string& path,
+                      std::vector<uint8_t>& storage,
+                      Span<const uint8_t>& contents) const;
+  // Same, falling back to the file itself.
+  bool ReadAssetFile(const std::string& path,
+                     std::vector<uint8_t>& storage,
+                     Span<const uint8_t>& contents) const;
+  void WriteAccessOrder() const;
+
+  mutable std::mutex mutex_ = {};
+  std::vector<MeshData> meshes_ = {};
+  std::vector<ImageData> images_ = {};
+  std::vector<ResourceId> failed_mesh_ids_ = {};
+  std::vector<ResourceId> failed_image_ids_ = {};
+  size_t pending_count_ = 0;
+  mutable std::vector<std::string> accessed_names_ = {};
+  mutable std::unordered_set<std::string> accessed_name_set_ = {};
+  bool generate_mips_;
+  std::unordered_set<VkFormat> sampled_formats_;
+  bool use_cooked_assets_;
+  bool use_mesh_cache_;
+  bool optimize_meshes_;
+  size_t mesh_import_budget_;
+  std::unique_ptr<AssetPack> pack_ = {};
+  std::string pack_path_ = {};
+  std::string pack_mount_point_ = {};  ///< with a trailing slash
+  bool record_access_order_ = false;
+  std::unique_ptr<ThreadPool> thread_pool_ = {};
+};
+}  // namespace render
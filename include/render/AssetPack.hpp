@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.hpp"
+#include "base.hpp"
+#include "span.hpp"
+#include "system.hpp"
+
+namespace render {
+// Single file holding many assets, so that loading them costs one open and
+// mostly sequential reads instead of a scattered open and read per file.
+//
+// Entries are keyed by the ResourceId of their name, a path relative to the
+// directory the pack was built from, in an open-addressed table mapped
+// along with the rest. Their data is 16-byte aligned, so that uncompressed
+// entries are used in place from the mapping; compressed ones are split in
+// chunks of LZ4 blocks that decompress independently. Entries are stored in
+// the order they are listed when building, which should be the order they
+// are first loaded in so that a cold start reads the file front to back.
+// Like the mesh cache, the format uses the native endianness.
+class AssetPack {
+ public:
+  // Laid out in AssetPack.cpp.
+  struct Entry;
+  struct Chunk;
+
+  AssetPack() = default;
+
+  AssetPack(const AssetPack&) = delete;
+  AssetPack(AssetPack&&) = delete;
+  const AssetPack& operator=(const AssetPack&) = delete;
+  AssetPack& operator=(AssetPack&&) = delete;
+
+  // Fails for missing or corrupt packs.
+  bool Open(const std::string& path);
+
+  bool Contains(ResourceId id) const;
+  // Uncompressed entries point into the mapping, compressed ones into
+  // `storage`, decompressed by the calling thread with the help of
+  // `thread_pool`. Fails for missing or corrupt entries.
+  bool Read(ResourceId id,
+            ThreadPool& thread_pool,
+            std::vector<uint8_t>& storage,
+            Span<const uint8_t>& data) const;
+
+  // Stable across runs and platforms, unlike std::hash.
+  static ResourceId GetId(const std::string& name);
+
+ private:
+  const Entry* FindEntry(ResourceId id) const;
+
+  MappedFile file_ = {};
+  Span<const Entry> entries_ = {};
+  Span<const uint32_t> slots_ = {};  ///< entry index + 1, 0 when empty
+  Span<const Chunk> chunks_ = {};
+  uint32_t chunk_size_ = 0;
+};
+
+struct AssetPackSource {
+  std::string name;  ///< key of the entry, see AssetPack
+  std::string path;  ///< file holding its data
+};
+
+// Packs `sources` in order, writing to a temporary file first. With
+// `compress`, chunks LZ4 doesn't shrink are kept uncompressed, as are
+// entries none of whose chunks shrink.
+bool WriteAssetPack(const std::string& path,
+                    const std::vector<AssetPackSource>& sources,
+                    bool compress,
+                    std::string& error);
+}  // namespace render
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace render {
+// CPU decoding of block-compressed textures, for devices that can't sample
+// the format they were shipped in. BC1, BC3 and BC5 are handled.
+
+// Uncompressed format the data of `format` decodes to, VK_FORMAT_UNDEFINED
+// when the decoder doesn't handle it.
+VkFormat GetDecodedFormat(VkFormat format);
+
+// Decodes `level_count` tightly packed levels into RGBA8 levels, tightly
+// packed as well.
+std::vector<uint8_t> DecodeBlocks(VkFormat format,
+                                  const uint8_t* data,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  uint32_t level_count);
+}  // namespace render
@@ -1,12 +1,16 @@
 #pragma once
 
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
 #include "base.hpp"
 
 namespace render {
 struct Frame {
   struct UniformBlock {
     std::vector<uint8_t> data;
-    uint32_t offset;
   };
 
   struct Pass {
@@ -14,10 +18,20 @@ struct Frame {
       UniformBlock uniform_block;
       ResourceId mesh_id;
       ResourceId material_id;
+      glm::mat4 world_matrix;  ///< for culling and level of detail selection
+      // Sub-meshes drawn, all of them by default. Sub-meshes without a
+      // material of their own, or whose material isn't resident, use
+      // `material_id`.
+      uint32_t first_sub_mesh = 0;
+      uint32_t sub_mesh_count = UINT32_MAX;
     };
 
+    // Uniform blocks are opaque to the render system, so what culling and
+    // level of detail selection need from the camera is repeated here.
     UniformBlock uniform_block;
     std::vector<RenderObject> render_objects;
+    glm::mat4 view_matrix;
+    glm::mat4 projection_matrix;  ///< perspective
   };
 
   std::vector<Pass> passes;
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "render/SubMesh.hpp"
+#include "render/Vertex.hpp"
+#include "span.hpp"
+
+namespace render {
+// Geometry of a binary glTF file. Each sub-mesh indexes vertices from its
+// vertex_offset on, as glTF primitives index their own attributes.
+struct GlbMesh {
+  Span<const Vertex> vertices;        ///< into the file or vertex_storage
+  Span<const uint32_t> indices;       ///< into the file or index_storage
+  std::vector<Vertex> vertex_storage;
+  std::vector<uint32_t> index_storage;
+  std::vector<SubMesh> sub_meshes;
+  size_t converted_size;  ///< bytes written to the storage vectors
+};
+
+// Reads every triangle primitive of every mesh in a glTF 2.0 binary (GLB)
+// file as a sub-mesh, in their own space: like OBJ groups, primitives are
+// loaded whatever nodes place them. Material ids hash the material name,
+// as they do OBJ usemtl names.
+//
+// Data already in upload layout is used in place from the BIN chunk:
+// 32-bit indices stored back to back across primitives, and vertices
+// interleaved exactly like Vertex. The rest is converted: smaller indices
+// are widened with SIMD, attributes gathered into Vertex and normalized
+// integers turned into floats. Missing normals are left null, colors white
+// and tangents generated as for OBJ files. Texture coordinates keep glTF's
+// top-left origin, the one textures are uploaded with.
+//
+// `file` must outlive the spans of `mesh`. Buffers other than the BIN
+// chunk, sparse accessors and quantized positions aren't supported.
+// Returns false and describes the problem in `error` on failure.
+bool ParseGlb(Span<const uint8_t> file, GlbMesh& mesh, std::string& error);
+}  // namespace render
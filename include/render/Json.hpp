@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace render {
+// Document tree of a JSON text, enough for glTF. Numbers are doubles and
+// objects keep their members in file order, looked up linearly, which beats
+// a map for the handful of keys glTF objects have.
+class JsonValue {
+ public:
+  enum class Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  Type GetType() const { return type_; }
+  bool IsNull() const { return type_ == Type::kNull; }
+  bool IsNumber() const { return type_ == Type::kNumber; }
+  bool IsString() const { return type_ == Type::kString; }
+  bool IsArray() const { return type_ == Type::kArray; }
+  bool IsObject() const { return type_ == Type::kObject; }
+
+  // Values of another type read as `fallback`, or an empty string.
+  bool GetBool(bool fallback) const;
+  double GetNumber(double fallback) const;
+  const std::string& GetString() const;
+
+  // Elements of arrays, members of objects, 0 for other types.
+  size_t GetSize() const { return elements_.size(); }
+  // Missing elements and members read as null.
+  const JsonValue& operator[](size_t index) const;
+  const JsonValue& operator[](const std::string& key) const;
+  // Name of member `index` of an object.
+  const std::string& GetKey(size_t index) const;
+
+ private:
+  friend class JsonParser;
+
+  Type type_ = Type::kNull;
+  bool bool_ = false;
+  double number_ = 0.0;
+  std::string string_ = {};
+  std::vector<JsonValue> elements_ = {};  ///< also the values of members
+  std::vector<std::string> keys_ = {};    ///< objects only
+};
+
+// Parses RFC 8259 JSON, nested at most 64 levels deep. Returns false and
+// describes the problem in `error` on failure.
+bool ParseJson(const char* begin,
+               const char* end,
+               JsonValue& value,
+               std::string& error);
+}  // namespace render
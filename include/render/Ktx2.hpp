@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace render {
+struct Ktx2Image {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t level_count;
+  std::vector<uint8_t> data;  ///< levels tightly packed, level 0 first
+  std::vector<std::pair<std::string, std::string>> key_values;
+};
+
+// Reads a KTX2 container holding a single 2D texture. Supercompressed files
+// (Basis Universal, Zstandard) are rejected since there is no transcoder in
+// the tree. Returns false and describes the problem in `error` on failure.
+bool LoadKtx2(const std::string& path, Ktx2Image& image, std::string& error);
+// Same as LoadKtx2, for a file already in memory.
+bool ParseKtx2(const uint8_t* file,
+               size_t file_size,
+               Ktx2Image& image,
+               std::string& error);
+// Writes `image` and its key/value pairs, through a temporary file so that
+// readers never see a partial one. Only uncompressed RGBA8 formats can be
+// described for now.
+bool WriteKtx2(const std::string& path,
+               const Ktx2Image& image,
+               std::string& error);
+}  // namespace render
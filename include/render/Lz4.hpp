@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace render {
+// Codec for the LZ4 block format, the raw sequences without the frame
+// around them. Blocks decode with any LZ4 implementation, though this
+// greedy compressor trades some ratio for simplicity.
+
+// Space Lz4Compress may need for `size` bytes of input.
+size_t GetLz4CompressBound(size_t size);
+
+// Compresses `size` bytes from `src` into `dst`, returning the compressed
+// size, or 0 when it would exceed `capacity`.
+size_t Lz4Compress(const uint8_t* src,
+                   size_t size,
+                   uint8_t* dst,
+                   size_t capacity);
+
+// Decompresses a block into exactly `size` bytes at `dst`. Fails on corrupt
+// input without reading or writing out of bounds.
+bool Lz4Decompress(const uint8_t* src,
+                   size_t compressed_size,
+                   uint8_t* dst,
+                   size_t size);
+}  // namespace render
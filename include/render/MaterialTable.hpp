@@ -0,0 +1,61 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "base.hpp"
+#include "render/TextureCache.hpp"
+
+namespace render {
+// The textures of each material, holding a reference to each in the texture
+// cache. A material is pending until all of its textures are resident, then
+// resident. One loaded again keeps its textures until the new ones are, being
+// both pending and resident meanwhile.
+//
+// Textures whose last reference is dropped are moved out into `released`,
+// for the caller to destroy once the GPU is done with them.
+class MaterialTable {
+ public:
+  explicit MaterialTable(TextureCache& texture_cache)
+      : texture_cache_(texture_cache) {}
+
+  MaterialTable(const MaterialTable&) = delete;
+  MaterialTable(MaterialTable&&) = delete;
+  const MaterialTable& operator=(const MaterialTable&) = delete;
+  MaterialTable& operator=(MaterialTable&&) = delete;
+
+  // Makes `id` wait on `texture_ids`, instead of whatever it waited on
+  // before. `first_referenced_ids` gets the textures nothing referenced yet,
+  // for the caller to load.
+  void Load(ResourceId id,
+            std::vector<ResourceId> texture_ids,
+            std::vector<ResourceId>& first_referenced_ids,
+            std::vector<Texture>& released);
+  // Returns whether `id` was resident.
+  bool Unload(ResourceId id, std::vector<Texture>& released);
+  // Makes the pending materials whose textures are all resident resident,
+  // returning their ids.
+  std::vector<ResourceId> BindComplete(std::vector<Texture>& released);
+  // Gives up on the pending materials waiting on one of
+  // `failed_texture_ids`, returning their ids.
+  std::vector<ResourceId> DropFailed(
+      const std::unordered_set<ResourceId>& failed_texture_ids,
+      std::vector<Texture>& released);
+
+  bool IsPending(ResourceId id) const { return pending_.count(id) != 0; }
+  // Texture ids of each resident material.
+  const std::unordered_map<ResourceId, std::vector<ResourceId>>& GetResident()
+      const {
+    return resident_;
+  }
+
+ private:
+  void Release(const std::vector<ResourceId>& texture_ids,
+               std::vector<Texture>& released);
+
+  TextureCache& texture_cache_;
+  std::unordered_map<ResourceId, std::vector<ResourceId>> pending_ = {};
+  std::unordered_map<ResourceId, std::vector<ResourceId>> resident_ = {};
+};
+}  // namespace render
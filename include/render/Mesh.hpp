@@ -1,11 +1,24 @@
 #pragma once
 
-#include "render/vulkan/Buffer.hpp"
+#include <vector>
+
+#include "render/MeshSimplifier.hpp"
+#include "render/Meshlet.hpp"
+#include "render/SubMesh.hpp"
+#include "render/Vertex.hpp"
+#include "render/vulkan/GeometryPool.hpp"
+#include "render/vulkan/UploadContext.hpp"
 
 namespace render {
 struct Mesh {
-  std::unique_ptr<vulkan::Buffer> vertex_buffer;
-  std::unique_ptr<vulkan::Buffer> index_buffer;
-  size_t index_count;
+  vulkan::GeometryPool::Allocation geometry;
+  VkIndexType index_type;
+  VertexFormat vertex_format;
+  MeshBounds bounds;  ///< packed format only
+  std::vector<SubMesh> sub_meshes;
+  std::vector<MeshLod> lods;  ///< a range per sub-mesh, finest level first
+  std::vector<Meshlet> meshlets;  ///< of all levels, empty if not built
+  glm::vec4 bounding_sphere;  ///< xyz center, w radius
+  vulkan::UploadTicket upload_ticket;
 };
 }  // namespace render
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "render/MeshSimplifier.hpp"
+#include "render/Meshlet.hpp"
+#include "render/SubMesh.hpp"
+#include "render/Vertex.hpp"
+#include "span.hpp"
+#include "system.hpp"
+
+namespace render {
+// Contents of a mesh cache. Those read from a file point into its mapping.
+struct MeshCacheContents {
+  uint64_t source_hash;  ///< hash_bytes of the source file
+  bool optimized;        ///< whether MeshLoader::Optimize ran
+  VertexFormat format;
+  Span<const Vertex> vertices;               ///< kFloat only
+  Span<const PackedVertex> packed_vertices;  ///< kPacked only
+  MeshBounds bounds;                         ///< kPacked only
+  Span<const uint32_t> indices;
+  Span<const SubMesh> sub_meshes;
+  Span<const MeshLod> lods;
+  Span<const Meshlet> meshlets;
+  glm::vec4 bounding_sphere;  ///< xyz center, w radius
+};
+
+// Derived data cache of MeshLoader's output, stored next to the source file.
+// The blob holds the final vertices and indices in upload layout, each array
+// 16-byte aligned, so reading it back is a mapping rather than a parse, then
+// the tables of sub-meshes, levels of detail and meshlets.
+//
+// A cache is only valid for the MeshLoader::kVersion and vertex layouts it
+// was written with, which reading checks, and for the source contents it
+// records, which is up to the caller. It uses the native endianness, being a
+// local cache rather than a distribution format. Optimized and unoptimized
+// meshes are cached side by side, with float vertices.
+std::string GetMeshCachePath(const std::string& source_path, bool optimized);
+
+// Cooked meshes are caches written ahead of time by the asset cooker, in the
+// vertex format they will be drawn with.
+std::string GetCookedMeshPath(const std::string& source_path,
+                              VertexFormat format);
+
+// Returns false when the cache is missing, from another loader version or
+// corrupt.
+bool ReadMeshCache(const std::string& path,
+                   MappedFile& file,
+                   MeshCacheContents& contents);
+// Same for a cache already in memory, such as an asset pack entry. `data`
+// must be 16-byte aligned and outlive `contents`.
+bool ParseMeshCache(Span<const uint8_t> data, MeshCacheContents& contents);
+// Writes to a temporary file first, so readers never see a partial cache.
+bool WriteMeshCache(const std::string& path,
+                    const MeshCacheContents& contents);
+}  // namespace render
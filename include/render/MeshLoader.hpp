@@ -5,36 +5,95 @@
 #include <string>
 #include <vector>
 
+#include "render/MeshSimplifier.hpp"
+#include "render/Meshlet.hpp"
+#include "render/ObjParser.hpp"
+#include "render/SubMesh.hpp"
 #include "render/Vertex.hpp"
 #include "render/tiny_obj_loader.h"
+#include "span.hpp"
 
 namespace render {
 
 class MeshLoader {
  public:
-  void Load(const std::string& path,
+  // Bump whenever the loader's output changes, to invalidate mesh caches.
+  static constexpr uint32_t kVersion = 6;
+
+  // With a nonzero `import_budget`, in bytes, OBJ files are streamed through
+  // in windows a quarter of its size instead of being parsed whole, which
+  // bounds the memory taken on top of the attributes and the output. Files
+  // whose faces refer to attributes defined after them can't be streamed.
+  explicit MeshLoader(size_t import_budget = 0)
+      : import_budget_(import_budget) {}
+
+  // Loads every shape and material group of the file as a sub-mesh. Each
+  // sub-mesh has vertices of its own, even where it touches another one.
+  // ".glb" files are read with ParseGlb instead, their primitives being
+  // sub-meshes, and their indices made relative to the whole mesh.
+  bool Load(const std::string& path,
             std::vector<uint32_t>& indices,
-            std::vector<Vertex>& vertices) const;
+            std::vector<Vertex>& vertices,
+            std::vector<SubMesh>& sub_meshes) const;
+  // Runs the whole pipeline: Load, GenerateLods, Optimize when `optimize` is
+  // set, then BuildMeshlets.
+  bool LoadAndProcess(const std::string& path,
+                      bool optimize,
+                      std::vector<uint32_t>& indices,
+                      std::vector<Vertex>& vertices,
+                      std::vector<SubMesh>& sub_meshes,
+                      std::vector<MeshLod>& lods,
+                      std::vector<Meshlet>& meshlets) const;
+  // Appends coarser levels of detail to `indices`, each simplified from the
+  // previous one down to about half its triangles. Sub-meshes are simplified
+  // together, the vertices they share a position with being locked, and
+  // `lods` receives a range per sub-mesh for each level, starting with the
+  // full mesh.
+  void GenerateLods(std::vector<uint32_t>& indices,
+                    Span<const Vertex> vertices,
+                    const std::vector<SubMesh>& sub_meshes,
+                    std::vector<MeshLod>& lods) const;
+  // Reorders the triangles of each range of `lods` for the post-transform
+  // cache and overdraw, then vertices for fetch locality, see
+  // MeshOptimizer.hpp.
+  void Optimize(std::vector<uint32_t>& indices,
+                std::vector<Vertex>& vertices,
+                const std::vector<SubMesh>& sub_meshes,
+                const std::vector<MeshLod>& lods) const;
+  // Splits every level into meshlets for culling, see Meshlet.hpp, and
+  // records which of `meshlets` each one is made of.
+  void BuildMeshlets(std::vector<uint32_t>& indices,
+                     Span<const Vertex> vertices,
+                     std::vector<MeshLod>& lods,
+                     std::vector<Meshlet>& meshlets) const;
+  // Sphere enclosing `vertices`, its center in xyz and its radius in w.
+  glm::vec4 ComputeBoundingSphere(Span<const Vertex> vertices) const;
+  // Quantizes `vertices` to the PackedVertex layout against their bounds,
+  // which are returned for the vertex shader to decode positions.
+  MeshBounds Pack(Span<const Vertex> vertices,
+                  std::vector<PackedVertex>& packed) const;
 
  private:
+  bool LoadGlb(const std::string& path,
+               std::vector<uint32_t>& indices,
+               std::vector<Vertex>& vertices,
+               std::vector<SubMesh>& sub_meshes) const;
+  // Welds as it parses, see ObjStreamParser.
+  bool LoadStreamed(const std::string& path,
+                    std::vector<uint32_t>& indices,
+                    std::vector<Vertex>& vertices,
+                    std::vector<SubMesh>& sub_meshes) const;
   void ConsolidateIndices(const tinyobj::attrib_t& attributes,
                           const std::vector<tinyobj::index_t>& tinyobj_indices,
+                          const std::vector<ObjGroup>& groups,
                           std::vector<uint32_t>& indices,
-                          std::vector<Vertex>& vertices) const;
-
-  void ComputeVectors(std::vector<Vertex>& vertices) const;
-
-  glm::vec3 ComputeTangent(const glm::vec3& dp1,
-                           const glm::vec3& dp2,
-                           const glm::vec2& duv1,
-                           const glm::vec2& duv2,
-                           float kf) const;
+                          std::vector<Vertex>& vertices,
+                          std::vector<SubMesh>& sub_meshes) const;
+  // Generates tangents then flips texture coordinates, once welded.
+  void FinishVertices(const std::vector<uint32_t>& indices,
+                      std::vector<Vertex>& vertices) const;
 
-  glm::vec3 ComputeBitangent(const glm::vec3& dp1,
-                             const glm::vec3& dp2,
-                             const glm::vec2& duv1,
-                             const glm::vec2& duv2,
-                             float kf) const;
+  size_t import_budget_ = 0;
 };
 
 }  // namespace render
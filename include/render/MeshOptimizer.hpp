@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "render/Vertex.hpp"
+#include "span.hpp"
+
+namespace render {
+// Post-transform cache size the optimizations target and the analysis
+// simulates. Most GPUs have more room than this, so orders tuned for it
+// remain good on them.
+static constexpr uint32_t kVertexCacheSize = 16;
+
+// Reorders triangles for vertex cache locality with Tipsify (Sander et al.,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"),
+// which fans around vertices while they are likely to be in the cache.
+// `clusters` receives the offset in `indices` of every run of triangles
+// that starts after Tipsify had to jump to a vertex out of the cache.
+void OptimizeVertexCache(std::vector<uint32_t>& indices,
+                         size_t vertex_count,
+                         std::vector<size_t>& clusters);
+
+// Sorts the clusters of a cache optimized index buffer so that the ones
+// facing away from the mesh center, which tend to occlude the rest, are drawn
+// first. Clusters are split further wherever that keeps the cache miss ratio
+// within `threshold` times the one of the whole mesh.
+void OptimizeOverdraw(std::vector<uint32_t>& indices,
+                      Span<const Vertex> vertices,
+                      const std::vector<size_t>& clusters,
+                      float threshold);
+
+// Renumbers vertices in the order the index buffer first references them,
+// so that vertex fetches walk memory forward. Unreferenced vertices are
+// dropped.
+void OptimizeVertexFetch(std::vector<uint32_t>& indices,
+                         std::vector<Vertex>& vertices);
+
+struct MeshStats {
+  float acmr;      ///< vertices transformed per triangle, 0.5 at best
+  float atvr;      ///< vertices transformed per vertex, 1 at best
+  float overdraw;  ///< fragments passing the depth test per covered pixel
+};
+
+// Measures `indices` against a FIFO cache of kVertexCacheSize entries, and
+// overdraw by rasterizing the mesh with a depth test, in submission order,
+// from each side of its bounding box. Neither needs a GPU.
+MeshStats AnalyzeMesh(Span<const Vertex> vertices,
+                      Span<const uint32_t> indices);
+}  // namespace render
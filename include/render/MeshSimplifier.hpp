@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "render/Vertex.hpp"
+#include "span.hpp"
+
+namespace render {
+// Range of a mesh's index buffer holding one level of detail of a
+// sub-mesh. All levels index the same vertices. Levels split into meshlets
+// list them as a range of the mesh's meshlet table, covering the level's
+// indices in order.
+struct MeshLod {
+  uint32_t index_offset;
+  uint32_t index_count;
+  float error;  ///< object space distance to the full detail surface
+  uint32_t meshlet_offset;
+  uint32_t meshlet_count;
+};
+
+// Removes triangles by collapsing edges onto one of their vertices, cheapest
+// first according to the area weighted plane quadrics of Garland and
+// Heckbert, "Surface Simplification Using Quadric Error Metrics". Stops once
+// `target_index_count` is reached or no collapse is cheaper than `max_error`.
+//
+// Vertices are never moved or created, so the result indexes `vertices` like
+// the input does and keeps their attributes. Positions shared by several
+// vertices, i.e. normal or uv seams, are locked in place, vertices on open
+// borders only slide along them, and collapses flipping a triangle are
+// rejected. `error` receives the largest error of the collapses done, as a
+// distance.
+std::vector<uint32_t> SimplifyMesh(Span<const Vertex> vertices,
+                                   Span<const uint32_t> indices,
+                                   size_t target_index_count,
+                                   float max_error,
+                                   float& error);
+}  // namespace render
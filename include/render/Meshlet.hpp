@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "render/Vertex.hpp"
+#include "span.hpp"
+
+namespace render {
+// Sizes matching the usual mesh shader limits, so the same clusters could
+// feed one later on.
+static constexpr uint32_t kMaxMeshletVertices = 64;
+static constexpr uint32_t kMaxMeshletTriangles = 124;
+
+// Cluster of neighboring triangles, drawn as a range of the index buffer.
+// Bounds are in object space.
+struct Meshlet {
+  uint32_t index_offset;
+  uint32_t index_count;
+  glm::vec4 bounding_sphere;  ///< xyz center, w radius
+  glm::vec4 cone;  ///< xyz mean normal, w sine of the spread, 1 if unbounded
+};
+
+// Range of an index buffer to draw.
+struct DrawRange {
+  uint32_t index_offset;
+  uint32_t index_count;
+};
+
+// Reorders the triangles of `indices` into meshlets of at most
+// kMaxMeshletVertices vertices and kMaxMeshletTriangles triangles, grown
+// greedily from each seed over shared vertices, and appends them to
+// `meshlets` with offsets into `indices`. Triangles keep their relative
+// order within a meshlet, so most of a cache optimized order survives.
+void BuildMeshlets(std::vector<uint32_t>& indices,
+                   Span<const Vertex> vertices,
+                   std::vector<Meshlet>& meshlets);
+
+// Appends the index ranges of the meshlets that may be visible, merging
+// contiguous ones but never into the ranges already in `ranges`. Meshlets
+// outside the side or near planes of `projection` are dropped and, with
+// `cull_backfacing`, so are the ones whose triangles all face away from the
+// camera. `world_view` maps object space to a view
+// space looking down -z, and should have no shear for the cone test to hold.
+void CullMeshlets(Span<const Meshlet> meshlets,
+                  const glm::mat4& world_view,
+                  const glm::mat4& projection,
+                  bool cull_backfacing,
+                  std::vector<DrawRange>& ranges);
+}  // namespace render
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace render {
+// Number of levels of a full mip chain, down to 1x1.
+uint32_t ComputeMipLevelCount(uint32_t width, uint32_t height);
+
+// Size in bytes of `level_count` tightly packed levels starting at level 0.
+size_t ComputeMipChainSize(uint32_t width,
+                           uint32_t height,
+                           uint32_t level_count,
+                           uint32_t texel_size);
+
+// CPU fallback for formats the GPU can't blit with linear filtering. Builds
+// the mip chain of an sRGB RGBA8 image with a 2x2 box filter, averaging in
+// linear space. Levels are tightly packed one after the other, level 0
+// included. Odd dimensions clamp to the last row or column.
+std::vector<uint8_t> GenerateMipChain(const uint8_t* pixels,
+                                      uint32_t width,
+                                      uint32_t height,
+                                      uint32_t level_count);
+}  // namespace render
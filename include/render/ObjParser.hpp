@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "render/tiny_obj_loader.h"
+#include "system.hpp"
+
+namespace render {
+// Run of faces between two g, o or usemtl statements.
+struct ObjGroup {
+  size_t index_offset;
+  size_t index_count;
+  std::string material;  ///< name given to usemtl, empty if none
+};
+
+// A g, o or usemtl statement. Each one closes the group before it, if it has
+// faces, and the material carries over g and o statements.
+struct ObjGroupStatement {
+  size_t index_offset;  ///< indices parsed before it
+  bool is_material;
+  std::string material;  ///< usemtl only
+};
+
+// Parses the subset of Wavefront OBJ the demo relies on (v, vn, vt, f, g, o
+// and usemtl statements) from a mapped file, splitting it at line boundaries
+// into one chunk per hardware thread. Chunks are counted, then parsed in
+// parallel straight into their slice of the attribute arrays.
+//
+// `attributes` holds every attribute of the file and `indices` every
+// triangulated face, matching tinyobj::LoadObj with triangulation bit for
+// bit. `groups` splits `indices` into shapes, and shapes further wherever
+// their material changes. Groups without faces are left out. Material
+// libraries aren't read, materials are only known by name. Returns false
+// and describes the problem in `error` on failure.
+bool ParseObj(const std::string& path,
+              tinyobj::attrib_t& attributes,
+              std::vector<tinyobj::index_t>& indices,
+              std::vector<ObjGroup>& groups,
+              std::string& error);
+
+// Bounded-memory counterpart of ParseObj, for files whose corners shouldn't
+// all be held at once. Open counts the statements one window of about
+// `window_size` bytes at a time and sizes the attribute arrays, then each
+// ParseWindow parses the next window, chunked over the hardware threads
+// like ParseObj does, into its slice of the attributes and its own corners
+// and group statements. Pages of the file are dropped from memory once a
+// window is done with, so that mapping a file larger than memory doesn't
+// grow the process by its size. Faces may only refer to attributes defined
+// before the end of their window.
+class ObjStreamParser {
+ public:
+  ObjStreamParser();
+  ~ObjStreamParser();
+
+  ObjStreamParser(const ObjStreamParser&) = delete;
+  ObjStreamParser(ObjStreamParser&&) = delete;
+  const ObjStreamParser& operator=(const ObjStreamParser&) = delete;
+  ObjStreamParser& operator=(ObjStreamParser&&) = delete;
+
+  bool Open(const std::string& path, size_t window_size, std::string& error);
+  bool IsDone() const;
+  size_t GetWindowCount() const;
+  // Statements of the whole file, known once opened.
+  size_t GetFaceCount() const { return face_count_; }
+  // Filled up to the end of the last window parsed.
+  const tinyobj::attrib_t& GetAttributes() const { return attributes_; }
+
+  // Replaces `indices` and `statements` with those of the next window,
+  // statement offsets being relative to its indices.
+  bool ParseWindow(std::vector<tinyobj::index_t>& indices,
+                   std::vector<ObjGroupStatement>& statements,
+                   std::string& error);
+
+ private:
+  struct Window;
+
+  MappedFile file_ = {};
+  std::vector<Window> windows_;  ///< Window is only complete in the .cpp
+  size_t next_window_ = 0;
+  size_t face_count_ = 0;
+  tinyobj::attrib_t attributes_ = {};
+};
+}  // namespace render
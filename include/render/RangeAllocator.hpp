@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace render {
+// Two-level segregated fit (TLSF) allocator over an abstract [0, size)
+// range. It only does the bookkeeping: callers map the returned offsets onto
+// whatever actually backs the range (a device memory block, a buffer...).
+// Both allocation and release run in constant time, and adjacent free ranges
+// are coalesced on release.
+class RangeAllocator {
+ public:
+  struct Range {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t node = 0;
+  };
+
+  struct Stats {
+    uint64_t size;
+    uint64_t used;
+    uint64_t largest_free_range;
+    size_t allocation_count;
+    size_t free_range_count;
+  };
+
+  explicit RangeAllocator(uint64_t size);
+
+  // `alignment` must be a power of two.
+  std::optional<Range> Allocate(uint64_t size, uint64_t alignment);
+  void Free(const Range& range);
+
+  Stats GetStats() const;
+  uint64_t GetSize() const { return size_; }
+  bool IsEmpty() const { return allocation_count_ == 0; }
+
+ private:
+  static constexpr uint32_t kSecondLevelBits = 4;
+  static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelBits;
+  static constexpr uint32_t kFirstLevelCount = 64;
+  static constexpr uint32_t kNullNode = ~0u;
+
+  struct Node {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t prev_physical;
+    uint32_t next_physical;
+    uint32_t prev_free;
+    uint32_t next_free;
+    bool free;
+  };
+
+  static void Mapping(uint64_t size, uint32_t& first, uint32_t& second);
+  uint32_t FindFreeNode(uint64_t size, uint64_t alignment) const;
+  void InsertFreeNode(uint32_t node);
+  void RemoveFreeNode(uint32_t node);
+  uint32_t CreateNode(uint64_t offset, uint64_t size);
+  void ReleaseNode(uint32_t node);
+
+  uint64_t size_;
+  uint64_t used_ = 0;
+  size_t allocation_count_ = 0;
+  size_t free_range_count_ = 0;
+  uint64_t first_level_bitmap_ = 0;
+  uint32_t second_level_bitmaps_[kFirstLevelCount] = {};
+  uint32_t free_lists_[kFirstLevelCount][kSecondLevelCount];
+  std::vector<Node> nodes_ = {};
+  std::vector<uint32_t> unused_nodes_ = {};
+};
+}  // namespace render
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 // Third party headers
@@ -12,21 +14,32 @@
 #include <vulkan/vulkan.h>
 
 #include "base.hpp"
+#include "render/AssetLoader.hpp"
 #include "render/Frame.hpp"
+#include "render/MaterialTable.hpp"
 #include "render/Mesh.hpp"
+#include "render/TextureCache.hpp"
 #include "render/Vertex.hpp"
+#include "render/vulkan/Allocator.hpp"
 #include "render/vulkan/Buffer.hpp"
 #include "render/vulkan/DescriptorPoolCache.hpp"
+#include "render/vulkan/GeometryPool.hpp"
 #include "render/vulkan/Image.hpp"
+#include "render/vulkan/SamplerCache.hpp"
+#include "render/vulkan/UniformArena.hpp"
+#include "render/vulkan/UploadContext.hpp"
+#include "span.hpp"
 
 namespace render {
+// Uniform blocks are bump-allocated into a per-frame arena and bound as
+// dynamic uniform buffers. Binding 0 receives the pass block and binding 1
+// the render object block.
 struct UniformBufferDescriptor {
   struct Block {
     uint32_t binding;
-    size_t offset;
     size_t range;
   };
-  size_t size;
+  size_t arena_size;  ///< initial bytes of uniform data per frame
   std::list<Block> blocks;
 };
 
@@ -34,14 +47,22 @@ struct UniformBufferDescriptor {
 class RenderSystem {
  private:
   const size_t kMaxFrames = 2;
+  const VkDeviceSize kStagingSize = 16 * 1024 * 1024;
+  const VkDeviceSize kGeometryPoolSize = 32 * 1024 * 1024;  ///< grows
 
   VkExtent2D window_extent_ = {800, 600};
   SDL_Window* window_ = nullptr;
   VkInstance instance_ = VK_NULL_HANDLE;
   VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties physical_device_properties_ = {};
   uint32_t queue_family_index_ = 0;
   VkDevice device_ = VK_NULL_HANDLE;
   VkQueue queue_ = VK_NULL_HANDLE;
+  uint32_t transfer_queue_family_index_ = 0;  ///< same as graphics if none
+  VkQueue transfer_queue_ = VK_NULL_HANDLE;
+  std::unique_ptr<vulkan::Allocator> allocator_ = {};
+  std::unique_ptr<vulkan::UploadContext> upload_context_ = {};
+  std::unique_ptr<vulkan::GeometryPool> geometry_pool_ = {};
   VkCommandPool command_pool_ = VK_NULL_HANDLE;
   std::vector<VkCommandBuffer> command_buffers_;
   VkSurfaceKHR surface_ = VK_NULL_HANDLE;
@@ -49,9 +70,11 @@ class RenderSystem {
   std::vector<VkImageView> swapchain_image_views_ = {};
   std::vector<VkFramebuffer> framebuffers_ = {};
   VkShaderModule vertex_shader_module_ = VK_NULL_HANDLE;
+  VkShaderModule packed_vertex_shader_module_ = VK_NULL_HANDLE;
   VkShaderModule fragment_shader_module_ = VK_NULL_HANDLE;
   VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
   VkPipeline pipeline_ = VK_NULL_HANDLE;
+  VkPipeline packed_pipeline_ = VK_NULL_HANDLE;  ///< for PackedVertex meshes
   VkRenderPass render_pass_ = VK_NULL_HANDLE;
   VkFormat swapchain_image_format_ = VK_FORMAT_UNDEFINED;
   std::vector<VkSemaphore> image_available_semaphores_ = {};
@@ -60,19 +83,106 @@ class RenderSystem {
   std::vector<VkFence> in_flight_images_ = {};
   size_t current_frame_ = 0;
   size_t frame_number_ = 0;
-  std::vector<vulkan::Buffer*> ubos_for_frames_ =
-      {};  ///< uniform buffer objects referenced by frame id
+  std::vector<std::unique_ptr<vulkan::UniformArena>> uniform_arenas_ =
+      {};  ///< uniform arenas referenced by frame id
+  std::list<UniformBufferDescriptor::Block> uniform_blocks_ = {};
   VkDescriptorSetLayout pass_descriptor_set_layout_ = VK_NULL_HANDLE;
   std::vector<VkDescriptorSet> pass_descriptor_sets_ = {};
   VkDescriptorSetLayout render_object_descriptor_set_layout_ = VK_NULL_HANDLE;
   VkDescriptorSet render_object_descriptor_set_ = VK_NULL_HANDLE;
   std::unordered_map<ResourceId, Mesh> meshes_ = {};
 
-  using Texture =
-      std::tuple<std::unique_ptr<vulkan::Image>, VkImageView, VkSampler>;
   std::unique_ptr<vulkan::DescriptorPoolCache> descriptor_pool_cache_ = {};
-  std::unordered_map<ResourceId, Texture> textures_ = {};
+  std::unique_ptr<vulkan::SamplerCache> sampler_cache_ = {};
+  TextureCache texture_cache_ = {};
   std::unordered_map<ResourceId, VkDescriptorSet> materials_ = {};
+  MaterialTable material_table_{texture_cache_};
+  std::unordered_map<ResourceId, vulkan::UploadTicket>
+      material_upload_tickets_ = {};
+  VkDescriptorSet placeholder_material_ = VK_NULL_HANDLE;
+  ResourceId placeholder_texture_ = 0;
+  bool gpu_mipmaps_ = false;  ///< blit mip chains rather than build on CPU
+  float lod_bias_ = 1.0f;     ///< tolerated error in pixels
+  bool meshlet_culling_ = true;
+  bool cone_culling_ = false;  ///< only right for one-sided meshes
+
+  // Scratch for DrawFrame, holding the visible parts of an object.
+  struct SubMeshDraw {
+    const SubMesh* sub_mesh;
+    size_t first_range;  ///< in draw_ranges_
+    size_t range_count;
+  };
+  std::vector<SubMeshDraw> sub_mesh_draws_ = {};
+  std::vector<DrawRange> draw_ranges_ = {};
+
+  std::unordered_set<VkFormat> sampled_texture_formats_ = {};
+
+  struct TextureStats {
+    size_t texture_count;
+    VkDeviceSize bytes;
+    VkDeviceSize rgba8_bytes;  ///< what the same textures take uncompressed
+    VkDeviceSize base_level_bytes;
+    VkDeviceSize texel_fetch_bytes_at_quarter_size;
+  };
+  TextureStats texture_stats_ = {};
+
+  // Assets requested but not resident yet.
+  std::unique_ptr<AssetLoader> asset_loader_ = {};
+  std::unordered_set<ResourceId> pending_meshes_ = {};
+  std::unordered_set<ResourceId> pending_textures_ = {};
+
+  // Textures no material references anymore, destroyed once the frames and
+  // uploads that may still use them are done.
+  struct RetiredTexture {
+    Texture texture;
+    size_t frame_number;
+    vulkan::UploadTicket upload_ticket;
+  };
+  std::vector<RetiredTexture> retired_textures_ = {};
+  // Same for the descriptor sets of unloaded materials, and those that
+  // defragmentation replaced.
+  struct RetiredDescriptorSet {
+    VkDescriptorSet descriptor_set;
+    size_t frame_number;
+  };
+  std::vector<RetiredDescriptorSet> retired_descriptor_sets_ = {};
+
+  // Same for the geometry of unloaded meshes, and for the pool buffers
+  // compactions replaced.
+  struct RetiredMesh {
+    vulkan::GeometryPool::Allocation geometry;
+    size_t frame_number;
+    vulkan::UploadTicket upload_ticket;
+  };
+  std::vector<RetiredMesh> retired_meshes_ = {};
+  struct RetiredBuffer {
+    std::unique_ptr<vulkan::Buffer> buffer;
+    size_t frame_number;
+  };
+  std::vector<RetiredBuffer> retired_buffers_ = {};
+
+  // Texture memory unloading left sparse is defragmented a few frames at a
+  // time, see Defragment. DEMO_DEFRAG_BUDGET_MB overrides the budget, 0
+  // disables it.
+  VkDeviceSize defragmentation_budget_ = 4 * 1024 * 1024;  ///< per frame
+  struct Defragmentation {
+    bool active;
+    // Left to move, by content: the path a texture was first loaded with
+    // may be unloaded while others still share it.
+    std::vector<uint64_t> content_hashes;
+    vulkan::UploadTicket upload_ticket;  ///< covers uploads to them
+    vulkan::Allocator::Stats stats_before;
+    size_t first_frame;
+    size_t texture_count;  ///< moved so far
+    VkDeviceSize bytes;
+    bool report_pending;
+    size_t report_frame;  ///< once the replaced images are destroyed
+    // Set when the other blocks ran out of room. No drain is started again
+    // until the device memory in use differs from what was left then.
+    bool stuck;
+    VkDeviceSize stuck_used;
+  };
+  Defragmentation defragmentation_ = {};
 
  private:
   std::vector<VkPhysicalDevice> EnumeratePhysicalDevices(VkInstance instance);
@@ -86,6 +196,8 @@ class RenderSystem {
   void SelectBestSurfaceFormat(VkSurfaceFormatKHR& surface_format);
   void CreateSwapchain();
   void FindPhysicalDevice();
+  void FindTransferQueueFamily(
+      const std::vector<VkQueueFamilyProperties>& queue_family_properties);
   void EnumerateDeviceExtensions(
       VkPhysicalDevice device,
       std::map<std::string, VkExtensionProperties>& extension_map);
@@ -105,34 +217,91 @@ class RenderSystem {
   void CreateSyncObjects();
   uint32_t BeginFrame();
   void EndFrame(uint32_t image_index);
-  void UpdateUniformBlock(size_t frame_id,
-                          const render::Frame::UniformBlock& block);
   std::vector<VkImage> GetSwapchainImages();
   void CreateFramebuffers();
-  void CreateUniformBufferObjects(size_t buffer_size);
+  void CreateUniformArenas(size_t arena_size);
   void AllocateUboDescriptorSets(
       const UniformBufferDescriptor& uniform_buffer_descriptor);
+  void WritePassDescriptorSet(size_t frame);
+  // Replaces the arena of the current frame with a larger one when `frame`
+  // pushes more than it holds.
+  void ReserveUniformArena(const Frame& frame);
 
   // Resource management
-  VkCommandBuffer BeginCommands();
-  void EndCommands(VkCommandBuffer command_buffer);
-  ResourceId LoadImageFromFile(const std::string& path);
+  void CollectLoadedAssets();
+  // Gives up on the materials waiting on textures that failed to load, so
+  // that loading them again retries.
+  void DropFailedAssets();
+  // Textures no material uses anymore, see MaterialTable.
+  void RetireTextures(std::vector<Texture>& textures);
+  void CreateMesh(ResourceId id,
+                  Span<const Vertex> vertices,
+                  Span<const uint32_t> indices,
+                  std::vector<SubMesh> sub_meshes,
+                  std::vector<MeshLod> lods,
+                  std::vector<Meshlet> meshlets,
+                  const glm::vec4& bounding_sphere);
+  void CreateMesh(ResourceId id,
+                  Span<const PackedVertex> vertices,
+                  const MeshBounds& bounds,
+                  Span<const uint32_t> indices,
+                  std::vector<SubMesh> sub_meshes,
+                  std::vector<MeshLod> lods,
+                  std::vector<Meshlet> meshlets,
+                  const glm::vec4& bounding_sphere);
+  // Picks the coarsest level whose error projects to less than a pixel,
+  // scaled by lod_bias_, and returns its number.
+  size_t SelectLod(const Mesh& mesh,
+                   const Frame::Pass& pass,
+                   const glm::mat4& world_matrix) const;
+  // Fills sub_mesh_draws_ and draw_ranges_ with the parts of the object's
+  // sub-meshes that may be visible at level `level`.
+  void CullMesh(const Mesh& mesh,
+                size_t level,
+                const Frame::Pass& pass,
+                const Frame::Pass::RenderObject& render_object);
+  // Allocates the mesh's geometry in the pool and lets the writers fill it.
+  // Indices are stored as uint16 when they all fit.
+  void UploadGeometry(
+      size_t vertex_count,
+      size_t vertex_size,
+      const vulkan::BufferWriter& write_vertices,
+      size_t index_count,
+      const std::function<void(Span<uint32_t>, size_t)>& write_indices,
+      Mesh& mesh);
+  // Replaces the mesh with the same id, if any.
+  void AddMesh(ResourceId id, Mesh mesh);
+  void RetireMesh(const Mesh& mesh);
+  // Points meshes at their geometry again after the pool moved it.
+  void RefreshMeshes();
+  void DestroyRetiredGeometry();
+  // Moves textures out of the sparsest block of image memory, up to
+  // defragmentation_budget_ bytes per frame, and compacts the geometry pool
+  // when that fits in the budget. Copies are recorded into `command_buffer`
+  // outside of any render pass and ahead of the draws.
+  void Defragment(VkCommandBuffer command_buffer);
+  void PrintDefragmentationStats() const;
+  void CheckTextureFormatSupport();
+  void CreateTexture(const AssetLoader::ImageData& image_data);
+  void DestroyTexture(Texture& texture);
+  void DestroyRetiredTextures();
+  // Frees `descriptor_set` once the frames recorded so far are done with it.
+  void RetireDescriptorSet(VkDescriptorSet descriptor_set);
+  void PrintTextureStats() const;
+  VkDescriptorSet CreateMaterialDescriptorSet(
+      const std::vector<ResourceId>& texture_ids);
+  void CreatePlaceholderMaterial();
   VkSampler CreateSampler();
-  VkImageView GenerateImageView(VkImage image);
-  void CopyBufferToImage(vulkan::Buffer& buffer,
-                         vulkan::Image* image,
-                         uint32_t width,
-                         uint32_t height);
-  void ChangeImageLayout(VkImage image,
-                         VkImageLayout src_layout,
-                         VkImageLayout dst_layout);
-  void CopyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size);
-
-  template <typename T>
-  std::unique_ptr<vulkan::Buffer> CreateBuffer(VkBufferUsageFlags usage,
-                                               const std::vector<T>& data);
+  VkImageView GenerateImageView(const vulkan::Image& image);
 
  public:
+  // Fill `dst` with elements [first, first + dst.size()) of a mesh buffer.
+  // They are called on consecutive ranges, straight into staging memory
+  // that is write-combined on most devices: write every element once and
+  // don't read it back.
+  using VertexWriter = std::function<void(Span<Vertex> dst, size_t first)>;
+  using IndexWriter = std::function<void(Span<uint32_t> dst, size_t first)>;
+
   RenderSystem();
 
   RenderSystem(const RenderSystem&) = delete;
@@ -141,42 +310,63 @@ class RenderSystem {
   RenderSystem& operator=(RenderSystem&&) = delete;
 
   void Cleanup();
+  // Both create a single sub-mesh mesh and return its id. The data is in
+  // staging memory once they return, so callers can release their copies
+  // right away, without waiting for the upload to complete.
   size_t CreateMesh(const std::string& name,
-                    const std::vector<render::Vertex>& vertices,
-                    const std::vector<uint32_t>& indices);
+                    Span<const Vertex> vertices,
+                    Span<const uint32_t> indices);
+  // Generates the mesh straight into staging memory, without a host copy.
+  // As vertices can't be read back, their bounding sphere must be given.
+  size_t CreateMesh(const std::string& name,
+                    size_t vertex_count,
+                    size_t index_count,
+                    const glm::vec4& bounding_sphere,
+                    const VertexWriter& write_vertices,
+                    const IndexWriter& write_indices);
   void DrawFrame(const Frame&);
   void Init(const UniformBufferDescriptor& uniform_buffer_descriptor);
+  // Error in pixels levels of detail may introduce. Higher values switch to
+  // coarser levels closer to the camera, 0 always draws the full meshes.
+  void SetLodBias(float bias);
   std::tuple<uint32_t, uint32_t> GetWindowDimensions() const;
   void WaitIdle();
-  void LoadMaterial(ResourceId id, const std::vector<std::string>& paths);
+
+  // Uploads are batched and only submitted once per frame, or when asked to.
+  // A ticket is returned for the batch holding the latest upload.
+  vulkan::UploadTicket SubmitUploads();
+  bool IsUploadComplete(vulkan::UploadTicket ticket);
+
+  // Loads the assets under `mount_point` from the pack the asset cooker
+  // built at `pack_path`, when there is one. Must come before the first
+  // load. Set DEMO_RECORD_ASSET_ORDER to log the order assets are first
+  // loaded in, which the cooker lays the next pack out by.
+  void MountAssetPack(const std::string& pack_path,
+                      const std::string& mount_point);
+  // Files are read and decoded in the background. Meshes are skipped by
+  // DrawFrame until they are resident, materials are drawn with a plain
+  // white placeholder texture.
+  ResourceId LoadMeshAsync(const std::string& name,
+                           const std::string& path,
+                           VertexFormat format = VertexFormat::kFloat);
+  void LoadMaterialAsync(ResourceId id, const std::vector<std::string>& paths);
+  // True once the resource's data has landed in GPU memory.
+  bool IsMeshReady(ResourceId id);
+  bool IsMaterialReady(ResourceId id);
+  // Drops the material's references to its textures. Textures no other
+  // material uses are destroyed a few frames later.
+  void UnloadMaterial(ResourceId id);
+  // The mesh's geometry is released a few frames later, for later meshes to
+  // reuse.
+  void UnloadMesh(ResourceId id);
+  // Moves meshes back to back in the geometry pool, reclaiming the space
+  // unloading left between them. Meshes are also compacted whenever one
+  // doesn't fit otherwise, but this lets a quiet moment, such as the end of
+  // a level, pay for it.
+  void CompactGeometry();
   std::vector<VkDescriptorSet> AllocateDescriptorSets(
       VkDescriptorSetLayout layout,
       size_t descriptor_set_count,
       const std::vector<VkDescriptorPoolSize>& pool_sizes);
 };
-
-template <typename T>
-std::unique_ptr<vulkan::Buffer> RenderSystem::CreateBuffer(
-    VkBufferUsageFlags usage,
-    const std::vector<T>& vertices) {
-  const size_t size = sizeof(vertices[0]) * vertices.size();
-  auto staging_vertex_buffer = std::make_unique<vulkan::Buffer>(
-      physical_device_, device_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      static_cast<VkDeviceSize>(size));
-
-  // Fill up buffer memory with data:
-  void* data = staging_vertex_buffer->Map<void>();
-  memcpy(data, vertices.data(), size);
-  staging_vertex_buffer->Unmap();
-
-  auto vertex_buffer = std::make_unique<vulkan::Buffer>(
-      physical_device_, device_, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, static_cast<VkDeviceSize>(size));
-  CopyBuffer(staging_vertex_buffer->buffer_, vertex_buffer->buffer_,
-             static_cast<VkDeviceSize>(size));
-
-  return vertex_buffer;
-}
-}  // namespace render
\ No newline at end of file
+}  // namespace render
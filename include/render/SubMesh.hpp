@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+#include "base.hpp"
+
+namespace render {
+// Marks sub-meshes drawn with the material of their render object.
+static constexpr ResourceId kNoMaterial = 0;
+
+// Part of a mesh with a material of its own. Sub-meshes share the mesh's
+// vertex and index buffers, so that they draw back to back with a single
+// bind. The range is the full detail one, coarser levels of detail have
+// their own.
+struct SubMesh {
+  uint32_t first_index;
+  uint32_t index_count;
+  int32_t vertex_offset;   ///< added to the indices of every level
+  ResourceId material_id;  ///< hash of the material name, or kNoMaterial
+};
+}  // namespace render
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+#include "render/Vertex.hpp"
+#include "span.hpp"
+
+namespace render {
+// Fills the tangent of every vertex from the uv gradients of the triangles
+// using it, averaged with area weights, made orthogonal to the vertex normal
+// with Gram-Schmidt, and with the handedness of the uv mapping in w: the
+// bitangent is cross(normal, tangent.xyz) * tangent.w.
+//
+// Triangles and vertices are processed as SoA streams, as many at a time as
+// the widest SIMD registers available hold, over several threads on large
+// meshes. Vertices without a usable uv gradient get an arbitrary tangent
+// orthogonal to their normal.
+void GenerateTangents(Span<const uint32_t> indices, Span<Vertex> vertices);
+}  // namespace render
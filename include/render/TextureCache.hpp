@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "base.hpp"
+#include "render/vulkan/Image.hpp"
+
+namespace render {
+// The sampler belongs to the sampler cache, not to the texture.
+using Texture =
+    std::tuple<std::unique_ptr<vulkan::Image>, VkImageView, VkSampler>;
+
+// Resident textures, keyed by the id of the path they were requested with and
+// deduplicated by the hash of the file they were loaded from: paths resolving
+// to identical contents share a single image.
+//
+// References are counted per path id and may be taken before the texture is
+// resident. A texture stays alive as long as one of its paths is referenced.
+class TextureCache {
+ public:
+  struct Stats {
+    size_t hits;               ///< references to a loaded or pending texture
+    size_t misses;             ///< textures uploaded
+    size_t content_hits;       ///< new paths resolved to a resident texture
+    VkDeviceSize bytes_saved;  ///< VRAM not spent on duplicate contents
+  };
+
+  TextureCache() = default;
+
+  TextureCache(const TextureCache&) = delete;
+  TextureCache(TextureCache&&) = delete;
+  const TextureCache& operator=(const TextureCache&) = delete;
+  TextureCache& operator=(TextureCache&&) = delete;
+
+  // Returns true for the first reference to `id`, which the caller is then
+  // expected to load.
+  bool AddReference(ResourceId id);
+  // Returns true when this was the last reference to a resident texture, in
+  // which case the texture is moved out for the caller to destroy.
+  bool RemoveReference(ResourceId id, Texture& texture);
+  bool IsReferenced(ResourceId id) const;
+
+  bool Contains(ResourceId id) const;
+  const Texture& Get(ResourceId id) const;
+  // Resolves `id` to the resident texture loaded from the same contents, if
+  // there is one.
+  bool AddAlias(ResourceId id, uint64_t content_hash);
+  void Insert(ResourceId id,
+              uint64_t content_hash,
+              VkDeviceSize size,
+              Texture texture);
+  // The content hash of every resident texture. Unlike path ids, these stay
+  // valid for as long as any path to the texture does.
+  std::vector<uint64_t> GetResidentContents() const;
+  // Null once every path to the contents is unloaded.
+  const Texture* FindContent(uint64_t content_hash) const;
+  // Swaps the texture loaded from `content_hash`, for every path sharing it,
+  // returning the replaced one for the caller to destroy.
+  Texture Replace(uint64_t content_hash, Texture texture);
+  // Empties the cache, returning every texture for the caller to destroy.
+  std::vector<Texture> Clear();
+
+  const Stats& GetStats() const { return stats_; }
+
+ private:
+  struct Entry {
+    Texture texture;
+    VkDeviceSize size;
+    size_t alias_count;  ///< path ids resolving to this entry
+  };
+
+  std::unordered_map<uint64_t, Entry> entries_ = {};  ///< by content hash
+  std::unordered_map<ResourceId, uint64_t> content_hashes_ = {};
+  std::unordered_map<ResourceId, size_t> reference_counts_ = {};
+  Stats stats_ = {};
+};
+}  // namespace render
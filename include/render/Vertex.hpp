@@ -2,6 +2,8 @@
 
 #include <vulkan/vulkan.h>
 #include <array>
+#include <cstdint>
+#include <vector>
 #include <glm/glm.hpp>
 
 namespace render {
@@ -10,8 +12,7 @@ struct Vertex {
   glm::vec3 normal;
   glm::vec3 color;
   glm::vec2 uv;
-  glm::vec3 tangent;
-  glm::vec3 bitangent;
+  glm::vec4 tangent;  ///< xyz unit, w handedness of the bitangent (±1)
 
   static VkVertexInputBindingDescription get_binding_description() {
     VkVertexInputBindingDescription desc{};
@@ -28,8 +29,53 @@ struct Vertex {
         {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)},
         {2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)},
         {3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)},
-        {4, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, tangent)},
-        {5, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, bitangent)}};
+        {4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, tangent)}};
+    return desc;
+  }
+};
+
+enum class VertexFormat {
+  kFloat,   ///< Vertex
+  kPacked,  ///< PackedVertex
+};
+
+// Axis-aligned bounds of a mesh, which PackedVertex positions are quantized
+// against. Laid out as the vertex shader's push constants; w is unused.
+struct MeshBounds {
+  glm::vec4 min;
+  glm::vec4 extent;
+};
+
+// Compact alternative to Vertex, 20 bytes instead of 60, for meshes bound by
+// vertex fetch bandwidth. Colors are dropped since they are always white and
+// the bitangent is rebuilt from the normal and tangent, as with Vertex:
+// - positions are unorm16 within the mesh bounds,
+// - normals and tangents are octahedral snorm16 pairs,
+// - the tangent's handedness is position[3], 0 for negative and 65535 for
+//   positive,
+// - uvs are half floats.
+struct PackedVertex {
+  uint16_t position[4];
+  uint32_t normal;   ///< glm::packSnorm2x16
+  uint32_t tangent;  ///< glm::packSnorm2x16
+  uint32_t uv;       ///< glm::packHalf2x16
+
+  static VkVertexInputBindingDescription get_binding_description() {
+    VkVertexInputBindingDescription desc{};
+    desc.binding = 0;
+    desc.stride = sizeof(PackedVertex);
+    desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return desc;
+  }
+
+  static std::vector<VkVertexInputAttributeDescription>
+  get_attribute_descriptions() {
+    std::vector<VkVertexInputAttributeDescription> desc{
+        {0, 0, VK_FORMAT_R16G16B16A16_UNORM,
+         offsetof(PackedVertex, position)},
+        {1, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal)},
+        {2, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, tangent)},
+        {3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv)}};
     return desc;
   }
 };
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "render/tiny_obj_loader.h"
+
+namespace render {
+// Maps OBJ index triples to welded vertex ids. Open addressing with linear
+// probing: keys sit inline next to their id in a flat power-of-two table kept
+// at most half full, so a lookup is usually a single cache line. Defined
+// here whole, since Insert runs once per corner of every face loaded.
+class VertexWelder {
+ public:
+  // Sized for `expected_count` vertices, though it grows past them.
+  explicit VertexWelder(size_t expected_count) {
+    size_t capacity = 16;
+    while (capacity < expected_count * 2) {
+      capacity *= 2;
+    }
+    slots_.resize(capacity);
+  }
+
+  // Returns the id of the vertex for `index`, assigning it the next one if
+  // the triple hasn't been seen yet.
+  std::pair<uint32_t, bool> Insert(const tinyobj::index_t& index) {
+    if ((count_ + 1) * 2 > slots_.size()) {
+      Grow();
+    }
+    Slot* slot = Find(index);
+    if (slot->id != kEmpty) {
+      return {slot->id, false};
+    }
+    *slot = Slot{index.vertex_index, index.normal_index, index.texcoord_index,
+                 static_cast<uint32_t>(count_++)};
+    return {slot->id, true};
+  }
+
+ private:
+  static constexpr uint32_t kEmpty = UINT32_MAX;
+
+  struct Slot {
+    int position = 0;
+    int normal = 0;
+    int uv = 0;
+    uint32_t id = kEmpty;
+  };
+
+  // The multiply-xorshift finalizer of MurmurHash3, which unlike
+  // hash_combine mixes every input bit into the low bits used for probing.
+  static uint64_t Hash(int position, int normal, int uv) {
+    uint64_t hash = static_cast<uint32_t>(position) |
+                    static_cast<uint64_t>(static_cast<uint32_t>(uv)) << 32;
+    hash ^= static_cast<uint32_t>(normal) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    return hash ^ (hash >> 33);
+  }
+
+  Slot* Find(const tinyobj::index_t& index) {
+    size_t mask = slots_.size() - 1;
+    size_t i = Hash(index.vertex_index, index.normal_index,
+                    index.texcoord_index) &
+               mask;
+    for (;; i = (i + 1) & mask) {
+      Slot& slot = slots_[i];
+      if (slot.id == kEmpty ||
+          (slot.position == index.vertex_index &&
+           slot.normal == index.normal_index &&
+           slot.uv == index.texcoord_index)) {
+        return &slot;
+      }
+    }
+  }
+
+  void Grow() {
+    std::vector<Slot> slots(slots_.size() * 2);
+    slots.swap(slots_);
+    for (const Slot& slot : slots) {
+      if (slot.id != kEmpty) {
+        *Find(tinyobj::index_t{slot.position, slot.normal, slot.uv}) = slot;
+      }
+    }
+  }
+
+  std::vector<Slot> slots_ = {};
+  size_t count_ = 0;
+};
+}  // namespace render
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+#include "base.hpp"
+#include "render/RangeAllocator.hpp"
+
+namespace render {
+namespace vulkan {
+// Buffers and optimal-tiling images never share a block, which keeps
+// sub-allocations clear of bufferImageGranularity conflicts without having to
+// pad every neighbour.
+enum class ResourceKind { kLinear, kOptimal };
+
+struct MemoryBlock {
+  VkDeviceMemory memory;
+  uint32_t memory_type;
+  ResourceKind kind;
+  bool dedicated;
+  bool draining;    ///< being emptied by a defragmentation, see Allocator
+  uint8_t* mapped;  ///< persistent mapping, null for device-only memory
+  RangeAllocator ranges;
+};
+
+struct Allocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  uint8_t* mapped = nullptr;
+  MemoryBlock* block = nullptr;
+  RangeAllocator::Range range = {};
+};
+
+// Sub-allocates buffers and images out of large per-memory-type blocks so
+// that the number of vkAllocateMemory calls stays far below the driver's
+// maxMemoryAllocationCount. Host-visible blocks are mapped once for their
+// whole lifetime.
+//
+// Unloading leaves blocks partly empty, in holes later resources may not fit.
+// A defragmentation marks one sparsely used block as draining: allocations
+// then avoid it, and its owner moves the resources it holds into the others,
+// after which the empty block is released like any other.
+class Allocator {
+ public:
+  static constexpr VkDeviceSize kDefaultBlockSize = 64ull * 1024 * 1024;
+
+  struct Stats {
+    size_t block_count;
+    size_t allocation_count;
+    VkDeviceSize reserved;
+    VkDeviceSize used;
+    VkDeviceSize largest_free_range;
+    // 1 - (sum of each block's largest free range) / (total free bytes)
+    float fragmentation;
+  };
+
+  Allocator(VkPhysicalDevice physical_device,
+            VkDevice device,
+            VkDeviceSize block_size = kDefaultBlockSize);
+  ~Allocator();
+
+  Allocator(const Allocator&) = delete;
+  Allocator(Allocator&&) = delete;
+  const Allocator& operator=(const Allocator&) = delete;
+  Allocator& operator=(Allocator&&) = delete;
+
+  // Without `create_block`, only blocks already holding resources are used,
+  // and the returned allocation has no block when none of them has room.
+  Allocation Allocate(const VkMemoryRequirements& requirements,
+                      VkMemoryPropertyFlags properties,
+                      ResourceKind kind,
+                      bool create_block = true);
+  void Free(const Allocation& allocation);
+
+  // Marks the shared block of `kind` that is the cheapest to empty as
+  // draining, if one is at most half used and the other blocks of its
+  // memory type have room for its contents. Returns false otherwise.
+  bool BeginDefragmentation(ResourceKind kind);
+  // Lets allocations use the draining block again, if it's still there.
+  void EndDefragmentation();
+  static bool IsDraining(const Allocation& allocation) {
+    return allocation.block != nullptr && allocation.block->draining;
+  }
+
+  Stats GetStats() const;
+  void PrintStats() const;
+
+  VkDevice GetDevice() const { return device_; }
+  VkPhysicalDevice GetPhysicalDevice() const { return physical_device_; }
+
+ private:
+  MemoryBlock* CreateBlock(uint32_t memory_type,
+                           ResourceKind kind,
+                           VkDeviceSize size,
+                           bool dedicated);
+  void DestroyBlock(MemoryBlock* block);
+  VkDeviceSize GetBlockSize(uint32_t memory_type) const;
+
+  VkPhysicalDevice physical_device_;
+  VkDevice device_;
+  VkDeviceSize block_size_;
+  VkPhysicalDeviceMemoryProperties memory_properties_ = {};
+  std::vector<std::unique_ptr<MemoryBlock>> blocks_ = {};
+};
+}  // namespace vulkan
+}  // namespace render
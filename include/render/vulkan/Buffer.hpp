@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.h>
 
 #include "base.hpp"
+#include "render/vulkan/Allocator.hpp"
 
 namespace render {
 class RenderSystem;
@@ -11,30 +12,37 @@ namespace vulkan {
 class Buffer {
  private:
   VkBuffer buffer_ = VK_NULL_HANDLE;
-  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  Allocation allocation_ = {};
   VkDeviceSize size_;
-  VkDevice device_;
+  Allocator& allocator_;
 
  public:
-  Buffer(VkPhysicalDevice physical_device,
-         VkDevice device,
+  Buffer(Allocator& allocator,
          VkBufferUsageFlags usage,
          VkMemoryPropertyFlags properties,
          VkDeviceSize size);
   ~Buffer();
 
+  Buffer(const Buffer&) = delete;
+  Buffer(Buffer&&) = delete;
+  const Buffer& operator=(const Buffer&) = delete;
+  Buffer& operator=(Buffer&&) = delete;
+
+  // Host-visible buffers are persistently mapped by the allocator, so there
+  // is nothing to unmap.
   template <typename T>
   T* Map();
-  void Unmap();
 
   friend class ::render::RenderSystem;
+  friend class GeometryPool;
+  friend class UniformArena;
+  friend class UploadContext;
 };
 
 template <typename T>
 T* Buffer::Map() {
-  void* dst_ptr;
-  vkMapMemory(device_, memory_, 0, size_, 0, &dst_ptr);
-  return reinterpret_cast<T*>(dst_ptr);
+  assert(allocation_.mapped != nullptr);
+  return reinterpret_cast<T*>(allocation_.mapped);
 }
 }  // namespace vulkan
-}  // namespace render
\ No newline at end of file
+}  // namespace render
@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan.h>
 #include <list>
+#include <unordered_map>
 #include <vector>
 
 namespace render {
@@ -10,12 +11,34 @@ class DescriptorPoolCache {
  public:
   DescriptorPoolCache(VkDevice device);
   ~DescriptorPoolCache();
+  // A pool of its own for `descriptor_count` sets, kept until the cache is
+  // destroyed. Meant for sets allocated once.
   VkDescriptorPool GetPool(size_t descriptor_count,
                            const std::vector<VkDescriptorPoolSize>& sizes);
 
+  // Allocates a set of `layout` that Free gives back, from shared pools
+  // created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT. Every
+  // set allocated this way must hold the same descriptors, `set_sizes`,
+  // which keeps the pools from fragmenting.
+  VkDescriptorSet AllocateFreeable(
+      VkDescriptorSetLayout layout,
+      const std::vector<VkDescriptorPoolSize>& set_sizes);
+  // The set must not be used by pending command buffers anymore.
+  void Free(VkDescriptorSet descriptor_set);
+
  private:
+  static constexpr uint32_t kFreeableSetsPerPool = 256;
+
+  struct FreeablePool {
+    VkDescriptorPool pool;
+    uint32_t set_count;  ///< allocated from it
+  };
+
   VkDevice device_;
   std::list<VkDescriptorPool> pools_;
+  std::vector<FreeablePool> freeable_pools_ = {};
+  // Index in freeable_pools_ of the pool of each set.
+  std::unordered_map<VkDescriptorSet, size_t> freeable_sets_ = {};
 };
 }  // namespace vulkan
 }  // namespace render
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace render {
+namespace vulkan {
+// Uncompressed formats are described as 1x1 blocks.
+struct FormatInfo {
+  uint32_t block_width;
+  uint32_t block_height;
+  uint32_t block_size;  ///< in bytes
+  bool compressed;
+};
+
+// Returns false for formats textures can't be created with.
+bool GetFormatInfo(VkFormat format, FormatInfo& info);
+const char* GetFormatName(VkFormat format);
+
+uint32_t GetMipSize(uint32_t size, uint32_t level);
+VkDeviceSize GetLevelSize(const FormatInfo& info,
+                          uint32_t width,
+                          uint32_t height,
+                          uint32_t level);
+// Size of `level_count` tightly packed levels starting at level 0.
+VkDeviceSize GetMipChainSize(const FormatInfo& info,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t level_count);
+}  // namespace vulkan
+}  // namespace render
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+#include "render/RangeAllocator.hpp"
+#include "render/vulkan/Buffer.hpp"
+#include "render/vulkan/UploadContext.hpp"
+
+namespace render {
+namespace vulkan {
+// Vertices and indices of every mesh, sub-allocated from one large buffer
+// bound as both the vertex and the index buffer. Drawing binds it once per
+// frame and picks meshes with the vertex offset and first index of draws,
+// which count in vertices and indices: vertex ranges start on a multiple of
+// their vertex size, index ranges on a multiple of their index size.
+//
+// Freed ranges are coalesced and reused. When an allocation doesn't fit, the
+// live ranges are compacted into a new buffer, larger if they would leave
+// too little room. Their copies are recorded into the next frame's command
+// buffer by RecordMoves, on the graphics queue which owns every uploaded
+// range, so moving doesn't involve any ownership transfer.
+class GeometryPool {
+ public:
+  struct Allocation {
+    uint32_t slot = 0;
+    int32_t vertex_offset = 0;  ///< in vertices of the allocation's size
+    uint32_t first_index = 0;   ///< in indices of the allocation's size
+  };
+
+  struct Stats {
+    VkDeviceSize size;
+    VkDeviceSize used;
+    VkDeviceSize largest_free_range;
+    size_t allocation_count;
+    size_t rebuild_count;  ///< compactions, growing ones included
+    // 1 - (largest free range) / (total free bytes)
+    float fragmentation;
+  };
+
+  GeometryPool(Allocator& allocator,
+               UploadContext& upload_context,
+               VkDeviceSize size);
+
+  GeometryPool(const GeometryPool&) = delete;
+  GeometryPool(GeometryPool&&) = delete;
+  const GeometryPool& operator=(const GeometryPool&) = delete;
+  GeometryPool& operator=(GeometryPool&&) = delete;
+
+  // Returns true when making room moved the other allocations, which then
+  // need to be refreshed. `index_size` must be a power of two.
+  bool Allocate(size_t vertex_count,
+                size_t vertex_size,
+                size_t index_count,
+                size_t index_size,
+                Allocation& allocation);
+  // Frames drawing the allocation must be done with it.
+  void Free(const Allocation& allocation);
+  // Updates the offsets of an allocation after a move.
+  void Refresh(Allocation& allocation) const;
+
+  // Fill the whole vertex or index range of the allocation as
+  // UploadContext::UploadBuffer does, with offsets relative to the range and
+  // in whole vertices or indices.
+  UploadTicket UploadVertices(const Allocation& allocation,
+                              const BufferWriter& write);
+  UploadTicket UploadIndices(const Allocation& allocation,
+                             const BufferWriter& write);
+
+  // Moves the live allocations back to back, reclaiming the space lost
+  // between them. Returns false when there was nothing to reclaim.
+  bool Compact();
+  // Records the copies of the moves since the last call into
+  // `command_buffer`, outside of any render pass and ahead of the draws.
+  // The buffers they read from are returned, to be destroyed once the frame
+  // is done.
+  std::vector<std::unique_ptr<Buffer>> RecordMoves(
+      VkCommandBuffer command_buffer);
+
+  VkBuffer GetBuffer() const { return buffer_->buffer_; }
+  Stats GetStats() const;
+  void PrintStats() const;
+
+ private:
+  static constexpr VkBufferUsageFlags kUsage =
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  static constexpr VkDeviceSize kVertexAlignment = 4;
+
+  struct Slot {
+    RangeAllocator::Range vertex_range;
+    RangeAllocator::Range index_range;
+    VkDeviceSize vertex_base;  ///< first multiple of vertex_size in the range
+    VkDeviceSize vertex_bytes;
+    VkDeviceSize index_bytes;
+    uint32_t vertex_size;
+    uint32_t index_size;
+    bool live;
+    // Where the data is until the pending moves are recorded, null when it
+    // is already in place.
+    const Buffer* source;
+    VkDeviceSize source_vertex_base;
+    VkDeviceSize source_index_offset;
+  };
+
+  bool TryAllocate(Slot& slot);
+  // Moves the live allocations back to back into a new buffer of `size`
+  // bytes.
+  void Rebuild(VkDeviceSize size);
+
+  Allocator& allocator_;
+  UploadContext& upload_context_;
+  std::unique_ptr<Buffer> buffer_;
+  RangeAllocator ranges_;
+  std::vector<Slot> slots_ = {};
+  std::vector<uint32_t> free_slots_ = {};
+  // Replaced buffers pending moves still read from.
+  std::vector<std::unique_ptr<Buffer>> retired_buffers_ = {};
+  size_t rebuild_count_ = 0;
+};
+}  // namespace vulkan
+}  // namespace render
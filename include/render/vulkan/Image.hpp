@@ -1,8 +1,9 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <memory>
 
-#include "render/vulkan/Buffer.hpp"
+#include "render/vulkan/Allocator.hpp"
 
 namespace render {
 class RenderSystem;
@@ -10,22 +11,53 @@ class RenderSystem;
 namespace vulkan {
 class Image {
  public:
-  Image(VkPhysicalDevice physical_device,
-        VkDevice device,
+  // Images can be used as a blit source, so that mip chains can be
+  // generated on the GPU, and as a copy source, so that defragmentation can
+  // move them.
+  Image(Allocator& allocator,
         size_t width,
-        size_t height);
+        size_t height,
+        uint32_t mip_levels = 1,
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
   ~Image();
+  // An image like `image`, in one of the allocator's blocks already holding
+  // resources, or null when none of them has room for it.
+  static std::unique_ptr<Image> CreateInPlaceOf(const Image& image);
 
-  friend class RenderSystem;
+  Image(const Image&) = delete;
+  Image(Image&&) = delete;
+  const Image& operator=(const Image&) = delete;
+  Image& operator=(Image&&) = delete;
 
- private:
-  void AllocateMemory();
+  uint32_t GetWidth() const { return width_; }
+  uint32_t GetHeight() const { return height_; }
+  uint32_t GetMipLevels() const { return mip_levels_; }
+  VkFormat GetFormat() const { return format_; }
+
+  // Records copying every level of this image, sampled in
+  // VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, into `dst`, an image like it.
+  // `dst` is left in that layout too, this image in
+  // VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL as it's meant to be destroyed next.
+  void RecordCopy(VkCommandBuffer command_buffer, const Image& dst) const;
+
+  friend class ::render::RenderSystem;
+  friend class UploadContext;
 
  private:
-  VkPhysicalDevice physical_device_;
-  VkDevice device_;
+  Image(Allocator& allocator,
+        uint32_t width,
+        uint32_t height,
+        uint32_t mip_levels,
+        VkFormat format,
+        bool create_block);
+
+  Allocator& allocator_;
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t mip_levels_;
+  VkFormat format_;
   VkImage image_ = VK_NULL_HANDLE;
-  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  Allocation allocation_ = {};
 };
 }  // namespace vulkan
-}  // namespace render
\ No newline at end of file
+}  // namespace render
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <vulkan/vulkan.h>
+
 namespace render {
 namespace vulkan {
-void AllocateVulkanMemory(const VkMemoryRequirements& memory_requirements,
-                          const VkPhysicalDevice& physical_device,
-                          const VkDevice& device,
-                          VkDeviceMemory* memory,
-                          VkMemoryPropertyFlags properties);
+uint32_t FindMemoryType(
+    const VkPhysicalDeviceMemoryProperties& memory_properties,
+    uint32_t type_filter,
+    VkMemoryPropertyFlags properties);
+
+void AllocateVulkanMemory(VkDevice device,
+                          VkDeviceSize size,
+                          uint32_t memory_type,
+                          VkDeviceMemory* memory);
 }  // namespace vulkan
-}  // namespace render
\ No newline at end of file
+}  // namespace render
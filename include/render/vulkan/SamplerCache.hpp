@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <utility>
+#include <vector>
+
+namespace render {
+namespace vulkan {
+// Hands out one sampler per distinct sampler state. Textures overwhelmingly
+// use the same few, and drivers cap how many samplers may be alive at once
+// (maxSamplerAllocationCount).
+class SamplerCache {
+ public:
+  struct Stats {
+    size_t sampler_count;
+    size_t hits;
+    size_t misses;
+  };
+
+  SamplerCache(VkDevice device);
+  ~SamplerCache();
+
+  SamplerCache(const SamplerCache&) = delete;
+  SamplerCache(SamplerCache&&) = delete;
+  const SamplerCache& operator=(const SamplerCache&) = delete;
+  SamplerCache& operator=(SamplerCache&&) = delete;
+
+  // `info` must not have a pNext chain. The sampler is owned by the cache.
+  VkSampler GetSampler(const VkSamplerCreateInfo& info);
+
+  Stats GetStats() const;
+
+ private:
+  VkDevice device_;
+  // A handful of entries at most, a linear search beats hashing them.
+  std::vector<std::pair<VkSamplerCreateInfo, VkSampler>> samplers_ = {};
+  size_t hits_ = 0;
+};
+}  // namespace vulkan
+}  // namespace render
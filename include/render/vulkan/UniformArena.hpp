@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "render/vulkan/Buffer.hpp"
+
+namespace render {
+namespace vulkan {
+// Linear allocator over a persistently-mapped uniform buffer. One arena is
+// used per frame in flight: it is reset once the frame's fence has been
+// waited on, then every uniform block of the frame is bump-allocated into it
+// and bound with a dynamic offset.
+class UniformArena {
+ public:
+  UniformArena(Allocator& allocator,
+               VkDeviceSize capacity,
+               VkDeviceSize alignment);
+
+  void Reset() { head_ = 0; }
+  // The caller makes sure the blocks fit, see GetPushSize.
+  uint32_t Push(const void* data, size_t size);
+  VkBuffer GetBuffer() const { return buffer_.buffer_; }
+  VkDeviceSize GetCapacity() const { return capacity_; }
+  // The most a Push of `size` bytes can take up, alignment included.
+  VkDeviceSize GetPushSize(size_t size) const {
+    return (size + alignment_ - 1) & ~(alignment_ - 1);
+  }
+
+ private:
+  Buffer buffer_;
+  uint8_t* data_;
+  VkDeviceSize capacity_;
+  VkDeviceSize alignment_;
+  VkDeviceSize head_ = 0;
+};
+}  // namespace vulkan
+}  // namespace render
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "render/vulkan/Buffer.hpp"
+#include "render/vulkan/Format.hpp"
+#include "render/vulkan/Image.hpp"
+
+namespace render {
+namespace vulkan {
+// Monotonic identifier of an upload batch. A ticket is complete once every
+// copy recorded in its batch has been executed by the GPU.
+using UploadTicket = uint64_t;
+
+// Fills `row_count` rows of blocks starting at `first_row` (texel rows for
+// uncompressed formats) at `dst`, tightly packed.
+using RowWriter =
+    std::function<void(uint8_t* dst, uint32_t first_row, uint32_t row_count)>;
+
+// Fills `size` bytes of a buffer starting at byte `offset` at `dst`.
+using BufferWriter =
+    std::function<void(uint8_t* dst, VkDeviceSize offset, VkDeviceSize size)>;
+
+// Records buffer and image uploads into one command buffer per batch instead
+// of one blocking submission per copy. Source data is staged through a ring
+// buffer that is recycled as batches retire, and uploads that don't fit in
+// the ring are split into chunks.
+//
+// Every batch ends with a barrier making the transfer writes visible to
+// vertex input and shader reads, so frames submitted afterwards on the
+// graphics queue can use the uploaded resources straight away.
+//
+// When the transfer queue belongs to another family than the graphics one,
+// the batch releases ownership of everything it wrote and a small command
+// buffer submitted on the graphics queue acquires it back, after waiting on
+// a semaphore signaled by the transfer submission. Passing the same queue
+// twice keeps everything on a single queue.
+class UploadContext {
+ public:
+  UploadContext(Allocator& allocator,
+                VkQueue transfer_queue,
+                uint32_t transfer_queue_family_index,
+                VkQueue graphics_queue,
+                uint32_t graphics_queue_family_index,
+                VkDeviceSize staging_size);
+  ~UploadContext();
+
+  UploadContext(const UploadContext&) = delete;
+  UploadContext(UploadContext&&) = delete;
+  const UploadContext& operator=(const UploadContext&) = delete;
+  UploadContext& operator=(UploadContext&&) = delete;
+
+  // Both return the ticket of the batch the upload ended up in.
+  UploadTicket UploadBuffer(Buffer& buffer,
+                            const void* data,
+                            VkDeviceSize size,
+                            VkDeviceSize offset = 0);
+  // Uploads `size` bytes by letting `write` produce them straight into
+  // staging memory, in ranges that are multiples of `granularity` bytes so
+  // callers can write whole elements. Staging memory is write-combined on
+  // most devices: `write` shouldn't read back what it wrote.
+  UploadTicket UploadBuffer(Buffer& buffer,
+                            VkDeviceSize size,
+                            VkDeviceSize granularity,
+                            const BufferWriter& write,
+                            VkDeviceSize offset = 0);
+  // `pixels` holds the first `level_count` mip levels in the image's format,
+  // tightly packed one after the other. The remaining levels of the image
+  // are generated by blitting from the last provided one, which the image
+  // format must support with linear filtering.
+  UploadTicket UploadImage(Image& image,
+                           const void* pixels,
+                           uint32_t level_count = 1);
+  // Uploads the first level by letting `write_rows` produce it straight into
+  // staging memory, which saves an intermediate copy when the pixels need
+  // converting anyway. The remaining levels are blitted as above.
+  UploadTicket UploadImage(Image& image, const RowWriter& write_rows);
+
+  // Submits the batch being recorded, if any, and returns its ticket.
+  UploadTicket Submit();
+  bool IsComplete(UploadTicket ticket);
+  void Wait(UploadTicket ticket);
+
+ private:
+  static constexpr VkDeviceSize kStagingAlignment = 16;
+  static constexpr VkPipelineStageFlags kConsumerStages =
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  static constexpr VkAccessFlags kConsumerAccess =
+      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+      VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+  struct MipGeneration {
+    VkImage image;
+    uint32_t width;
+    uint32_t height;
+    uint32_t base_level;  ///< last uploaded level
+    uint32_t level_count;
+  };
+
+  struct Batch {
+    VkCommandBuffer command_buffer;
+    VkCommandBuffer acquire_command_buffer;  ///< ownership transfer only
+    VkSemaphore semaphore;                   ///< ownership transfer only
+    VkFence fence;
+    UploadTicket ticket;
+    uint64_t ring_end;
+  };
+
+  bool TransfersOwnership() const {
+    return transfer_queue_family_index_ != graphics_queue_family_index_;
+  }
+  VkCommandBuffer AllocateCommandBuffer(VkCommandPool pool);
+  VkCommandPool CreateCommandPool(uint32_t queue_family_index);
+  VkCommandBuffer GetCommandBuffer();
+  void SubmitOwnershipTransfer();
+  uint8_t* Reserve(VkDeviceSize size, VkDeviceSize& staging_offset);
+  void Retire(bool wait_for_oldest);
+  void ChangeImageLayout(VkCommandBuffer command_buffer,
+                         VkImage image,
+                         VkImageLayout src_layout,
+                         VkImageLayout dst_layout,
+                         uint32_t base_level,
+                         uint32_t level_count);
+  void GenerateMips(VkCommandBuffer command_buffer, const MipGeneration& mips);
+  // Records the copies of levels [0, level_count) filled by `write_level`,
+  // called with the level as first argument, and the transitions around them.
+  UploadTicket UploadImageLevels(
+      Image& image,
+      uint32_t level_count,
+      const std::function<void(uint32_t, uint8_t*, uint32_t, uint32_t)>&
+          write_level);
+  void CopyToLevel(Image& image,
+                   const FormatInfo& format_info,
+                   uint32_t level,
+                   const RowWriter& write_rows);
+
+  VkDevice device_;
+  VkQueue transfer_queue_;
+  uint32_t transfer_queue_family_index_;
+  VkQueue graphics_queue_;
+  uint32_t graphics_queue_family_index_;
+  VkCommandPool command_pool_ = VK_NULL_HANDLE;
+  VkCommandPool acquire_command_pool_ = VK_NULL_HANDLE;
+  Buffer staging_buffer_;
+  uint8_t* staging_data_;
+  VkDeviceSize staging_size_;
+
+  // Ring positions are virtual offsets that only ever grow; the physical
+  // offset is the virtual one modulo the staging size.
+  uint64_t ring_head_ = 0;
+  uint64_t ring_tail_ = 0;
+
+  std::vector<Batch> free_batches_ = {};
+  std::deque<Batch> submitted_batches_ = {};
+  Batch recording_batch_ = {};
+  bool recording_ = false;
+  UploadTicket next_ticket_ = 1;
+  UploadTicket completed_ticket_ = 0;
+  // Barriers making this batch's writes visible to the graphics queue. Buffer
+  // barriers are only needed for ownership transfers, a global memory barrier
+  // covers them otherwise.
+  std::vector<VkBufferMemoryBarrier> pending_buffer_barriers_ = {};
+  std::vector<VkImageMemoryBarrier> pending_image_barriers_ = {};
+  // Mip chains to blit on the graphics queue once ownership is acquired.
+  std::vector<MipGeneration> pending_mip_generations_ = {};
+};
+}  // namespace vulkan
+}  // namespace render
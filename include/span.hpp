@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Non-owning view over contiguous elements, standing in for C++20's
+// std::span. Implicitly built from anything with data() and size(), such as
+// std::vector.
+template <typename T>
+class Span {
+ public:
+  Span() = default;
+  Span(T* data, size_t size) : data_(data), size_(size) {}
+  template <typename Container,
+            typename = std::enable_if_t<std::is_convertible<
+                decltype(std::declval<Container&>().data()),
+                T*>::value>>
+  Span(Container& container)
+      : data_(container.data()), size_(container.size()) {}
+
+  T* data() const { return data_; }
+  size_t size() const { return size_; }
+  size_t size_bytes() const { return size_ * sizeof(T); }
+  bool empty() const { return size_ == 0; }
+  T* begin() const { return data_; }
+  T* end() const { return data_ + size_; }
+  T& operator[](size_t index) const {
+    assert(index < size_);
+    return data_[index];
+  }
+
+ private:
+  T* data_ = nullptr;
+  size_t size_ = 0;
+};
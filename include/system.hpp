@@ -1,3 +1,41 @@
 #pragma once
 
-size_t get_terminal_width();
\ No newline at end of file
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+size_t get_terminal_width();
+// Largest resident set of the process so far, in bytes.
+size_t get_peak_memory_usage();
+
+// Read-only mapping of a whole file. Pages are only read from disk when
+// touched, and stay shared with the page cache instead of being copied.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&&) = delete;
+  const MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile& operator=(MappedFile&&) = delete;
+
+  // Fails for missing or empty files, which can't be mapped.
+  bool Open(const std::string& path);
+  void Close();
+
+  const uint8_t* GetData() const { return data_; }
+  size_t GetSize() const { return size_; }
+
+  // Drops the pages of a range already read from the resident set, for files
+  // streamed through once. They are read again if touched later.
+  void Evict(size_t offset, size_t size) const;
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  void* file_ = nullptr;     ///< HANDLE
+  void* mapping_ = nullptr;  ///< HANDLE
+#endif
+};
@@ -11,7 +11,6 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "App.hpp"
-#include "render/MeshLoader.hpp"
 #include "render/Vertex.hpp"
 #include "system.hpp"
 
@@ -25,26 +24,24 @@ struct ObjectUniforms {
   glm::mat4 world_matrix;
 };
 
-static constexpr size_t kUniformBufferSize =
-    sizeof(PassUniforms) + sizeof(ObjectUniforms);
+// Room for a few thousand render objects per frame at the usual 256-byte
+// minUniformBufferOffsetAlignment, frames drawing more grow their arena.
+static constexpr size_t kUniformArenaSize = 1024 * 1024;
 }  // namespace
 
 App::App() : material_id_(std::hash<std::string>{}("some_material")) {
   assert(SDL_Init(SDL_INIT_EVERYTHING) == 0);
   std::list<render::UniformBufferDescriptor::Block> blocks{
-      {0, 0, sizeof(PassUniforms)},
-      {1, sizeof(PassUniforms), sizeof(ObjectUniforms)}};
-  render::UniformBufferDescriptor ubo_descriptor{
-      sizeof(PassUniforms) + sizeof(ObjectUniforms), blocks};
+      {0, sizeof(PassUniforms)}, {1, sizeof(ObjectUniforms)}};
+  render::UniformBufferDescriptor ubo_descriptor{kUniformArenaSize, blocks};
   CreateFramePacket();
   render_system_.Init(ubo_descriptor);
 
-  render::MeshLoader mesh_loader;
-  mesh_loader.Load("../../../assets/meshes/Axe_LP_Final.obj", indices_,
-                   vertices_);
-
-  render_system_.CreateMesh("quad_mesh", vertices_, indices_);
-  render_system_.LoadMaterial(
+  render_system_.MountAssetPack("../../../assets.pack", "../../../assets");
+  render_system_.LoadMeshAsync("quad_mesh",
+                               "../../../assets/meshes/Axe_LP_Final.obj",
+                               render::VertexFormat::kPacked);
+  render_system_.LoadMaterialAsync(
       material_id_, {"../../../assets/textures/AxeLP_Combined_A.png"});
 }
 
@@ -69,7 +66,6 @@ void App::Run() {
 
 void App::CreateFramePacket() {
   std::hash<std::string> hash{};
-  size_t offset = 0;
   std::tuple<uint32_t, uint32_t> window_dimensions =
       render_system_.GetWindowDimensions();
   float window_width = static_cast<float>(std::get<0>(window_dimensions));
@@ -83,21 +79,20 @@ void App::CreateFramePacket() {
                   glm::vec3(0.0f, 1.0f, 0.0f));
   pass_uniforms->projection_matrix = glm::perspective(
       glm::radians(70.0f), window_width / window_height, 0.1f, 1000.0f);
-  render::Frame::UniformBlock pass_uniform_block{pass_uniform_data,
-                                                 static_cast<uint32_t>(offset)};
-
-  offset += pass_uniform_data.size();
+  render::Frame::UniformBlock pass_uniform_block{pass_uniform_data};
 
   std::vector<uint8_t> object_uniform_data(sizeof(ObjectUniforms));
   ObjectUniforms* object_uniforms =
       reinterpret_cast<ObjectUniforms*>(object_uniform_data.data());
   object_uniforms->world_matrix = glm::mat4(1.0f);
-  render::Frame::UniformBlock object_uniform_block{
-      object_uniform_data, static_cast<uint32_t>(offset)};
+  render::Frame::UniformBlock object_uniform_block{object_uniform_data};
   render::Frame::Pass::RenderObject render_object{
-      object_uniform_block, hash("quad_mesh"), material_id_};
+      object_uniform_block, hash("quad_mesh"), material_id_,
+      object_uniforms->world_matrix};
 
-  render::Frame::Pass pass{pass_uniform_block, {render_object}};
+  render::Frame::Pass pass{pass_uniform_block, {render_object},
+                           pass_uniforms->view_matrix,
+                           pass_uniforms->projection_matrix};
 
   frame_.passes.clear();
   frame_.passes.push_back(pass);
@@ -0,0 +1,212 @@
+// Cooks the meshes and textures under the given directories into the files
+// the demo loads without processing, see AssetCooker.hpp, then optionally
+// packs those into a single file, see AssetPack.hpp.
+
+#define SDL_MAIN_HANDLED
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL_image.h>
+
+#include "ThreadPool.hpp"
+#include "render/AssetCooker.hpp"
+#include "render/AssetPack.hpp"
+
+namespace {
+enum class AssetType { kNone, kMesh, kTexture };
+
+AssetType GetAssetType(const std::filesystem::path& path) {
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (extension == ".obj" || extension == ".glb") {
+    return AssetType::kMesh;
+  }
+  if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
+      extension == ".tga" || extension == ".bmp") {
+    return AssetType::kTexture;
+  }
+  return AssetType::kNone;
+}
+
+bool IsLoadReady(const std::filesystem::path& path) {
+  std::string extension = path.extension().string();
+  return extension == ".mesh" || extension == ".ktx2";
+}
+
+void PrintUsage() {
+  std::cerr
+      << "Usage: asset_cooker [--force] [--no-optimize]\n"
+      << "                    [--import-budget <MiB>] [--pack <file>]\n"
+      << "                    [--compress] <directory>...\n"
+      << "\t--force\t\tcook assets even when their outputs are current\n"
+      << "\t--no-optimize\tkeep meshes in file order\n"
+      << "\t--import-budget\tstream each OBJ file through <MiB> of memory\n"
+      << "\t--pack\t\tpack cooked meshes and KTX2 textures into <file>\n"
+      << "\t--compress\tcompress the pack with LZ4\n";
+}
+
+// Packs the files ready to load under `directories`, named relative to the
+// directory they were found in. Those listed in the access order file the
+// demo records go first, in that order, and the others follow by name.
+bool WritePack(const std::string& pack_path,
+               const std::vector<std::string>& directories,
+               bool compress) {
+  std::vector<render::AssetPackSource> sources;
+  for (const auto& directory : directories) {
+    for (const auto& entry :
+         std::filesystem::recursive_directory_iterator(directory)) {
+      if (entry.is_regular_file() && IsLoadReady(entry.path())) {
+        sources.push_back(render::AssetPackSource{
+            entry.path().lexically_relative(directory).generic_string(),
+            entry.path().string()});
+      }
+    }
+  }
+  std::unordered_map<std::string, size_t> access_order;
+  std::ifstream order_stream(pack_path + ".order");
+  for (std::string name; std::getline(order_stream, name);) {
+    access_order.emplace(name, access_order.size());
+  }
+  auto get_rank = [&](const render::AssetPackSource& source) {
+    auto it = access_order.find(source.name);
+    return std::make_pair(
+        it != access_order.end() ? it->second : access_order.size(),
+        source.name);
+  };
+  std::sort(sources.begin(), sources.end(),
+            [&](const render::AssetPackSource& a,
+                const render::AssetPackSource& b) {
+              return get_rank(a) < get_rank(b);
+            });
+
+  std::string error;
+  if (!render::WriteAssetPack(pack_path, sources, compress, error)) {
+    std::cerr << "Failed to write " << pack_path << ": " << error << '\n';
+    return false;
+  }
+  std::cout << "Packed " << sources.size() << " files into " << pack_path
+            << '\n';
+  return true;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool force = false;
+  bool optimize = true;
+  size_t import_budget = 0;
+  std::string pack_path;
+  bool compress = false;
+  std::vector<std::string> directories;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--force") == 0) {
+      force = true;
+    } else if (std::strcmp(argv[i], "--no-optimize") == 0) {
+      optimize = false;
+    } else if (std::strcmp(argv[i], "--import-budget") == 0 &&
+               i + 1 < argc) {
+      import_budget =
+          static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10)) << 20;
+    } else if (std::strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+      pack_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--compress") == 0) {
+      compress = true;
+    } else if (argv[i][0] == '-') {
+      PrintUsage();
+      return 2;
+    } else {
+      directories.emplace_back(argv[i]);
+    }
+  }
+  if (directories.empty()) {
+    PrintUsage();
+    return 2;
+  }
+
+  std::vector<std::filesystem::path> paths;
+  for (const auto& directory : directories) {
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator it(directory, error);
+    for (; !error && it != std::filesystem::recursive_directory_iterator();
+         it.increment(error)) {
+      if (it->is_regular_file() &&
+          GetAssetType(it->path()) != AssetType::kNone) {
+        paths.push_back(it->path());
+      }
+    }
+    if (error) {
+      std::cerr << "Failed to list " << directory << ": " << error.message()
+                << '\n';
+      return 1;
+    }
+  }
+
+  if (IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG) == 0) {
+    std::cerr << "Failed to initialize SDL_image: " << IMG_GetError() << '\n';
+    return 1;
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::mutex mutex;
+  std::condition_variable condition;
+  size_t pending_count = paths.size();
+  size_t counts[3] = {};
+  {
+    // The main thread only waits, so it doesn't get a worker's share.
+    ThreadPool thread_pool(std::max(std::thread::hardware_concurrency(), 1u));
+    for (const auto& path : paths) {
+      thread_pool.Submit([&, path] {
+        const std::string source_path = path.string();
+        render::CookResult result =
+            GetAssetType(path) == AssetType::kMesh
+                ? render::CookMesh(source_path, optimize, import_budget,
+                                   force)
+                : render::CookTexture(source_path, force);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ++counts[static_cast<size_t>(result)];
+        if (result == render::CookResult::kCooked) {
+          std::cout << "Cooked " << source_path << '\n';
+        } else if (result == render::CookResult::kFailed) {
+          std::cerr << "Failed to cook " << source_path << '\n';
+        }
+        if (--pending_count == 0) {
+          condition.notify_one();
+        }
+      });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&] { return pending_count == 0; });
+  }
+  IMG_Quit();
+
+  using render::CookResult;
+  size_t failed_count = counts[static_cast<size_t>(CookResult::kFailed)];
+  std::cout << counts[static_cast<size_t>(CookResult::kCooked)] << " cooked, "
+            << counts[static_cast<size_t>(CookResult::kUpToDate)]
+            << " up to date, " << failed_count << " failed in "
+            << std::chrono::duration<float>(std::chrono::steady_clock::now() -
+                                            start)
+                   .count()
+            << " s\n";
+  // Failed assets may have left outdated outputs behind, not to be packed.
+  if (failed_count != 0) {
+    return 1;
+  }
+  if (!pack_path.empty() && !WritePack(pack_path, directories, compress)) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <SDL_image.h>
+
+#include "hash.hpp"
+#include "render/AssetCooker.hpp"
+#include "render/Ktx2.hpp"
+#include "render/MeshCache.hpp"
+#include "render/MeshLoader.hpp"
+#include "render/MipChain.hpp"
+#include "system.hpp"
+
+namespace render {
+namespace {
+// Key of the source hash in cooked textures, since KTX2 has no field for it.
+const char kSourceHashKey[] = "vulkan_demo.source_hash";
+
+const VertexFormat kVertexFormats[] = {VertexFormat::kFloat,
+                                       VertexFormat::kPacked};
+
+bool HashFile(const std::string& path, uint64_t& hash) {
+  MappedFile file;
+  if (!file.Open(path)) {
+    std::cerr << "Failed to open " << path << '\n';
+    return false;
+  }
+  hash = hash_bytes(file.GetData(), file.GetSize());
+  return true;
+}
+
+std::string FormatHash(uint64_t hash) {
+  char digits[17];
+  std::snprintf(digits, sizeof(digits), "%016llx",
+                static_cast<unsigned long long>(hash));
+  return digits;
+}
+
+bool IsMeshUpToDate(const std::string& path,
+                    VertexFormat format,
+                    uint64_t source_hash,
+                    bool optimize) {
+  MappedFile file;
+  MeshCacheContents contents{};
+  return ReadMeshCache(path, file, contents) && contents.format == format &&
+         contents.source_hash == source_hash && contents.optimized == optimize;
+}
+
+bool IsTextureUpToDate(const std::string& path, uint64_t source_hash) {
+  Ktx2Image image;
+  std::string error;
+  if (!LoadKtx2(path, image, error)) {
+    return false;
+  }
+  for (const auto& pair : image.key_values) {
+    if (pair.first == kSourceHashKey) {
+      return pair.second == FormatHash(source_hash);
+    }
+  }
+  return false;
+}
+}  // namespace
+
+std::string GetCookedTexturePath(const std::string& source_path) {
+  return source_path + ".ktx2";
+}
+
+CookResult CookMesh(const std::string& source_path,
+                    bool optimize,
+                    size_t import_budget,
+                    bool force) {
+  uint64_t source_hash;
+  if (!HashFile(source_path, source_hash)) {
+    return CookResult::kFailed;
+  }
+  bool up_to_date = !force;
+  for (VertexFormat format : kVertexFormats) {
+    up_to_date =
+        up_to_date && IsMeshUpToDate(GetCookedMeshPath(source_path, format),
+                                     format, source_hash, optimize);
+  }
+  if (up_to_date) {
+    return CookResult::kUpToDate;
+  }
+
+  MeshLoader mesh_loader(import_budget);
+  std::vector<uint32_t> indices;
+  std::vector<Vertex> vertices;
+  std::vector<SubMesh> sub_meshes;
+  std::vector<MeshLod> lods;
+  std::vector<Meshlet> meshlets;
+  if (!mesh_loader.LoadAndProcess(source_path, optimize, indices, vertices,
+                                  sub_meshes, lods, meshlets)) {
+    return CookResult::kFailed;
+  }
+  std::vector<PackedVertex> packed_vertices;
+  MeshCacheContents contents{};
+  contents.source_hash = source_hash;
+  contents.optimized = optimize;
+  contents.indices = indices;
+  contents.sub_meshes = sub_meshes;
+  contents.lods = lods;
+  contents.meshlets = meshlets;
+  contents.bounding_sphere = mesh_loader.ComputeBoundingSphere(vertices);
+  for (VertexFormat format : kVertexFormats) {
+    contents.format = format;
+    if (format == VertexFormat::kPacked) {
+      contents.bounds = mesh_loader.Pack(vertices, packed_vertices);
+      contents.vertices = {};
+      contents.packed_vertices = packed_vertices;
+    } else {
+      contents.vertices = vertices;
+    }
+    std::string path = GetCookedMeshPath(source_path, format);
+    if (!WriteMeshCache(path, contents)) {
+      std::cerr << "Failed to write " << path << '\n';
+      return CookResult::kFailed;
+    }
+  }
+  return CookResult::kCooked;
+}
+
+CookResult CookTexture(const std::string& source_path, bool force) {
+  uint64_t source_hash;
+  if (!HashFile(source_path, source_hash)) {
+    return CookResult::kFailed;
+  }
+  const std::string path = GetCookedTexturePath(source_path);
+  if (!force && IsTextureUpToDate(path, source_hash)) {
+    return CookResult::kUpToDate;
+  }
+
+  SDL_Surface* original_surface = IMG_Load(source_path.c_str());
+  if (original_surface == nullptr) {
+    std::cerr << "Failed to load " << source_path << ": " << IMG_GetError()
+              << '\n';
+    return CookResult::kFailed;
+  }
+  SDL_Surface* surface =
+      SDL_ConvertSurfaceFormat(original_surface, SDL_PIXELFORMAT_RGBA32, 0);
+  SDL_FreeSurface(original_surface);
+  if (surface == nullptr) {
+    std::cerr << "Failed to convert " << source_path << ": " << SDL_GetError()
+              << '\n';
+    return CookResult::kFailed;
+  }
+
+  Ktx2Image image;
+  image.format = VK_FORMAT_R8G8B8A8_SRGB;
+  image.width = static_cast<uint32_t>(surface->w);
+  image.height = static_cast<uint32_t>(surface->h);
+  image.level_count = ComputeMipLevelCount(image.width, image.height);
+  std::vector<uint8_t> base_level(size_t{image.width} * image.height * 4);
+  SDL_LockSurface(surface);
+  for (uint32_t row = 0; row < image.height; ++row) {
+    std::memcpy(base_level.data() + size_t{row} * image.width * 4,
+                reinterpret_cast<const uint8_t*>(surface->pixels) +
+                    size_t{row} * surface->pitch,
+                size_t{image.width} * 4);
+  }
+  SDL_UnlockSurface(surface);
+  SDL_FreeSurface(surface);
+  image.data = GenerateMipChain(base_level.data(), image.width, image.height,
+                                image.level_count);
+  image.key_values.emplace_back(kSourceHashKey, FormatHash(source_hash));
+
+  std::string error;
+  if (!WriteKtx2(path, image, error)) {
+    std::cerr << "Failed to write " << path << ": " << error << '\n';
+    return CookResult::kFailed;
+  }
+  return CookResult::kCooked;
+}
+}  // namespace render
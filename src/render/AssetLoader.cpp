@@ -0,0 +1,470 @@
+#include <cassert>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+#include <SDL_image.h>
+
+#include "hash.hpp"
+#include "render/AssetCooker.hpp"
+#include "render/AssetLoader.hpp"
+#include "render/BlockDecoder.hpp"
+#include "render/Glb.hpp"
+#include "render/Ktx2.hpp"
+#include "render/MeshCache.hpp"
+#include "render/MeshLoader.hpp"
+#include "render/MipChain.hpp"
+#include "render/vulkan/Format.hpp"
+
+namespace render {
+namespace {
+bool ReadFile(const std::string& path, std::vector<uint8_t>& file) {
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream) {
+    return false;
+  }
+  file.assign(std::istreambuf_iterator<char>(stream),
+              std::istreambuf_iterator<char>());
+  return true;
+}
+
+SDL_Surface* LoadSdlImage(const std::string& path, Span<const uint8_t> file) {
+  std::cout << "Loading texture from file: " << path << '\n';
+  SDL_Surface* original_surface = IMG_Load_RW(
+      SDL_RWFromConstMem(file.data(), static_cast<int>(file.size())), 1);
+  if (original_surface == nullptr) {
+    std::cerr << "Failed to load " << path << ": " << IMG_GetError() << '\n';
+    return nullptr;
+  }
+  // SDL_ConvertPixels can't expand palettes, so only these get converted
+  // ahead of time.
+  if (SDL_ISPIXELFORMAT_INDEXED(original_surface->format->format)) {
+    SDL_Surface* rgba32_surface =
+        SDL_ConvertSurfaceFormat(original_surface, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(original_surface);
+    return rgba32_surface;
+  }
+  return original_surface;
+}
+}  // namespace
+
+AssetLoader::AssetLoader(bool generate_mips,
+                         std::unordered_set<VkFormat> sampled_formats,
+                         bool use_cooked_assets,
+                         bool use_mesh_cache,
+                         bool optimize_meshes,
+                         size_t mesh_import_budget)
+    : generate_mips_(generate_mips),
+      sampled_formats_(std::move(sampled_formats)),
+      use_cooked_assets_(use_cooked_assets),
+      use_mesh_cache_(use_mesh_cache),
+      optimize_meshes_(optimize_meshes),
+      mesh_import_budget_(mesh_import_budget),
+      thread_pool_(std::make_unique<ThreadPool>()) {}
+
+AssetLoader::~AssetLoader() {
+  // Join the workers before releasing whatever they produced.
+  thread_pool_.reset(nullptr);
+  if (record_access_order_) {
+    WriteAccessOrder();
+  }
+  for (const auto& image : images_) {
+    SDL_FreeSurface(image.surface);
+  }
+}
+
+void AssetLoader::WriteRgba32Rows(SDL_Surface* surface,
+                                  uint8_t* dst,
+                                  uint32_t first_row,
+                                  uint32_t row_count) {
+  SDL_LockSurface(surface);
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(surface->pixels) +
+                       size_t{first_row} * surface->pitch;
+  int result = SDL_ConvertPixels(
+      surface->w, static_cast<int>(row_count), surface->format->format, src,
+      surface->pitch, SDL_PIXELFORMAT_RGBA32, dst, surface->w * 4);
+  assert(result == 0);
+  (void)result;
+  SDL_UnlockSurface(surface);
+}
+
+void AssetLoader::MountPack(const std::string& pack_path,
+                            const std::string& mount_point,
+                            bool record_access_order) {
+  if (!use_cooked_assets_) {
+    return;
+  }
+  pack_path_ = pack_path;
+  pack_mount_point_ = mount_point;
+  if (pack_mount_point_.empty() || pack_mount_point_.back() != '/') {
+    pack_mount_point_ += '/';
+  }
+  record_access_order_ = record_access_order;
+  pack_ = std::make_unique<AssetPack>();
+  if (pack_->Open(pack_path)) {
+    std::cout << "Mounted " << pack_path << " at " << pack_mount_point_
+              << '\n';
+  } else {
+    std::cout << "No asset pack at " << pack_path << ", using loose files\n";
+    pack_.reset(nullptr);
+  }
+}
+
+void AssetLoader::LoadMesh(ResourceId id,
+                           const std::string& path,
+                           VertexFormat format) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pending_count_;
+  }
+  thread_pool_->Submit([this, id, path, format] {
+    MeshData mesh{};
+    mesh.id = id;
+    mesh.format = format;
+    bool loaded = LoadMeshData(path, mesh);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (loaded) {
+      meshes_.push_back(std::move(mesh));
+    } else {
+      failed_mesh_ids_.push_back(id);
+    }
+    --pending_count_;
+  });
+}
+
+void AssetLoader::LoadImage(ResourceId id, const std::string& path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pending_count_;
+  }
+  thread_pool_->Submit([this, id, path] {
+    auto start = std::chrono::steady_clock::now();
+    ImageData image{id, path, 0, 0, 0, VK_FORMAT_UNDEFINED, 1, 1, nullptr, {},
+                    0};
+    const std::string extension = ".ktx2";
+    bool is_ktx2 = path.size() >= extension.size() &&
+                   path.compare(path.size() - extension.size(),
+                                extension.size(), extension) == 0;
+    // Files are read up front so that their contents can be hashed, which
+    // lets the texture cache spot the same image under different paths.
+    // Cooked textures are KTX2 files too.
+    std::vector<uint8_t> storage;
+    Span<const uint8_t> file;
+    bool loaded = false;
+    if (use_cooked_assets_ && !is_ktx2 &&
+        ReadAssetFile(GetCookedTexturePath(path), storage, file)) {
+      image.path = GetCookedTexturePath(path);
+      is_ktx2 = true;
+      loaded = true;
+    }
+    loaded = loaded || ReadAssetFile(path, storage, file);
+    if (loaded) {
+      image.content_hash = hash_bytes(file.data(), file.size());
+      loaded = is_ktx2 ? LoadCompressedImage(image, file)
+                       : DecodeImage(image, file);
+    } else {
+      std::cerr << "Failed to open " << path << '\n';
+    }
+    image.load_time_ms = std::chrono::duration<float, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (loaded) {
+      images_.push_back(std::move(image));
+    } else {
+      failed_image_ids_.push_back(id);
+    }
+    --pending_count_;
+  });
+}
+
+bool AssetLoader::LoadMeshData(const std::string& path, MeshData& mesh) const {
+  auto start = std::chrono::steady_clock::now();
+  if (use_cooked_assets_ && LoadCookedMesh(path, mesh)) {
+    std::cout << "Mesh " << path << ": read cooked in "
+              << std::chrono::duration<float, std::milli>(
+                     std::chrono::steady_clock::now() - start)
+                     .count()
+              << " ms\n";
+    return true;
+  }
+  // GLB files are binary already, a cache would only duplicate them.
+  const std::string glb_extension = ".glb";
+  if (path.size() >= glb_extension.size() &&
+      path.compare(path.size() - glb_extension.size(), glb_extension.size(),
+                   glb_extension) == 0) {
+    return LoadGlbMesh(path, mesh);
+  }
+
+  std::string cache_path = GetMeshCachePath(path, optimize_meshes_);
+  MappedFile source;
+  if (!source.Open(path)) {
+    std::cerr << "Failed to open " << path << '\n';
+    return false;
+  }
+  uint64_t source_hash = hash_bytes(source.GetData(), source.GetSize());
+  source.Close();
+
+  auto cache_file = std::make_unique<MappedFile>();
+  MeshCacheContents contents{};
+  bool cache_hit = use_mesh_cache_ &&
+                   ReadMeshCache(cache_path, *cache_file, contents) &&
+                   contents.source_hash == source_hash &&
+                   contents.format == VertexFormat::kFloat;
+  MeshLoader mesh_loader(mesh_import_budget_);
+  if (cache_hit) {
+    mesh.vertices = contents.vertices;
+    mesh.indices = contents.indices;
+    // The tables are small, and copying them spares the render system from
+    // keeping the mapping around.
+    mesh.sub_meshes.assign(contents.sub_meshes.begin(),
+                           contents.sub_meshes.end());
+    mesh.lods.assign(contents.lods.begin(), contents.lods.end());
+    mesh.meshlets.assign(contents.meshlets.begin(), contents.meshlets.end());
+    mesh.bounding_sphere = contents.bounding_sphere;
+    mesh.cache_file = std::move(cache_file);
+  } else {
+    if (!mesh_loader.LoadAndProcess(path, optimize_meshes_, mesh.index_storage,
+                                    mesh.vertex_storage, mesh.sub_meshes,
+                                    mesh.lods, mesh.meshlets)) {
+      return false;
+    }
+    mesh.vertices = mesh.vertex_storage;
+    mesh.indices = mesh.index_storage;
+    mesh.bounding_sphere = mesh_loader.ComputeBoundingSphere(mesh.vertices);
+    contents.source_hash = source_hash;
+    contents.optimized = optimize_meshes_;
+    contents.format = VertexFormat::kFloat;
+    contents.vertices = mesh.vertices;
+    contents.indices = mesh.indices;
+    contents.sub_meshes = mesh.sub_meshes;
+    contents.lods = mesh.lods;
+    contents.meshlets = mesh.meshlets;
+    contents.bounding_sphere = mesh.bounding_sphere;
+    if (use_mesh_cache_ && !WriteMeshCache(cache_path, contents)) {
+      std::cerr << "Failed to write " << cache_path << '\n';
+    }
+  }
+  // The cache holds float vertices whatever the format, packing them again
+  // costs less than a cache per format. Cooked meshes come in both.
+  if (mesh.format == VertexFormat::kPacked) {
+    mesh.bounds = mesh_loader.Pack(mesh.vertices, mesh.packed_vertex_storage);
+    mesh.packed_vertices = mesh.packed_vertex_storage;
+    mesh.vertices = {};
+    mesh.vertex_storage = {};
+  }
+
+  float load_time_ms = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  std::cout << "Mesh " << path << ": "
+            << (cache_hit ? "read from cache" : "parsed") << " in "
+            << load_time_ms << " ms\n";
+  return true;
+}
+
+bool AssetLoader::LoadCookedMesh(const std::string& path,
+                                 MeshData& mesh) const {
+  const std::string cooked_path = GetCookedMeshPath(path, mesh.format);
+  auto file = std::make_unique<MappedFile>();
+  Span<const uint8_t> packed_file;
+  MeshCacheContents contents{};
+  // Cooked meshes are trusted to match their source, which isn't read.
+  // Allocations are 16-byte aligned, like pack entries.
+  bool read = ReadPackedFile(cooked_path, mesh.file_storage, packed_file)
+                  ? ParseMeshCache(packed_file, contents)
+                  : ReadMeshCache(cooked_path, *file, contents);
+  if (!read || contents.format != mesh.format) {
+    mesh.file_storage = {};
+    return false;
+  }
+  mesh.vertices = contents.vertices;
+  mesh.packed_vertices = contents.packed_vertices;
+  mesh.bounds = contents.bounds;
+  mesh.indices = contents.indices;
+  mesh.sub_meshes.assign(contents.sub_meshes.begin(),
+                         contents.sub_meshes.end());
+  mesh.lods.assign(contents.lods.begin(), contents.lods.end());
+  mesh.meshlets.assign(contents.meshlets.begin(), contents.meshlets.end());
+  mesh.bounding_sphere = contents.bounding_sphere;
+  mesh.cache_file = std::move(file);
+  return true;
+}
+
+bool AssetLoader::LoadGlbMesh(const std::string& path, MeshData& mesh) const {
+  auto start = std::chrono::steady_clock::now();
+  std::cout << "Loading mesh from file: " << path << '\n';
+  auto file = std::make_unique<MappedFile>();
+  if (!file->Open(path)) {
+    std::cerr << "Failed to open " << path << '\n';
+    return false;
+  }
+  GlbMesh glb;
+  std::string error;
+  if (!ParseGlb(Span<const uint8_t>(file->GetData(), file->GetSize()), glb,
+                error)) {
+    std::cerr << "Failed to load " << path << ": " << error << '\n';
+    return false;
+  }
+  // The spans survive moving the storage they may point into.
+  mesh.vertices = glb.vertices;
+  mesh.indices = glb.indices;
+  mesh.vertex_storage = std::move(glb.vertex_storage);
+  mesh.index_storage = std::move(glb.index_storage);
+  mesh.sub_meshes = std::move(glb.sub_meshes);
+  for (const SubMesh& sub_mesh : mesh.sub_meshes) {
+    mesh.lods.push_back(
+        MeshLod{sub_mesh.first_index, sub_mesh.index_count, 0.0f, 0, 0});
+  }
+  MeshLoader mesh_loader;
+  mesh.bounding_sphere = mesh_loader.ComputeBoundingSphere(mesh.vertices);
+  size_t converted_size = glb.converted_size;
+  if (mesh.format == VertexFormat::kPacked) {
+    mesh.bounds = mesh_loader.Pack(mesh.vertices, mesh.packed_vertex_storage);
+    mesh.packed_vertices = mesh.packed_vertex_storage;
+    mesh.vertices = {};
+    mesh.vertex_storage = {};
+    converted_size += mesh.packed_vertices.size_bytes();
+  }
+  mesh.cache_file = std::move(file);
+
+  // debug traces
+  const size_t upload_size =
+      mesh.vertices.size_bytes() + mesh.packed_vertices.size_bytes() +
+      mesh.indices.size_bytes();
+  std::cout << "Mesh " << path << ": mapped in "
+            << std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms, " << converted_size << " bytes converted for "
+            << upload_size << " uploaded\n";
+  return true;
+}
+
+bool AssetLoader::DecodeImage(ImageData& image,
+                              Span<const uint8_t> file) const {
+  image.surface = LoadSdlImage(image.path, file);
+  if (image.surface == nullptr) {
+    return false;
+  }
+  image.width = static_cast<uint32_t>(image.surface->w);
+  image.height = static_cast<uint32_t>(image.surface->h);
+  image.format = VK_FORMAT_R8G8B8A8_SRGB;
+  image.mip_levels = ComputeMipLevelCount(image.width, image.height);
+  if (generate_mips_) {
+    std::vector<uint8_t> base_level(size_t{image.width} * image.height * 4);
+    WriteRgba32Rows(image.surface, base_level.data(), 0, image.height);
+    image.pixels = GenerateMipChain(base_level.data(), image.width,
+                                    image.height, image.mip_levels);
+    SDL_FreeSurface(image.surface);
+    image.surface = nullptr;
+    image.level_count = image.mip_levels;
+  }
+  return true;
+}
+
+bool AssetLoader::LoadCompressedImage(ImageData& image,
+                                      Span<const uint8_t> file) const {
+  std::cout << "Loading compressed texture from file: " << image.path << '\n';
+  Ktx2Image ktx2;
+  std::string error;
+  if (!ParseKtx2(file.data(), file.size(), ktx2, error)) {
+    std::cerr << "Failed to load " << image.path << ": " << error << '\n';
+    return false;
+  }
+  image.width = ktx2.width;
+  image.height = ktx2.height;
+  image.mip_levels = ktx2.level_count;
+  image.level_count = ktx2.level_count;
+  if (sampled_formats_.count(ktx2.format) != 0) {
+    image.format = ktx2.format;
+    image.pixels = std::move(ktx2.data);
+    return true;
+  }
+
+  // No transcoding from one block format to another: fall back to RGBA8.
+  VkFormat decoded_format = GetDecodedFormat(ktx2.format);
+  if (decoded_format == VK_FORMAT_UNDEFINED ||
+      sampled_formats_.count(decoded_format) == 0) {
+    std::cerr << "Failed to load " << image.path << ": "
+              << vulkan::GetFormatName(ktx2.format)
+              << " is not supported by the device\n";
+    return false;
+  }
+  image.format = decoded_format;
+  image.pixels = DecodeBlocks(ktx2.format, ktx2.data.data(), ktx2.width,
+                              ktx2.height, ktx2.level_count);
+  return true;
+}
+
+bool AssetLoader::ReadPackedFile(const std::string& path,
+                                 std::vector<uint8_t>& storage,
+                                 Span<const uint8_t>& contents) const {
+  if (pack_mount_point_.empty() ||
+      path.compare(0, pack_mount_point_.size(), pack_mount_point_) != 0) {
+    return false;
+  }
+  std::string name = path.substr(pack_mount_point_.size());
+  if (record_access_order_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (accessed_name_set_.insert(name).second) {
+      accessed_names_.push_back(name);
+    }
+  }
+  return pack_ != nullptr &&
+         pack_->Read(AssetPack::GetId(name), *thread_pool_, storage, contents);
+}
+
+bool AssetLoader::ReadAssetFile(const std::string& path,
+                                std::vector<uint8_t>& storage,
+                                Span<const uint8_t>& contents) const {
+  if (ReadPackedFile(path, storage, contents)) {
+    return true;
+  }
+  if (!ReadFile(path, storage)) {
+    return false;
+  }
+  contents = storage;
+  return true;
+}
+
+void AssetLoader::WriteAccessOrder() const {
+  const std::string path = pack_path_ + ".order";
+  std::ofstream stream(path, std::ios::trunc);
+  for (const auto& name : accessed_names_) {
+    stream << name << '\n';
+  }
+  if (!stream) {
+    std::cerr << "Failed to write " << path << '\n';
+  }
+}
+
+std::vector<AssetLoader::MeshData> AssetLoader::TakeMeshes() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::exchange(meshes_, {});
+}
+
+std::vector<AssetLoader::ImageData> AssetLoader::TakeImages() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::exchange(images_, {});
+}
+
+std::vector<ResourceId> AssetLoader::TakeFailedMeshIds() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::exchange(failed_mesh_ids_, {});
+}
+
+std::vector<ResourceId> AssetLoader::TakeFailedImageIds() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::exchange(failed_image_ids_, {});
+}
+
+size_t AssetLoader::GetPendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_count_;
+}
+}  // namespace render
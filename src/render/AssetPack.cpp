@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#include "hash.hpp"
+#include "render/AssetPack.hpp"
+#include "render/Lz4.hpp"
+
+namespace render {
+namespace {
+const char kMagic[8] = {'V', 'D', 'P', 'A', 'C', 'K', '\r', '\n'};
+const uint32_t kFormatVersion = 1;
+const uint64_t kAlignment = 16;
+// Large enough for LZ4 to find its matches, small enough for a texture or
+// mesh to spread over the workers.
+const uint32_t kChunkSize = 256 * 1024;
+
+struct Header {
+  char magic[8];
+  uint32_t format_version;
+  uint32_t chunk_size;
+  uint32_t entry_count;
+  uint32_t slot_count;  ///< power of two
+  uint32_t chunk_count;
+  uint32_t reserved;
+  uint64_t entry_offset;
+  uint64_t slot_offset;
+  uint64_t chunk_offset;
+};
+static_assert(sizeof(Header) == 56, "asset pack header must be packed");
+
+uint64_t Align(uint64_t offset) {
+  return (offset + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+// Empty files can't be mapped, their entries simply hold no data.
+bool IsEmptyFile(const std::string& path) {
+  std::ifstream stream(path, std::ios::binary);
+  return stream && stream.peek() == std::ifstream::traits_type::eof();
+}
+
+bool IsValidRange(uint64_t offset,
+                  uint64_t count,
+                  uint64_t element_size,
+                  uint64_t file_size) {
+  return offset % kAlignment == 0 && offset <= file_size &&
+         count <= (file_size - offset) / element_size;
+}
+}  // namespace
+
+struct AssetPack::Entry {
+  uint64_t id;
+  uint64_t offset;  ///< of the data, when not compressed
+  uint64_t size;    ///< uncompressed
+  uint32_t first_chunk;
+  uint32_t chunk_count;  ///< 0 when not compressed
+};
+static_assert(sizeof(AssetPack::Entry) == 32, "pack entries must be packed");
+
+// Chunks cover chunk_size bytes of their entry, except for the last one.
+struct AssetPack::Chunk {
+  uint64_t offset;
+  uint32_t stored_size;  ///< equal to size when not compressed
+  uint32_t size;
+};
+static_assert(sizeof(AssetPack::Chunk) == 16, "pack chunks must be packed");
+
+namespace {
+// Chunks of an entry being decompressed. The thread reading the entry and
+// whichever workers pick up a helper job claim chunks one at a time, and the
+// reader returns once every claimed chunk is done, so that it never waits
+// on a worker busy with something else. Helpers starting after that find no
+// chunk left, and only keep this state alive.
+struct Decompression {
+  const uint8_t* file;
+  const AssetPack::Chunk* chunks;
+  size_t chunk_count;
+  uint32_t chunk_size;
+  uint8_t* dst;
+  size_t size;
+
+  std::atomic<size_t> next_chunk{0};
+  std::atomic<bool> failed{false};
+  std::mutex mutex = {};
+  std::condition_variable condition = {};
+  size_t done_count = 0;
+
+  void Run() {
+    for (;;) {
+      size_t index = next_chunk.fetch_add(1);
+      if (index >= chunk_count) {
+        return;
+      }
+      const AssetPack::Chunk& chunk = chunks[index];
+      size_t offset = index * chunk_size;
+      bool valid = chunk.size == std::min<size_t>(chunk_size, size - offset);
+      if (valid && chunk.stored_size == chunk.size) {
+        std::memcpy(dst + offset, file + chunk.offset, chunk.size);
+      } else if (!valid || !Lz4Decompress(file + chunk.offset,
+                                          chunk.stored_size, dst + offset,
+                                          chunk.size)) {
+        failed = true;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      if (++done_count == chunk_count) {
+        condition.notify_all();
+      }
+    }
+  }
+};
+}  // namespace
+
+bool AssetPack::Open(const std::string& path) {
+  if (!file_.Open(path) || file_.GetSize() < sizeof(Header)) {
+    file_.Close();
+    return false;
+  }
+  Header header;
+  std::memcpy(&header, file_.GetData(), sizeof(header));
+  const uint64_t file_size = file_.GetSize();
+  bool valid =
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+      header.format_version == kFormatVersion && header.chunk_size > 0 &&
+      header.slot_count > 0 &&
+      (header.slot_count & (header.slot_count - 1)) == 0 &&
+      IsValidRange(header.entry_offset, header.entry_count, sizeof(Entry),
+                   file_size) &&
+      IsValidRange(header.slot_offset, header.slot_count, sizeof(uint32_t),
+                   file_size) &&
+      IsValidRange(header.chunk_offset, header.chunk_count, sizeof(Chunk),
+                   file_size);
+  if (!valid) {
+    file_.Close();
+    return false;
+  }
+  // Mappings are page aligned, so aligned offsets give aligned arrays.
+  const uint8_t* data = file_.GetData();
+  entries_ = Span<const Entry>(
+      reinterpret_cast<const Entry*>(data + header.entry_offset),
+      header.entry_count);
+  slots_ = Span<const uint32_t>(
+      reinterpret_cast<const uint32_t*>(data + header.slot_offset),
+      header.slot_count);
+  chunks_ = Span<const Chunk>(
+      reinterpret_cast<const Chunk*>(data + header.chunk_offset),
+      header.chunk_count);
+  chunk_size_ = header.chunk_size;
+  return true;
+}
+
+bool AssetPack::Contains(ResourceId id) const {
+  return FindEntry(id) != nullptr;
+}
+
+bool AssetPack::Read(ResourceId id,
+                     ThreadPool& thread_pool,
+                     std::vector<uint8_t>& storage,
+                     Span<const uint8_t>& data) const {
+  const Entry* entry = FindEntry(id);
+  if (entry == nullptr) {
+    return false;
+  }
+  const uint64_t file_size = file_.GetSize();
+  if (entry->chunk_count == 0) {
+    if (entry->offset > file_size || entry->size > file_size - entry->offset) {
+      return false;
+    }
+    data = Span<const uint8_t>(file_.GetData() + entry->offset, entry->size);
+    return true;
+  }
+
+  if (entry->first_chunk > chunks_.size() ||
+      entry->chunk_count > chunks_.size() - entry->first_chunk ||
+      entry->chunk_count !=
+          (entry->size + chunk_size_ - 1) / chunk_size_) {
+    return false;
+  }
+  const Chunk* chunks = chunks_.data() + entry->first_chunk;
+  for (uint32_t i = 0; i < entry->chunk_count; ++i) {
+    if (chunks[i].offset > file_size ||
+        chunks[i].stored_size > file_size - chunks[i].offset) {
+      return false;
+    }
+  }
+  storage.resize(entry->size);
+  auto decompression = std::make_shared<Decompression>();
+  decompression->file = file_.GetData();
+  decompression->chunks = chunks;
+  decompression->chunk_count = entry->chunk_count;
+  decompression->chunk_size = chunk_size_;
+  decompression->dst = storage.data();
+  decompression->size = storage.size();
+  size_t helper_count =
+      std::min<size_t>(thread_pool.GetThreadCount(), entry->chunk_count - 1);
+  for (size_t i = 0; i < helper_count; ++i) {
+    thread_pool.Submit([decompression] { decompression->Run(); });
+  }
+  decompression->Run();
+  {
+    std::unique_lock<std::mutex> lock(decompression->mutex);
+    decompression->condition.wait(lock, [&] {
+      return decompression->done_count == decompression->chunk_count;
+    });
+  }
+  if (decompression->failed) {
+    return false;
+  }
+  data = storage;
+  return true;
+}
+
+ResourceId AssetPack::GetId(const std::string& name) {
+  return static_cast<ResourceId>(hash_bytes(name.data(), name.size()));
+}
+
+const AssetPack::Entry* AssetPack::FindEntry(ResourceId id) const {
+  if (slots_.empty()) {
+    return nullptr;
+  }
+  // Linear probing, bounded in case a corrupt table has no empty slot.
+  size_t mask = slots_.size() - 1;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    uint32_t slot = slots_[(id + i) & mask];
+    if (slot == 0 || slot > entries_.size()) {
+      return nullptr;
+    }
+    const Entry& entry = entries_[slot - 1];
+    if (entry.id == static_cast<uint64_t>(id)) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+bool WriteAssetPack(const std::string& path,
+                    const std::vector<AssetPackSource>& sources,
+                    bool compress,
+                    std::string& error) {
+  // Compressed chunks are kept in memory until the layout is known, other
+  // entries are copied from their mapping while writing.
+  std::vector<std::unique_ptr<MappedFile>> files;
+  std::vector<std::vector<uint8_t>> compressed_data(sources.size());
+  std::vector<AssetPack::Entry> entries;
+  std::vector<AssetPack::Chunk> chunks;
+  uint32_t slot_count = 1;
+  while (slot_count < sources.size() * 2) {
+    slot_count *= 2;
+  }
+  std::vector<uint32_t> slots(slot_count, 0);
+  for (size_t i = 0; i < sources.size(); ++i) {
+    files.push_back(std::make_unique<MappedFile>());
+    MappedFile& file = *files.back();
+    if (!file.Open(sources[i].path) && !IsEmptyFile(sources[i].path)) {
+      error = "can't read " + sources[i].path;
+      return false;
+    }
+    AssetPack::Entry entry{AssetPack::GetId(sources[i].name), 0,
+                           file.GetSize(), 0, 0};
+    size_t slot = entry.id & (slot_count - 1);
+    for (; slots[slot] != 0; slot = (slot + 1) & (slot_count - 1)) {
+      if (entries[slots[slot] - 1].id == entry.id) {
+        error = "duplicate entry " + sources[i].name;
+        return false;
+      }
+    }
+    slots[slot] = static_cast<uint32_t>(i + 1);
+
+    std::vector<AssetPack::Chunk> entry_chunks;
+    std::vector<uint8_t>& stored = compressed_data[i];
+    bool shrunk = false;
+    for (size_t offset = 0; compress && offset < file.GetSize();
+         offset += kChunkSize) {
+      uint32_t size = static_cast<uint32_t>(
+          std::min<size_t>(kChunkSize, file.GetSize() - offset));
+      size_t stored_offset = stored.size();
+      stored.resize(stored_offset + GetLz4CompressBound(size));
+      size_t stored_size =
+          Lz4Compress(file.GetData() + offset, size,
+                      stored.data() + stored_offset, GetLz4CompressBound(size));
+      if (stored_size == 0 || stored_size >= size) {
+        stored_size = size;
+        std::memcpy(stored.data() + stored_offset, file.GetData() + offset,
+                    size);
+      } else {
+        shrunk = true;
+      }
+      stored.resize(stored_offset + stored_size);
+      entry_chunks.push_back(AssetPack::Chunk{
+          stored_offset, static_cast<uint32_t>(stored_size), size});
+    }
+    if (shrunk) {
+      entry.first_chunk = static_cast<uint32_t>(chunks.size());
+      entry.chunk_count = static_cast<uint32_t>(entry_chunks.size());
+      chunks.insert(chunks.end(), entry_chunks.begin(), entry_chunks.end());
+    } else {
+      stored = {};
+    }
+    entries.push_back(entry);
+  }
+
+  Header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.format_version = kFormatVersion;
+  header.chunk_size = kChunkSize;
+  header.entry_count = static_cast<uint32_t>(entries.size());
+  header.slot_count = slot_count;
+  header.chunk_count = static_cast<uint32_t>(chunks.size());
+  header.entry_offset = Align(sizeof(Header));
+  header.slot_offset =
+      Align(header.entry_offset + entries.size() * sizeof(AssetPack::Entry));
+  header.chunk_offset =
+      Align(header.slot_offset + slots.size() * sizeof(uint32_t));
+  // Chunk offsets are relative to their entry's data until now.
+  uint64_t offset =
+      Align(header.chunk_offset + chunks.size() * sizeof(AssetPack::Chunk));
+  std::vector<uint64_t> data_offsets(entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    AssetPack::Entry& entry = entries[i];
+    data_offsets[i] = offset;
+    if (entry.chunk_count == 0) {
+      entry.offset = offset;
+      offset = Align(offset + entry.size);
+      continue;
+    }
+    for (uint32_t j = 0; j < entry.chunk_count; ++j) {
+      chunks[entry.first_chunk + j].offset += offset;
+    }
+    offset = Align(offset + compressed_data[i].size());
+  }
+
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+    const char padding[kAlignment] = {};
+    uint64_t position = 0;
+    auto write = [&](uint64_t at, const void* data, size_t size) {
+      stream.write(padding, at - position);
+      stream.write(reinterpret_cast<const char*>(data), size);
+      position = at + size;
+    };
+    write(0, &header, sizeof(header));
+    write(header.entry_offset, entries.data(),
+          entries.size() * sizeof(AssetPack::Entry));
+    write(header.slot_offset, slots.data(), slots.size() * sizeof(uint32_t));
+    write(header.chunk_offset, chunks.data(),
+          chunks.size() * sizeof(AssetPack::Chunk));
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (entries[i].chunk_count == 0) {
+        write(data_offsets[i], files[i]->GetData(), files[i]->GetSize());
+      } else {
+        write(data_offsets[i], compressed_data[i].data(),
+              compressed_data[i].size());
+      }
+    }
+    if (!stream) {
+      stream.close();
+      std::remove(temporary_path.c_str());
+      error = "can't write file";
+      return false;
+    }
+  }
+  // rename() doesn't replace existing files on Windows.
+  std::remove(path.c_str());
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    error = "can't replace file";
+    return false;
+  }
+  return true;
+}
+}  // namespace render
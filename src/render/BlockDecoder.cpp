@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cassert>
+
+#include "render/BlockDecoder.hpp"
+#include "render/vulkan/Format.hpp"
+
+namespace render {
+namespace {
+uint16_t ReadU16(const uint8_t* data) {
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+void Expand565(uint16_t color, uint8_t* rgba) {
+  uint32_t r = (color >> 11) & 0x1f;
+  uint32_t g = (color >> 5) & 0x3f;
+  uint32_t b = color & 0x1f;
+  rgba[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+  rgba[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+  rgba[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+  rgba[3] = 255;
+}
+
+// Writes 16 RGBA texels, row by row. `punch_through` enables BC1's 3-color
+// mode with transparent black, which BC3 color blocks never use.
+void DecodeColorBlock(const uint8_t* block,
+                      bool punch_through,
+                      uint8_t* texels) {
+  uint16_t color0 = ReadU16(block);
+  uint16_t color1 = ReadU16(block + 2);
+  uint8_t palette[4][4];
+  Expand565(color0, palette[0]);
+  Expand565(color1, palette[1]);
+  for (int c = 0; c < 3; ++c) {
+    if (color0 > color1 || !punch_through) {
+      palette[2][c] =
+          static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+      palette[3][c] =
+          static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+    } else {
+      palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+      palette[3][c] = 0;
+    }
+  }
+  palette[2][3] = 255;
+  palette[3][3] = color0 > color1 || !punch_through ? 255 : 0;
+
+  uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) |
+                     (static_cast<uint32_t>(block[7]) << 24);
+  for (int i = 0; i < 16; ++i) {
+    const uint8_t* color = palette[(indices >> (2 * i)) & 3];
+    std::copy(color, color + 4, texels + i * 4);
+  }
+}
+
+// BC3 alpha and BC5 channel blocks. Writes one byte every `stride` bytes.
+void DecodeChannelBlock(const uint8_t* block, uint8_t* texels, int stride) {
+  uint32_t value0 = block[0];
+  uint32_t value1 = block[1];
+  uint8_t palette[8] = {static_cast<uint8_t>(value0),
+                        static_cast<uint8_t>(value1)};
+  if (value0 > value1) {
+    for (uint32_t i = 2; i < 8; ++i) {
+      palette[i] =
+          static_cast<uint8_t>(((8 - i) * value0 + (i - 1) * value1) / 7);
+    }
+  } else {
+    for (uint32_t i = 2; i < 6; ++i) {
+      palette[i] =
+          static_cast<uint8_t>(((6 - i) * value0 + (i - 1) * value1) / 5);
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; ++i) {
+    indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+  }
+  for (int i = 0; i < 16; ++i) {
+    texels[i * stride] = palette[(indices >> (3 * i)) & 7];
+  }
+}
+
+void DecodeBlock(VkFormat format, const uint8_t* block, uint8_t* texels) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      DecodeColorBlock(block, true, texels);
+      if (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK ||
+          format == VK_FORMAT_BC1_RGB_SRGB_BLOCK) {
+        for (int i = 0; i < 16; ++i) {
+          texels[i * 4 + 3] = 255;
+        }
+      }
+      break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      DecodeColorBlock(block + 8, false, texels);
+      DecodeChannelBlock(block, texels + 3, 4);
+      break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+      DecodeChannelBlock(block, texels, 4);
+      DecodeChannelBlock(block + 8, texels + 1, 4);
+      for (int i = 0; i < 16; ++i) {
+        texels[i * 4 + 2] = 0;
+        texels[i * 4 + 3] = 255;
+      }
+      break;
+    default:
+      assert(false);
+  }
+}
+}  // namespace
+
+VkFormat GetDecodedFormat(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      return VK_FORMAT_R8G8B8A8_SRGB;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+      return VK_FORMAT_R8G8B8A8_UNORM;
+    default:
+      return VK_FORMAT_UNDEFINED;
+  }
+}
+
+std::vector<uint8_t> DecodeBlocks(VkFormat format,
+                                  const uint8_t* data,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  uint32_t level_count) {
+  vulkan::FormatInfo info;
+  bool known_format = vulkan::GetFormatInfo(format, info);
+  assert(known_format && GetDecodedFormat(format) != VK_FORMAT_UNDEFINED);
+  (void)known_format;
+
+  vulkan::FormatInfo rgba8_info{1, 1, 4, false};
+  std::vector<uint8_t> pixels(
+      vulkan::GetMipChainSize(rgba8_info, width, height, level_count));
+  uint8_t* dst = pixels.data();
+  for (uint32_t level = 0; level < level_count; ++level) {
+    uint32_t level_width = vulkan::GetMipSize(width, level);
+    uint32_t level_height = vulkan::GetMipSize(height, level);
+    uint32_t blocks_x = (level_width + 3) / 4;
+    uint32_t blocks_y = (level_height + 3) / 4;
+    for (uint32_t by = 0; by < blocks_y; ++by) {
+      for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+        uint8_t texels[16 * 4];
+        DecodeBlock(format, data, texels);
+        data += info.block_size;
+
+        // Blocks hanging over the edge of small levels are cropped.
+        uint32_t rows = std::min(4u, level_height - by * 4);
+        uint32_t columns = std::min(4u, level_width - bx * 4);
+        for (uint32_t y = 0; y < rows; ++y) {
+          std::copy(texels + y * 16, texels + y * 16 + columns * 4,
+                    dst + ((by * 4 + y) * size_t{level_width} + bx * 4) * 4);
+        }
+      }
+    }
+    dst += size_t{level_width} * level_height * 4;
+  }
+  return pixels;
+}
+}  // namespace render
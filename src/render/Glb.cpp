@@ -0,0 +1,575 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DEMO_GLB_SSE2
+#endif
+
+#include "render/Glb.hpp"
+#include "render/Json.hpp"
+#include "render/TangentGenerator.hpp"
+
+namespace render {
+namespace {
+const uint32_t kMagic = 0x46546c67;      // "glTF"
+const uint32_t kJsonChunk = 0x4e4f534a;  // "JSON"
+const uint32_t kBinChunk = 0x004e4942;   // "BIN\0"
+const size_t kHeaderSize = 12;
+const size_t kChunkHeaderSize = 8;
+
+const uint32_t kUnsignedByte = 5121;
+const uint32_t kUnsignedShort = 5123;
+const uint32_t kUnsignedInt = 5125;
+const uint32_t kFloat = 5126;
+
+const size_t kTriangles = 4;
+
+// Elements of an accessor, bounds checked against the BIN chunk.
+struct Accessor {
+  const uint8_t* data;  ///< first element
+  size_t stride;
+  size_t count;
+  uint32_t component_type;
+  size_t component_count;
+  bool normalized;
+};
+
+uint32_t ReadUint32(const uint8_t* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+size_t GetComponentSize(uint32_t component_type) {
+  switch (component_type) {
+    case 5120:  // BYTE
+    case kUnsignedByte:
+      return 1;
+    case 5122:  // SHORT
+    case kUnsignedShort:
+      return 2;
+    case kUnsignedInt:
+    case kFloat:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+size_t GetComponentCount(const std::string& type) {
+  if (type == "SCALAR") {
+    return 1;
+  }
+  if (type == "VEC2") {
+    return 2;
+  }
+  if (type == "VEC3") {
+    return 3;
+  }
+  if (type == "VEC4") {
+    return 4;
+  }
+  return 0;
+}
+
+// Reads member `key` of `object` as a non-negative integer, `fallback` when
+// it is missing. Fails for other values.
+bool GetSize(const JsonValue& object,
+             const char* key,
+             size_t fallback,
+             size_t& value) {
+  const JsonValue& member = object[key];
+  if (member.IsNull()) {
+    value = fallback;
+    return true;
+  }
+  double number = member.GetNumber(-1.0);
+  // Past 2^53, doubles no longer hold every integer.
+  if (!(number >= 0.0 && number <= 9007199254740992.0) ||
+      number != std::floor(number)) {
+    return false;
+  }
+  value = static_cast<size_t>(number);
+  return true;
+}
+
+bool GetAccessor(const JsonValue& json,
+                 Span<const uint8_t> bin,
+                 size_t index,
+                 Accessor& accessor,
+                 std::string& error) {
+  const JsonValue& object = json["accessors"][index];
+  if (!object.IsObject()) {
+    error = "missing accessor";
+    return false;
+  }
+  if (!object["sparse"].IsNull()) {
+    error = "sparse accessors aren't supported";
+    return false;
+  }
+  size_t view_index;
+  if (!GetSize(object, "bufferView", SIZE_MAX, view_index) ||
+      view_index == SIZE_MAX) {
+    error = "accessors without a buffer view aren't supported";
+    return false;
+  }
+  const JsonValue& view = json["bufferViews"][view_index];
+  size_t buffer;
+  size_t view_offset;
+  size_t view_size;
+  size_t view_stride;
+  size_t offset;
+  size_t component_type;
+  if (!view.IsObject() || !GetSize(view, "buffer", SIZE_MAX, buffer) ||
+      !GetSize(view, "byteOffset", 0, view_offset) ||
+      !GetSize(view, "byteLength", SIZE_MAX, view_size) ||
+      !GetSize(view, "byteStride", 0, view_stride) ||
+      !GetSize(object, "byteOffset", 0, offset) ||
+      !GetSize(object, "componentType", 0, component_type) ||
+      !GetSize(object, "count", SIZE_MAX, accessor.count)) {
+    error = "invalid accessor";
+    return false;
+  }
+  if (buffer != 0) {
+    error = "external buffers aren't supported";
+    return false;
+  }
+  accessor.component_type = static_cast<uint32_t>(component_type);
+  accessor.component_count = GetComponentCount(object["type"].GetString());
+  accessor.normalized = object["normalized"].GetBool(false);
+  const size_t element_size =
+      GetComponentSize(accessor.component_type) * accessor.component_count;
+  accessor.stride = view_stride != 0 ? view_stride : element_size;
+  // Strides are at most 252 bytes, which keeps the products below in range.
+  if (element_size == 0 || accessor.stride < element_size ||
+      accessor.stride > 252 || view_offset > bin.size() ||
+      view_size > bin.size() - view_offset || offset > view_size ||
+      accessor.count > view_size) {
+    error = "invalid accessor";
+    return false;
+  }
+  if (accessor.count > 0 &&
+      accessor.stride * (accessor.count - 1) + element_size >
+          view_size - offset) {
+    error = "accessor out of bounds";
+    return false;
+  }
+  accessor.data = bin.data() + view_offset + offset;
+  return true;
+}
+
+// Reads attribute `name` of a primitive, checking its layout against the
+// component types allowed. Missing attributes leave `accessor` empty.
+bool GetAttribute(const JsonValue& json,
+                  Span<const uint8_t> bin,
+                  const JsonValue& primitive,
+                  const char* name,
+                  size_t vertex_count,
+                  size_t min_component_count,
+                  size_t max_component_count,
+                  bool allow_normalized,
+                  Accessor& accessor,
+                  std::string& error) {
+  accessor = Accessor{nullptr, 0, 0, 0, 0, false};
+  size_t index;
+  if (!GetSize(primitive["attributes"], name, SIZE_MAX, index)) {
+    error = std::string("invalid ") + name;
+    return false;
+  }
+  if (index == SIZE_MAX) {
+    return true;
+  }
+  if (!GetAccessor(json, bin, index, accessor, error)) {
+    return false;
+  }
+  bool normalized_integer =
+      allow_normalized && accessor.normalized &&
+      (accessor.component_type == kUnsignedByte ||
+       accessor.component_type == kUnsignedShort);
+  if ((accessor.component_type != kFloat && !normalized_integer) ||
+      accessor.component_count < min_component_count ||
+      accessor.component_count > max_component_count ||
+      (vertex_count != 0 && accessor.count != vertex_count)) {
+    error = std::string("unsupported ") + name + " layout";
+    return false;
+  }
+  return true;
+}
+
+// Converts the first `component_count` components of each element of
+// `accessor` to floats at `dst`, `dst_stride` bytes apart.
+void GatherFloats(const Accessor& accessor,
+                  size_t component_count,
+                  uint8_t* dst,
+                  size_t dst_stride) {
+  const uint8_t* src = accessor.data;
+  if (accessor.component_type == kFloat) {
+    for (size_t i = 0; i < accessor.count; ++i) {
+      std::memcpy(dst + i * dst_stride, src + i * accessor.stride,
+                  component_count * sizeof(float));
+    }
+    return;
+  }
+  float components[4];
+  for (size_t i = 0; i < accessor.count; ++i, src += accessor.stride) {
+    for (size_t c = 0; c < component_count; ++c) {
+      if (accessor.component_type == kUnsignedByte) {
+        components[c] = static_cast<float>(src[c]) / 255.0f;
+      } else {
+        uint16_t value;
+        std::memcpy(&value, src + c * sizeof(value), sizeof(value));
+        components[c] = static_cast<float>(value) / 65535.0f;
+      }
+    }
+    std::memcpy(dst + i * dst_stride, components,
+                component_count * sizeof(float));
+  }
+}
+
+// Index buffer views have no stride, so indices are tightly packed and
+// widen a register at a time.
+void WidenIndices(const Accessor& accessor, uint32_t* dst) {
+  const uint8_t* src = accessor.data;
+  const size_t count = accessor.count;
+  size_t i = 0;
+  if (accessor.component_type == kUnsignedInt) {
+    std::memcpy(dst, src, count * sizeof(uint32_t));
+    return;
+  }
+  if (accessor.component_type == kUnsignedShort) {
+#if defined(DEMO_GLB_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+      __m128i shorts =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                       _mm_unpacklo_epi16(shorts, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4),
+                       _mm_unpackhi_epi16(shorts, zero));
+    }
+#endif
+    for (; i < count; ++i) {
+      uint16_t index;
+      std::memcpy(&index, src + i * 2, sizeof(index));
+      dst[i] = index;
+    }
+    return;
+  }
+#if defined(DEMO_GLB_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     _mm_unpacklo_epi16(low, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4),
+                     _mm_unpackhi_epi16(low, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8),
+                     _mm_unpacklo_epi16(high, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12),
+                     _mm_unpackhi_epi16(high, zero));
+  }
+#endif
+  for (; i < count; ++i) {
+    dst[i] = src[i];
+  }
+}
+
+bool IsAligned(const void* data, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(data) % alignment == 0;
+}
+
+struct Primitive {
+  Accessor indices;  ///< empty when not indexed
+  Accessor positions;
+  Accessor normals;
+  Accessor uvs;
+  Accessor tangents;
+  Accessor colors;
+  ResourceId material_id;
+};
+
+bool ReadPrimitive(const JsonValue& json,
+                   Span<const uint8_t> bin,
+                   const JsonValue& object,
+                   Primitive& primitive,
+                   std::string& error) {
+  if (!GetAttribute(json, bin, object, "POSITION", 0, 3, 3, false,
+                    primitive.positions, error)) {
+    return false;
+  }
+  const size_t vertex_count = primitive.positions.count;
+  if (primitive.positions.data == nullptr || vertex_count == 0) {
+    error = "primitive without positions";
+    return false;
+  }
+  if (!GetAttribute(json, bin, object, "NORMAL", vertex_count, 3, 3, false,
+                    primitive.normals, error) ||
+      !GetAttribute(json, bin, object, "TEXCOORD_0", vertex_count, 2, 2,
+                    true, primitive.uvs, error) ||
+      !GetAttribute(json, bin, object, "TANGENT", vertex_count, 4, 4, false,
+                    primitive.tangents, error) ||
+      !GetAttribute(json, bin, object, "COLOR_0", vertex_count, 3, 4, true,
+                    primitive.colors, error)) {
+    return false;
+  }
+
+  primitive.indices = Accessor{nullptr, 0, vertex_count, 0, 0, false};
+  size_t index;
+  if (!GetSize(object, "indices", SIZE_MAX, index)) {
+    error = "invalid indices";
+    return false;
+  }
+  if (index != SIZE_MAX) {
+    if (!GetAccessor(json, bin, index, primitive.indices, error)) {
+      return false;
+    }
+    uint32_t type = primitive.indices.component_type;
+    if ((type != kUnsignedByte && type != kUnsignedShort &&
+         type != kUnsignedInt) ||
+        primitive.indices.component_count != 1 ||
+        primitive.indices.stride != GetComponentSize(type)) {
+      error = "unsupported index layout";
+      return false;
+    }
+  }
+  if (primitive.indices.count == 0 || primitive.indices.count % 3 != 0) {
+    error = "incomplete triangles";
+    return false;
+  }
+
+  size_t material;
+  if (!GetSize(object, "material", SIZE_MAX, material)) {
+    error = "invalid material";
+    return false;
+  }
+  const std::string& name = json["materials"][material]["name"].GetString();
+  primitive.material_id =
+      name.empty() ? kNoMaterial : std::hash<std::string>{}(name);
+  return true;
+}
+
+// Whether the attributes of `primitive` are interleaved exactly like
+// Vertex, starting right after `next_vertex` when given.
+bool IsVertexLayout(const Primitive& primitive, const uint8_t* next_vertex) {
+  const uint8_t* base = primitive.positions.data;
+  auto matches = [base](const Accessor& accessor, size_t component_count,
+                        size_t offset) {
+    return accessor.data == base + offset &&
+           accessor.component_type == kFloat &&
+           accessor.component_count == component_count &&
+           accessor.stride == sizeof(Vertex);
+  };
+  return (next_vertex == nullptr || base == next_vertex) &&
+         IsAligned(base, alignof(Vertex)) &&
+         matches(primitive.positions, 3, offsetof(Vertex, position)) &&
+         matches(primitive.normals, 3, offsetof(Vertex, normal)) &&
+         matches(primitive.colors, 3, offsetof(Vertex, color)) &&
+         matches(primitive.uvs, 2, offsetof(Vertex, uv)) &&
+         matches(primitive.tangents, 4, offsetof(Vertex, tangent));
+}
+
+// Fills the vertices of a primitive, which `indices` refer to.
+void ConvertVertices(const Primitive& primitive,
+                     Span<const uint32_t> indices,
+                     Vertex* vertices) {
+  const size_t count = primitive.positions.count;
+  for (size_t i = 0; i < count; ++i) {
+    vertices[i] =
+        Vertex{glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3{1.0f, 1.0f, 1.0f},
+               glm::vec2(0.0f), glm::vec4(0.0f)};
+  }
+  uint8_t* dst = reinterpret_cast<uint8_t*>(vertices);
+  GatherFloats(primitive.positions, 3, dst + offsetof(Vertex, position),
+               sizeof(Vertex));
+  if (primitive.normals.data != nullptr) {
+    GatherFloats(primitive.normals, 3, dst + offsetof(Vertex, normal),
+                 sizeof(Vertex));
+  }
+  // Alpha has no place in Vertex.
+  if (primitive.colors.data != nullptr) {
+    GatherFloats(primitive.colors, 3, dst + offsetof(Vertex, color),
+                 sizeof(Vertex));
+  }
+  if (primitive.uvs.data != nullptr) {
+    GatherFloats(primitive.uvs, 2, dst + offsetof(Vertex, uv),
+                 sizeof(Vertex));
+  }
+  if (primitive.tangents.data != nullptr) {
+    GatherFloats(primitive.tangents, 4, dst + offsetof(Vertex, tangent),
+                 sizeof(Vertex));
+    return;
+  }
+  // Tangents are generated as for OBJ files, whose v axis points up.
+  Span<Vertex> span(vertices, count);
+  for (Vertex& vertex : span) {
+    vertex.uv.y = 1.0f - vertex.uv.y;
+  }
+  GenerateTangents(indices, span);
+  for (Vertex& vertex : span) {
+    vertex.uv.y = 1.0f - vertex.uv.y;
+  }
+}
+}  // namespace
+
+bool ParseGlb(Span<const uint8_t> file, GlbMesh& mesh, std::string& error) {
+  mesh = GlbMesh{};
+  if (file.size() < kHeaderSize + kChunkHeaderSize ||
+      ReadUint32(file.data()) != kMagic) {
+    error = "not a GLB file";
+    return false;
+  }
+  if (ReadUint32(file.data() + 4) != 2) {
+    error = "unsupported glTF version";
+    return false;
+  }
+  const size_t file_size =
+      std::min<size_t>(ReadUint32(file.data() + 8), file.size());
+  const uint8_t* chunk = file.data() + kHeaderSize;
+  size_t json_size = ReadUint32(chunk);
+  if (ReadUint32(chunk + 4) != kJsonChunk ||
+      json_size > file_size - kHeaderSize - kChunkHeaderSize) {
+    error = "invalid JSON chunk";
+    return false;
+  }
+  const char* json_begin =
+      reinterpret_cast<const char*>(chunk + kChunkHeaderSize);
+  JsonValue json;
+  if (!ParseJson(json_begin, json_begin + json_size, json, error)) {
+    error = "invalid JSON chunk: " + error;
+    return false;
+  }
+  // The BIN chunk is optional, and only the first buffer may refer to it.
+  Span<const uint8_t> bin;
+  size_t bin_offset = kHeaderSize + kChunkHeaderSize + json_size;
+  if (bin_offset + kChunkHeaderSize <= file_size &&
+      ReadUint32(file.data() + bin_offset + 4) == kBinChunk) {
+    size_t bin_size = ReadUint32(file.data() + bin_offset);
+    bin_offset += kChunkHeaderSize;
+    if (bin_size > file_size - bin_offset) {
+      error = "invalid BIN chunk";
+      return false;
+    }
+    bin = Span<const uint8_t>(file.data() + bin_offset, bin_size);
+  }
+  if (!json["buffers"][0]["uri"].IsNull()) {
+    error = "external buffers aren't supported";
+    return false;
+  }
+
+  std::vector<Primitive> primitives;
+  const JsonValue& meshes = json["meshes"];
+  for (size_t i = 0; i < meshes.GetSize(); ++i) {
+    const JsonValue& mesh_primitives = meshes[i]["primitives"];
+    for (size_t j = 0; j < mesh_primitives.GetSize(); ++j) {
+      // Points and lines have no place in a triangle mesh.
+      size_t mode;
+      if (!GetSize(mesh_primitives[j], "mode", kTriangles, mode)) {
+        error = "invalid primitive mode";
+        return false;
+      }
+      if (mode != kTriangles) {
+        continue;
+      }
+      primitives.emplace_back();
+      if (!ReadPrimitive(json, bin, mesh_primitives[j], primitives.back(),
+                         error)) {
+        return false;
+      }
+    }
+  }
+  if (primitives.empty()) {
+    error = "no triangles";
+    return false;
+  }
+
+  size_t index_count = 0;
+  size_t vertex_count = 0;
+  bool indices_in_place = IsAligned(primitives[0].indices.data, 4);
+  bool vertices_in_place = true;
+  for (size_t i = 0; i < primitives.size(); ++i) {
+    const Primitive& primitive = primitives[i];
+    const Primitive* previous = i > 0 ? &primitives[i - 1] : nullptr;
+    indices_in_place =
+        indices_in_place && primitive.indices.component_type == kUnsignedInt &&
+        (previous == nullptr ||
+         primitive.indices.data ==
+             previous->indices.data + previous->indices.count * 4);
+    vertices_in_place =
+        vertices_in_place &&
+        IsVertexLayout(primitive,
+                       previous == nullptr
+                           ? nullptr
+                           : previous->positions.data +
+                                 previous->positions.count * sizeof(Vertex));
+    mesh.sub_meshes.push_back(SubMesh{static_cast<uint32_t>(index_count),
+                                      static_cast<uint32_t>(
+                                          primitive.indices.count),
+                                      static_cast<int32_t>(vertex_count),
+                                      primitive.material_id});
+    index_count += primitive.indices.count;
+    vertex_count += primitive.positions.count;
+  }
+  if (index_count > UINT32_MAX || vertex_count > INT32_MAX) {
+    error = "too many vertices";
+    return false;
+  }
+
+  if (indices_in_place) {
+    mesh.indices = Span<const uint32_t>(
+        reinterpret_cast<const uint32_t*>(primitives[0].indices.data),
+        index_count);
+  } else {
+    mesh.index_storage.resize(index_count);
+    for (size_t i = 0; i < primitives.size(); ++i) {
+      uint32_t* dst = &mesh.index_storage[mesh.sub_meshes[i].first_index];
+      if (primitives[i].indices.data != nullptr) {
+        WidenIndices(primitives[i].indices, dst);
+      } else {
+        for (uint32_t j = 0; j < primitives[i].indices.count; ++j) {
+          dst[j] = j;
+        }
+      }
+    }
+    mesh.indices = mesh.index_storage;
+  }
+  // Tangent generation and the GPU both rely on indices being in range.
+  for (size_t i = 0; i < primitives.size(); ++i) {
+    const SubMesh& sub_mesh = mesh.sub_meshes[i];
+    const uint32_t* indices = &mesh.indices[sub_mesh.first_index];
+    const size_t primitive_vertex_count = primitives[i].positions.count;
+    for (uint32_t j = 0; j < sub_mesh.index_count; ++j) {
+      if (indices[j] >= primitive_vertex_count) {
+        error = "index out of range";
+        return false;
+      }
+    }
+  }
+
+  if (vertices_in_place) {
+    mesh.vertices = Span<const Vertex>(
+        reinterpret_cast<const Vertex*>(primitives[0].positions.data),
+        vertex_count);
+  } else {
+    mesh.vertex_storage.resize(vertex_count);
+    for (size_t i = 0; i < primitives.size(); ++i) {
+      const SubMesh& sub_mesh = mesh.sub_meshes[i];
+      ConvertVertices(
+          primitives[i],
+          Span<const uint32_t>(&mesh.indices[sub_mesh.first_index],
+                               sub_mesh.index_count),
+          &mesh.vertex_storage[static_cast<size_t>(sub_mesh.vertex_offset)]);
+    }
+    mesh.vertices = mesh.vertex_storage;
+  }
+  mesh.converted_size = mesh.index_storage.size() * sizeof(uint32_t) +
+                        mesh.vertex_storage.size() * sizeof(Vertex);
+  return true;
+}
+}  // namespace render
@@ -0,0 +1,358 @@
+#include <cstdint>
+#include <locale>
+#include <sstream>
+#include <string>
+
+#include "render/Json.hpp"
+
+namespace render {
+namespace {
+const size_t kMaxDepth = 64;
+
+const JsonValue& GetNull() {
+  static const JsonValue null;
+  return null;
+}
+
+bool IsDigit(char c) {
+  return static_cast<unsigned int>(c - '0') < 10u;
+}
+
+int ParseHexDigit(char c) {
+  if (IsDigit(c)) {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+void AppendUtf8(uint32_t code_point, std::string& string) {
+  if (code_point < 0x80) {
+    string += static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    string += static_cast<char>(0xc0 | code_point >> 6);
+    string += static_cast<char>(0x80 | (code_point & 0x3f));
+  } else if (code_point < 0x10000) {
+    string += static_cast<char>(0xe0 | code_point >> 12);
+    string += static_cast<char>(0x80 | (code_point >> 6 & 0x3f));
+    string += static_cast<char>(0x80 | (code_point & 0x3f));
+  } else {
+    string += static_cast<char>(0xf0 | code_point >> 18);
+    string += static_cast<char>(0x80 | (code_point >> 12 & 0x3f));
+    string += static_cast<char>(0x80 | (code_point >> 6 & 0x3f));
+    string += static_cast<char>(0x80 | (code_point & 0x3f));
+  }
+}
+}  // namespace
+
+// Recursive descent over the text, failing on the first error.
+class JsonParser {
+ public:
+  JsonParser(const char* begin, const char* end)
+      : begin_(begin), p_(begin), end_(end) {
+    // strtod follows LC_NUMERIC, which may want a ',' decimal point.
+    number_stream_.imbue(std::locale::classic());
+  }
+
+  bool Parse(JsonValue& value, std::string& error) {
+    if (!ParseValue(value, 0) || (SkipSpaces(), p_ != end_)) {
+      error = (error_ != nullptr ? error_ : "unexpected character") +
+              std::string(" at offset ") + std::to_string(p_ - begin_);
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  bool Fail(const char* error) {
+    error_ = error;
+    return false;
+  }
+
+  void SkipSpaces() {
+    while (p_ < end_ &&
+           (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+      ++p_;
+    }
+  }
+
+  bool Consume(const char* literal) {
+    const char* p = p_;
+    for (; *literal != '\0'; ++literal, ++p) {
+      if (p == end_ || *p != *literal) {
+        return false;
+      }
+    }
+    p_ = p;
+    return true;
+  }
+
+  bool ParseValue(JsonValue& value, size_t depth) {
+    if (depth > kMaxDepth) {
+      return Fail("nested too deeply");
+    }
+    SkipSpaces();
+    if (p_ == end_) {
+      return Fail("unexpected end");
+    }
+    switch (*p_) {
+      case '{':
+        return ParseObject(value, depth);
+      case '[':
+        return ParseArray(value, depth);
+      case '"':
+        value.type_ = JsonValue::Type::kString;
+        return ParseString(value.string_);
+      case 't':
+      case 'f':
+        value.type_ = JsonValue::Type::kBool;
+        value.bool_ = *p_ == 't';
+        return Consume(value.bool_ ? "true" : "false");
+      case 'n':
+        return Consume("null");
+      default:
+        return ParseNumber(value);
+    }
+  }
+
+  bool ParseObject(JsonValue& value, size_t depth) {
+    value.type_ = JsonValue::Type::kObject;
+    ++p_;
+    SkipSpaces();
+    if (p_ < end_ && *p_ == '}') {
+      ++p_;
+      return true;
+    }
+    for (;;) {
+      SkipSpaces();
+      if (p_ == end_ || *p_ != '"') {
+        return Fail("expected a member name");
+      }
+      value.keys_.emplace_back();
+      if (!ParseString(value.keys_.back())) {
+        return false;
+      }
+      SkipSpaces();
+      if (p_ == end_ || *p_++ != ':') {
+        return Fail("expected ':'");
+      }
+      value.elements_.emplace_back();
+      if (!ParseValue(value.elements_.back(), depth + 1)) {
+        return false;
+      }
+      SkipSpaces();
+      if (p_ < end_ && *p_ == ',') {
+        ++p_;
+      } else if (p_ < end_ && *p_ == '}') {
+        ++p_;
+        return true;
+      } else {
+        return Fail("expected ',' or '}'");
+      }
+    }
+  }
+
+  bool ParseArray(JsonValue& value, size_t depth) {
+    value.type_ = JsonValue::Type::kArray;
+    ++p_;
+    SkipSpaces();
+    if (p_ < end_ && *p_ == ']') {
+      ++p_;
+      return true;
+    }
+    for (;;) {
+      value.elements_.emplace_back();
+      if (!ParseValue(value.elements_.back(), depth + 1)) {
+        return false;
+      }
+      SkipSpaces();
+      if (p_ < end_ && *p_ == ',') {
+        ++p_;
+      } else if (p_ < end_ && *p_ == ']') {
+        ++p_;
+        return true;
+      } else {
+        return Fail("expected ',' or ']'");
+      }
+    }
+  }
+
+  bool ParseHex4(uint32_t& code_unit) {
+    if (end_ - p_ < 4) {
+      return false;
+    }
+    code_unit = 0;
+    for (int i = 0; i < 4; ++i) {
+      int digit = ParseHexDigit(*p_++);
+      if (digit < 0) {
+        return false;
+      }
+      code_unit = code_unit << 4 | static_cast<uint32_t>(digit);
+    }
+    return true;
+  }
+
+  bool ParseString(std::string& string) {
+    ++p_;
+    for (;;) {
+      const char* run_end = p_;
+      while (run_end < end_ && *run_end != '"' && *run_end != '\\' &&
+             static_cast<unsigned char>(*run_end) >= 0x20) {
+        ++run_end;
+      }
+      string.append(p_, run_end);
+      p_ = run_end;
+      if (p_ == end_) {
+        return Fail("unterminated string");
+      }
+      char c = *p_++;
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\' || p_ == end_) {
+        return Fail("invalid character in string");
+      }
+      switch (*p_++) {
+        case '"':
+          string += '"';
+          break;
+        case '\\':
+          string += '\\';
+          break;
+        case '/':
+          string += '/';
+          break;
+        case 'b':
+          string += '\b';
+          break;
+        case 'f':
+          string += '\f';
+          break;
+        case 'n':
+          string += '\n';
+          break;
+        case 'r':
+          string += '\r';
+          break;
+        case 't':
+          string += '\t';
+          break;
+        case 'u': {
+          uint32_t code_point;
+          if (!ParseHex4(code_point)) {
+            return Fail("invalid \\u escape");
+          }
+          // Characters outside the basic plane come as surrogate pairs.
+          if (code_point >= 0xd800 && code_point < 0xdc00) {
+            uint32_t low;
+            if (!Consume("\\u") || !ParseHex4(low) || low < 0xdc00 ||
+                low >= 0xe000) {
+              return Fail("unpaired surrogate");
+            }
+            code_point = 0x10000 + ((code_point - 0xd800) << 10) +
+                         (low - 0xdc00);
+          } else if (code_point >= 0xdc00 && code_point < 0xe000) {
+            return Fail("unpaired surrogate");
+          }
+          AppendUtf8(code_point, string);
+          break;
+        }
+        default:
+          return Fail("invalid escape");
+      }
+    }
+  }
+
+  // Checks the grammar, which the stream is laxer about, then converts.
+  bool ParseNumber(JsonValue& value) {
+    const char* p = p_;
+    if (p < end_ && *p == '-') {
+      ++p;
+    }
+    if (p < end_ && *p == '0') {
+      ++p;
+    } else if (p < end_ && IsDigit(*p)) {
+      while (p < end_ && IsDigit(*p)) {
+        ++p;
+      }
+    } else {
+      return Fail("unexpected character");
+    }
+    if (p < end_ && *p == '.') {
+      if (++p == end_ || !IsDigit(*p)) {
+        return Fail("invalid number");
+      }
+      while (p < end_ && IsDigit(*p)) {
+        ++p;
+      }
+    }
+    if (p < end_ && (*p == 'e' || *p == 'E')) {
+      ++p;
+      if (p < end_ && (*p == '+' || *p == '-')) {
+        ++p;
+      }
+      if (p == end_ || !IsDigit(*p)) {
+        return Fail("invalid number");
+      }
+      while (p < end_ && IsDigit(*p)) {
+        ++p;
+      }
+    }
+    number_stream_.clear();
+    number_stream_.str(std::string(p_, p));
+    value.type_ = JsonValue::Type::kNumber;
+    number_stream_ >> value.number_;
+    p_ = p;
+    return true;
+  }
+
+  const char* begin_;
+  const char* p_;
+  const char* end_;
+  const char* error_ = nullptr;
+  std::istringstream number_stream_;
+};
+
+bool JsonValue::GetBool(bool fallback) const {
+  return type_ == Type::kBool ? bool_ : fallback;
+}
+
+double JsonValue::GetNumber(double fallback) const {
+  return type_ == Type::kNumber ? number_ : fallback;
+}
+
+const std::string& JsonValue::GetString() const {
+  return string_;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+  return type_ == Type::kArray && index < elements_.size() ? elements_[index]
+                                                           : GetNull();
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const {
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    if (keys_[i] == key) {
+      return elements_[i];
+    }
+  }
+  return GetNull();
+}
+
+const std::string& JsonValue::GetKey(size_t index) const {
+  return keys_[index];
+}
+
+bool ParseJson(const char* begin,
+               const char* end,
+               JsonValue& value,
+               std::string& error) {
+  value = JsonValue();
+  return JsonParser(begin, end).Parse(value, error);
+}
+}  // namespace render
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "render/Ktx2.hpp"
+#include "render/vulkan/Format.hpp"
+
+namespace render {
+namespace {
+const uint8_t kIdentifier[12] = {0xAB, 'K', 'T',  'X',  ' ', '2',
+                                 '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Header {
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  // Followed by the 64-bit supercompression global data offset and length,
+  // unused without supercompression.
+};
+
+const size_t kLevelIndexOffset = 80;
+
+struct LevelIndex {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+};
+
+static_assert(sizeof(Header) == 52, "KTX2 header must be tightly packed");
+static_assert(sizeof(LevelIndex) == 24, "KTX2 level index must be packed");
+
+// Key/value entries are a 32-bit length, then a NUL terminated key and the
+// value, padded to 4 bytes.
+void ParseKeyValues(const uint8_t* data,
+                    size_t size,
+                    std::vector<std::pair<std::string, std::string>>& pairs) {
+  size_t offset = 0;
+  while (offset + sizeof(uint32_t) <= size) {
+    uint32_t length;
+    std::memcpy(&length, data + offset, sizeof(length));
+    offset += sizeof(length);
+    if (length > size - offset) {
+      return;
+    }
+    const char* entry = reinterpret_cast<const char*>(data + offset);
+    const char* key_end = std::find(entry, entry + length, '\0');
+    if (key_end != entry + length) {
+      const char* value_end = entry + length;
+      // String values conventionally include their terminator.
+      if (value_end > key_end + 1 && value_end[-1] == '\0') {
+        --value_end;
+      }
+      pairs.emplace_back(std::string(entry, key_end),
+                         std::string(key_end + 1, value_end));
+    }
+    offset += (length + 3) & ~3u;
+  }
+}
+
+// Basic data format descriptor of an RGBA8 format, the one piece of
+// metadata KTX2 requires.
+std::vector<uint32_t> DescribeRgba8(bool srgb) {
+  const uint32_t kBlockSize = 24 + 4 * 16;
+  std::vector<uint32_t> words = {
+      4 + kBlockSize,        // total size
+      0,                     // Khronos vendor, basic descriptor type
+      2 | kBlockSize << 16,  // version 2
+      // RGBSDA color model, BT.709 primaries, then the transfer function.
+      1 | 1 << 8 | (srgb ? 2u : 1u) << 16,
+      0,  // 1x1x1x1 texel blocks
+      4,  // bytes in plane 0
+      0};
+  const uint32_t channels[4] = {0, 1, 2, 15};
+  for (uint32_t i = 0; i < 4; ++i) {
+    // Alpha stays linear in sRGB formats.
+    uint32_t channel = channels[i] | (srgb && i == 3 ? 0x10 : 0);
+    words.insert(words.end(), {i * 8 | 7 << 16 | channel << 24, 0, 0, 255});
+  }
+  return words;
+}
+
+uint32_t Align4(uint32_t offset) {
+  return (offset + 3) & ~3u;
+}
+}  // namespace
+
+bool LoadKtx2(const std::string& path, Ktx2Image& image, std::string& error) {
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream) {
+    error = "can't open file";
+    return false;
+  }
+  std::vector<uint8_t> file((std::istreambuf_iterator<char>(stream)),
+                            std::istreambuf_iterator<char>());
+  return ParseKtx2(file.data(), file.size(), image, error);
+}
+
+bool ParseKtx2(const uint8_t* file,
+               size_t file_size,
+               Ktx2Image& image,
+               std::string& error) {
+  // KTX2 is little-endian, like every platform this demo runs on.
+  Header header;
+  if (file_size < kLevelIndexOffset ||
+      std::memcmp(file, kIdentifier, sizeof(kIdentifier)) != 0) {
+    error = "not a KTX2 file";
+    return false;
+  }
+  std::memcpy(&header, file + sizeof(kIdentifier), sizeof(header));
+
+  if (header.supercompression_scheme != 0 ||
+      header.vk_format == VK_FORMAT_UNDEFINED) {
+    error = "supercompressed textures are not supported";
+    return false;
+  }
+  if (header.pixel_depth > 1 || header.layer_count > 1 ||
+      header.face_count != 1 || header.pixel_height == 0) {
+    error = "only single 2D textures are supported";
+    return false;
+  }
+  vulkan::FormatInfo format_info;
+  VkFormat format = static_cast<VkFormat>(header.vk_format);
+  if (!vulkan::GetFormatInfo(format, format_info)) {
+    error = "unsupported format " + std::to_string(header.vk_format);
+    return false;
+  }
+
+  // A level count of 0 asks the loader to generate mips, which block
+  // compressed data can't be; only level 0 is present then.
+  uint32_t level_count = std::max(header.level_count, 1u);
+  if (file_size < kLevelIndexOffset + level_count * sizeof(LevelIndex)) {
+    error = "truncated level index";
+    return false;
+  }
+
+  image.format = format;
+  image.width = header.pixel_width;
+  image.height = header.pixel_height;
+  image.level_count = level_count;
+  image.data.resize(vulkan::GetMipChainSize(format_info, image.width,
+                                            image.height, level_count));
+
+  // Levels are stored smallest first in the file but indexed from level 0.
+  size_t data_offset = 0;
+  for (uint32_t level = 0; level < level_count; ++level) {
+    LevelIndex level_index;
+    std::memcpy(&level_index,
+                file + kLevelIndexOffset + level * sizeof(LevelIndex),
+                sizeof(level_index));
+    uint64_t level_size = vulkan::GetLevelSize(format_info, image.width,
+                                               image.height, level);
+    if (level_index.byte_length != level_size ||
+        level_index.byte_offset + level_size > file_size) {
+      error = "bad size for level " + std::to_string(level);
+      return false;
+    }
+    std::memcpy(image.data.data() + data_offset,
+                file + level_index.byte_offset, level_size);
+    data_offset += level_size;
+  }
+
+  image.key_values.clear();
+  if (header.kvd_byte_length > 0 && header.kvd_byte_offset <= file_size &&
+      header.kvd_byte_length <= file_size - header.kvd_byte_offset) {
+    ParseKeyValues(file + header.kvd_byte_offset, header.kvd_byte_length,
+                   image.key_values);
+  }
+  return true;
+}
+
+bool WriteKtx2(const std::string& path,
+               const Ktx2Image& image,
+               std::string& error) {
+  if (image.format != VK_FORMAT_R8G8B8A8_SRGB &&
+      image.format != VK_FORMAT_R8G8B8A8_UNORM) {
+    error = "no data format descriptor for " +
+            std::string(vulkan::GetFormatName(image.format));
+    return false;
+  }
+  vulkan::FormatInfo format_info;
+  vulkan::GetFormatInfo(image.format, format_info);
+  std::vector<uint32_t> dfd =
+      DescribeRgba8(image.format == VK_FORMAT_R8G8B8A8_SRGB);
+  std::vector<uint8_t> kvd;
+  for (const auto& pair : image.key_values) {
+    uint32_t length =
+        static_cast<uint32_t>(pair.first.size() + pair.second.size() + 2);
+    const uint8_t* length_bytes = reinterpret_cast<const uint8_t*>(&length);
+    kvd.insert(kvd.end(), length_bytes, length_bytes + sizeof(length));
+    kvd.insert(kvd.end(), pair.first.begin(), pair.first.end());
+    kvd.push_back(0);
+    kvd.insert(kvd.end(), pair.second.begin(), pair.second.end());
+    kvd.push_back(0);
+    kvd.resize(Align4(static_cast<uint32_t>(kvd.size())), 0);
+  }
+
+  Header header{};
+  header.vk_format = image.format;
+  header.type_size = 1;
+  header.pixel_width = image.width;
+  header.pixel_height = image.height;
+  header.face_count = 1;
+  header.level_count = image.level_count;
+  header.dfd_byte_offset = static_cast<uint32_t>(
+      kLevelIndexOffset + image.level_count * sizeof(LevelIndex));
+  header.dfd_byte_length =
+      static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+  header.kvd_byte_offset =
+      kvd.empty() ? 0 : header.dfd_byte_offset + header.dfd_byte_length;
+  header.kvd_byte_length = static_cast<uint32_t>(kvd.size());
+
+  // Levels go smallest first, each aligned to 4 bytes, the texel size.
+  std::vector<LevelIndex> level_indices(image.level_count);
+  std::vector<size_t> data_offsets(image.level_count);
+  const uint32_t metadata_end = header.dfd_byte_offset +
+                                header.dfd_byte_length +
+                                header.kvd_byte_length;
+  uint64_t file_offset = Align4(metadata_end);
+  size_t data_offset = 0;
+  for (uint32_t level = 0; level < image.level_count; ++level) {
+    data_offsets[level] = data_offset;
+    data_offset += vulkan::GetLevelSize(format_info, image.width, image.height,
+                                        level);
+  }
+  if (data_offset != image.data.size()) {
+    error = "data doesn't match the level count";
+    return false;
+  }
+  for (uint32_t level = image.level_count; level-- > 0;) {
+    uint64_t level_size = vulkan::GetLevelSize(format_info, image.width,
+                                               image.height, level);
+    level_indices[level] = LevelIndex{file_offset, level_size, level_size};
+    file_offset += level_size;
+  }
+
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+    const uint64_t supercompression_global_data[2] = {0, 0};
+    const char padding[4] = {};
+    stream.write(reinterpret_cast<const char*>(kIdentifier),
+                 sizeof(kIdentifier));
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(supercompression_global_data),
+                 sizeof(supercompression_global_data));
+    stream.write(reinterpret_cast<const char*>(level_indices.data()),
+                 level_indices.size() * sizeof(LevelIndex));
+    stream.write(reinterpret_cast<const char*>(dfd.data()),
+                 header.dfd_byte_length);
+    stream.write(reinterpret_cast<const char*>(kvd.data()), kvd.size());
+    stream.write(padding, Align4(metadata_end) - metadata_end);
+    for (uint32_t level = image.level_count; level-- > 0;) {
+      stream.write(reinterpret_cast<const char*>(image.data.data()) +
+                       data_offsets[level],
+                   level_indices[level].byte_length);
+    }
+    if (!stream) {
+      stream.close();
+      std::remove(temporary_path.c_str());
+      error = "can't write file";
+      return false;
+    }
+  }
+  // rename() doesn't replace existing files on Windows.
+  std::remove(path.c_str());
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    error = "can't replace file";
+    return false;
+  }
+  return true;
+}
+}  // namespace render
@@ -0,0 +1,188 @@
+#include <cstring>
+
+#include "render/Lz4.hpp"
+
+namespace render {
+namespace {
+const size_t kMinMatch = 4;
+// The format requires the last 5 bytes to be literals, and the last match
+// to start 12 bytes before the end at the latest.
+const size_t kLastLiterals = 5;
+const size_t kMatchFindLimit = 12;
+const size_t kMaxOffset = 65535;
+const uint32_t kHashBits = 12;
+
+uint32_t Read32(const uint8_t* bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+uint32_t Hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+// Bytes the part of a length that doesn't fit its token nibble takes.
+size_t GetLengthSize(size_t length) {
+  return length < 15 ? 0 : (length - 15) / 255 + 1;
+}
+
+// Writes the part of a length that doesn't fit its token nibble.
+uint8_t* WriteLength(uint8_t* dst, size_t length) {
+  for (; length >= 255; length -= 255) {
+    *dst++ = 255;
+  }
+  *dst++ = static_cast<uint8_t>(length);
+  return dst;
+}
+
+bool ReadLength(const uint8_t*& src, const uint8_t* src_end, size_t& length) {
+  uint8_t byte;
+  do {
+    if (src == src_end) {
+      return false;
+    }
+    byte = *src++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// Writes a sequence of `literal_count` literals then, when `match_length` is
+// not 0, a match. Returns nullptr when it doesn't fit before `dst_end`.
+uint8_t* WriteSequence(uint8_t* dst,
+                       uint8_t* dst_end,
+                       const uint8_t* literals,
+                       size_t literal_count,
+                       size_t offset,
+                       size_t match_length) {
+  // Token, length bytes, literals, offset and match length bytes.
+  size_t sequence_size = 1 + GetLengthSize(literal_count) + literal_count;
+  if (match_length != 0) {
+    sequence_size += 2 + GetLengthSize(match_length - kMinMatch);
+  }
+  if (sequence_size > static_cast<size_t>(dst_end - dst)) {
+    return nullptr;
+  }
+  uint8_t* token = dst++;
+  *token = static_cast<uint8_t>(
+      (literal_count < 15 ? literal_count : 15) << 4);
+  if (literal_count >= 15) {
+    dst = WriteLength(dst, literal_count - 15);
+  }
+  // Empty inputs may come as null.
+  if (literal_count > 0) {
+    std::memcpy(dst, literals, literal_count);
+  }
+  dst += literal_count;
+  if (match_length == 0) {
+    return dst;
+  }
+  *dst++ = static_cast<uint8_t>(offset);
+  *dst++ = static_cast<uint8_t>(offset >> 8);
+  size_t length_code = match_length - kMinMatch;
+  *token |= static_cast<uint8_t>(length_code < 15 ? length_code : 15);
+  if (length_code >= 15) {
+    dst = WriteLength(dst, length_code - 15);
+  }
+  return dst;
+}
+}  // namespace
+
+size_t GetLz4CompressBound(size_t size) {
+  return size + size / 255 + 16;
+}
+
+size_t Lz4Compress(const uint8_t* src,
+                   size_t size,
+                   uint8_t* dst,
+                   size_t capacity) {
+  uint8_t* const dst_begin = dst;
+  uint8_t* const dst_end = dst + capacity;
+  // Positions plus one, so that 0 marks empty slots.
+  uint32_t table[1u << kHashBits] = {};
+  size_t position = 0;
+  size_t anchor = 0;
+  while (position + kMatchFindLimit <= size) {
+    uint32_t sequence = Read32(src + position);
+    uint32_t& slot = table[Hash(sequence)];
+    size_t candidate = slot;
+    slot = static_cast<uint32_t>(position + 1);
+    if (candidate == 0 || position + 1 - candidate > kMaxOffset ||
+        Read32(src + candidate - 1) != sequence) {
+      ++position;
+      continue;
+    }
+    size_t match = candidate - 1;
+    size_t match_length = kMinMatch;
+    while (position + match_length < size - kLastLiterals &&
+           src[match + match_length] == src[position + match_length]) {
+      ++match_length;
+    }
+    dst = WriteSequence(dst, dst_end, src + anchor, position - anchor,
+                        position - match, match_length);
+    if (dst == nullptr) {
+      return 0;
+    }
+    position += match_length;
+    anchor = position;
+  }
+  dst = WriteSequence(dst, dst_end, src + anchor, size - anchor, 0, 0);
+  return dst == nullptr ? 0 : static_cast<size_t>(dst - dst_begin);
+}
+
+bool Lz4Decompress(const uint8_t* src,
+                   size_t compressed_size,
+                   uint8_t* dst,
+                   size_t size) {
+  const uint8_t* const src_end = src + compressed_size;
+  uint8_t* const dst_begin = dst;
+  uint8_t* const dst_end = dst + size;
+  while (src != src_end) {
+    uint8_t token = *src++;
+    size_t literal_count = token >> 4;
+    if (literal_count == 15 && !ReadLength(src, src_end, literal_count)) {
+      return false;
+    }
+    if (literal_count > static_cast<size_t>(src_end - src) ||
+        literal_count > static_cast<size_t>(dst_end - dst)) {
+      return false;
+    }
+    if (literal_count > 0) {
+      std::memcpy(dst, src, literal_count);
+    }
+    src += literal_count;
+    dst += literal_count;
+    // Only the last sequence lacks a match.
+    if (src == src_end) {
+      break;
+    }
+
+    if (src_end - src < 2) {
+      return false;
+    }
+    size_t offset = src[0] | size_t{src[1]} << 8;
+    src += 2;
+    size_t match_length = token & 15;
+    if (match_length == 15 && !ReadLength(src, src_end, match_length)) {
+      return false;
+    }
+    match_length += kMinMatch;
+    if (offset == 0 || offset > static_cast<size_t>(dst - dst_begin) ||
+        match_length > static_cast<size_t>(dst_end - dst)) {
+      return false;
+    }
+    // Matches may overlap the bytes they produce, repeating them.
+    const uint8_t* match = dst - offset;
+    if (offset >= match_length) {
+      std::memcpy(dst, match, match_length);
+      dst += match_length;
+    } else {
+      for (size_t i = 0; i < match_length; ++i) {
+        *dst++ = match[i];
+      }
+    }
+  }
+  return dst == dst_end;
+}
+}  // namespace render
@@ -0,0 +1,88 @@
+#include "render/MaterialTable.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace render {
+void MaterialTable::Load(ResourceId id,
+                         std::vector<ResourceId> texture_ids,
+                         std::vector<ResourceId>& first_referenced_ids,
+                         std::vector<Texture>& released) {
+  // References are taken before the replaced ones are dropped, textures
+  // both lists share stay resident.
+  for (ResourceId texture_id : texture_ids) {
+    if (texture_cache_.AddReference(texture_id)) {
+      first_referenced_ids.push_back(texture_id);
+    }
+  }
+  std::vector<ResourceId>& pending_ids = pending_[id];
+  Release(pending_ids, released);
+  pending_ids = std::move(texture_ids);
+}
+
+bool MaterialTable::Unload(ResourceId id, std::vector<Texture>& released) {
+  auto pending_it = pending_.find(id);
+  if (pending_it != pending_.end()) {
+    Release(pending_it->second, released);
+    pending_.erase(pending_it);
+  }
+  auto resident_it = resident_.find(id);
+  if (resident_it == resident_.end()) {
+    return false;
+  }
+  Release(resident_it->second, released);
+  resident_.erase(resident_it);
+  return true;
+}
+
+std::vector<ResourceId> MaterialTable::BindComplete(
+    std::vector<Texture>& released) {
+  std::vector<ResourceId> ids;
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    const std::vector<ResourceId>& texture_ids = it->second;
+    bool complete = std::all_of(
+        texture_ids.begin(), texture_ids.end(),
+        [this](ResourceId id) { return texture_cache_.Contains(id); });
+    if (!complete) {
+      ++it;
+      continue;
+    }
+    std::vector<ResourceId>& resident_ids = resident_[it->first];
+    Release(resident_ids, released);
+    resident_ids = std::move(it->second);
+    ids.push_back(it->first);
+    it = pending_.erase(it);
+  }
+  return ids;
+}
+
+std::vector<ResourceId> MaterialTable::DropFailed(
+    const std::unordered_set<ResourceId>& failed_texture_ids,
+    std::vector<Texture>& released) {
+  auto is_failed = [&failed_texture_ids](ResourceId id) {
+    return failed_texture_ids.count(id) != 0;
+  };
+  std::vector<ResourceId> ids;
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    const std::vector<ResourceId>& texture_ids = it->second;
+    if (std::none_of(texture_ids.begin(), texture_ids.end(), is_failed)) {
+      ++it;
+      continue;
+    }
+    Release(texture_ids, released);
+    ids.push_back(it->first);
+    it = pending_.erase(it);
+  }
+  return ids;
+}
+
+void MaterialTable::Release(const std::vector<ResourceId>& texture_ids,
+                            std::vector<Texture>& released) {
+  for (ResourceId texture_id : texture_ids) {
+    Texture texture;
+    if (texture_cache_.RemoveReference(texture_id, texture)) {
+      released.push_back(std::move(texture));
+    }
+  }
+}
+}  // namespace render
@@ -0,0 +1,242 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "render/MeshCache.hpp"
+#include "render/MeshLoader.hpp"
+
+namespace render {
+namespace {
+const char kMagic[8] = {'V', 'D', 'M', 'E', 'S', 'H', '\r', '\n'};
+const uint32_t kFormatVersion = 5;
+const uint64_t kAlignment = 16;
+
+struct Header {
+  char magic[8];
+  uint32_t format_version;
+  uint32_t loader_version;
+  uint64_t source_hash;
+  uint32_t vertex_format;
+  uint32_t optimized;
+  MeshBounds bounds;
+  glm::vec4 bounding_sphere;
+  uint32_t vertex_size;
+  uint32_t index_size;
+  uint64_t vertex_count;
+  uint64_t vertex_offset;
+  uint64_t index_count;
+  uint64_t index_offset;
+  uint32_t sub_mesh_count;
+  uint32_t sub_mesh_size;
+  uint64_t sub_mesh_offset;
+  uint32_t lod_count;
+  uint32_t lod_size;
+  uint64_t lod_offset;
+  uint32_t meshlet_count;
+  uint32_t meshlet_size;
+  uint64_t meshlet_offset;
+};
+static_assert(sizeof(Header) == 168, "mesh cache header must be packed");
+
+uint64_t Align(uint64_t offset) {
+  return (offset + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+uint32_t GetVertexSize(VertexFormat format) {
+  return format == VertexFormat::kPacked ? sizeof(PackedVertex)
+                                         : sizeof(Vertex);
+}
+
+// Checks that [offset, offset + count * element_size) is an aligned range
+// of the file, without overflowing on garbage counts.
+bool IsValidRange(uint64_t offset,
+                  uint64_t count,
+                  uint64_t element_size,
+                  uint64_t file_size) {
+  return offset % kAlignment == 0 && offset <= file_size &&
+         count <= (file_size - offset) / element_size;
+}
+
+template <typename T>
+Span<const T> GetArray(Span<const uint8_t> data,
+                       uint64_t offset,
+                       size_t count) {
+  // The blob is aligned, so aligned offsets give aligned arrays.
+  return Span<const T>(reinterpret_cast<const T*>(data.data() + offset),
+                       count);
+}
+
+// Pads to `offset`, then writes `array` and returns the offset following it.
+template <typename T>
+uint64_t WriteArray(std::ofstream& stream,
+                    uint64_t position,
+                    uint64_t offset,
+                    Span<const T> array) {
+  const char padding[kAlignment] = {};
+  stream.write(padding, offset - position);
+  stream.write(reinterpret_cast<const char*>(array.data()),
+               array.size_bytes());
+  return offset + array.size_bytes();
+}
+}  // namespace
+
+std::string GetMeshCachePath(const std::string& source_path, bool optimized) {
+  return source_path + (optimized ? ".optimized.meshcache" : ".meshcache");
+}
+
+std::string GetCookedMeshPath(const std::string& source_path,
+                              VertexFormat format) {
+  return source_path +
+         (format == VertexFormat::kPacked ? ".packed.mesh" : ".mesh");
+}
+
+bool ReadMeshCache(const std::string& path,
+                   MappedFile& file,
+                   MeshCacheContents& contents) {
+  // Mappings are page aligned.
+  if (!file.Open(path) ||
+      !ParseMeshCache(Span<const uint8_t>(file.GetData(), file.GetSize()),
+                      contents)) {
+    file.Close();
+    return false;
+  }
+  return true;
+}
+
+bool ParseMeshCache(Span<const uint8_t> data, MeshCacheContents& contents) {
+  if (data.size() < sizeof(Header)) {
+    return false;
+  }
+  Header header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  VertexFormat format = static_cast<VertexFormat>(header.vertex_format);
+  bool valid =
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+      header.format_version == kFormatVersion &&
+      header.loader_version == MeshLoader::kVersion &&
+      (format == VertexFormat::kFloat || format == VertexFormat::kPacked) &&
+      header.vertex_size == GetVertexSize(format) &&
+      header.index_size == sizeof(uint32_t) &&
+      IsValidRange(header.vertex_offset, header.vertex_count,
+                   header.vertex_size, data.size()) &&
+      IsValidRange(header.index_offset, header.index_count, sizeof(uint32_t),
+                   data.size()) &&
+      header.sub_mesh_size == sizeof(SubMesh) && header.sub_mesh_count > 0 &&
+      IsValidRange(header.sub_mesh_offset, header.sub_mesh_count,
+                   sizeof(SubMesh), data.size()) &&
+      header.lod_size == sizeof(MeshLod) && header.lod_count > 0 &&
+      header.lod_count % header.sub_mesh_count == 0 &&
+      IsValidRange(header.lod_offset, header.lod_count, sizeof(MeshLod),
+                   data.size()) &&
+      header.meshlet_size == sizeof(Meshlet) &&
+      IsValidRange(header.meshlet_offset, header.meshlet_count,
+                   sizeof(Meshlet), data.size());
+  if (!valid) {
+    return false;
+  }
+
+  contents.source_hash = header.source_hash;
+  contents.optimized = header.optimized != 0;
+  contents.format = format;
+  contents.vertices = {};
+  contents.packed_vertices = {};
+  if (format == VertexFormat::kPacked) {
+    contents.packed_vertices = GetArray<PackedVertex>(
+        data, header.vertex_offset, header.vertex_count);
+  } else {
+    contents.vertices =
+        GetArray<Vertex>(data, header.vertex_offset, header.vertex_count);
+  }
+  contents.bounds = header.bounds;
+  contents.indices =
+      GetArray<uint32_t>(data, header.index_offset, header.index_count);
+  contents.sub_meshes =
+      GetArray<SubMesh>(data, header.sub_mesh_offset, header.sub_mesh_count);
+  contents.lods = GetArray<MeshLod>(data, header.lod_offset, header.lod_count);
+  contents.meshlets =
+      GetArray<Meshlet>(data, header.meshlet_offset, header.meshlet_count);
+  contents.bounding_sphere = header.bounding_sphere;
+
+  for (const SubMesh& sub_mesh : contents.sub_meshes) {
+    valid = valid && sub_mesh.first_index <= header.index_count &&
+            sub_mesh.index_count <= header.index_count - sub_mesh.first_index &&
+            sub_mesh.index_count % 3 == 0;
+  }
+  for (const MeshLod& lod : contents.lods) {
+    valid = valid && lod.index_offset <= header.index_count &&
+            lod.index_count <= header.index_count - lod.index_offset &&
+            lod.index_count % 3 == 0 &&
+            lod.meshlet_offset <= header.meshlet_count &&
+            lod.meshlet_count <= header.meshlet_count - lod.meshlet_offset;
+  }
+  for (const Meshlet& meshlet : contents.meshlets) {
+    valid = valid && meshlet.index_offset <= header.index_count &&
+            meshlet.index_count <= header.index_count - meshlet.index_offset;
+  }
+  if (!valid) {
+    contents = {};
+  }
+  return valid;
+}
+
+bool WriteMeshCache(const std::string& path,
+                    const MeshCacheContents& contents) {
+  Span<const uint8_t> vertices =
+      contents.format == VertexFormat::kPacked
+          ? Span<const uint8_t>(
+                reinterpret_cast<const uint8_t*>(
+                    contents.packed_vertices.data()),
+                contents.packed_vertices.size_bytes())
+          : Span<const uint8_t>(
+                reinterpret_cast<const uint8_t*>(contents.vertices.data()),
+                contents.vertices.size_bytes());
+  Header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.format_version = kFormatVersion;
+  header.loader_version = MeshLoader::kVersion;
+  header.source_hash = contents.source_hash;
+  header.vertex_format = static_cast<uint32_t>(contents.format);
+  header.optimized = contents.optimized ? 1 : 0;
+  header.bounds = contents.bounds;
+  header.bounding_sphere = contents.bounding_sphere;
+  header.vertex_size = GetVertexSize(contents.format);
+  header.index_size = sizeof(uint32_t);
+  header.vertex_count = vertices.size() / header.vertex_size;
+  header.vertex_offset = Align(sizeof(Header));
+  header.index_count = contents.indices.size();
+  header.index_offset = Align(header.vertex_offset + vertices.size());
+  header.sub_mesh_count = static_cast<uint32_t>(contents.sub_meshes.size());
+  header.sub_mesh_size = sizeof(SubMesh);
+  header.sub_mesh_offset =
+      Align(header.index_offset + contents.indices.size_bytes());
+  header.lod_count = static_cast<uint32_t>(contents.lods.size());
+  header.lod_size = sizeof(MeshLod);
+  header.lod_offset =
+      Align(header.sub_mesh_offset + contents.sub_meshes.size_bytes());
+  header.meshlet_count = static_cast<uint32_t>(contents.meshlets.size());
+  header.meshlet_size = sizeof(Meshlet);
+  header.meshlet_offset = Align(header.lod_offset + contents.lods.size_bytes());
+
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t position = sizeof(header);
+    position = WriteArray(stream, position, header.vertex_offset, vertices);
+    position =
+        WriteArray(stream, position, header.index_offset, contents.indices);
+    position = WriteArray(stream, position, header.sub_mesh_offset,
+                          contents.sub_meshes);
+    position = WriteArray(stream, position, header.lod_offset, contents.lods);
+    WriteArray(stream, position, header.meshlet_offset, contents.meshlets);
+    if (!stream) {
+      stream.close();
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+  }
+  // rename() doesn't replace existing files on Windows.
+  std::remove(path.c_str());
+  return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+}  // namespace render
@@ -1,187 +1,517 @@
 #include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <functional>
 #include <iostream>
-#include <unordered_map>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-
-#include "hash.hpp"
+#include "render/Glb.hpp"
 #include "render/MeshLoader.hpp"
+#include "render/MeshOptimizer.hpp"
+#include "render/TangentGenerator.hpp"
+#include "render/VertexWelder.hpp"
 
 namespace render {
-bool operator==(const Vertex& lhs, const Vertex& rhs) {
-  return (lhs.position == rhs.position && lhs.normal == rhs.normal &&
-          lhs.uv == rhs.uv);
+namespace {
+// Maps a unit vector onto the octahedron |x| + |y| + |z| = 1, then unfolds
+// its lower half over the upper one, which keeps the error of a snorm16 pair
+// well under that of three snorm8 components. Null vectors and those that
+// aren't finite encode +z.
+uint32_t EncodeOctahedral(glm::vec3 v) {
+  float length = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+  if (!std::isfinite(length) || length == 0.0f) {
+    return glm::packSnorm2x16(glm::vec2(0.0f, 0.0f));
+  }
+  v /= length;
+  glm::vec2 encoded{v.x, v.y};
+  if (v.z < 0.0f) {
+    encoded.x = (1.0f - std::abs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f);
+    encoded.y = (1.0f - std::abs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return glm::packSnorm2x16(encoded);
 }
-}  // namespace render
 
-namespace {
-struct Index {
-  int position;
-  int normal;
-  int uv;
-};
-
-bool operator==(const Index& lhs, const Index& rhs) {
-  return (lhs.position == rhs.position && lhs.normal == rhs.normal &&
-          lhs.uv == rhs.uv);
+// Missing normals and texture coordinates are left null.
+Vertex MakeVertex(const tinyobj::attrib_t& attributes,
+                  const tinyobj::index_t& index) {
+  Vertex vertex{glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3{1.0f, 1.0f, 1.0f},
+                glm::vec2(0.0f), glm::vec4(0.0f)};
+  const tinyobj::real_t* position =
+      &attributes.vertices[static_cast<size_t>(index.vertex_index) * 3];
+  vertex.position = glm::vec3{position[0], position[1], position[2]};
+  if (index.normal_index >= 0) {
+    const tinyobj::real_t* normal =
+        &attributes.normals[static_cast<size_t>(index.normal_index) * 3];
+    vertex.normal = glm::vec3{normal[0], normal[1], normal[2]};
+  }
+  if (index.texcoord_index >= 0) {
+    const tinyobj::real_t* uv =
+        &attributes.texcoords[static_cast<size_t>(index.texcoord_index) * 2];
+    vertex.uv = glm::vec2{uv[0], uv[1]};
+  }
+  return vertex;
 }
-}  // namespace
 
-namespace std {
-template <>
-struct hash<render::Vertex> {
-  typedef render::Vertex argument_type;
-  typedef std::size_t result_type;
+// Welds `count` corners of a group into `indices`, appending the vertices
+// seen for the first time. Vertices are emitted in the order they first
+// appear in the index buffer.
+void WeldCorners(const tinyobj::attrib_t& attributes,
+                 const tinyobj::index_t* corners,
+                 size_t count,
+                 uint32_t vertex_base,
+                 VertexWelder& welder,
+                 uint32_t* indices,
+                 std::vector<Vertex>& vertices) {
+  for (size_t i = 0; i < count; ++i) {
+    auto vertex_id = welder.Insert(corners[i]);
+    indices[i] = vertex_base + vertex_id.first;
+    if (vertex_id.second) {
+      vertices.push_back(MakeVertex(attributes, corners[i]));
+    }
+  }
+}
+}  // namespace
 
-  std::size_t operator()(const render::Vertex& vertex) const noexcept {
-    std::size_t seed = 0;
-    hash_combine(seed, vertex.position);
-    hash_combine(seed, vertex.normal);
-    hash_combine(seed, vertex.uv);
-    return seed;
+bool MeshLoader::Load(const std::string& path,
+                      std::vector<uint32_t>& indices,
+                      std::vector<Vertex>& vertices,
+                      std::vector<SubMesh>& sub_meshes) const {
+  std::cout << "Loading mesh from file: " << path << '\n';
+  const std::string glb_extension = ".glb";
+  if (path.size() >= glb_extension.size() &&
+      path.compare(path.size() - glb_extension.size(), glb_extension.size(),
+                   glb_extension) == 0) {
+    return LoadGlb(path, indices, vertices, sub_meshes);
+  }
+  if (import_budget_ > 0) {
+    return LoadStreamed(path, indices, vertices, sub_meshes);
   }
-};
 
-template <>
-struct hash<Index> {
-  typedef Index argument_type;
-  typedef std::size_t result_type;
+  auto start = std::chrono::steady_clock::now();
+  tinyobj::attrib_t attributes;
+  std::vector<tinyobj::index_t> tinyobj_indices;
+  std::vector<ObjGroup> groups;
+  std::string error;
+  if (!ParseObj(path, attributes, tinyobj_indices, groups, error)) {
+    std::cerr << "Failed to load " << path << ": " << error << '\n';
+    return false;
+  }
+  std::cout << "\tparsed in "
+            << std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms\n";
+  ConsolidateIndices(attributes, tinyobj_indices, groups, indices, vertices,
+                     sub_meshes);
+  return true;
+}
 
-  std::size_t operator()(const Index& index) const noexcept {
-    std::size_t seed = 0;
-    hash_combine(seed, index.position);
-    hash_combine(seed, index.normal);
-    hash_combine(seed, index.uv);
-    return seed;
+bool MeshLoader::LoadGlb(const std::string& path,
+                         std::vector<uint32_t>& indices,
+                         std::vector<Vertex>& vertices,
+                         std::vector<SubMesh>& sub_meshes) const {
+  auto start = std::chrono::steady_clock::now();
+  MappedFile file;
+  GlbMesh mesh;
+  std::string error;
+  if (!file.Open(path)) {
+    std::cerr << "Failed to open " << path << '\n';
+    return false;
+  }
+  if (!ParseGlb(Span<const uint8_t>(file.GetData(), file.GetSize()), mesh,
+                error)) {
+    std::cerr << "Failed to load " << path << ": " << error << '\n';
+    return false;
+  }
+  // Levels of detail and meshlets index the whole mesh.
+  vertices.assign(mesh.vertices.begin(), mesh.vertices.end());
+  indices.assign(mesh.indices.begin(), mesh.indices.end());
+  sub_meshes = std::move(mesh.sub_meshes);
+  for (SubMesh& sub_mesh : sub_meshes) {
+    for (uint32_t i = 0; i < sub_mesh.index_count; ++i) {
+      indices[sub_mesh.first_index + i] +=
+          static_cast<uint32_t>(sub_mesh.vertex_offset);
+    }
+    sub_mesh.vertex_offset = 0;
   }
-};
-}  // namespace std
 
-namespace render {
+  // debug traces
+  std::cout << "\tparsed in "
+            << std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms\n";
+  std::cout << "\tvertices: " << vertices.size() << '\n';
+  std::cout << "\tindices: " << indices.size() << '\n';
+  return true;
+}
 
-void MeshLoader::Load(const std::string& path,
-                      std::vector<uint32_t>& indices,
-                      std::vector<Vertex>& vertices) const {
-  std::cout << "Loading mesh from file: " << path << '\n';
+bool MeshLoader::LoadStreamed(const std::string& path,
+                              std::vector<uint32_t>& indices,
+                              std::vector<Vertex>& vertices,
+                              std::vector<SubMesh>& sub_meshes) const {
+  const size_t kMinWindowSize = 1 << 20;
 
-  tinyobj::attrib_t attributes;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
+  auto start = std::chrono::steady_clock::now();
+  ObjStreamParser parser;
   std::string error;
+  if (!parser.Open(path, std::max(kMinWindowSize, import_budget_ / 4),
+                   error)) {
+    std::cerr << "Failed to load " << path << ": " << error << '\n';
+    return false;
+  }
+  const tinyobj::attrib_t& attributes = parser.GetAttributes();
+  indices.clear();
+  indices.reserve(parser.GetFaceCount() * 3);
+  vertices.clear();
+  vertices.reserve(parser.GetFaceCount() * 3 / 4);
+  sub_meshes.clear();
+
+  // Groups are closed by the statements as in ParseObj, except that they
+  // may span windows, and so does the welder of the open one.
+  SubMesh sub_mesh{0, 0, 0, kNoMaterial};
+  std::string material;
+  VertexWelder welder(0);
+  uint32_t vertex_base = 0;
+  auto close_group = [&](size_t index_offset) {
+    sub_mesh.index_count =
+        static_cast<uint32_t>(index_offset - sub_mesh.first_index);
+    if (sub_mesh.index_count > 0) {
+      sub_mesh.material_id = material.empty()
+                                 ? kNoMaterial
+                                 : std::hash<std::string>{}(material);
+      sub_meshes.push_back(sub_mesh);
+      welder = VertexWelder(0);
+      vertex_base = static_cast<uint32_t>(vertices.size());
+    }
+    sub_mesh.first_index = static_cast<uint32_t>(index_offset);
+  };
+  std::vector<tinyobj::index_t> window_indices;
+  std::vector<ObjGroupStatement> statements;
+  while (!parser.IsDone()) {
+    if (!parser.ParseWindow(window_indices, statements, error)) {
+      std::cerr << "Failed to load " << path << ": " << error << '\n';
+      return false;
+    }
+    const size_t window_offset = indices.size();
+    indices.resize(window_offset + window_indices.size());
+    size_t welded = 0;
+    auto weld = [&](size_t end) {
+      WeldCorners(attributes, window_indices.data() + welded, end - welded,
+                  vertex_base, welder, indices.data() + window_offset + welded,
+                  vertices);
+      welded = end;
+    };
+    for (const ObjGroupStatement& statement : statements) {
+      weld(statement.index_offset);
+      close_group(window_offset + statement.index_offset);
+      if (statement.is_material) {
+        material = statement.material;
+      }
+    }
+    weld(window_indices.size());
+  }
+  close_group(indices.size());
+
+  // debug traces
+  std::cout << "\tparsed and welded in "
+            << std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms, " << parser.GetWindowCount() << " windows\n";
+  std::cout << "\tpeak memory: " << (get_peak_memory_usage() >> 20)
+            << " MiB, budget " << (import_budget_ >> 20) << " MiB\n";
+
+  FinishVertices(indices, vertices);
+  return true;
+}
 
-  tinyobj::LoadObj(&attributes, &shapes, &materials, &error, path.c_str(),
-                   nullptr, true);
-  // TODO: implement support for sub-meshes.
-  ConsolidateIndices(attributes, shapes[0].mesh.indices, indices, vertices);
+bool MeshLoader::LoadAndProcess(const std::string& path,
+                                bool optimize,
+                                std::vector<uint32_t>& indices,
+                                std::vector<Vertex>& vertices,
+                                std::vector<SubMesh>& sub_meshes,
+                                std::vector<MeshLod>& lods,
+                                std::vector<Meshlet>& meshlets) const {
+  if (!Load(path, indices, vertices, sub_meshes)) {
+    return false;
+  }
+  GenerateLods(indices, vertices, sub_meshes, lods);
+  if (optimize) {
+    Optimize(indices, vertices, sub_meshes, lods);
+  }
+  BuildMeshlets(indices, vertices, lods, meshlets);
+  return true;
 }
 
 void MeshLoader::ConsolidateIndices(
     const tinyobj::attrib_t& attributes,
     const std::vector<tinyobj::index_t>& tinyobj_indices,
+    const std::vector<ObjGroup>& groups,
     std::vector<uint32_t>& indices,
-    std::vector<Vertex>& vertices) const {
-  // 1. expand vertices
-  std::unordered_map<Vertex, uint32_t> vertex_map;
-  std::vector<Vertex> expanded_vertices;
-  expanded_vertices.reserve(tinyobj_indices.size());
-  indices.reserve(tinyobj_indices.size());
-  for (const tinyobj::index_t& index : tinyobj_indices) {
-    size_t vertex_index = static_cast<size_t>(index.vertex_index) * 3;
-    size_t normal_index = static_cast<size_t>(index.normal_index) * 3;
-    size_t texcoord_index = static_cast<size_t>(index.texcoord_index) * 2;
-    Vertex vertex = Vertex{glm::vec3{attributes.vertices[vertex_index + 0],
-                                     attributes.vertices[vertex_index + 1],
-                                     attributes.vertices[vertex_index + 2]},
-                           glm::vec3{attributes.normals[normal_index + 0],
-                                     attributes.normals[normal_index + 1],
-                                     attributes.normals[normal_index + 2]},
-                           glm::vec3{1.0f, 1.0f, 1.0f},
-                           glm::vec2{attributes.texcoords[texcoord_index + 0],
-                                     attributes.texcoords[texcoord_index + 1]},
-                           glm::vec3(0.0f),
-                           glm::vec3(0.0f)};
-    expanded_vertices.push_back(vertex);
-
-    uint32_t index;
-    if (vertex_map.find(vertex) == vertex_map.cend()) {
-      index = static_cast<uint32_t>(vertex_map.size());
-      vertex_map[vertex] = index;
-    } else {
-      index = vertex_map[vertex];
-    }
-    indices.push_back(index);
+    std::vector<Vertex>& vertices,
+    std::vector<SubMesh>& sub_meshes) const {
+  auto start = std::chrono::steady_clock::now();
+  indices.resize(tinyobj_indices.size());
+  // Exporters rarely share fewer than a handful of corners per vertex.
+  vertices.reserve(tinyobj_indices.size() / 4);
+  sub_meshes.clear();
+
+  // Each group is welded on its own, so that sub-meshes never share
+  // vertices.
+  for (const ObjGroup& group : groups) {
+    ResourceId material_id =
+        group.material.empty() ? kNoMaterial
+                               : std::hash<std::string>{}(group.material);
+    sub_meshes.push_back(SubMesh{static_cast<uint32_t>(group.index_offset),
+                                 static_cast<uint32_t>(group.index_count), 0,
+                                 material_id});
+    VertexWelder welder(group.index_count / 4);
+    WeldCorners(attributes, &tinyobj_indices[group.index_offset],
+                group.index_count, static_cast<uint32_t>(vertices.size()),
+                welder, &indices[group.index_offset], vertices);
   }
 
-  // 2. calculate tangent and bitangent
-  ComputeVectors(expanded_vertices);
+  // debug traces
+  std::cout << "\twelded in "
+            << std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms\n";
 
-  // 3. write deduplicated vertices in same order than they appear in index
-  // buffer
-  vertices.reserve(vertex_map.size());
-  vertex_map.clear();
-  for (const auto& vertex : expanded_vertices) {
-    if (vertex_map.find(vertex) == vertex_map.cend()) {
-      vertices.push_back(vertex);
-      vertex_map[vertex] = 0;
-    }
+  FinishVertices(indices, vertices);
+}
+
+void MeshLoader::FinishVertices(const std::vector<uint32_t>& indices,
+                                std::vector<Vertex>& vertices) const {
+  auto start = std::chrono::steady_clock::now();
+  GenerateTangents(indices, vertices);
+  // OBJ puts v = 0 at the bottom of the image while textures are uploaded
+  // top row first, so v is flipped here rather than the pixels. Tangents
+  // were computed with the original v and keep their handedness.
+  for (auto& vertex : vertices) {
+    vertex.uv.y = 1.0f - vertex.uv.y;
   }
 
   // debug traces
+  std::cout << "\ttangents generated in "
+            << std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms\n";
   std::cout << "\tvertices: " << vertices.size() << '\n';
   std::cout << "\tindices: " << indices.size() << '\n';
 }
 
-glm::vec3 MeshLoader::ComputeTangent(const glm::vec3& dp1,
-                                     const glm::vec3& dp2,
-                                     const glm::vec2& duv1,
-                                     const glm::vec2& duv2,
-                                     float kf) const {
-  glm::vec3 tangent;
-  tangent.x = kf * (duv2.y * dp1.x - duv1.y * dp2.x);
-  tangent.y = kf * (duv2.y * dp1.y - duv1.y * dp2.y);
-  tangent.z = kf * (duv2.y * dp1.z - duv1.y * dp2.z);
-  return glm::normalize(tangent);
+void MeshLoader::GenerateLods(std::vector<uint32_t>& indices,
+                              Span<const Vertex> vertices,
+                              const std::vector<SubMesh>& sub_meshes,
+                              std::vector<MeshLod>& lods) const {
+  const size_t kMaxLodCount = 6;
+  const size_t kMinIndexCount = 3 * 64;
+
+  auto start = std::chrono::steady_clock::now();
+  // Sub-meshes have vertices of their own, which tells their triangles apart
+  // once simplified. Where they meet, positions have several vertices and
+  // are locked like any seam, so that no cracks open between them.
+  const size_t sub_mesh_count = sub_meshes.size();
+  std::vector<uint32_t> vertex_sub_meshes(vertices.size(), 0);
+  std::vector<uint32_t> lod_indices;
+  lods.clear();
+  for (uint32_t i = 0; i < sub_mesh_count; ++i) {
+    const SubMesh& sub_mesh = sub_meshes[i];
+    auto sub_mesh_begin = indices.begin() + sub_mesh.first_index;
+    lods.push_back(
+        MeshLod{sub_mesh.first_index, sub_mesh.index_count, 0.0f, 0, 0});
+    lod_indices.insert(lod_indices.end(), sub_mesh_begin,
+                       sub_mesh_begin + sub_mesh.index_count);
+    for (auto it = sub_mesh_begin; it != sub_mesh_begin + sub_mesh.index_count;
+         ++it) {
+      vertex_sub_meshes[*it] = i;
+    }
+  }
+
+  std::vector<size_t> sub_mesh_offsets(sub_mesh_count + 1);
+  float level_error = 0.0f;
+  std::vector<size_t> level_triangle_counts(1, lod_indices.size() / 3);
+  while (level_triangle_counts.size() < kMaxLodCount &&
+         lod_indices.size() >= kMinIndexCount) {
+    float error;
+    std::vector<uint32_t> simplified = SimplifyMesh(
+        vertices, lod_indices, lod_indices.size() / 6 * 3, FLT_MAX, error);
+    // Levels saving less than a quarter of the triangles aren't worth it,
+    // which happens once mostly seams and borders are left.
+    if (simplified.size() > lod_indices.size() / 4 * 3) {
+      break;
+    }
+    // Each level is simplified from the previous one, so errors add up.
+    level_error += error;
+
+    // Sub-meshes follow each other within the level, in the same order,
+    // which a counting sort of the triangles gives.
+    std::fill(sub_mesh_offsets.begin(), sub_mesh_offsets.end(), 0);
+    for (size_t i = 0; i < simplified.size(); i += 3) {
+      sub_mesh_offsets[vertex_sub_meshes[simplified[i]] + 1] += 3;
+    }
+    const size_t level_offset = indices.size();
+    sub_mesh_offsets[0] = level_offset;
+    for (size_t i = 0; i < sub_mesh_count; ++i) {
+      size_t index_count = sub_mesh_offsets[i + 1];
+      sub_mesh_offsets[i + 1] += sub_mesh_offsets[i];
+      lods.push_back(MeshLod{static_cast<uint32_t>(sub_mesh_offsets[i]),
+                             static_cast<uint32_t>(index_count), level_error,
+                             0, 0});
+    }
+    indices.resize(level_offset + simplified.size());
+    for (size_t i = 0; i < simplified.size(); i += 3) {
+      size_t& offset = sub_mesh_offsets[vertex_sub_meshes[simplified[i]]];
+      std::copy(&simplified[i], &simplified[i] + 3, &indices[offset]);
+      offset += 3;
+    }
+    lod_indices.assign(indices.begin() + level_offset, indices.end());
+    level_triangle_counts.push_back(lod_indices.size() / 3);
+  }
+
+  // debug traces
+  std::cout << "\tLODs generated in "
+            << std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms\n";
+  for (size_t i = 0; i < level_triangle_counts.size(); ++i) {
+    std::cout << "\t\tLOD " << i << ": " << level_triangle_counts[i]
+              << " triangles, error " << lods[i * sub_mesh_count].error
+              << '\n';
+  }
 }
 
-glm::vec3 MeshLoader::ComputeBitangent(const glm::vec3& dp1,
-                                       const glm::vec3& dp2,
-                                       const glm::vec2& duv1,
-                                       const glm::vec2& duv2,
-                                       float kf) const {
-  glm::vec3 bitangent;
-  bitangent.x = kf * (-duv2.y * dp1.x + duv1.y * dp2.x);
-  bitangent.y = kf * (-duv2.y * dp1.y + duv1.y * dp2.y);
-  bitangent.z = kf * (-duv2.y * dp1.z + duv1.y * dp2.z);
-  return glm::normalize(bitangent);
+void MeshLoader::Optimize(std::vector<uint32_t>& indices,
+                          std::vector<Vertex>& vertices,
+                          const std::vector<SubMesh>& sub_meshes,
+                          const std::vector<MeshLod>& lods) const {
+  // Sander et al. suggest cutting clusters down to 5% more cache misses.
+  const float kOverdrawThreshold = 1.05f;
+
+  // The full detail level comes first.
+  size_t full_index_count = 0;
+  for (const SubMesh& sub_mesh : sub_meshes) {
+    full_index_count += sub_mesh.index_count;
+  }
+  Span<const uint32_t> full_lod(indices.data(), full_index_count);
+  MeshStats before = AnalyzeMesh(vertices, full_lod);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint32_t> lod_indices;
+  std::vector<size_t> clusters;
+  for (const MeshLod& lod : lods) {
+    auto lod_begin = indices.begin() + lod.index_offset;
+    lod_indices.assign(lod_begin, lod_begin + lod.index_count);
+    OptimizeVertexCache(lod_indices, vertices.size(), clusters);
+    OptimizeOverdraw(lod_indices, vertices, clusters, kOverdrawThreshold);
+    std::copy(lod_indices.begin(), lod_indices.end(), lod_begin);
+  }
+  // Coarser levels use a subset of the full mesh's vertices, which come
+  // first.
+  OptimizeVertexFetch(indices, vertices);
+  float optimize_time_ms = std::chrono::duration<float, std::milli>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+  MeshStats after = AnalyzeMesh(vertices, full_lod);
+
+  // debug traces
+  std::cout << "\toptimized in " << optimize_time_ms << " ms\n";
+  std::cout << "\tACMR: " << before.acmr << " -> " << after.acmr << '\n';
+  std::cout << "\tATVR: " << before.atvr << " -> " << after.atvr << '\n';
+  std::cout << "\toverdraw: " << before.overdraw << " -> " << after.overdraw
+            << '\n';
+}
+
+void MeshLoader::BuildMeshlets(std::vector<uint32_t>& indices,
+                               Span<const Vertex> vertices,
+                               std::vector<MeshLod>& lods,
+                               std::vector<Meshlet>& meshlets) const {
+  auto start = std::chrono::steady_clock::now();
+  meshlets.clear();
+  std::vector<uint32_t> lod_indices;
+  for (MeshLod& lod : lods) {
+    auto lod_begin = indices.begin() + lod.index_offset;
+    lod_indices.assign(lod_begin, lod_begin + lod.index_count);
+    lod.meshlet_offset = static_cast<uint32_t>(meshlets.size());
+    render::BuildMeshlets(lod_indices, vertices, meshlets);
+    lod.meshlet_count =
+        static_cast<uint32_t>(meshlets.size()) - lod.meshlet_offset;
+    for (uint32_t i = lod.meshlet_offset; i < meshlets.size(); ++i) {
+      meshlets[i].index_offset += lod.index_offset;
+    }
+    std::copy(lod_indices.begin(), lod_indices.end(), lod_begin);
+  }
+
+  // debug traces
+  std::cout << "\tmeshlets built in "
+            << std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms\n";
+  std::cout << "\t\t" << meshlets.size() << " meshlets, "
+            << static_cast<float>(indices.size()) / 3 /
+                   static_cast<float>(std::max<size_t>(meshlets.size(), 1))
+            << " triangles each\n";
+}
+
+glm::vec4 MeshLoader::ComputeBoundingSphere(
+    Span<const Vertex> vertices) const {
+  if (vertices.empty()) {
+    return glm::vec4(0.0f);
+  }
+  // Centered on the bounding box, which is never far from the optimal
+  // sphere for the compact shapes LODs matter for.
+  glm::vec3 min = vertices[0].position;
+  glm::vec3 max = min;
+  for (const Vertex& vertex : vertices) {
+    min = glm::min(min, vertex.position);
+    max = glm::max(max, vertex.position);
+  }
+  glm::vec3 center = (min + max) * 0.5f;
+  float radius = 0.0f;
+  for (const Vertex& vertex : vertices) {
+    radius = std::max(radius, glm::distance(center, vertex.position));
+  }
+  return glm::vec4(center, radius);
 }
 
-void MeshLoader::ComputeVectors(std::vector<Vertex>& vertices) const {
-  size_t triangle_count = vertices.size() / 3;
-  for (size_t i = 0; i < triangle_count; i++) {
-    size_t offset = i * 3;
-    glm::vec3 p1 = vertices[offset + 0].position;
-    glm::vec3 p2 = vertices[offset + 1].position;
-    glm::vec3 p3 = vertices[offset + 2].position;
-    glm::vec2 uv1 = vertices[offset + 0].uv;
-    glm::vec2 uv2 = vertices[offset + 1].uv;
-    glm::vec2 uv3 = vertices[offset + 2].uv;
-    glm::vec3 dp1 = p2 - p1;
-    glm::vec3 dp2 = p3 - p1;
-    glm::vec2 duv1 = uv2 - uv1;
-    glm::vec2 duv2 = uv3 - uv1;
-    float f = 1.0f / (duv1.x * duv2.y - duv2.x * duv1.y);
-    glm::vec3 tangent = ComputeTangent(dp1, dp2, duv1, duv2, f);
-    glm::vec3 bitangent = ComputeBitangent(dp1, dp2, duv1, duv2, f);
-    vertices[offset + 0].tangent = tangent;
-    vertices[offset + 1].tangent = tangent;
-    vertices[offset + 2].tangent = tangent;
-    vertices[offset + 0].bitangent = bitangent;
-    vertices[offset + 1].bitangent = bitangent;
-    vertices[offset + 2].bitangent = bitangent;
+MeshBounds MeshLoader::Pack(Span<const Vertex> vertices,
+                            std::vector<PackedVertex>& packed) const {
+  glm::vec3 min(0.0f);
+  glm::vec3 max(0.0f);
+  if (!vertices.empty()) {
+    min = max = vertices[0].position;
+  }
+  for (const Vertex& vertex : vertices) {
+    min = glm::min(min, vertex.position);
+    max = glm::max(max, vertex.position);
+  }
+  glm::vec3 extent = max - min;
+  // Flat axes quantize to 0, whatever the scale.
+  glm::vec3 scale{extent.x > 0.0f ? 65535.0f / extent.x : 0.0f,
+                  extent.y > 0.0f ? 65535.0f / extent.y : 0.0f,
+                  extent.z > 0.0f ? 65535.0f / extent.z : 0.0f};
+
+  packed.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    const Vertex& vertex = vertices[i];
+    PackedVertex& packed_vertex = packed[i];
+    glm::vec3 position = (vertex.position - min) * scale;
+    for (int axis = 0; axis < 3; ++axis) {
+      packed_vertex.position[axis] = static_cast<uint16_t>(
+          std::lround(glm::clamp(position[axis], 0.0f, 65535.0f)));
+    }
+    packed_vertex.position[3] = vertex.tangent.w >= 0.0f ? 65535 : 0;
+    packed_vertex.normal = EncodeOctahedral(vertex.normal);
+    packed_vertex.tangent = EncodeOctahedral(glm::vec3(vertex.tangent));
+    packed_vertex.uv = glm::packHalf2x16(vertex.uv);
   }
+  return MeshBounds{glm::vec4(min, 0.0f), glm::vec4(extent, 0.0f)};
 }
 
 }  // namespace render
\ No newline at end of file
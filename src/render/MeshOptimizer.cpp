@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "render/MeshOptimizer.hpp"
+
+namespace render {
+namespace {
+const uint32_t kNoVertex = UINT32_MAX;
+
+// Triangles using each vertex, in compressed sparse row form. Triangles are
+// listed once per corner, so degenerate ones may show up twice.
+struct Adjacency {
+  std::vector<uint32_t> offsets;  ///< vertex_count + 1 entries
+  std::vector<uint32_t> triangles;
+
+  Adjacency(Span<const uint32_t> indices, size_t vertex_count)
+      : offsets(vertex_count + 1, 0), triangles(indices.size()) {
+    for (uint32_t index : indices) {
+      ++offsets[index + 1];
+    }
+    for (size_t i = 0; i < vertex_count; ++i) {
+      offsets[i + 1] += offsets[i];
+    }
+    std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+      triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+};
+
+// FIFO post-transform cache, tracking when each vertex last entered it.
+class VertexCache {
+ public:
+  explicit VertexCache(size_t vertex_count) : timestamps_(vertex_count, 0) {}
+
+  // Returns true on a miss.
+  bool Access(uint32_t vertex) {
+    if (time_ - timestamps_[vertex] <= kVertexCacheSize) {
+      return false;
+    }
+    timestamps_[vertex] = time_++;
+    return true;
+  }
+
+  void Flush() { time_ += kVertexCacheSize + 1; }
+
+ private:
+  std::vector<uint64_t> timestamps_;
+  uint64_t time_ = kVertexCacheSize + 1;
+};
+
+// Counts fragments of a triangle soup passing a less-than depth test on a
+// square grid, without face culling like the demo's pipeline.
+class OverdrawRasterizer {
+ public:
+  static constexpr int kSize = 256;
+
+  OverdrawRasterizer()
+      : depths_(kSize * kSize, std::numeric_limits<float>::infinity()) {}
+
+  // Vertices are in pixels, z being the depth.
+  void Draw(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    float area = Edge(a, b, c);
+    if (area == 0.0f) {
+      return;
+    }
+    float left = std::min(a.x, std::min(b.x, c.x));
+    float right = std::max(a.x, std::max(b.x, c.x));
+    float top = std::min(a.y, std::min(b.y, c.y));
+    float bottom = std::max(a.y, std::max(b.y, c.y));
+    int min_x = std::max(0, static_cast<int>(std::floor(left)));
+    int max_x = std::min(kSize - 1, static_cast<int>(std::ceil(right)));
+    int min_y = std::max(0, static_cast<int>(std::floor(top)));
+    int max_y = std::min(kSize - 1, static_cast<int>(std::ceil(bottom)));
+    for (int y = min_y; y <= max_y; ++y) {
+      for (int x = min_x; x <= max_x; ++x) {
+        glm::vec3 p{static_cast<float>(x) + 0.5f,
+                    static_cast<float>(y) + 0.5f, 0.0f};
+        // Barycentric weights scaled by the signed area, so that they share
+        // its sign inside the triangle whatever its winding.
+        float wa = Edge(b, c, p) / area;
+        float wb = Edge(c, a, p) / area;
+        float wc = Edge(a, b, p) / area;
+        if (wa < 0.0f || wb < 0.0f || wc < 0.0f) {
+          continue;
+        }
+        float depth = wa * a.z + wb * b.z + wc * c.z;
+        float& stored_depth = depths_[y * kSize + x];
+        if (depth < stored_depth) {
+          covered_ += std::isinf(stored_depth) ? 1 : 0;
+          ++shaded_;
+          stored_depth = depth;
+        }
+      }
+    }
+  }
+
+  size_t GetCovered() const { return covered_; }
+  size_t GetShaded() const { return shaded_; }
+
+ private:
+  static float Edge(const glm::vec3& a,
+                    const glm::vec3& b,
+                    const glm::vec3& p) {
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+  }
+
+  std::vector<float> depths_;
+  size_t covered_ = 0;
+  size_t shaded_ = 0;
+};
+}  // namespace
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices,
+                         size_t vertex_count,
+                         std::vector<size_t>& clusters) {
+  clusters.clear();
+  Adjacency adjacency(indices, vertex_count);
+  // Triangles left to emit around each vertex.
+  std::vector<uint32_t> live(vertex_count);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    live[i] = adjacency.offsets[i + 1] - adjacency.offsets[i];
+  }
+  std::vector<uint32_t> cache_times(vertex_count, 0);
+  std::vector<bool> emitted(indices.size() / 3, false);
+  std::vector<uint32_t> dead_ends;
+  dead_ends.reserve(indices.size());
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  uint32_t time = kVertexCacheSize + 1;
+  size_t cursor = 0;
+
+  // Once fanning gets stuck, restarts from the most recently used vertex
+  // with triangles left, then from the next one in index order.
+  auto skip_dead_end = [&]() {
+    while (!dead_ends.empty()) {
+      uint32_t vertex = dead_ends.back();
+      dead_ends.pop_back();
+      if (live[vertex] > 0) {
+        return vertex;
+      }
+    }
+    for (; cursor < vertex_count; ++cursor) {
+      if (live[cursor] > 0) {
+        return static_cast<uint32_t>(cursor);
+      }
+    }
+    return kNoVertex;
+  };
+
+  for (uint32_t fanning = skip_dead_end(); fanning != kNoVertex;
+       fanning = skip_dead_end()) {
+    clusters.push_back(output.size());
+    while (fanning != kNoVertex) {
+      candidates.clear();
+      for (uint32_t i = adjacency.offsets[fanning];
+           i < adjacency.offsets[fanning + 1]; ++i) {
+        uint32_t triangle = adjacency.triangles[i];
+        if (emitted[triangle]) {
+          continue;
+        }
+        emitted[triangle] = true;
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+          uint32_t vertex = indices[triangle * 3 + corner];
+          output.push_back(vertex);
+          dead_ends.push_back(vertex);
+          candidates.push_back(vertex);
+          --live[vertex];
+          if (time - cache_times[vertex] > kVertexCacheSize) {
+            cache_times[vertex] = time++;
+          }
+        }
+      }
+
+      // Fans next around the oldest candidate that stays in the cache while
+      // its remaining triangles are emitted, or any candidate with triangles
+      // left when none does.
+      fanning = kNoVertex;
+      int64_t best_priority = -1;
+      for (uint32_t vertex : candidates) {
+        if (live[vertex] == 0) {
+          continue;
+        }
+        int64_t priority = 0;
+        if (time - cache_times[vertex] + 2 * live[vertex] <=
+            kVertexCacheSize) {
+          priority = time - cache_times[vertex];
+        }
+        if (priority > best_priority) {
+          best_priority = priority;
+          fanning = vertex;
+        }
+      }
+    }
+  }
+  indices.swap(output);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices,
+                      Span<const Vertex> vertices,
+                      const std::vector<size_t>& clusters,
+                      float threshold) {
+  size_t triangle_count = indices.size() / 3;
+  if (triangle_count == 0) {
+    return;
+  }
+
+  VertexCache cache(vertices.size());
+  size_t mesh_misses = 0;
+  for (uint32_t index : indices) {
+    mesh_misses += cache.Access(index) ? 1 : 0;
+  }
+  float max_cluster_acmr = threshold * static_cast<float>(mesh_misses) /
+                           static_cast<float>(triangle_count);
+
+  // Cuts inside each cluster wherever the triangles since the last cut make
+  // a good enough use of the cache on their own.
+  std::vector<size_t> cuts;
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    size_t end = c + 1 < clusters.size() ? clusters[c + 1] : indices.size();
+    size_t begin = clusters[c];
+    size_t misses = 0;
+    cuts.push_back(begin);
+    cache.Flush();
+    for (size_t i = begin; i < end; i += 3) {
+      for (size_t corner = 0; corner < 3; ++corner) {
+        misses += cache.Access(indices[i + corner]) ? 1 : 0;
+      }
+      size_t triangles = (i + 3 - begin) / 3;
+      if (i + 3 < end && static_cast<float>(misses) <=
+                             max_cluster_acmr * static_cast<float>(triangles)) {
+        begin = i + 3;
+        misses = 0;
+        cuts.push_back(begin);
+        cache.Flush();
+      }
+    }
+  }
+
+  glm::vec3 mesh_center(0.0f);
+  for (uint32_t index : indices) {
+    mesh_center += vertices[index].position;
+  }
+  mesh_center /= static_cast<float>(indices.size());
+
+  struct Cluster {
+    size_t begin;
+    size_t end;
+    float sort_key;
+  };
+  std::vector<Cluster> sorted_clusters(cuts.size());
+  for (size_t c = 0; c < cuts.size(); ++c) {
+    Cluster& cluster = sorted_clusters[c];
+    cluster.begin = cuts[c];
+    cluster.end = c + 1 < cuts.size() ? cuts[c + 1] : indices.size();
+    // Area weighted center and normal of the cluster's triangles.
+    glm::vec3 center(0.0f);
+    glm::vec3 normal(0.0f);
+    float area = 0.0f;
+    for (size_t i = cluster.begin; i < cluster.end; i += 3) {
+      const glm::vec3& a = vertices[indices[i + 0]].position;
+      const glm::vec3& b = vertices[indices[i + 1]].position;
+      const glm::vec3& c = vertices[indices[i + 2]].position;
+      glm::vec3 triangle_normal = glm::cross(b - a, c - a);
+      float triangle_area = glm::length(triangle_normal);
+      center += (a + b + c) * (triangle_area / 3.0f);
+      normal += triangle_normal;
+      area += triangle_area;
+    }
+    float normal_length = glm::length(normal);
+    cluster.sort_key =
+        area > 0.0f && normal_length > 0.0f
+            ? glm::dot(center / area - mesh_center, normal / normal_length)
+            : 0.0f;
+  }
+  std::stable_sort(sorted_clusters.begin(), sorted_clusters.end(),
+                   [](const Cluster& lhs, const Cluster& rhs) {
+                     return lhs.sort_key > rhs.sort_key;
+                   });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (const Cluster& cluster : sorted_clusters) {
+    output.insert(output.end(), indices.begin() + cluster.begin,
+                  indices.begin() + cluster.end);
+  }
+  indices.swap(output);
+}
+
+void OptimizeVertexFetch(std::vector<uint32_t>& indices,
+                         std::vector<Vertex>& vertices) {
+  std::vector<uint32_t> remap(vertices.size(), kNoVertex);
+  std::vector<Vertex> fetched;
+  fetched.reserve(vertices.size());
+  for (uint32_t& index : indices) {
+    if (remap[index] == kNoVertex) {
+      remap[index] = static_cast<uint32_t>(fetched.size());
+      fetched.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices.swap(fetched);
+}
+
+MeshStats AnalyzeMesh(Span<const Vertex> vertices,
+                      Span<const uint32_t> indices) {
+  MeshStats stats{0.0f, 0.0f, 0.0f};
+  size_t triangle_count = indices.size() / 3;
+  if (triangle_count == 0) {
+    return stats;
+  }
+
+  VertexCache cache(vertices.size());
+  std::vector<bool> referenced(vertices.size(), false);
+  size_t misses = 0;
+  size_t referenced_count = 0;
+  glm::vec3 min = vertices[indices[0]].position;
+  glm::vec3 max = min;
+  for (uint32_t index : indices) {
+    misses += cache.Access(index) ? 1 : 0;
+    if (!referenced[index]) {
+      referenced[index] = true;
+      ++referenced_count;
+      min = glm::min(min, vertices[index].position);
+      max = glm::max(max, vertices[index].position);
+    }
+  }
+  stats.acmr =
+      static_cast<float>(misses) / static_cast<float>(triangle_count);
+  stats.atvr =
+      static_cast<float>(misses) / static_cast<float>(referenced_count);
+
+  // Orthographic views down each axis, from both sides.
+  glm::vec3 extent = max - min;
+  size_t covered = 0;
+  size_t shaded = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    float largest_extent = std::max(extent[u], extent[v]);
+    if (largest_extent <= 0.0f) {
+      continue;
+    }
+    float scale =
+        static_cast<float>(OverdrawRasterizer::kSize - 1) / largest_extent;
+    for (float direction : {1.0f, -1.0f}) {
+      OverdrawRasterizer rasterizer;
+      auto project = [&](uint32_t index) {
+        const glm::vec3& position = vertices[index].position;
+        return glm::vec3{(position[u] - min[u]) * scale,
+                         (position[v] - min[v]) * scale,
+                         (position[axis] - min[axis]) * direction};
+      };
+      for (size_t i = 0; i + 3 <= indices.size(); i += 3) {
+        rasterizer.Draw(project(indices[i + 0]), project(indices[i + 1]),
+                        project(indices[i + 2]));
+      }
+      covered += rasterizer.GetCovered();
+      shaded += rasterizer.GetShaded();
+    }
+  }
+  stats.overdraw =
+      covered > 0 ? static_cast<float>(shaded) / static_cast<float>(covered)
+                  : 0.0f;
+  return stats;
+}
+}  // namespace render
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_set>
+
+#include "render/MeshSimplifier.hpp"
+
+namespace render {
+namespace {
+const uint32_t kNoVertex = UINT32_MAX;
+// Border planes count this many times more than the faces around them, per
+// unit of area, so that open borders barely move.
+const double kBorderWeight = 10.0;
+
+enum class VertexKind : uint8_t { kManifold, kBorder, kLocked };
+
+// Weighted sum of squared distances to planes, as the symmetric matrix of
+// Garland and Heckbert. Evaluating divides by the total weight, so that the
+// error reads as a mean squared distance.
+struct Quadric {
+  double a00 = 0.0, a11 = 0.0, a22 = 0.0;
+  double a01 = 0.0, a02 = 0.0, a12 = 0.0;
+  double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+  double c = 0.0;
+  double weight = 0.0;
+
+  // The plane is dot(normal, p) + distance = 0, `normal` being unit length.
+  void AddPlane(const glm::vec3& normal, float distance, double plane_weight) {
+    double x = normal.x, y = normal.y, z = normal.z, d = distance;
+    a00 += plane_weight * x * x;
+    a11 += plane_weight * y * y;
+    a22 += plane_weight * z * z;
+    a01 += plane_weight * x * y;
+    a02 += plane_weight * x * z;
+    a12 += plane_weight * y * z;
+    b0 += plane_weight * x * d;
+    b1 += plane_weight * y * d;
+    b2 += plane_weight * z * d;
+    c += plane_weight * d * d;
+    weight += plane_weight;
+  }
+
+  Quadric& operator+=(const Quadric& other) {
+    a00 += other.a00;
+    a11 += other.a11;
+    a22 += other.a22;
+    a01 += other.a01;
+    a02 += other.a02;
+    a12 += other.a12;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    weight += other.weight;
+    return *this;
+  }
+
+  double Evaluate(const glm::vec3& p) const {
+    double x = p.x, y = p.y, z = p.z;
+    double error = a00 * x * x + a11 * y * y + a22 * z * z +
+                   2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                   2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+  }
+};
+
+struct Collapse {
+  uint32_t from;  ///< position id moving away
+  uint32_t to;    ///< position id staying
+  double cost;
+};
+
+// Maps each vertex to the lowest index of the vertices sharing its position.
+std::vector<uint32_t> BuildPositionIds(Span<const Vertex> vertices) {
+  auto less = [&vertices](uint32_t lhs, uint32_t rhs) {
+    const glm::vec3& a = vertices[lhs].position;
+    const glm::vec3& b = vertices[rhs].position;
+    if (a.x != b.x) {
+      return a.x < b.x;
+    }
+    if (a.y != b.y) {
+      return a.y < b.y;
+    }
+    if (a.z != b.z) {
+      return a.z < b.z;
+    }
+    return lhs < rhs;
+  };
+  std::vector<uint32_t> order(vertices.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), less);
+  std::vector<uint32_t> position_ids(vertices.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    bool shared = i > 0 && vertices[order[i]].position ==
+                               vertices[order[i - 1]].position;
+    position_ids[order[i]] = shared ? position_ids[order[i - 1]] : order[i];
+  }
+  return position_ids;
+}
+
+uint64_t GetEdgeKey(uint32_t from, uint32_t to) {
+  return static_cast<uint64_t>(from) << 32 | to;
+}
+}  // namespace
+
+std::vector<uint32_t> SimplifyMesh(Span<const Vertex> vertices,
+                                   Span<const uint32_t> indices,
+                                   size_t target_index_count,
+                                   float max_error,
+                                   float& error) {
+  const size_t vertex_count = vertices.size();
+  std::vector<uint32_t> position_ids = BuildPositionIds(vertices);
+  auto position_of = [&](uint32_t vertex) {
+    return vertices[vertex].position;
+  };
+
+  // Degenerate triangles would only get in the way of the adjacency.
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (size_t i = 0; i + 3 <= indices.size(); i += 3) {
+    uint32_t a = position_ids[indices[i + 0]];
+    uint32_t b = position_ids[indices[i + 1]];
+    uint32_t c = position_ids[indices[i + 2]];
+    if (a != b && b != c && a != c) {
+      result.insert(result.end(), indices.begin() + i, indices.begin() + i + 3);
+    }
+  }
+
+  // Positions with several vertices are seams, which stay locked.
+  std::vector<uint32_t> wedge_counts(vertex_count, 0);
+  std::vector<bool> referenced(vertex_count, false);
+  for (uint32_t index : result) {
+    if (!referenced[index]) {
+      referenced[index] = true;
+      ++wedge_counts[position_ids[index]];
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertex_count);
+  for (size_t i = 0; i < result.size(); i += 3) {
+    glm::vec3 a = position_of(result[i + 0]);
+    glm::vec3 normal = glm::cross(position_of(result[i + 1]) - a,
+                                  position_of(result[i + 2]) - a);
+    float length = glm::length(normal);
+    if (length == 0.0f) {
+      continue;
+    }
+    normal /= length;
+    for (size_t corner = 0; corner < 3; ++corner) {
+      quadrics[position_ids[result[i + corner]]].AddPlane(
+          normal, -glm::dot(normal, a), 0.5 * length);
+    }
+  }
+
+  std::unordered_set<uint64_t> edges;
+  std::vector<VertexKind> kinds(vertex_count);
+  std::vector<uint32_t> adjacency_offsets(vertex_count + 1);
+  std::vector<uint32_t> adjacency;
+  std::vector<Collapse> collapses;
+  std::vector<uint32_t> vertex_remap(vertex_count);
+  std::vector<bool> locked(vertex_count);
+  const double max_cost = static_cast<double>(max_error) * max_error;
+  double worst_cost = 0.0;
+
+  for (bool first_pass = true; result.size() > target_index_count + 2;
+       first_pass = false) {
+    const size_t triangle_count = result.size() / 3;
+    edges.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; ++corner) {
+        edges.insert(GetEdgeKey(position_ids[result[i + corner]],
+                                position_ids[result[i + (corner + 1) % 3]]));
+      }
+    }
+
+    // Edges without a twin lie on an open border. Their plane, orthogonal to
+    // the face, is added to the quadrics once, like the face planes.
+    for (size_t i = 0; i < vertex_count; ++i) {
+      kinds[i] =
+          wedge_counts[i] > 1 ? VertexKind::kLocked : VertexKind::kManifold;
+    }
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; ++corner) {
+        uint32_t from = position_ids[result[i + corner]];
+        uint32_t to = position_ids[result[i + (corner + 1) % 3]];
+        if (edges.count(GetEdgeKey(to, from)) != 0) {
+          continue;
+        }
+        for (uint32_t position : {from, to}) {
+          if (kinds[position] == VertexKind::kManifold) {
+            kinds[position] = VertexKind::kBorder;
+          }
+        }
+        if (first_pass) {
+          glm::vec3 a = position_of(result[i + 0]);
+          glm::vec3 face_normal = glm::cross(position_of(result[i + 1]) - a,
+                                             position_of(result[i + 2]) - a);
+          glm::vec3 edge = vertices[to].position - vertices[from].position;
+          glm::vec3 normal = glm::cross(edge, face_normal);
+          float length = glm::length(normal);
+          if (length > 0.0f) {
+            normal /= length;
+            double weight = kBorderWeight * glm::dot(edge, edge);
+            float distance = -glm::dot(normal, vertices[from].position);
+            quadrics[from].AddPlane(normal, distance, weight);
+            quadrics[to].AddPlane(normal, distance, weight);
+          }
+        }
+      }
+    }
+
+    // Triangles around each position.
+    std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+    for (uint32_t index : result) {
+      ++adjacency_offsets[position_ids[index] + 1];
+    }
+    for (size_t i = 0; i < vertex_count; ++i) {
+      adjacency_offsets[i + 1] += adjacency_offsets[i];
+    }
+    adjacency.resize(result.size());
+    {
+      std::vector<uint32_t> cursors(adjacency_offsets.begin(),
+                                    adjacency_offsets.end() - 1);
+      for (size_t i = 0; i < result.size(); ++i) {
+        adjacency[cursors[position_ids[result[i]]]++] =
+            static_cast<uint32_t>(i / 3);
+      }
+    }
+
+    // Interior edges are seen from both of their triangles, only one of them
+    // queues the edge's collapses.
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; ++corner) {
+        uint32_t a = position_ids[result[i + corner]];
+        uint32_t b = position_ids[result[i + (corner + 1) % 3]];
+        bool on_border = edges.count(GetEdgeKey(b, a)) == 0;
+        if (!on_border && a > b) {
+          continue;
+        }
+        for (auto collapse : {std::make_pair(a, b), std::make_pair(b, a)}) {
+          uint32_t from = collapse.first;
+          uint32_t to = collapse.second;
+          if (kinds[from] == VertexKind::kLocked ||
+              (kinds[from] == VertexKind::kBorder && !on_border)) {
+            continue;
+          }
+          Quadric quadric = quadrics[from];
+          quadric += quadrics[to];
+          collapses.push_back(
+              Collapse{from, to, quadric.Evaluate(vertices[to].position)});
+        }
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& lhs, const Collapse& rhs) {
+                return lhs.cost < rhs.cost;
+              });
+
+    // Collapses touching the triangles of an earlier one wait for the next
+    // pass, their cost being stale.
+    std::iota(vertex_remap.begin(), vertex_remap.end(), 0);
+    std::fill(locked.begin(), locked.end(), false);
+    const size_t target_triangle_count = target_index_count / 3;
+    size_t removed_count = 0;
+    for (const Collapse& collapse : collapses) {
+      if (triangle_count - removed_count <= target_triangle_count ||
+          collapse.cost > max_cost) {
+        break;
+      }
+      if (locked[collapse.from] || locked[collapse.to]) {
+        continue;
+      }
+      const glm::vec3& target = vertices[collapse.to].position;
+      uint32_t from_vertex = kNoVertex;
+      uint32_t to_vertex = kNoVertex;
+      size_t collapsing_count = 0;
+      bool flips = false;
+      for (uint32_t j = adjacency_offsets[collapse.from];
+           j < adjacency_offsets[collapse.from + 1] && !flips; ++j) {
+        const uint32_t* triangle = &result[adjacency[j] * 3];
+        glm::vec3 corners[3];
+        size_t moving_corner = 0;
+        bool collapsing = false;
+        for (size_t corner = 0; corner < 3; ++corner) {
+          uint32_t position = position_ids[triangle[corner]];
+          corners[corner] = position_of(triangle[corner]);
+          if (position == collapse.from) {
+            from_vertex = triangle[corner];
+            moving_corner = corner;
+          } else if (position == collapse.to) {
+            to_vertex = triangle[corner];
+            collapsing = true;
+          }
+        }
+        if (collapsing) {
+          ++collapsing_count;
+          continue;
+        }
+        glm::vec3 before = glm::cross(corners[1] - corners[0],
+                                      corners[2] - corners[0]);
+        corners[moving_corner] = target;
+        glm::vec3 after = glm::cross(corners[1] - corners[0],
+                                     corners[2] - corners[0]);
+        // Turning by more than ~75 degrees counts as a flip too, as it
+        // mostly happens to triangles collapsing into slivers.
+        flips = glm::dot(before, after) <=
+                0.25f * glm::length(before) * glm::length(after);
+      }
+      if (flips || to_vertex == kNoVertex) {
+        continue;
+      }
+
+      // `from` isn't a seam, so all of its triangles use the same vertex.
+      vertex_remap[from_vertex] = to_vertex;
+      quadrics[collapse.to] += quadrics[collapse.from];
+      for (uint32_t j = adjacency_offsets[collapse.from];
+           j < adjacency_offsets[collapse.from + 1]; ++j) {
+        for (size_t corner = 0; corner < 3; ++corner) {
+          locked[position_ids[result[adjacency[j] * 3 + corner]]] = true;
+        }
+      }
+      removed_count += collapsing_count;
+      worst_cost = std::max(worst_cost, collapse.cost);
+    }
+    if (removed_count == 0) {
+      break;
+    }
+
+    size_t write = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      uint32_t a = vertex_remap[result[i + 0]];
+      uint32_t b = vertex_remap[result[i + 1]];
+      uint32_t c = vertex_remap[result[i + 2]];
+      if (position_ids[a] != position_ids[b] &&
+          position_ids[b] != position_ids[c] &&
+          position_ids[a] != position_ids[c]) {
+        result[write++] = a;
+        result[write++] = b;
+        result[write++] = c;
+      }
+    }
+    result.resize(write);
+  }
+
+  error = static_cast<float>(std::sqrt(worst_cost));
+  return result;
+}
+}  // namespace render
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "render/Meshlet.hpp"
+
+namespace render {
+namespace {
+const uint32_t kNone = UINT32_MAX;
+
+glm::vec3 ComputeNormal(Span<const Vertex> vertices, const uint32_t* triangle) {
+  const glm::vec3& a = vertices[triangle[0]].position;
+  return glm::cross(vertices[triangle[1]].position - a,
+                    vertices[triangle[2]].position - a);
+}
+
+void ComputeBounds(Span<const Vertex> vertices,
+                   const uint32_t* indices,
+                   Meshlet& meshlet) {
+  glm::vec3 min(FLT_MAX);
+  glm::vec3 max(-FLT_MAX);
+  for (uint32_t i = 0; i < meshlet.index_count; ++i) {
+    min = glm::min(min, vertices[indices[i]].position);
+    max = glm::max(max, vertices[indices[i]].position);
+  }
+  glm::vec3 center = (min + max) * 0.5f;
+  float radius = 0.0f;
+  for (uint32_t i = 0; i < meshlet.index_count; ++i) {
+    radius =
+        std::max(radius, glm::distance(center, vertices[indices[i]].position));
+  }
+  meshlet.bounding_sphere = glm::vec4(center, radius);
+
+  // The cone around the mean normal containing all the triangle normals.
+  // Triangles count once whatever their area, so that slivers can't be
+  // outvoted.
+  glm::vec3 axis(0.0f);
+  for (uint32_t i = 0; i < meshlet.index_count; i += 3) {
+    glm::vec3 normal = ComputeNormal(vertices, indices + i);
+    float length = glm::length(normal);
+    if (length > 0.0f) {
+      axis += normal / length;
+    }
+  }
+  float axis_length = glm::length(axis);
+  if (axis_length == 0.0f) {
+    meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    return;
+  }
+  axis /= axis_length;
+  float min_dot = 1.0f;
+  for (uint32_t i = 0; i < meshlet.index_count; i += 3) {
+    glm::vec3 normal = ComputeNormal(vertices, indices + i);
+    float length = glm::length(normal);
+    if (length > 0.0f) {
+      min_dot = std::min(min_dot, glm::dot(axis, normal) / length);
+    }
+  }
+  // Cones 90 degrees wide or more always have a triangle facing the camera.
+  float sine = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+  meshlet.cone = glm::vec4(axis, sine);
+}
+}  // namespace
+
+void BuildMeshlets(std::vector<uint32_t>& indices,
+                   Span<const Vertex> vertices,
+                   std::vector<Meshlet>& meshlets) {
+  const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+  const size_t vertex_count = vertices.size();
+
+  // Triangles using each vertex, in compressed sparse row form.
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  for (uint32_t index : indices) {
+    ++offsets[index + 1];
+  }
+  for (size_t i = 0; i < vertex_count; ++i) {
+    offsets[i + 1] += offsets[i];
+  }
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+      adjacency[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  // Marks hold the number of the meshlet a vertex was last added to, or a
+  // triangle last listed as a candidate of.
+  std::vector<uint32_t> vertex_marks(vertex_count, kNone);
+  std::vector<uint32_t> candidate_marks(triangle_count, kNone);
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> triangles;
+  std::vector<uint32_t> meshlet_indices;
+  meshlet_indices.reserve(indices.size());
+  uint32_t next_seed = 0;
+  uint32_t meshlet_number = 0;
+
+  while (true) {
+    // Seed with what the previous meshlet had to leave behind, to stay on
+    // the same surface, and fall back to the index buffer's order.
+    uint32_t seed = kNone;
+    for (uint32_t candidate : candidates) {
+      if (!emitted[candidate]) {
+        seed = candidate;
+        break;
+      }
+    }
+    while (seed == kNone && next_seed < triangle_count) {
+      if (!emitted[next_seed]) {
+        seed = next_seed;
+      }
+      ++next_seed;
+    }
+    if (seed == kNone) {
+      break;
+    }
+
+    candidates.assign(1, seed);
+    candidate_marks[seed] = meshlet_number;
+    triangles.clear();
+    uint32_t meshlet_vertex_count = 0;
+    glm::vec3 position_sum(0.0f);
+    while (triangles.size() < kMaxMeshletTriangles) {
+      // Pick the candidate adding the fewest vertices, then the closest to
+      // the meshlet's centroid, dropping the ones emitted meanwhile.
+      size_t best = 0;
+      uint32_t best_new_vertices = 4;  // until one is found
+      float best_distance = FLT_MAX;
+      glm::vec3 centroid =
+          position_sum / static_cast<float>(std::max(meshlet_vertex_count, 1u));
+      size_t live_count = 0;
+      for (uint32_t candidate : candidates) {
+        if (emitted[candidate]) {
+          continue;
+        }
+        const uint32_t* triangle = &indices[candidate * 3];
+        uint32_t new_vertices = 0;
+        glm::vec3 center(0.0f);
+        for (int corner = 0; corner < 3; ++corner) {
+          new_vertices += vertex_marks[triangle[corner]] != meshlet_number;
+          center += vertices[triangle[corner]].position;
+        }
+        float distance = glm::distance(centroid, center / 3.0f);
+        if (new_vertices < best_new_vertices ||
+            (new_vertices == best_new_vertices && distance < best_distance)) {
+          best = live_count;
+          best_new_vertices = new_vertices;
+          best_distance = distance;
+        }
+        candidates[live_count++] = candidate;
+      }
+      candidates.resize(live_count);
+      if (best_new_vertices == 4 ||
+          meshlet_vertex_count + best_new_vertices > kMaxMeshletVertices) {
+        break;
+      }
+
+      uint32_t triangle = candidates[best];
+      emitted[triangle] = true;
+      triangles.push_back(triangle);
+      for (int corner = 0; corner < 3; ++corner) {
+        uint32_t vertex = indices[triangle * 3 + corner];
+        if (vertex_marks[vertex] == meshlet_number) {
+          continue;
+        }
+        vertex_marks[vertex] = meshlet_number;
+        ++meshlet_vertex_count;
+        position_sum += vertices[vertex].position;
+        for (uint32_t i = offsets[vertex]; i < offsets[vertex + 1]; ++i) {
+          uint32_t neighbor = adjacency[i];
+          if (!emitted[neighbor] &&
+              candidate_marks[neighbor] != meshlet_number) {
+            candidate_marks[neighbor] = meshlet_number;
+            candidates.push_back(neighbor);
+          }
+        }
+      }
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+    Meshlet meshlet{static_cast<uint32_t>(meshlet_indices.size()),
+                    static_cast<uint32_t>(triangles.size() * 3),
+                    {},
+                    {}};
+    for (uint32_t triangle : triangles) {
+      meshlet_indices.insert(meshlet_indices.end(), &indices[triangle * 3],
+                             &indices[triangle * 3] + 3);
+    }
+    ComputeBounds(vertices, &meshlet_indices[meshlet.index_offset], meshlet);
+    meshlets.push_back(meshlet);
+    ++meshlet_number;
+  }
+  indices.swap(meshlet_indices);
+}
+
+void CullMeshlets(Span<const Meshlet> meshlets,
+                  const glm::mat4& world_view,
+                  const glm::mat4& projection,
+                  bool cull_backfacing,
+                  std::vector<DrawRange>& ranges) {
+  // View space planes of the clip space tests -w <= x <= w, -w <= y <= w and
+  // -w <= z, the latter being conservative for both depth conventions.
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(projection[0][i], projection[1][i], projection[2][i],
+                        projection[3][i]);
+  }
+  glm::vec4 planes[5] = {rows[3] + rows[0], rows[3] - rows[0],
+                         rows[3] + rows[1], rows[3] - rows[1],
+                         rows[3] + rows[2]};
+  for (glm::vec4& plane : planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  glm::mat3 rotation(world_view);
+  float scale = std::max({glm::length(rotation[0]), glm::length(rotation[1]),
+                          glm::length(rotation[2])});
+  const size_t first_range = ranges.size();
+
+  for (const Meshlet& meshlet : meshlets) {
+    glm::vec3 center(world_view *
+                     glm::vec4(glm::vec3(meshlet.bounding_sphere), 1.0f));
+    float radius = meshlet.bounding_sphere.w * scale;
+    bool visible = true;
+    for (const glm::vec4& plane : planes) {
+      visible =
+          visible && glm::dot(glm::vec3(plane), center) + plane.w >= -radius;
+    }
+    // The camera sits at the origin. It only sees back faces when the
+    // direction to the sphere is within the complement of the cone's spread
+    // of its axis, with some slack for the sphere's extent.
+    if (visible && cull_backfacing && meshlet.cone.w < 1.0f) {
+      glm::vec3 axis = glm::normalize(rotation * glm::vec3(meshlet.cone));
+      visible = glm::dot(center, axis) <
+                meshlet.cone.w * glm::length(center) + radius;
+    }
+    if (!visible) {
+      continue;
+    }
+    if (ranges.size() > first_range && ranges.back().index_offset +
+                                   ranges.back().index_count ==
+                               meshlet.index_offset) {
+      ranges.back().index_count += meshlet.index_count;
+    } else {
+      ranges.push_back(DrawRange{meshlet.index_offset, meshlet.index_count});
+    }
+  }
+}
+}  // namespace render
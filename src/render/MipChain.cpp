@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DEMO_MIP_CHAIN_SSE2
+#endif
+
+#include "render/MipChain.hpp"
+
+namespace render {
+namespace {
+// sRGB decoding goes through a 256-entry table, encoding through a 12-bit
+// one, which is finer than what 8 bits can tell apart.
+struct SrgbTables {
+  static constexpr uint32_t kEncodeSize = 4096;
+
+  float decode[256];
+  uint8_t encode[kEncodeSize];
+
+  SrgbTables() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      float c = static_cast<float>(i) / 255.0f;
+      decode[i] = c <= 0.04045f ? c / 12.92f
+                                : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (uint32_t i = 0; i < kEncodeSize; ++i) {
+      float l = static_cast<float>(i) / static_cast<float>(kEncodeSize - 1);
+      float c = l <= 0.0031308f ? l * 12.92f
+                                : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+      encode[i] = static_cast<uint8_t>(std::lround(c * 255.0f));
+    }
+  }
+};
+
+const SrgbTables& GetSrgbTables() {
+  static const SrgbTables tables;
+  return tables;
+}
+
+void Downsample(const SrgbTables& tables,
+                const uint8_t* src,
+                uint32_t src_width,
+                uint32_t src_height,
+                uint8_t* dst) {
+  uint32_t dst_width = std::max(src_width / 2, 1u);
+  uint32_t dst_height = std::max(src_height / 2, 1u);
+  for (uint32_t y = 0; y < dst_height; ++y) {
+    const uint8_t* row0 = src + size_t{std::min(2 * y, src_height - 1)} *
+                                    src_width * 4;
+    const uint8_t* row1 = src + size_t{std::min(2 * y + 1, src_height - 1)} *
+                                    src_width * 4;
+    for (uint32_t x = 0; x < dst_width; ++x) {
+      const uint8_t* texels[4] = {
+          row0 + std::min(2 * x, src_width - 1) * 4,
+          row0 + std::min(2 * x + 1, src_width - 1) * 4,
+          row1 + std::min(2 * x, src_width - 1) * 4,
+          row1 + std::min(2 * x + 1, src_width - 1) * 4};
+      uint8_t* out = dst + (size_t{y} * dst_width + x) * 4;
+#if defined(DEMO_MIP_CHAIN_SSE2)
+      __m128 sum = _mm_setzero_ps();
+      for (const uint8_t* t : texels) {
+        sum = _mm_add_ps(sum, _mm_set_ps(static_cast<float>(t[3]) / 255.0f,
+                                         tables.decode[t[2]],
+                                         tables.decode[t[1]],
+                                         tables.decode[t[0]]));
+      }
+      __m128 scale = _mm_set1_ps(0.25f * (SrgbTables::kEncodeSize - 1));
+      alignas(16) int32_t codes[4];
+      _mm_store_si128(reinterpret_cast<__m128i*>(codes),
+                      _mm_cvtps_epi32(_mm_mul_ps(sum, scale)));
+      out[0] = tables.encode[codes[0]];
+      out[1] = tables.encode[codes[1]];
+      out[2] = tables.encode[codes[2]];
+      out[3] = static_cast<uint8_t>(
+          (codes[3] * 255 + (SrgbTables::kEncodeSize - 1) / 2) /
+          (SrgbTables::kEncodeSize - 1));
+#else
+      for (uint32_t c = 0; c < 3; ++c) {
+        float sum = tables.decode[texels[0][c]] + tables.decode[texels[1][c]] +
+                    tables.decode[texels[2][c]] + tables.decode[texels[3][c]];
+        out[c] = tables.encode[std::lround(
+            sum * 0.25f * (SrgbTables::kEncodeSize - 1))];
+      }
+      out[3] = static_cast<uint8_t>(
+          (texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+#endif
+    }
+  }
+}
+}  // namespace
+
+uint32_t ComputeMipLevelCount(uint32_t width, uint32_t height) {
+  uint32_t level_count = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+    ++level_count;
+  }
+  return level_count;
+}
+
+size_t ComputeMipChainSize(uint32_t width,
+                           uint32_t height,
+                           uint32_t level_count,
+                           uint32_t texel_size) {
+  size_t size = 0;
+  for (uint32_t level = 0; level < level_count; ++level) {
+    size += size_t{std::max(width >> level, 1u)} *
+            std::max(height >> level, 1u) * texel_size;
+  }
+  return size;
+}
+
+std::vector<uint8_t> GenerateMipChain(const uint8_t* pixels,
+                                      uint32_t width,
+                                      uint32_t height,
+                                      uint32_t level_count) {
+  const SrgbTables& tables = GetSrgbTables();
+  std::vector<uint8_t> chain(
+      ComputeMipChainSize(width, height, level_count, 4));
+  std::memcpy(chain.data(), pixels, size_t{width} * height * 4);
+
+  uint8_t* src = chain.data();
+  for (uint32_t level = 1; level < level_count; ++level) {
+    uint32_t src_width = std::max(width >> (level - 1), 1u);
+    uint32_t src_height = std::max(height >> (level - 1), 1u);
+    uint8_t* dst = src + size_t{src_width} * src_height * 4;
+    Downsample(tables, src, src_width, src_height, dst);
+    src = dst;
+  }
+  return chain;
+}
+}  // namespace render
@@ -0,0 +1,618 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DEMO_OBJ_PARSER_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "render/ObjParser.hpp"
+#include "system.hpp"
+
+namespace render {
+namespace {
+// Files smaller than this are parsed by the calling thread alone.
+const size_t kMinChunkSize = 1 << 20;
+
+enum class Statement {
+  kOther,
+  kVertex,
+  kNormal,
+  kTexcoord,
+  kFace,
+  kGroup,
+  kMaterial
+};
+
+struct Chunk {
+  const char* begin;
+  const char* end;
+  size_t vertex_count;  ///< statements in the chunk
+  size_t normal_count;
+  size_t texcoord_count;
+  size_t face_count;
+  size_t vertex_base;  ///< statements in the chunks before this one
+  size_t normal_base;
+  size_t texcoord_base;
+  std::vector<tinyobj::index_t> indices;
+  std::vector<ObjGroupStatement> group_statements;  ///< offsets in the chunk
+};
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+bool IsDigit(char c) {
+  return static_cast<unsigned int>(c - '0') < 10u;
+}
+
+int CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// Lines end with "\n", "\r\n" or a lone "\r", like in tinyobj.
+const char* FindLineEnd(const char* p, const char* end) {
+#if defined(DEMO_OBJ_PARSER_SSE2)
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i carriage_return = _mm_set1_epi8('\r');
+  for (; end - p >= 16; p += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(bytes, newline),
+                                   _mm_cmpeq_epi8(bytes, carriage_return));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(matches));
+    if (mask != 0) {
+      return p + CountTrailingZeros(mask);
+    }
+  }
+#endif
+  while (p < end && *p != '\n' && *p != '\r') {
+    ++p;
+  }
+  return p;
+}
+
+const char* SkipLineEnd(const char* p, const char* end) {
+  if (p < end && *p == '\r') {
+    ++p;
+  }
+  if (p < end && *p == '\n') {
+    ++p;
+  }
+  return p;
+}
+
+const char* SkipSpaces(const char* p, const char* line_end) {
+  while (p < line_end && IsSpace(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+// Identifies the statement on the line and moves `p` to its arguments.
+Statement ParseKeyword(const char*& p, const char* line_end) {
+  p = SkipSpaces(p, line_end);
+  auto at = [p, line_end](size_t offset) {
+    return p + offset < line_end ? p[offset] : '\0';
+  };
+  if (at(0) == 'v' && IsSpace(at(1))) {
+    p += 2;
+    return Statement::kVertex;
+  }
+  if (at(0) == 'v' && at(1) == 'n' && IsSpace(at(2))) {
+    p += 3;
+    return Statement::kNormal;
+  }
+  if (at(0) == 'v' && at(1) == 't' && IsSpace(at(2))) {
+    p += 3;
+    return Statement::kTexcoord;
+  }
+  if (at(0) == 'f' && IsSpace(at(1))) {
+    p += 2;
+    return Statement::kFace;
+  }
+  if ((at(0) == 'g' || at(0) == 'o') && IsSpace(at(1))) {
+    return Statement::kGroup;
+  }
+  static const char kUseMtl[] = "usemtl";
+  const size_t keyword_size = sizeof(kUseMtl) - 1;
+  if (static_cast<size_t>(line_end - p) > keyword_size &&
+      std::equal(kUseMtl, kUseMtl + keyword_size, p) &&
+      IsSpace(p[keyword_size])) {
+    p += keyword_size;
+    return Statement::kMaterial;
+  }
+  return Statement::kOther;
+}
+
+// Same digit accumulation as tinyobj's tryParseDouble, which isn't correctly
+// rounded: a correctly rounded parser such as std::from_chars would disagree
+// on the last bit of some values.
+bool ParseDouble(const char* s, const char* s_end, double* result) {
+  static const double kPowers[] = {
+      1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001,
+  };
+  const int kPowerCount = sizeof(kPowers) / sizeof(kPowers[0]);
+
+  if (s >= s_end) {
+    return false;
+  }
+  double mantissa = 0.0;
+  int exponent = 0;
+  char sign = '+';
+  char exponent_sign = '+';
+  const char* p = s;
+  if (*p == '+' || *p == '-') {
+    sign = *p++;
+  } else if (!IsDigit(*p)) {
+    return false;
+  }
+
+  int read = 0;
+  while (p != s_end && IsDigit(*p)) {
+    mantissa *= 10;
+    mantissa += static_cast<int>(*p - '0');
+    ++p;
+    ++read;
+  }
+  if (read == 0) {
+    return false;
+  }
+
+  if (p != s_end) {
+    bool has_exponent = *p == 'e' || *p == 'E';
+    if (*p == '.') {
+      ++p;
+      read = 1;
+      while (p != s_end && IsDigit(*p)) {
+        mantissa += static_cast<int>(*p - '0') *
+                    (read < kPowerCount ? kPowers[read]
+                                        : std::pow(10.0, -read));
+        ++read;
+        ++p;
+      }
+      has_exponent = p != s_end && (*p == 'e' || *p == 'E');
+    }
+
+    if (has_exponent) {
+      ++p;
+      if (p != s_end && (*p == '+' || *p == '-')) {
+        exponent_sign = *p++;
+      } else if (p == s_end || !IsDigit(*p)) {
+        return false;
+      }
+      read = 0;
+      while (p != s_end && IsDigit(*p)) {
+        exponent *= 10;
+        exponent += static_cast<int>(*p - '0');
+        ++p;
+        ++read;
+      }
+      exponent *= (exponent_sign == '+' ? 1 : -1);
+      if (read == 0) {
+        return false;
+      }
+    }
+  }
+
+  *result = (sign == '+' ? 1 : -1) *
+            (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent)
+                      : mantissa);
+  return true;
+}
+
+// Unparsable values leave the default, zero, as in tinyobj.
+tinyobj::real_t ParseReal(const char*& p, const char* line_end) {
+  p = SkipSpaces(p, line_end);
+  const char* token_end = p;
+  while (token_end < line_end && !IsSpace(*token_end)) {
+    ++token_end;
+  }
+  double value = 0.0;
+  ParseDouble(p, token_end, &value);
+  p = token_end;
+  return static_cast<tinyobj::real_t>(value);
+}
+
+// atoi, bounded by the end of the line.
+int ParseInt(const char* p, const char* line_end) {
+  while (p < line_end && (IsSpace(*p) || *p == '\v' || *p == '\f')) {
+    ++p;
+  }
+  bool negative = false;
+  if (p < line_end && (*p == '+' || *p == '-')) {
+    negative = *p++ == '-';
+  }
+  int value = 0;
+  while (p < line_end && IsDigit(*p)) {
+    value = value * 10 + (*p++ - '0');
+  }
+  return negative ? -value : value;
+}
+
+const char* SkipIndex(const char* p, const char* line_end) {
+  while (p < line_end && *p != '/' && !IsSpace(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+// Makes indices zero-based and resolves relative (negative) ones against the
+// number of elements defined so far.
+int FixIndex(int index, size_t count) {
+  if (index > 0) {
+    return index - 1;
+  }
+  if (index == 0) {
+    return 0;
+  }
+  return static_cast<int>(count) + index;
+}
+
+// Parses one of i, i/j, i//k or i/j/k.
+tinyobj::index_t ParseTriple(const char*& p,
+                             const char* line_end,
+                             size_t vertex_count,
+                             size_t normal_count,
+                             size_t texcoord_count) {
+  tinyobj::index_t index{-1, -1, -1};
+  index.vertex_index = FixIndex(ParseInt(p, line_end), vertex_count);
+  p = SkipIndex(p, line_end);
+  if (p == line_end || *p != '/') {
+    return index;
+  }
+  ++p;
+
+  if (p < line_end && *p == '/') {
+    ++p;
+    index.normal_index = FixIndex(ParseInt(p, line_end), normal_count);
+    p = SkipIndex(p, line_end);
+    return index;
+  }
+
+  index.texcoord_index = FixIndex(ParseInt(p, line_end), texcoord_count);
+  p = SkipIndex(p, line_end);
+  if (p == line_end || *p != '/') {
+    return index;
+  }
+  ++p;
+  index.normal_index = FixIndex(ParseInt(p, line_end), normal_count);
+  p = SkipIndex(p, line_end);
+  return index;
+}
+
+void CountStatements(Chunk& chunk) {
+  for (const char* p = chunk.begin; p < chunk.end;) {
+    const char* line_end = FindLineEnd(p, chunk.end);
+    switch (ParseKeyword(p, line_end)) {
+      case Statement::kVertex:
+        ++chunk.vertex_count;
+        break;
+      case Statement::kNormal:
+        ++chunk.normal_count;
+        break;
+      case Statement::kTexcoord:
+        ++chunk.texcoord_count;
+        break;
+      case Statement::kFace:
+        ++chunk.face_count;
+        break;
+      default:
+        break;
+    }
+    p = SkipLineEnd(line_end, chunk.end);
+  }
+}
+
+void ParseChunk(Chunk& chunk, tinyobj::attrib_t& attributes) {
+  // Through data(), since files without normals or uvs leave them empty.
+  tinyobj::real_t* vertex = attributes.vertices.data() + chunk.vertex_base * 3;
+  tinyobj::real_t* normal = attributes.normals.data() + chunk.normal_base * 3;
+  tinyobj::real_t* texcoord =
+      attributes.texcoords.data() + chunk.texcoord_base * 2;
+  size_t vertex_count = chunk.vertex_base;
+  size_t normal_count = chunk.normal_base;
+  size_t texcoord_count = chunk.texcoord_base;
+  std::vector<tinyobj::index_t> face;
+  chunk.indices.reserve(chunk.face_count * 3);
+
+  for (const char* p = chunk.begin; p < chunk.end;) {
+    const char* line_end = FindLineEnd(p, chunk.end);
+    switch (ParseKeyword(p, line_end)) {
+      case Statement::kVertex:
+        for (int i = 0; i < 3; ++i) {
+          *vertex++ = ParseReal(p, line_end);
+        }
+        ++vertex_count;
+        break;
+      case Statement::kNormal:
+        for (int i = 0; i < 3; ++i) {
+          *normal++ = ParseReal(p, line_end);
+        }
+        ++normal_count;
+        break;
+      case Statement::kTexcoord:
+        for (int i = 0; i < 2; ++i) {
+          *texcoord++ = ParseReal(p, line_end);
+        }
+        ++texcoord_count;
+        break;
+      case Statement::kFace:
+        face.clear();
+        p = SkipSpaces(p, line_end);
+        while (p < line_end) {
+          face.push_back(ParseTriple(p, line_end, vertex_count, normal_count,
+                                     texcoord_count));
+          p = SkipSpaces(p, line_end);
+        }
+        // Polygons are turned into triangle fans.
+        for (size_t k = 2; k < face.size(); ++k) {
+          chunk.indices.push_back(face[0]);
+          chunk.indices.push_back(face[k - 1]);
+          chunk.indices.push_back(face[k]);
+        }
+        break;
+      case Statement::kGroup:
+        chunk.group_statements.push_back(
+            ObjGroupStatement{chunk.indices.size(), false, {}});
+        break;
+      case Statement::kMaterial: {
+        p = SkipSpaces(p, line_end);
+        const char* name_end = line_end;
+        while (name_end > p && IsSpace(name_end[-1])) {
+          --name_end;
+        }
+        chunk.group_statements.push_back(ObjGroupStatement{
+            chunk.indices.size(), true, std::string(p, name_end)});
+        break;
+      }
+      case Statement::kOther:
+        break;
+    }
+    p = SkipLineEnd(line_end, chunk.end);
+  }
+}
+
+// Splits [begin, end) into one chunk per hardware thread, if large enough.
+// Chunks end right after a newline, a line never straddles two of them.
+void SplitChunks(const char* begin,
+                 const char* end,
+                 std::vector<Chunk>& chunks) {
+  const size_t size = static_cast<size_t>(end - begin);
+  size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+  size_t chunk_count =
+      std::max<size_t>(1, std::min(thread_count, size / kMinChunkSize));
+  const char* chunk_begin = begin;
+  for (size_t i = 1; i <= chunk_count && chunk_begin < end; ++i) {
+    const char* chunk_end = end;
+    if (i < chunk_count) {
+      chunk_end = std::max(chunk_begin, begin + size * i / chunk_count);
+      while (chunk_end < end && *chunk_end++ != '\n') {
+      }
+    }
+    chunks.push_back(
+        Chunk{chunk_begin, chunk_end, 0, 0, 0, 0, 0, 0, 0, {}, {}});
+    chunk_begin = chunk_end;
+  }
+}
+
+void ParseChunks(std::vector<Chunk>& chunks,
+                 const std::function<void(Chunk&)>& parse) {
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    threads.emplace_back(parse, std::ref(chunks[i]));
+  }
+  parse(chunks[0]);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Whether every corner refers to attributes among the first `*_count` ones,
+// normals and texture coordinates being optional.
+bool AreIndicesInRange(const std::vector<tinyobj::index_t>& indices,
+                       size_t vertex_count,
+                       size_t normal_count,
+                       size_t texcoord_count) {
+  const auto vertex_end = static_cast<int64_t>(vertex_count);
+  const auto normal_end = static_cast<int64_t>(normal_count);
+  const auto texcoord_end = static_cast<int64_t>(texcoord_count);
+  for (const tinyobj::index_t& index : indices) {
+    if (index.vertex_index < 0 || index.vertex_index >= vertex_end ||
+        index.normal_index < -1 || index.normal_index >= normal_end ||
+        index.texcoord_index < -1 || index.texcoord_index >= texcoord_end) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+bool ParseObj(const std::string& path,
+              tinyobj::attrib_t& attributes,
+              std::vector<tinyobj::index_t>& indices,
+              std::vector<ObjGroup>& groups,
+              std::string& error) {
+  MappedFile file;
+  if (!file.Open(path)) {
+    error = "can't open file";
+    return false;
+  }
+  const char* begin = reinterpret_cast<const char*>(file.GetData());
+  const char* end = begin + file.GetSize();
+  std::vector<Chunk> chunks;
+  SplitChunks(begin, end, chunks);
+
+  ParseChunks(chunks, CountStatements);
+  size_t vertex_count = 0;
+  size_t normal_count = 0;
+  size_t texcoord_count = 0;
+  for (auto& chunk : chunks) {
+    chunk.vertex_base = vertex_count;
+    chunk.normal_base = normal_count;
+    chunk.texcoord_base = texcoord_count;
+    vertex_count += chunk.vertex_count;
+    normal_count += chunk.normal_count;
+    texcoord_count += chunk.texcoord_count;
+  }
+  attributes.vertices.resize(vertex_count * 3);
+  attributes.normals.resize(normal_count * 3);
+  attributes.texcoords.resize(texcoord_count * 2);
+  ParseChunks(chunks, [&attributes](Chunk& chunk) {
+    ParseChunk(chunk, attributes);
+  });
+
+  // Every statement closes the group before it, if it has faces, and the
+  // material carries over g and o statements.
+  size_t index_count = 0;
+  for (const auto& chunk : chunks) {
+    index_count += chunk.indices.size();
+  }
+  indices.clear();
+  indices.reserve(index_count);
+  groups.clear();
+  ObjGroup group{0, 0, {}};
+  auto close_group = [&groups, &group](size_t index_offset) {
+    group.index_count = index_offset - group.index_offset;
+    if (group.index_count > 0) {
+      groups.push_back(group);
+    }
+    group.index_offset = index_offset;
+  };
+  for (const auto& chunk : chunks) {
+    for (const auto& statement : chunk.group_statements) {
+      close_group(indices.size() + statement.index_offset);
+      if (statement.is_material) {
+        group.material = statement.material;
+      }
+    }
+    indices.insert(indices.end(), chunk.indices.begin(), chunk.indices.end());
+  }
+  close_group(indices.size());
+  if (indices.empty()) {
+    error = "no faces";
+    return false;
+  }
+  if (!AreIndicesInRange(indices, vertex_count, normal_count,
+                         texcoord_count)) {
+    error = "face refers to an undefined attribute";
+    return false;
+  }
+  return true;
+}
+
+struct ObjStreamParser::Window {
+  const char* begin;
+  const char* end;
+  std::vector<Chunk> chunks;
+};
+
+ObjStreamParser::ObjStreamParser() = default;
+ObjStreamParser::~ObjStreamParser() = default;
+
+bool ObjStreamParser::Open(const std::string& path,
+                           size_t window_size,
+                           std::string& error) {
+  if (!file_.Open(path)) {
+    error = "can't open file";
+    return false;
+  }
+  const char* begin = reinterpret_cast<const char*>(file_.GetData());
+  const char* end = begin + file_.GetSize();
+  windows_.clear();
+  next_window_ = 0;
+
+  // Windows end right after a newline too.
+  size_t vertex_count = 0;
+  size_t normal_count = 0;
+  size_t texcoord_count = 0;
+  face_count_ = 0;
+  for (const char* window_begin = begin; window_begin < end;) {
+    const char* window_end =
+        window_begin +
+        std::min(std::max<size_t>(window_size, 1),
+                 static_cast<size_t>(end - window_begin));
+    while (window_end < end && *window_end++ != '\n') {
+    }
+    windows_.push_back(Window{window_begin, window_end, {}});
+    std::vector<Chunk>& chunks = windows_.back().chunks;
+    SplitChunks(window_begin, window_end, chunks);
+    ParseChunks(chunks, CountStatements);
+    for (auto& chunk : chunks) {
+      chunk.vertex_base = vertex_count;
+      chunk.normal_base = normal_count;
+      chunk.texcoord_base = texcoord_count;
+      vertex_count += chunk.vertex_count;
+      normal_count += chunk.normal_count;
+      texcoord_count += chunk.texcoord_count;
+      face_count_ += chunk.face_count;
+    }
+    file_.Evict(static_cast<size_t>(window_begin - begin),
+                static_cast<size_t>(window_end - window_begin));
+    window_begin = window_end;
+  }
+  if (face_count_ == 0) {
+    error = "no faces";
+    return false;
+  }
+  // Sized exactly, since growing them would briefly take twice the space.
+  attributes_.vertices.assign(vertex_count * 3, 0.0f);
+  attributes_.normals.assign(normal_count * 3, 0.0f);
+  attributes_.texcoords.assign(texcoord_count * 2, 0.0f);
+  return true;
+}
+
+bool ObjStreamParser::IsDone() const {
+  return next_window_ == windows_.size();
+}
+
+size_t ObjStreamParser::GetWindowCount() const {
+  return windows_.size();
+}
+
+bool ObjStreamParser::ParseWindow(std::vector<tinyobj::index_t>& indices,
+                                  std::vector<ObjGroupStatement>& statements,
+                                  std::string& error) {
+  Window& window = windows_[next_window_++];
+  ParseChunks(window.chunks, [this](Chunk& chunk) {
+    ParseChunk(chunk, attributes_);
+  });
+
+  indices.clear();
+  statements.clear();
+  for (auto& chunk : window.chunks) {
+    for (auto& statement : chunk.group_statements) {
+      statement.index_offset += indices.size();
+      statements.push_back(std::move(statement));
+    }
+    indices.insert(indices.end(), chunk.indices.begin(), chunk.indices.end());
+    chunk.indices = {};
+    chunk.group_statements = {};
+  }
+  const char* begin = reinterpret_cast<const char*>(file_.GetData());
+  file_.Evict(static_cast<size_t>(window.begin - begin),
+              static_cast<size_t>(window.end - window.begin));
+
+  // Attributes past the window are still zero.
+  const Chunk& last_chunk = window.chunks.back();
+  if (!AreIndicesInRange(
+          indices, last_chunk.vertex_base + last_chunk.vertex_count,
+          last_chunk.normal_base + last_chunk.normal_count,
+          last_chunk.texcoord_base + last_chunk.texcoord_count)) {
+    error = "face refers to an attribute not defined before it";
+    return false;
+  }
+  return true;
+}
+}  // namespace render
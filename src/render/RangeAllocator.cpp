@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "render/RangeAllocator.hpp"
+
+namespace render {
+namespace {
+uint32_t FindFirstSet(uint64_t x) {
+  assert(x != 0);
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(x));
+#endif
+}
+
+uint32_t FloorLog2(uint64_t x) {
+  assert(x != 0);
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, x);
+  return static_cast<uint32_t>(index);
+#else
+  return 63u - static_cast<uint32_t>(__builtin_clzll(x));
+#endif
+}
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+}  // namespace
+
+RangeAllocator::RangeAllocator(uint64_t size) : size_(size) {
+  for (auto& lists : free_lists_) {
+    std::fill(std::begin(lists), std::end(lists), kNullNode);
+  }
+  if (size_ > 0) {
+    InsertFreeNode(CreateNode(0, size_));
+  }
+}
+
+void RangeAllocator::Mapping(uint64_t size,
+                             uint32_t& first,
+                             uint32_t& second) {
+  if (size < kSecondLevelCount) {
+    // Small ranges all live in the first list, one bucket per size.
+    first = 0;
+    second = static_cast<uint32_t>(size);
+  } else {
+    uint32_t log2 = FloorLog2(size);
+    first = log2 - kSecondLevelBits + 1;
+    second = static_cast<uint32_t>(size >> (log2 - kSecondLevelBits)) -
+             kSecondLevelCount;
+  }
+}
+
+uint32_t RangeAllocator::FindFreeNode(uint64_t size,
+                                     uint64_t alignment) const {
+  // Round the request up to the next bucket boundary so that any node found
+  // in the selected bucket is guaranteed to be large enough.
+  uint64_t search_size = size + alignment - 1;
+  if (search_size >= kSecondLevelCount) {
+    search_size +=
+        (uint64_t{1} << (FloorLog2(search_size) - kSecondLevelBits)) - 1;
+  }
+  uint32_t first;
+  uint32_t second;
+  Mapping(search_size, first, second);
+
+  uint32_t second_map =
+      first < kFirstLevelCount ? second_level_bitmaps_[first] & (~0u << second)
+                               : 0;
+  if (second_map == 0 && first + 1 < kFirstLevelCount) {
+    uint64_t first_map = first_level_bitmap_ & (~uint64_t{0} << (first + 1));
+    if (first_map != 0) {
+      first = FindFirstSet(first_map);
+      second_map = second_level_bitmaps_[first];
+    }
+  }
+  if (second_map != 0) {
+    return free_lists_[first][FindFirstSet(second_map)];
+  }
+
+  // Nothing is guaranteed to fit, but nodes sharing the request's own bucket
+  // still might (think of a range sized exactly for one allocation).
+  Mapping(size, first, second);
+  for (uint32_t id = free_lists_[first][second]; id != kNullNode;
+       id = nodes_[id].next_free) {
+    const Node& node = nodes_[id];
+    if (AlignUp(node.offset, alignment) - node.offset + size <= node.size) {
+      return id;
+    }
+  }
+  return kNullNode;
+}
+
+void RangeAllocator::InsertFreeNode(uint32_t node_id) {
+  Node& node = nodes_[node_id];
+  uint32_t first;
+  uint32_t second;
+  Mapping(node.size, first, second);
+
+  uint32_t head = free_lists_[first][second];
+  node.free = true;
+  node.prev_free = kNullNode;
+  node.next_free = head;
+  if (head != kNullNode) {
+    nodes_[head].prev_free = node_id;
+  }
+  free_lists_[first][second] = node_id;
+  first_level_bitmap_ |= uint64_t{1} << first;
+  second_level_bitmaps_[first] |= 1u << second;
+  ++free_range_count_;
+}
+
+void RangeAllocator::RemoveFreeNode(uint32_t node_id) {
+  Node& node = nodes_[node_id];
+  uint32_t first;
+  uint32_t second;
+  Mapping(node.size, first, second);
+
+  if (node.prev_free != kNullNode) {
+    nodes_[node.prev_free].next_free = node.next_free;
+  } else {
+    free_lists_[first][second] = node.next_free;
+    if (node.next_free == kNullNode) {
+      second_level_bitmaps_[first] &= ~(1u << second);
+      if (second_level_bitmaps_[first] == 0) {
+        first_level_bitmap_ &= ~(uint64_t{1} << first);
+      }
+    }
+  }
+  if (node.next_free != kNullNode) {
+    nodes_[node.next_free].prev_free = node.prev_free;
+  }
+  node.free = false;
+  node.prev_free = kNullNode;
+  node.next_free = kNullNode;
+  --free_range_count_;
+}
+
+uint32_t RangeAllocator::CreateNode(uint64_t offset, uint64_t size) {
+  Node node{offset, size, kNullNode, kNullNode, kNullNode, kNullNode, false};
+  if (!unused_nodes_.empty()) {
+    uint32_t id = unused_nodes_.back();
+    unused_nodes_.pop_back();
+    nodes_[id] = node;
+    return id;
+  }
+  nodes_.push_back(node);
+  return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+void RangeAllocator::ReleaseNode(uint32_t node_id) {
+  unused_nodes_.push_back(node_id);
+}
+
+std::optional<RangeAllocator::Range> RangeAllocator::Allocate(
+    uint64_t size,
+    uint64_t alignment) {
+  assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+  size = std::max<uint64_t>(size, 1);
+
+  uint32_t node_id = FindFreeNode(size, alignment);
+  if (node_id == kNullNode) {
+    return std::nullopt;
+  }
+  RemoveFreeNode(node_id);
+
+  // Give the alignment padding back as a free node of its own. The previous
+  // physical node is necessarily in use, otherwise they would have been
+  // coalesced, so there is nothing to merge it with.
+  uint64_t aligned_offset = AlignUp(nodes_[node_id].offset, alignment);
+  uint64_t padding = aligned_offset - nodes_[node_id].offset;
+  if (padding > 0) {
+    uint32_t padding_id = CreateNode(nodes_[node_id].offset, padding);
+    Node& node = nodes_[node_id];
+    Node& padding_node = nodes_[padding_id];
+    padding_node.prev_physical = node.prev_physical;
+    padding_node.next_physical = node_id;
+    if (node.prev_physical != kNullNode) {
+      nodes_[node.prev_physical].next_physical = padding_id;
+    }
+    node.prev_physical = padding_id;
+    node.offset = aligned_offset;
+    node.size -= padding;
+    InsertFreeNode(padding_id);
+  }
+
+  // Same for the tail of the node.
+  if (nodes_[node_id].size > size) {
+    uint32_t tail_id = CreateNode(nodes_[node_id].offset + size,
+                                  nodes_[node_id].size - size);
+    Node& node = nodes_[node_id];
+    Node& tail_node = nodes_[tail_id];
+    tail_node.prev_physical = node_id;
+    tail_node.next_physical = node.next_physical;
+    if (node.next_physical != kNullNode) {
+      nodes_[node.next_physical].prev_physical = tail_id;
+    }
+    node.next_physical = tail_id;
+    node.size = size;
+    InsertFreeNode(tail_id);
+  }
+
+  used_ += size;
+  ++allocation_count_;
+  const Node& node = nodes_[node_id];
+  return Range{node.offset, node.size, node_id};
+}
+
+void RangeAllocator::Free(const Range& range) {
+  uint32_t node_id = range.node;
+  assert(node_id < nodes_.size() && !nodes_[node_id].free);
+  assert(nodes_[node_id].offset == range.offset);
+
+  used_ -= nodes_[node_id].size;
+  --allocation_count_;
+
+  uint32_t prev_id = nodes_[node_id].prev_physical;
+  if (prev_id != kNullNode && nodes_[prev_id].free) {
+    RemoveFreeNode(prev_id);
+    Node& prev = nodes_[prev_id];
+    Node& node = nodes_[node_id];
+    prev.size += node.size;
+    prev.next_physical = node.next_physical;
+    if (node.next_physical != kNullNode) {
+      nodes_[node.next_physical].prev_physical = prev_id;
+    }
+    ReleaseNode(node_id);
+    node_id = prev_id;
+  }
+
+  uint32_t next_id = nodes_[node_id].next_physical;
+  if (next_id != kNullNode && nodes_[next_id].free) {
+    RemoveFreeNode(next_id);
+    Node& node = nodes_[node_id];
+    Node& next = nodes_[next_id];
+    node.size += next.size;
+    node.next_physical = next.next_physical;
+    if (next.next_physical != kNullNode) {
+      nodes_[next.next_physical].prev_physical = node_id;
+    }
+    ReleaseNode(next_id);
+  }
+
+  InsertFreeNode(node_id);
+}
+
+RangeAllocator::Stats RangeAllocator::GetStats() const {
+  Stats stats{size_, used_, 0, allocation_count_, free_range_count_};
+  if (first_level_bitmap_ != 0) {
+    // The largest free node lives in the highest non-empty bucket, but
+    // buckets are not sorted so the whole list has to be scanned.
+    uint32_t first = FloorLog2(first_level_bitmap_);
+    uint32_t second = FloorLog2(second_level_bitmaps_[first]);
+    for (uint32_t id = free_lists_[first][second]; id != kNullNode;
+         id = nodes_[id].next_free) {
+      stats.largest_free_range =
+          std::max(stats.largest_free_range, nodes_[id].size);
+    }
+  }
+  return stats;
+}
+}  // namespace render
@@ -1,6 +1,9 @@
 // STL headers
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -12,61 +15,13 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <SDL_image.h>
-
+#include "hash.hpp"
+#include "render/MeshLoader.hpp"
 #include "render/RenderSystem.hpp"
+#include "render/vulkan/Format.hpp"
 #include "system.hpp"
 
 namespace render {
-namespace {
-SDL_Surface* CreateMirrorSurface(SDL_Surface* surface) {
-  int width = surface->w;
-  int height = surface->h;
-  SDL_Surface* new_surface = SDL_CreateRGBSurfaceWithFormat(
-      0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
-  uint32_t* src_pixels = reinterpret_cast<uint32_t*>(surface->pixels);
-  uint32_t* dst_pixels = reinterpret_cast<uint32_t*>(new_surface->pixels);
-
-  assert(SDL_LockSurface(new_surface) == 0);
-  assert(SDL_LockSurface(surface) == 0);
-  for (size_t y = 0; y < height; ++y) {
-    for (size_t x = 0; x < width; ++x) {
-      uint32_t* src_ptr = src_pixels + y * width + x;
-      uint32_t* dst_ptr = dst_pixels + ((height - y - 1) * width) + x;
-      *dst_ptr = *src_ptr;
-    }
-  }
-  SDL_UnlockSurface(surface);
-  SDL_UnlockSurface(new_surface);
-  return new_surface;
-}
-
-SDL_Surface* LoadSdlImageFromFile(const std::string& path) {
-  std::cout << "Loading texture from file: " << path << '\n';
-  SDL_Surface* original_surface = IMG_Load(path.c_str());
-  SDL_Surface* rgba32_surface =
-      SDL_ConvertSurfaceFormat(original_surface, SDL_PIXELFORMAT_RGBA32, 0);
-  SDL_FreeSurface(original_surface);
-  SDL_Surface* mirror_surface = CreateMirrorSurface(rgba32_surface);
-  SDL_FreeSurface(rgba32_surface);
-  return mirror_surface;
-}
-
-void BlitSdlSurfaceToVulkanBuffer(SDL_Surface* surface,
-                                  vulkan::Buffer& staging_buffer) {
-  SDL_LockSurface(surface);
-  auto src_ptr = reinterpret_cast<uint8_t*>(surface->pixels);
-  auto dst_ptr = staging_buffer.Map<uint8_t>();
-  size_t size = static_cast<size_t>(surface->w) *
-                static_cast<size_t>(surface->h) *
-                static_cast<size_t>(surface->format->BytesPerPixel);
-  std::memcpy(dst_ptr, src_ptr, size);
-  staging_buffer.Unmap();
-  SDL_UnlockSurface(surface);
-  SDL_FreeSurface(surface);
-}
-}  // namespace
-
 void RenderSystem::CheckExtensions(
     std::vector<VkExtensionProperties> available_extensions_vec,
     std::vector<const char*> wanted_extensions) {
@@ -280,6 +235,9 @@ void RenderSystem::FindPhysicalDevice() {
         if (supported == VK_TRUE) {
           physical_device_ = physical_device;
           queue_family_index_ = queue_family_index;
+          vkGetPhysicalDeviceProperties(physical_device_,
+                                        &physical_device_properties_);
+          FindTransferQueueFamily(queue_family_properties);
           return;
         }
       }
@@ -288,6 +246,50 @@ void RenderSystem::FindPhysicalDevice() {
   }
 }
 
+void RenderSystem::FindTransferQueueFamily(
+    const std::vector<VkQueueFamilyProperties>& queue_family_properties) {
+  transfer_queue_family_index_ = queue_family_index_;
+  if (std::getenv("DEMO_DISABLE_TRANSFER_QUEUE") != nullptr) {
+    std::cout << "Transfer queue disabled, uploading on the graphics queue\n";
+    return;
+  }
+
+  // Prefer a transfer-only family, which usually maps to the copy engines,
+  // then settle for any other family. Graphics and compute families support
+  // transfers implicitly.
+  const VkQueueFlags transfer_flags =
+      VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+  std::optional<uint32_t> fallback_index;
+  for (uint32_t queue_family_index = 0;
+       queue_family_index < queue_family_properties.size();
+       ++queue_family_index) {
+    const auto& properties = queue_family_properties[queue_family_index];
+    if (queue_family_index == queue_family_index_ ||
+        (properties.queueFlags & transfer_flags) == 0) {
+      continue;
+    }
+    if ((properties.queueFlags &
+         (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0) {
+      transfer_queue_family_index_ = queue_family_index;
+      break;
+    }
+    if (!fallback_index) {
+      fallback_index = queue_family_index;
+    }
+  }
+  if (transfer_queue_family_index_ == queue_family_index_ && fallback_index) {
+    transfer_queue_family_index_ = *fallback_index;
+  }
+
+  if (transfer_queue_family_index_ == queue_family_index_) {
+    std::cout << "No separate transfer queue family, uploading on the "
+                 "graphics queue\n";
+  } else {
+    std::cout << "Uploading on queue family " << transfer_queue_family_index_
+              << '\n';
+  }
+}
+
 void RenderSystem::EnumerateDeviceExtensions(
     VkPhysicalDevice device,
     std::map<std::string, VkExtensionProperties>& extension_map) {
@@ -338,19 +340,23 @@ void RenderSystem::CreateDevice() {
   CheckDeviceExtensions(physical_device_, extensions);
 
   float queue_priorities = 1.0f;
-  VkDeviceQueueCreateInfo queue_info{};
-  queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-  queue_info.queueFamilyIndex = queue_family_index_;
-  queue_info.queueCount = 1;
-  queue_info.pQueuePriorities = &queue_priorities;
+  std::vector<VkDeviceQueueCreateInfo> queue_infos(1);
+  queue_infos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queue_infos[0].queueFamilyIndex = queue_family_index_;
+  queue_infos[0].queueCount = 1;
+  queue_infos[0].pQueuePriorities = &queue_priorities;
+  if (transfer_queue_family_index_ != queue_family_index_) {
+    queue_infos.push_back(queue_infos[0]);
+    queue_infos[1].queueFamilyIndex = transfer_queue_family_index_;
+  }
 
   VkPhysicalDeviceFeatures device_features{};
   device_features.samplerAnisotropy = VK_TRUE;
 
   VkDeviceCreateInfo info{};
   info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  info.queueCreateInfoCount = 1;
-  info.pQueueCreateInfos = &queue_info;
+  info.queueCreateInfoCount = static_cast<uint32_t>(queue_infos.size());
+  info.pQueueCreateInfos = queue_infos.data();
   info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
   info.ppEnabledExtensionNames = extensions.data();
   info.pEnabledFeatures = &device_features;
@@ -358,6 +364,7 @@ void RenderSystem::CreateDevice() {
   VK_CHECK(vkCreateDevice(physical_device_, &info, nullptr, &device_));
 
   vkGetDeviceQueue(device_, queue_family_index_, 0, &queue_);
+  vkGetDeviceQueue(device_, transfer_queue_family_index_, 0, &transfer_queue_);
 }
 
 void RenderSystem::CreateCommandPool() {
@@ -389,7 +396,7 @@ void RenderSystem::CreatePassDescriptorSetLayout(
   // First the uniform block bindings.
   for (const auto& block : uniform_buffer_descriptor.blocks) {
     bindings[i].binding = block.binding;
-    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     bindings[i].descriptorCount = 1;
     bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     i++;
@@ -422,10 +429,15 @@ void RenderSystem::CreateRenderObjectDescriptorSetLayout() {
 void RenderSystem::CreatePipelineLayout() {
   std::vector<VkDescriptorSetLayout> layouts = {
       pass_descriptor_set_layout_, render_object_descriptor_set_layout_};
+  // Bounds of the mesh being drawn, for packed positions.
+  VkPushConstantRange push_constant_range{VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                          sizeof(MeshBounds)};
   VkPipelineLayoutCreateInfo info{};
   info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   info.setLayoutCount = static_cast<uint32_t>(layouts.size());
   info.pSetLayouts = layouts.data();
+  info.pushConstantRangeCount = 1;
+  info.pPushConstantRanges = &push_constant_range;
   VK_CHECK(vkCreatePipelineLayout(device_, &info, nullptr, &pipeline_layout_));
 }
 
@@ -561,6 +573,21 @@ void RenderSystem::CreatePipeline() {
 
   VK_CHECK(vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &info, nullptr,
                                      &pipeline_));
+
+  // Packed meshes only differ by their vertex shader and input layout.
+  auto packed_binding_description =
+      render::PackedVertex::get_binding_description();
+  auto packed_attribute_descriptions =
+      render::PackedVertex::get_attribute_descriptions();
+  vertex_input_state_info.pVertexBindingDescriptions =
+      &packed_binding_description;
+  vertex_input_state_info.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(packed_attribute_descriptions.size());
+  vertex_input_state_info.pVertexAttributeDescriptions =
+      packed_attribute_descriptions.data();
+  shader_stages[0].module = packed_vertex_shader_module_;
+  VK_CHECK(vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &info, nullptr,
+                                     &packed_pipeline_));
 }
 
 std::string RenderSystem::LoadFile(const std::string& path,
@@ -589,6 +616,7 @@ VkShaderModule RenderSystem::LoadShader(const std::string& path) {
 
 void RenderSystem::LoadShaders() {
   vertex_shader_module_ = LoadShader("vertex.spv");
+  packed_vertex_shader_module_ = LoadShader("vertex_packed.spv");
   fragment_shader_module_ = LoadShader("fragment.spv");
 }
 
@@ -640,6 +668,14 @@ uint32_t RenderSystem::BeginFrame() {
   vkResetCommandBuffer(command_buffer, 0);
   vkBeginCommandBuffer(command_buffer, &begin_info);
 
+  // Resources that defragmentation and compactions moved since the last
+  // frame are copied before anything draws from their new place.
+  Defragment(command_buffer);
+  for (auto& buffer : geometry_pool_->RecordMoves(command_buffer)) {
+    retired_buffers_.push_back(
+        RetiredBuffer{std::move(buffer), frame_number_ + 1});
+  }
+
   VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
 
   VkRenderPassBeginInfo render_pass_info{};
@@ -699,46 +735,104 @@ void RenderSystem::EndFrame(uint32_t image_index) {
   frame_number_++;
 }
 
-void RenderSystem::UpdateUniformBlock(
-    size_t frame_id,
-    const render::Frame::UniformBlock& block) {
-  VkDeviceMemory memory = ubos_for_frames_[frame_id]->memory_;
-  void* data;
-
-  vkMapMemory(device_, memory, static_cast<VkDeviceSize>(block.offset),
-              static_cast<VkDeviceSize>(block.data.size()), 0, &data);
-  memcpy(data, block.data.data(), block.data.size());
-  vkUnmapMemory(device_, memory);
-}
-
 void RenderSystem::DrawFrame(const Frame& frame) {
+  CollectLoadedAssets();
   uint32_t image_index = BeginFrame();
 
-  vkCmdBindDescriptorSets(command_buffers_[current_frame_],
-                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0,
-                          1, &pass_descriptor_sets_[current_frame_], 0,
-                          nullptr);
+  // BeginFrame waited on this frame's fence, so the GPU is done reading
+  // whatever was pushed into the arena last time around.
+  ReserveUniformArena(frame);
+  vulkan::UniformArena& uniform_arena = *uniform_arenas_[current_frame_];
+  uniform_arena.Reset();
+  VkPipeline bound_pipeline = pipeline_;
+  // Every mesh lives in the geometry pool: its buffer is bound once, and
+  // only rebound as index buffer when the index type changes.
+  VkBuffer geometry_buffer = geometry_pool_->GetBuffer();
+  VkDeviceSize geometry_offset = 0;
+  vkCmdBindVertexBuffers(command_buffers_[current_frame_], 0, 1,
+                         &geometry_buffer, &geometry_offset);
+  VkIndexType bound_index_type = VK_INDEX_TYPE_MAX_ENUM;
+
   for (const auto& pass : frame.passes) {
-    UpdateUniformBlock(current_frame_, pass.uniform_block);
+    const auto& pass_data = pass.uniform_block.data;
+    uint32_t pass_offset =
+        uniform_arena.Push(pass_data.data(), pass_data.size());
     for (const auto& render_object : pass.render_objects) {
-      VkDescriptorSet render_object_descriptor_set =
-          materials_[render_object.material_id];
-      const Mesh& mesh = meshes_[render_object.mesh_id];
-      VkBuffer vertex_buffers[] = {mesh.vertex_buffer->buffer_};
-      VkDeviceSize offsets[] = {0};
-      UpdateUniformBlock(current_frame_, render_object.uniform_block);
-      vkCmdBindVertexBuffers(command_buffers_[current_frame_], 0, 1,
-                             vertex_buffers, offsets);
-      vkCmdBindIndexBuffer(command_buffers_[current_frame_],
-                           mesh.index_buffer->buffer_, 0, VK_INDEX_TYPE_UINT32);
+      // Objects whose mesh is still loading are skipped, the ones whose
+      // material is still loading get the placeholder.
+      auto mesh_it = meshes_.find(render_object.mesh_id);
+      if (mesh_it == meshes_.end()) {
+        continue;
+      }
+      const Mesh& mesh = mesh_it->second;
+      CullMesh(mesh, SelectLod(mesh, pass, render_object.world_matrix), pass,
+               render_object);
+      if (sub_mesh_draws_.empty()) {
+        continue;
+      }
+      // Both pipelines share their layout, so switching keeps descriptor
+      // sets bound.
+      VkPipeline pipeline = mesh.vertex_format == VertexFormat::kPacked
+                                ? packed_pipeline_
+                                : pipeline_;
+      if (pipeline != bound_pipeline) {
+        vkCmdBindPipeline(command_buffers_[current_frame_],
+                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        bound_pipeline = pipeline;
+      }
+      if (mesh.vertex_format == VertexFormat::kPacked) {
+        vkCmdPushConstants(command_buffers_[current_frame_], pipeline_layout_,
+                           VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshBounds),
+                           &mesh.bounds);
+      }
+      auto material_it = materials_.find(render_object.material_id);
+      VkDescriptorSet object_material = material_it != materials_.end()
+                                            ? material_it->second
+                                            : placeholder_material_;
+      const auto& object_data = render_object.uniform_block.data;
+      uint32_t dynamic_offsets[] = {
+          pass_offset,
+          uniform_arena.Push(object_data.data(), object_data.size())};
       vkCmdBindDescriptorSets(command_buffers_[current_frame_],
                               VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_,
-                              1, 1, &render_object_descriptor_set, 0, nullptr);
-      vkCmdDrawIndexed(command_buffers_[current_frame_],
-                       static_cast<uint32_t>(mesh.index_count), 1, 0, 0, 0);
+                              0, 1, &pass_descriptor_sets_[current_frame_], 2,
+                              dynamic_offsets);
+      if (mesh.index_type != bound_index_type) {
+        vkCmdBindIndexBuffer(command_buffers_[current_frame_],
+                             geometry_buffer, 0, mesh.index_type);
+        bound_index_type = mesh.index_type;
+      }
+      // Sub-meshes only rebind their material, and only when it changes.
+      VkDescriptorSet bound_material = VK_NULL_HANDLE;
+      for (const SubMeshDraw& draw : sub_mesh_draws_) {
+        VkDescriptorSet material = object_material;
+        if (draw.sub_mesh->material_id != kNoMaterial) {
+          auto it = materials_.find(draw.sub_mesh->material_id);
+          if (it != materials_.end()) {
+            material = it->second;
+          }
+        }
+        if (material != bound_material) {
+          vkCmdBindDescriptorSets(command_buffers_[current_frame_],
+                                  VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                  pipeline_layout_, 1, 1, &material, 0,
+                                  nullptr);
+          bound_material = material;
+        }
+        for (size_t i = 0; i < draw.range_count; ++i) {
+          const DrawRange& range = draw_ranges_[draw.first_range + i];
+          vkCmdDrawIndexed(
+              command_buffers_[current_frame_], range.index_count, 1,
+              mesh.geometry.first_index + range.index_offset,
+              mesh.geometry.vertex_offset + draw.sub_mesh->vertex_offset, 0);
+        }
+      }
     }
   }
 
+  // Uploads recorded since the last frame go out first so that this frame,
+  // submitted afterwards on the same queue, sees them.
+  upload_context_->Submit();
   EndFrame(image_index);
 }
 
@@ -794,82 +888,493 @@ void RenderSystem::CreateFramebuffers() {
 }
 
 size_t RenderSystem::CreateMesh(const std::string& name,
-                                const std::vector<render::Vertex>& vertices,
-                                const std::vector<uint32_t>& indices) {
+                                Span<const Vertex> vertices,
+                                Span<const uint32_t> indices) {
   size_t id = std::hash<std::string>{}(name);
-  auto vertex_buffer =
-      CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices);
-  auto index_buffer = CreateBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices);
-  meshes_[id] =
-      Mesh{std::move(vertex_buffer), std::move(index_buffer), indices.size()};
+  MeshLoader mesh_loader;
+  const uint32_t index_count = static_cast<uint32_t>(indices.size());
+  CreateMesh(id, vertices, indices, {SubMesh{0, index_count, 0, kNoMaterial}},
+             {MeshLod{0, index_count, 0.0f, 0, 0}}, {},
+             mesh_loader.ComputeBoundingSphere(vertices));
   return id;
 }
 
-void RenderSystem::CopyBuffer(VkBuffer src_buffer,
-                              VkBuffer dst_buffer,
-                              VkDeviceSize size) {
-  VkBufferCopy copy_info{};
-  copy_info.srcOffset = 0;
-  copy_info.dstOffset = 0;
-  copy_info.size = size;
+size_t RenderSystem::CreateMesh(const std::string& name,
+                                size_t vertex_count,
+                                size_t index_count,
+                                const glm::vec4& bounding_sphere,
+                                const VertexWriter& write_vertices,
+                                const IndexWriter& write_indices) {
+  size_t id = std::hash<std::string>{}(name);
+  const uint32_t count = static_cast<uint32_t>(index_count);
+  Mesh mesh{{},
+            VK_INDEX_TYPE_UINT32,
+            VertexFormat::kFloat,
+            {},
+            {SubMesh{0, count, 0, kNoMaterial}},
+            {MeshLod{0, count, 0.0f, 0, 0}},
+            {},
+            bounding_sphere,
+            0};
+  // Staging chunks start 16-byte aligned and hold whole vertices.
+  UploadGeometry(
+      vertex_count, sizeof(Vertex),
+      [&](uint8_t* dst, VkDeviceSize offset, VkDeviceSize size) {
+        write_vertices(Span<Vertex>(reinterpret_cast<Vertex*>(dst),
+                                    static_cast<size_t>(size / sizeof(Vertex))),
+                       static_cast<size_t>(offset / sizeof(Vertex)));
+      },
+      index_count, write_indices, mesh);
+  AddMesh(id, std::move(mesh));
+  return id;
+}
 
-  VkCommandBuffer command_buffer = BeginCommands();
-  vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_info);
-  EndCommands(command_buffer);
+void RenderSystem::CreateMesh(ResourceId id,
+                              Span<const Vertex> vertices,
+                              Span<const uint32_t> indices,
+                              std::vector<SubMesh> sub_meshes,
+                              std::vector<MeshLod> lods,
+                              std::vector<Meshlet> meshlets,
+                              const glm::vec4& bounding_sphere) {
+  Mesh mesh{{},
+            VK_INDEX_TYPE_UINT32,
+            VertexFormat::kFloat,
+            {},
+            std::move(sub_meshes),
+            std::move(lods),
+            std::move(meshlets),
+            bounding_sphere,
+            0};
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(vertices.data());
+  UploadGeometry(
+      vertices.size(), sizeof(Vertex),
+      [&](uint8_t* dst, VkDeviceSize offset, VkDeviceSize size) {
+        std::memcpy(dst, src + offset, size);
+      },
+      indices.size(),
+      [&](Span<uint32_t> dst, size_t first) {
+        std::memcpy(dst.data(), indices.data() + first, dst.size_bytes());
+      },
+      mesh);
+  AddMesh(id, std::move(mesh));
 }
 
-void RenderSystem::CreateUniformBufferObjects(size_t buffer_size) {
-  ubos_for_frames_.resize(swapchain_image_views_.size());
-  for (size_t i = 0; i < swapchain_image_views_.size(); ++i) {
-    ubos_for_frames_[i] = new vulkan::Buffer(
-        physical_device_, device_, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        static_cast<VkDeviceSize>(buffer_size));
+void RenderSystem::CreateMesh(ResourceId id,
+                              Span<const PackedVertex> vertices,
+                              const MeshBounds& bounds,
+                              Span<const uint32_t> indices,
+                              std::vector<SubMesh> sub_meshes,
+                              std::vector<MeshLod> lods,
+                              std::vector<Meshlet> meshlets,
+                              const glm::vec4& bounding_sphere) {
+  Mesh mesh{{},
+            VK_INDEX_TYPE_UINT32,
+            VertexFormat::kPacked,
+            bounds,
+            std::move(sub_meshes),
+            std::move(lods),
+            std::move(meshlets),
+            bounding_sphere,
+            0};
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(vertices.data());
+  UploadGeometry(
+      vertices.size(), sizeof(PackedVertex),
+      [&](uint8_t* dst, VkDeviceSize offset, VkDeviceSize size) {
+        std::memcpy(dst, src + offset, size);
+      },
+      indices.size(),
+      [&](Span<uint32_t> dst, size_t first) {
+        std::memcpy(dst.data(), indices.data() + first, dst.size_bytes());
+      },
+      mesh);
+  AddMesh(id, std::move(mesh));
+}
+
+void RenderSystem::UploadGeometry(
+    size_t vertex_count,
+    size_t vertex_size,
+    const vulkan::BufferWriter& write_vertices,
+    size_t index_count,
+    const std::function<void(Span<uint32_t>, size_t)>& write_indices,
+    Mesh& mesh) {
+  // 0xffff is left out as it restarts primitives when that is enabled.
+  mesh.index_type =
+      vertex_count >= 65536 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+  const size_t index_size =
+      mesh.index_type == VK_INDEX_TYPE_UINT32 ? sizeof(uint32_t)
+                                              : sizeof(uint16_t);
+  if (geometry_pool_->Allocate(vertex_count, vertex_size, index_count,
+                               index_size, mesh.geometry)) {
+    RefreshMeshes();
+  }
+  geometry_pool_->UploadVertices(mesh.geometry, write_vertices);
+
+  if (mesh.index_type == VK_INDEX_TYPE_UINT32) {
+    mesh.upload_ticket = geometry_pool_->UploadIndices(
+        mesh.geometry,
+        [&](uint8_t* dst, VkDeviceSize offset, VkDeviceSize size) {
+          write_indices(
+              Span<uint32_t>(reinterpret_cast<uint32_t*>(dst),
+                             static_cast<size_t>(size / sizeof(uint32_t))),
+              static_cast<size_t>(offset / sizeof(uint32_t)));
+        });
+    return;
+  }
+  // Short indices are narrowed through a block that stays in cache rather
+  // than a copy of the whole buffer.
+  const size_t kBlockSize = 4096;
+  std::array<uint32_t, kBlockSize> block;
+  mesh.upload_ticket = geometry_pool_->UploadIndices(
+      mesh.geometry,
+      [&](uint8_t* dst, VkDeviceSize offset, VkDeviceSize size) {
+        uint16_t* short_indices = reinterpret_cast<uint16_t*>(dst);
+        const size_t first = static_cast<size_t>(offset / sizeof(uint16_t));
+        const size_t count = static_cast<size_t>(size / sizeof(uint16_t));
+        for (size_t i = 0; i < count; i += kBlockSize) {
+          const size_t block_count = std::min(kBlockSize, count - i);
+          write_indices(Span<uint32_t>(block.data(), block_count), first + i);
+          for (size_t j = 0; j < block_count; ++j) {
+            short_indices[i + j] = static_cast<uint16_t>(block[j]);
+          }
+        }
+      });
+}
+
+void RenderSystem::AddMesh(ResourceId id, Mesh mesh) {
+  auto it = meshes_.find(id);
+  if (it != meshes_.end()) {
+    RetireMesh(it->second);
+    it->second = std::move(mesh);
+  } else {
+    meshes_.emplace(id, std::move(mesh));
+  }
+}
+
+void RenderSystem::RetireMesh(const Mesh& mesh) {
+  retired_meshes_.push_back(
+      RetiredMesh{mesh.geometry, frame_number_, mesh.upload_ticket});
+}
+
+void RenderSystem::RefreshMeshes() {
+  for (auto& entry : meshes_) {
+    geometry_pool_->Refresh(entry.second.geometry);
+  }
+}
+
+void RenderSystem::UnloadMesh(ResourceId id) {
+  pending_meshes_.erase(id);
+  auto it = meshes_.find(id);
+  if (it != meshes_.end()) {
+    RetireMesh(it->second);
+    meshes_.erase(it);
+  }
+}
+
+void RenderSystem::CompactGeometry() {
+  if (geometry_pool_->Compact()) {
+    RefreshMeshes();
+  }
+}
+
+void RenderSystem::DestroyRetiredGeometry() {
+  // As for textures, see DestroyRetiredTextures.
+  for (auto it = retired_meshes_.begin(); it != retired_meshes_.end();) {
+    if (frame_number_ < it->frame_number + kMaxFrames ||
+        !upload_context_->IsComplete(it->upload_ticket)) {
+      ++it;
+      continue;
+    }
+    geometry_pool_->Free(it->geometry);
+    it = retired_meshes_.erase(it);
+  }
+  for (auto it = retired_buffers_.begin(); it != retired_buffers_.end();) {
+    if (frame_number_ < it->frame_number + kMaxFrames) {
+      ++it;
+      continue;
+    }
+    it = retired_buffers_.erase(it);
+  }
+}
+
+void RenderSystem::Defragment(VkCommandBuffer command_buffer) {
+  Defragmentation& defragmentation = defragmentation_;
+  if (defragmentation_budget_ == 0) {
+    return;
+  }
+
+  if (!defragmentation.active) {
+    if (defragmentation.report_pending) {
+      if (frame_number_ < defragmentation.report_frame) {
+        return;
+      }
+      PrintDefragmentationStats();
+      defragmentation.report_pending = false;
+      if (defragmentation.stuck) {
+        defragmentation.stuck_used = allocator_->GetStats().used;
+      }
+    }
+
+    // The pool moves all of its meshes at once.
+    vulkan::GeometryPool::Stats pool_stats = geometry_pool_->GetStats();
+    if (pool_stats.fragmentation > 0.5f &&
+        pool_stats.used <= defragmentation_budget_) {
+      CompactGeometry();
+    }
+
+    if (allocator_->GetStats().used == defragmentation.stuck_used ||
+        !allocator_->BeginDefragmentation(vulkan::ResourceKind::kOptimal)) {
+      return;
+    }
+    defragmentation.active = true;
+    defragmentation.stuck = false;
+    defragmentation.texture_count = 0;
+    defragmentation.bytes = 0;
+    for (uint64_t content_hash : texture_cache_.GetResidentContents()) {
+      const vulkan::Image& image =
+          *std::get<0>(*texture_cache_.FindContent(content_hash));
+      if (vulkan::Allocator::IsDraining(image.allocation_)) {
+        defragmentation.content_hashes.push_back(content_hash);
+      }
+    }
+    // The block may only hold textures retired already.
+    if (defragmentation.content_hashes.empty()) {
+      allocator_->EndDefragmentation();
+      defragmentation.active = false;
+      return;
+    }
+    // Images are only copied once everything written to them has landed.
+    defragmentation.upload_ticket = upload_context_->Submit();
+    defragmentation.stats_before = allocator_->GetStats();
+    defragmentation.first_frame = frame_number_;
+  }
+  if (!upload_context_->IsComplete(defragmentation.upload_ticket)) {
+    return;
+  }
+
+  std::unordered_set<const vulkan::Image*> moved_images;
+  VkDeviceSize moved_bytes = 0;
+  while (!defragmentation.content_hashes.empty() &&
+         moved_bytes < defragmentation_budget_) {
+    uint64_t content_hash = defragmentation.content_hashes.back();
+    defragmentation.content_hashes.pop_back();
+    // Textures unloaded since are gone, and reloaded ones went elsewhere.
+    const Texture* texture = texture_cache_.FindContent(content_hash);
+    if (texture == nullptr) {
+      continue;
+    }
+    const vulkan::Image& image = *std::get<0>(*texture);
+    if (!vulkan::Allocator::IsDraining(image.allocation_)) {
+      continue;
+    }
+    std::unique_ptr<vulkan::Image> moved_image =
+        vulkan::Image::CreateInPlaceOf(image);
+    if (moved_image == nullptr) {
+      // Holes left in the other blocks are too small for what remains.
+      defragmentation.stuck = true;
+      defragmentation.content_hashes.clear();
+      break;
+    }
+    image.RecordCopy(command_buffer, *moved_image);
+    moved_bytes += image.allocation_.size;
+    moved_images.insert(moved_image.get());
+
+    VkImageView image_view = GenerateImageView(*moved_image);
+    Texture replaced = texture_cache_.Replace(
+        content_hash,
+        Texture(std::move(moved_image), image_view, std::get<2>(*texture)));
+    // Recorded frames still sample the old image, this one copies from it.
+    retired_textures_.push_back(RetiredTexture{
+        std::move(replaced), frame_number_ + 1, defragmentation.upload_ticket});
+  }
+  defragmentation.texture_count += moved_images.size();
+  defragmentation.bytes += moved_bytes;
+
+  // Descriptor sets can't be updated while recorded frames use them, the
+  // materials get new ones and the old sets are freed once those frames are
+  // done.
+  auto is_moved = [this, &moved_images](ResourceId texture_id) {
+    return moved_images.count(
+               std::get<0>(texture_cache_.Get(texture_id)).get()) != 0;
+  };
+  if (!moved_images.empty()) {
+    for (const auto& entry : material_table_.GetResident()) {
+      if (std::any_of(entry.second.begin(), entry.second.end(), is_moved)) {
+        VkDescriptorSet& descriptor_set = materials_[entry.first];
+        RetireDescriptorSet(descriptor_set);
+        descriptor_set = CreateMaterialDescriptorSet(entry.second);
+      }
+    }
+    if (is_moved(placeholder_texture_)) {
+      RetireDescriptorSet(placeholder_material_);
+      placeholder_material_ =
+          CreateMaterialDescriptorSet({placeholder_texture_});
+    }
+  }
+
+  if (defragmentation.content_hashes.empty()) {
+    allocator_->EndDefragmentation();
+    defragmentation.active = false;
+    defragmentation.report_pending = true;
+    defragmentation.report_frame = frame_number_ + kMaxFrames + 1;
+  }
+}
+
+void RenderSystem::PrintDefragmentationStats() const {
+  const Defragmentation& defragmentation = defragmentation_;
+  vulkan::Allocator::Stats before = defragmentation.stats_before;
+  vulkan::Allocator::Stats after = allocator_->GetStats();
+  std::cout << "Defragmented device memory in "
+            << frame_number_ - defragmentation.first_frame << " frames:\n";
+  std::cout << "\tmoved: " << defragmentation.texture_count << " textures ("
+            << defragmentation.bytes << " bytes)\n";
+  std::cout << "\tblocks: " << before.block_count << " -> "
+            << after.block_count << '\n';
+  std::cout << "\treserved: " << before.reserved << " -> " << after.reserved
+            << " bytes\n";
+  std::cout << "\tfragmentation: " << 100.0f * before.fragmentation
+            << "% -> " << 100.0f * after.fragmentation << "%\n";
+}
+
+size_t RenderSystem::SelectLod(const Mesh& mesh,
+                               const Frame::Pass& pass,
+                               const glm::mat4& world_matrix) const {
+  glm::mat4 world_view = pass.view_matrix * world_matrix;
+  glm::vec3 center(world_view *
+                   glm::vec4(glm::vec3(mesh.bounding_sphere), 1.0f));
+  float scale = std::max({glm::length(glm::vec3(world_view[0])),
+                          glm::length(glm::vec3(world_view[1])),
+                          glm::length(glm::vec3(world_view[2]))});
+  // Errors are measured where the sphere gets closest to the camera, so the
+  // level only changes on screen size and not on rotation.
+  float distance = -center.z - mesh.bounding_sphere.w * scale;
+  if (distance <= 0.0f || lod_bias_ <= 0.0f) {
+    return 0;
+  }
+  float pixels_per_unit = scale * pass.projection_matrix[1][1] * 0.5f *
+                          static_cast<float>(window_extent_.height) / distance;
+  float max_error = lod_bias_ / pixels_per_unit;
+  // Sub-meshes are simplified together and share the errors of each level,
+  // which grow with every level.
+  const size_t sub_mesh_count = mesh.sub_meshes.size();
+  const size_t level_count = mesh.lods.size() / sub_mesh_count;
+  size_t level = 0;
+  while (level + 1 < level_count &&
+         mesh.lods[(level + 1) * sub_mesh_count].error <= max_error) {
+    ++level;
+  }
+  return level;
+}
+
+void RenderSystem::CullMesh(const Mesh& mesh,
+                            size_t level,
+                            const Frame::Pass& pass,
+                            const Frame::Pass::RenderObject& render_object) {
+  sub_mesh_draws_.clear();
+  draw_ranges_.clear();
+  const size_t sub_mesh_count = mesh.sub_meshes.size();
+  size_t first = std::min<size_t>(render_object.first_sub_mesh, sub_mesh_count);
+  size_t last = first + std::min<size_t>(render_object.sub_mesh_count,
+                                         sub_mesh_count - first);
+  glm::mat4 world_view = pass.view_matrix * render_object.world_matrix;
+  for (size_t i = first; i < last; ++i) {
+    const MeshLod& lod = mesh.lods[level * sub_mesh_count + i];
+    size_t first_range = draw_ranges_.size();
+    if (!meshlet_culling_ || lod.meshlet_count == 0) {
+      if (lod.index_count > 0) {
+        draw_ranges_.push_back(DrawRange{lod.index_offset, lod.index_count});
+      }
+    } else {
+      CullMeshlets(Span<const Meshlet>(&mesh.meshlets[lod.meshlet_offset],
+                                       lod.meshlet_count),
+                   world_view, pass.projection_matrix, cone_culling_,
+                   draw_ranges_);
+    }
+    if (draw_ranges_.size() > first_range) {
+      sub_mesh_draws_.push_back(SubMeshDraw{
+          &mesh.sub_meshes[i], first_range, draw_ranges_.size() - first_range});
+    }
+  }
+}
+
+void RenderSystem::SetLodBias(float bias) {
+  lod_bias_ = bias;
+}
+
+void RenderSystem::CreateUniformArenas(size_t arena_size) {
+  uniform_arenas_.resize(kMaxFrames);
+  for (size_t i = 0; i < kMaxFrames; ++i) {
+    uniform_arenas_[i] = std::make_unique<vulkan::UniformArena>(
+        *allocator_, static_cast<VkDeviceSize>(arena_size),
+        physical_device_properties_.limits.minUniformBufferOffsetAlignment);
   }
 }
 
 void RenderSystem::AllocateUboDescriptorSets(
     const UniformBufferDescriptor& uniform_buffer_descriptor) {
-  uint32_t descriptor_count =
-      static_cast<uint32_t>(swapchain_image_views_.size());
-  size_t block_count = uniform_buffer_descriptor.blocks.size();
-  size_t write_count = descriptor_count * block_count;
+  uint32_t descriptor_count = static_cast<uint32_t>(kMaxFrames);
+  size_t write_count =
+      descriptor_count * uniform_buffer_descriptor.blocks.size();
 
   pass_descriptor_sets_ = AllocateDescriptorSets(
       pass_descriptor_set_layout_, descriptor_count,
-      {{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptor_count * 2}});
-
-  std::vector<VkWriteDescriptorSet> write_infos(write_count);
-  std::vector<VkDescriptorBufferInfo> buffer_infos(write_count);
-  for (size_t set_id = 0, write_info_id = 0; set_id < descriptor_count;
-       ++set_id) {
-    auto it = uniform_buffer_descriptor.blocks.begin();
-    for (size_t block_id = 0; block_id < block_count;
-         ++block_id, ++write_info_id) {
-      const auto& block_descriptor = *it;
-      size_t i = set_id * block_count + block_id;
-      buffer_infos[i].buffer = ubos_for_frames_[set_id]->buffer_;
-      buffer_infos[i].offset = block_descriptor.offset;
-      buffer_infos[i].range = block_descriptor.range;
-
-      write_infos[write_info_id].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      write_infos[write_info_id].dstSet = pass_descriptor_sets_[set_id];
-      write_infos[write_info_id].dstBinding = static_cast<uint32_t>(block_id);
-      write_infos[write_info_id].dstArrayElement = 0;
-      write_infos[write_info_id].descriptorCount = 1;
-      write_infos[write_info_id].descriptorType =
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      write_infos[write_info_id].pBufferInfo = &buffer_infos[block_id];
+      {{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        static_cast<uint32_t>(write_count)}});
+  uniform_blocks_ = uniform_buffer_descriptor.blocks;
+  for (size_t set_id = 0; set_id < descriptor_count; ++set_id) {
+    WritePassDescriptorSet(set_id);
+  }
+}
 
-      ++it;
-    }
+void RenderSystem::WritePassDescriptorSet(size_t frame) {
+  std::vector<VkWriteDescriptorSet> write_infos(uniform_blocks_.size());
+  std::vector<VkDescriptorBufferInfo> buffer_infos(uniform_blocks_.size());
+  auto it = uniform_blocks_.begin();
+  for (size_t i = 0; i < uniform_blocks_.size(); ++i, ++it) {
+    const auto& block_descriptor = *it;
+    buffer_infos[i].buffer = uniform_arenas_[frame]->GetBuffer();
+    buffer_infos[i].offset = 0;
+    buffer_infos[i].range = block_descriptor.range;
+
+    write_infos[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_infos[i].dstSet = pass_descriptor_sets_[frame];
+    write_infos[i].dstBinding = block_descriptor.binding;
+    write_infos[i].dstArrayElement = 0;
+    write_infos[i].descriptorCount = 1;
+    write_infos[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write_infos[i].pBufferInfo = &buffer_infos[i];
   }
 
   vkUpdateDescriptorSets(device_, static_cast<uint32_t>(write_infos.size()),
                          write_infos.data(), 0, nullptr);
 }
 
+void RenderSystem::ReserveUniformArena(const Frame& frame) {
+  const vulkan::UniformArena& uniform_arena = *uniform_arenas_[current_frame_];
+  // Objects whose mesh is still loading are counted too, the arena only has
+  // to be large enough.
+  VkDeviceSize size = 0;
+  for (const auto& pass : frame.passes) {
+    size += uniform_arena.GetPushSize(pass.uniform_block.data.size());
+    for (const auto& render_object : pass.render_objects) {
+      size +=
+          uniform_arena.GetPushSize(render_object.uniform_block.data.size());
+    }
+  }
+  if (size <= uniform_arena.GetCapacity()) {
+    return;
+  }
+  // Doubling keeps scenes that grow a little every frame from replacing the
+  // arena every frame. BeginFrame waited on this frame's fence, and nothing
+  // recorded since binds its descriptor set: both can be replaced.
+  VkDeviceSize capacity = std::max(size, 2 * uniform_arena.GetCapacity());
+  std::cout << "Uniform arena " << current_frame_ << " grows to " << capacity
+            << " bytes\n";
+  uniform_arenas_[current_frame_] = std::make_unique<vulkan::UniformArena>(
+      *allocator_, capacity,
+      physical_device_properties_.limits.minUniformBufferOffsetAlignment);
+  WritePassDescriptorSet(current_frame_);
+}
+
 std::vector<VkDescriptorSet> RenderSystem::AllocateDescriptorSets(
     VkDescriptorSetLayout layout,
     size_t descriptor_set_count,
@@ -903,6 +1408,13 @@ void RenderSystem::Init(
   CreateVulkanSurface();
   FindPhysicalDevice();
   CreateDevice();
+  CheckTextureFormatSupport();
+  allocator_ = std::make_unique<vulkan::Allocator>(physical_device_, device_);
+  upload_context_ = std::make_unique<vulkan::UploadContext>(
+      *allocator_, transfer_queue_, transfer_queue_family_index_, queue_,
+      queue_family_index_, kStagingSize);
+  geometry_pool_ = std::make_unique<vulkan::GeometryPool>(
+      *allocator_, *upload_context_, kGeometryPoolSize);
   CreateSwapchain();
   LoadShaders();
   CreatePassDescriptorSetLayout(uniform_buffer_descriptor);
@@ -911,22 +1423,68 @@ void RenderSystem::Init(
   CreatePipeline();
   CreateFramebuffers();
   CreateCommandPool();
-  CreateUniformBufferObjects(uniform_buffer_descriptor.size);
+  CreateUniformArenas(uniform_buffer_descriptor.arena_size);
   CreateCommandBuffer();
   CreateSyncObjects();
   descriptor_pool_cache_ =
       std::make_unique<vulkan::DescriptorPoolCache>(device_);
+  sampler_cache_ = std::make_unique<vulkan::SamplerCache>(device_);
   AllocateUboDescriptorSets(uniform_buffer_descriptor);
+  CreatePlaceholderMaterial();
+  // Set DEMO_DISABLE_COOKED_ASSETS to ignore what asset_cooker wrote,
+  // DEMO_DISABLE_MESH_CACHE to time the cold path, and
+  // DEMO_DISABLE_MESH_OPTIMIZER to compare against file order.
+  bool use_cooked_assets =
+      std::getenv("DEMO_DISABLE_COOKED_ASSETS") == nullptr;
+  bool use_mesh_cache = std::getenv("DEMO_DISABLE_MESH_CACHE") == nullptr;
+  bool optimize_meshes =
+      std::getenv("DEMO_DISABLE_MESH_OPTIMIZER") == nullptr;
+  // DEMO_MESH_IMPORT_BUDGET_MB streams meshes that miss the caches through
+  // that much memory, see MeshLoader.
+  size_t mesh_import_budget = 0;
+  if (const char* budget = std::getenv("DEMO_MESH_IMPORT_BUDGET_MB")) {
+    mesh_import_budget =
+        static_cast<size_t>(std::strtoull(budget, nullptr, 10)) << 20;
+  }
+  asset_loader_ = std::make_unique<AssetLoader>(
+      !gpu_mipmaps_, sampled_texture_formats_, use_cooked_assets,
+      use_mesh_cache, optimize_meshes, mesh_import_budget);
+  // DEMO_LOD_BIAS overrides the tolerated error in pixels, see SetLodBias.
+  if (const char* lod_bias = std::getenv("DEMO_LOD_BIAS")) {
+    SetLodBias(std::strtof(lod_bias, nullptr));
+  }
+  // Set DEMO_DISABLE_MESHLET_CULLING to draw whole levels. The pipeline
+  // draws back faces, cone culling would drop those of open or double-sided
+  // meshes: DEMO_CONE_CULLING turns it on for scenes that have none.
+  meshlet_culling_ = std::getenv("DEMO_DISABLE_MESHLET_CULLING") == nullptr;
+  cone_culling_ = std::getenv("DEMO_CONE_CULLING") != nullptr;
+  if (const char* budget = std::getenv("DEMO_DEFRAG_BUDGET_MB")) {
+    defragmentation_budget_ =
+        static_cast<VkDeviceSize>(std::strtoull(budget, nullptr, 10)) << 20;
+  }
 }
 
 void RenderSystem::Cleanup() {
+  asset_loader_.reset(nullptr);
+  upload_context_.reset(nullptr);
+  geometry_pool_->PrintStats();
+  meshes_.clear();
+  retired_meshes_.clear();
+  retired_buffers_.clear();
+  geometry_pool_.reset(nullptr);
+  allocator_->PrintStats();
+  PrintTextureStats();
+  // Freed along with their pools.
+  retired_descriptor_sets_.clear();
   descriptor_pool_cache_.reset(nullptr);
-  for (const auto& texture : textures_) {
-    vkDestroyImageView(device_, std::get<1>(texture.second), nullptr);
-    vkDestroySampler(device_, std::get<2>(texture.second), nullptr);
+  for (auto& texture : texture_cache_.Clear()) {
+    DestroyTexture(texture);
   }
-  textures_.clear();
-  meshes_.clear();
+  for (auto& retired_texture : retired_textures_) {
+    DestroyTexture(retired_texture.texture);
+  }
+  retired_textures_.clear();
+  sampler_cache_.reset(nullptr);
   for (size_t i = 0; i < kMaxFrames; ++i) {
     vkDestroySemaphore(device_, render_finished_semaphores_[i], nullptr);
     vkDestroySemaphore(device_, image_available_semaphores_[i], nullptr);
@@ -935,17 +1493,20 @@ void RenderSystem::Cleanup() {
   vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
   vkDestroyRenderPass(device_, render_pass_, nullptr);
   vkDestroyPipeline(device_, pipeline_, nullptr);
+  vkDestroyPipeline(device_, packed_pipeline_, nullptr);
   vkDestroyShaderModule(device_, vertex_shader_module_, nullptr);
+  vkDestroyShaderModule(device_, packed_vertex_shader_module_, nullptr);
   vkDestroyShaderModule(device_, fragment_shader_module_, nullptr);
   vkDestroyCommandPool(device_, command_pool_, nullptr);
   vkDestroyDescriptorSetLayout(device_, pass_descriptor_set_layout_, nullptr);
   vkDestroyDescriptorSetLayout(device_, render_object_descriptor_set_layout_,
                                nullptr);
+  uniform_arenas_.clear();
   for (size_t i = 0; i < swapchain_image_views_.size(); ++i) {
-    delete ubos_for_frames_[i];
     vkDestroyImageView(device_, swapchain_image_views_[i], nullptr);
     vkDestroyFramebuffer(device_, framebuffers_[i], nullptr);
   }
+  allocator_.reset(nullptr);
   vkDestroySwapchainKHR(device_, swapchain_, nullptr);
   vkDestroyDevice(device_, nullptr);
   vkDestroySurfaceKHR(instance_, surface_, nullptr);
@@ -957,22 +1518,171 @@ void RenderSystem::WaitIdle() {
   vkDeviceWaitIdle(device_);
 }
 
-void RenderSystem::LoadMaterial(ResourceId id,
-                                const std::vector<std::string>& paths) {
-  std::vector<VkDescriptorImageInfo> image_info(paths.size());
-  std::vector<VkWriteDescriptorSet> write_info(paths.size());
-  std::vector<VkDescriptorSet> descriptor_sets =
-      AllocateDescriptorSets(render_object_descriptor_set_layout_, 1,
-                             {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                               static_cast<uint32_t>(paths.size())}});
-  VkDescriptorSet descriptor_set = descriptor_sets[0];
+vulkan::UploadTicket RenderSystem::SubmitUploads() {
+  return upload_context_->Submit();
+}
+
+bool RenderSystem::IsUploadComplete(vulkan::UploadTicket ticket) {
+  return upload_context_->IsComplete(ticket);
+}
+
+void RenderSystem::MountAssetPack(const std::string& pack_path,
+                                  const std::string& mount_point) {
+  bool record_access_order =
+      std::getenv("DEMO_RECORD_ASSET_ORDER") != nullptr;
+  asset_loader_->MountPack(pack_path, mount_point, record_access_order);
+}
+
+ResourceId RenderSystem::LoadMeshAsync(const std::string& name,
+                                       const std::string& path,
+                                       VertexFormat format) {
+  ResourceId id = std::hash<std::string>{}(name);
+  pending_meshes_.insert(id);
+  asset_loader_->LoadMesh(id, path, format);
+  return id;
+}
 
+void RenderSystem::LoadMaterialAsync(ResourceId id,
+                                     const std::vector<std::string>& paths) {
+  std::vector<ResourceId> texture_ids(paths.size());
+  std::unordered_map<ResourceId, const std::string*> texture_paths;
   for (size_t i = 0; i < paths.size(); ++i) {
-    ResourceId id = LoadImageFromFile(paths[i]);
+    texture_ids[i] = std::hash<std::string>{}(paths[i]);
+    texture_paths[texture_ids[i]] = &paths[i];
+  }
+  // Loading a material again replaces what it waited on, the textures it
+  // is drawn with stay until the new ones are resident.
+  std::vector<ResourceId> first_referenced_ids;
+  std::vector<Texture> released;
+  material_table_.Load(id, std::move(texture_ids), first_referenced_ids,
+                       released);
+  RetireTextures(released);
+  for (ResourceId texture_id : first_referenced_ids) {
+    if (pending_textures_.insert(texture_id).second) {
+      asset_loader_->LoadImage(texture_id, *texture_paths[texture_id]);
+    }
+  }
+}
+
+void RenderSystem::UnloadMaterial(ResourceId id) {
+  std::vector<Texture> released;
+  if (material_table_.Unload(id, released)) {
+    auto material_it = materials_.find(id);
+    RetireDescriptorSet(material_it->second);
+    materials_.erase(material_it);
+    material_upload_tickets_.erase(id);
+  }
+  RetireTextures(released);
+}
+
+void RenderSystem::RetireTextures(std::vector<Texture>& textures) {
+  for (Texture& texture : textures) {
+    retired_textures_.push_back(RetiredTexture{
+        std::move(texture), frame_number_, upload_context_->Submit()});
+  }
+}
+
+bool RenderSystem::IsMeshReady(ResourceId id) {
+  auto it = meshes_.find(id);
+  return it != meshes_.end() &&
+         upload_context_->IsComplete(it->second.upload_ticket);
+}
+
+bool RenderSystem::IsMaterialReady(ResourceId id) {
+  auto it = material_upload_tickets_.find(id);
+  return it != material_upload_tickets_.end() &&
+         upload_context_->IsComplete(it->second);
+}
+
+void RenderSystem::DropFailedAssets() {
+  for (ResourceId id : asset_loader_->TakeFailedMeshIds()) {
+    pending_meshes_.erase(id);
+  }
+  std::vector<ResourceId> failed_ids = asset_loader_->TakeFailedImageIds();
+  if (failed_ids.empty()) {
+    return;
+  }
+  std::unordered_set<ResourceId> failed_id_set(failed_ids.begin(),
+                                               failed_ids.end());
+  for (ResourceId id : failed_ids) {
+    pending_textures_.erase(id);
+  }
+  // Their references are all that keeps the failed textures referenced: a
+  // resident material only uses resident textures.
+  std::vector<Texture> released;
+  for (ResourceId id : material_table_.DropFailed(failed_id_set, released)) {
+    std::cerr << "Material " << id << " failed to load\n";
+  }
+  RetireTextures(released);
+}
+
+void RenderSystem::CollectLoadedAssets() {
+  DestroyRetiredTextures();
+  DestroyRetiredGeometry();
+  DropFailedAssets();
+  for (auto& mesh : asset_loader_->TakeMeshes()) {
+    // Meshes unloaded while loading are dropped.
+    if (pending_meshes_.erase(mesh.id) == 0) {
+      continue;
+    }
+    if (mesh.format == VertexFormat::kPacked) {
+      CreateMesh(mesh.id, mesh.packed_vertices, mesh.bounds, mesh.indices,
+                 std::move(mesh.sub_meshes), std::move(mesh.lods),
+                 std::move(mesh.meshlets), mesh.bounding_sphere);
+    } else {
+      CreateMesh(mesh.id, mesh.vertices, mesh.indices,
+                 std::move(mesh.sub_meshes), std::move(mesh.lods),
+                 std::move(mesh.meshlets), mesh.bounding_sphere);
+    }
+  }
+
+  std::vector<AssetLoader::ImageData> images = asset_loader_->TakeImages();
+  if (images.empty()) {
+    return;
+  }
+  for (const auto& image : images) {
+    // Textures every material gave up on while loading are dropped, and the
+    // ones whose contents are already resident under another path share it.
+    pending_textures_.erase(image.id);
+    if (texture_cache_.IsReferenced(image.id) &&
+        !texture_cache_.AddAlias(image.id, image.content_hash)) {
+      CreateTexture(image);
+    }
+    SDL_FreeSurface(image.surface);
+  }
+
+  // Materials are only bound once all of their textures are resident, until
+  // then DrawFrame falls back to the placeholder, or to the textures they
+  // were loaded with before.
+  std::vector<Texture> released;
+  for (ResourceId id : material_table_.BindComplete(released)) {
+    auto material_it = materials_.find(id);
+    if (material_it != materials_.end()) {
+      RetireDescriptorSet(material_it->second);
+    }
+    materials_[id] =
+        CreateMaterialDescriptorSet(material_table_.GetResident().at(id));
+    material_upload_tickets_[id] = upload_context_->Submit();
+  }
+  RetireTextures(released);
+}
 
+VkDescriptorSet RenderSystem::CreateMaterialDescriptorSet(
+    const std::vector<ResourceId>& texture_ids) {
+  std::vector<VkDescriptorImageInfo> image_info(texture_ids.size());
+  std::vector<VkWriteDescriptorSet> write_info(texture_ids.size());
+  // Materials come and go, and defragmentation replaces their sets, which
+  // have to be freed one by one.
+  VkDescriptorSet descriptor_set = descriptor_pool_cache_->AllocateFreeable(
+      render_object_descriptor_set_layout_,
+      {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        static_cast<uint32_t>(texture_ids.size())}});
+
+  for (size_t i = 0; i < texture_ids.size(); ++i) {
+    const Texture& texture = texture_cache_.Get(texture_ids[i]);
     image_info[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    image_info[i].imageView = std::get<1>(textures_[id]);
-    image_info[i].sampler = std::get<2>(textures_[id]);
+    image_info[i].imageView = std::get<1>(texture);
+    image_info[i].sampler = std::get<2>(texture);
 
     write_info[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     write_info[i].dstSet = descriptor_set;
@@ -985,52 +1695,184 @@ void RenderSystem::LoadMaterial(ResourceId id,
 
   vkUpdateDescriptorSets(device_, static_cast<uint32_t>(write_info.size()),
                          write_info.data(), 0, nullptr);
+  return descriptor_set;
+}
 
-  materials_[id] = descriptor_set;
+void RenderSystem::CreatePlaceholderMaterial() {
+  const uint32_t white_pixel = 0xffffffff;
+  ResourceId id = std::hash<std::string>{}("__placeholder_texture");
+  placeholder_texture_ = id;
+  auto image = std::make_unique<vulkan::Image>(*allocator_, 1, 1);
+  upload_context_->UploadImage(*image, &white_pixel);
+  VkImageView image_view = GenerateImageView(*image);
+  // Never released, the placeholder lives as long as the render system.
+  texture_cache_.AddReference(id);
+  texture_cache_.Insert(id, hash_bytes(&white_pixel, sizeof(white_pixel)),
+                        sizeof(white_pixel),
+                        Texture(std::move(image), image_view, CreateSampler()));
+  placeholder_material_ = CreateMaterialDescriptorSet({id});
 }
 
 std::tuple<uint32_t, uint32_t> RenderSystem::GetWindowDimensions() const {
   return std::make_tuple(window_extent_.width, window_extent_.height);
 }
 
-ResourceId RenderSystem::LoadImageFromFile(const std::string& path) {
-  SDL_Surface* surface = LoadSdlImageFromFile(path);
-  VkDeviceSize staging_buffer_size =
-      static_cast<VkDeviceSize>(surface->w) *
-      static_cast<VkDeviceSize>(surface->h) *
-      static_cast<VkDeviceSize>(surface->format->BytesPerPixel);
+void RenderSystem::CheckTextureFormatSupport() {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(physical_device_, VK_FORMAT_R8G8B8A8_SRGB,
+                                      &properties);
+  const VkFormatFeatureFlags blit_features =
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  gpu_mipmaps_ =
+      (properties.optimalTilingFeatures & blit_features) == blit_features &&
+      std::getenv("DEMO_CPU_MIPMAPS") == nullptr;
+  std::cout << "Generating mipmaps on the " << (gpu_mipmaps_ ? "GPU" : "CPU")
+            << '\n';
+
+  const VkFormat texture_formats[] = {
+      VK_FORMAT_R8G8B8A8_UNORM,           VK_FORMAT_R8G8B8A8_SRGB,
+      VK_FORMAT_BC1_RGB_UNORM_BLOCK,      VK_FORMAT_BC1_RGB_SRGB_BLOCK,
+      VK_FORMAT_BC1_RGBA_UNORM_BLOCK,     VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+      VK_FORMAT_BC3_UNORM_BLOCK,          VK_FORMAT_BC3_SRGB_BLOCK,
+      VK_FORMAT_BC5_UNORM_BLOCK,          VK_FORMAT_BC7_UNORM_BLOCK,
+      VK_FORMAT_BC7_SRGB_BLOCK,           VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,
+      VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK,   VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK,
+      VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK};
+  const VkFormatFeatureFlags sampled_features =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  std::cout << "Sampled texture formats:";
+  for (VkFormat format : texture_formats) {
+    vkGetPhysicalDeviceFormatProperties(physical_device_, format, &properties);
+    if ((properties.optimalTilingFeatures & sampled_features) ==
+        sampled_features) {
+      sampled_texture_formats_.insert(format);
+      std::cout << ' ' << vulkan::GetFormatName(format);
+    }
+  }
+  std::cout << '\n';
+}
 
-  vulkan::Buffer staging_buffer(physical_device_, device_,
-                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
-                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                                staging_buffer_size);
-  BlitSdlSurfaceToVulkanBuffer(surface, staging_buffer);
+void RenderSystem::CreateTexture(const AssetLoader::ImageData& image_data) {
   auto image = std::make_unique<vulkan::Image>(
-      physical_device_, device_, static_cast<uint32_t>(surface->w),
-      static_cast<uint32_t>(surface->h));
-
-  ChangeImageLayout(image->image_, VK_IMAGE_LAYOUT_UNDEFINED,
-                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  CopyBufferToImage(staging_buffer, image.get(), surface->w, surface->h);
-  ChangeImageLayout(image->image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-  VkImageView image_view = GenerateImageView(image->image_);
+      *allocator_, image_data.width, image_data.height, image_data.mip_levels,
+      image_data.format);
+
+  auto staging_start = std::chrono::steady_clock::now();
+  if (image_data.surface != nullptr) {
+    // Expand to RGBA straight into staging memory rather than through an
+    // intermediate surface.
+    SDL_Surface* surface = image_data.surface;
+    upload_context_->UploadImage(
+        *image, [surface](uint8_t* dst, uint32_t first_row,
+                          uint32_t row_count) {
+          AssetLoader::WriteRgba32Rows(surface, dst, first_row, row_count);
+        });
+  } else {
+    upload_context_->UploadImage(*image, image_data.pixels.data(),
+                                 image_data.level_count);
+  }
+  float staging_time_ms = std::chrono::duration<float, std::milli>(
+                              std::chrono::steady_clock::now() - staging_start)
+                              .count();
+
+  vulkan::FormatInfo format_info;
+  vulkan::GetFormatInfo(image_data.format, format_info);
+  const vulkan::FormatInfo rgba8_info{1, 1, 4, false};
+  uint32_t width = image_data.width;
+  uint32_t height = image_data.height;
+  uint32_t mip_levels = image_data.mip_levels;
+  VkDeviceSize size =
+      vulkan::GetMipChainSize(format_info, width, height, mip_levels);
+  VkDeviceSize rgba8_size =
+      vulkan::GetMipChainSize(rgba8_info, width, height, mip_levels);
+  VkDeviceSize base_level_size =
+      vulkan::GetLevelSize(format_info, width, height, 0);
+
+  ++texture_stats_.texture_count;
+  texture_stats_.bytes += size;
+  texture_stats_.rgba8_bytes += rgba8_size;
+  texture_stats_.base_level_bytes += base_level_size;
+  texture_stats_.texel_fetch_bytes_at_quarter_size += vulkan::GetLevelSize(
+      format_info, width, height, std::min(2u, mip_levels - 1));
+
+  std::cout << "Texture " << image_data.path << ":\n";
+  std::cout << "\tformat: " << vulkan::GetFormatName(image_data.format)
+            << ", " << width << "x" << height << ", " << mip_levels
+            << " levels\n";
+  std::cout << "\tsize: " << size << " bytes (" << rgba8_size
+            << " as RGBA8)\n";
+  VkDeviceSize staged_size = vulkan::GetMipChainSize(
+      format_info, width, height, image_data.level_count);
+  float ingest_time_ms = image_data.load_time_ms + staging_time_ms;
+  std::cout << "\tloaded in " << image_data.load_time_ms << " ms, staged in "
+            << staging_time_ms << " ms ("
+            << staged_size / (ingest_time_ms * 1000.0f) << " MB/s)\n";
+
+  VkImageView image_view = GenerateImageView(*image);
   VkSampler sampler = CreateSampler();
+  texture_cache_.Insert(image_data.id, image_data.content_hash, size,
+                        Texture(std::move(image), image_view, sampler));
+}
 
-  ResourceId id = std::hash<std::string>{}(path);
-  textures_[id] = Texture(std::move(image), image_view, sampler);
-  return id;
+void RenderSystem::DestroyTexture(Texture& texture) {
+  vkDestroyImageView(device_, std::get<1>(texture), nullptr);
+  std::get<0>(texture).reset(nullptr);
 }
 
-VkSampler RenderSystem::CreateSampler() {
-  VkSampler sampler;
+void RenderSystem::DestroyRetiredTextures() {
+  // Frames recorded before a texture was retired may still be in flight until
+  // kMaxFrames more frames have been started.
+  for (auto it = retired_textures_.begin(); it != retired_textures_.end();) {
+    if (frame_number_ < it->frame_number + kMaxFrames ||
+        !upload_context_->IsComplete(it->upload_ticket)) {
+      ++it;
+      continue;
+    }
+    DestroyTexture(it->texture);
+    it = retired_textures_.erase(it);
+  }
+  for (auto it = retired_descriptor_sets_.begin();
+       it != retired_descriptor_sets_.end();) {
+    if (frame_number_ < it->frame_number + kMaxFrames) {
+      ++it;
+      continue;
+    }
+    descriptor_pool_cache_->Free(it->descriptor_set);
+    it = retired_descriptor_sets_.erase(it);
+  }
+}
+
+void RenderSystem::RetireDescriptorSet(VkDescriptorSet descriptor_set) {
+  retired_descriptor_sets_.push_back(
+      RetiredDescriptorSet{descriptor_set, frame_number_});
+}
 
-  // TODO: cache physical device properties.
-  VkPhysicalDeviceProperties properties{};
-  vkGetPhysicalDeviceProperties(physical_device_, &properties);
+void RenderSystem::PrintTextureStats() const {
+  const TextureStats& stats = texture_stats_;
+  std::cout << "Texture stats:\n";
+  std::cout << "\ttextures: " << stats.texture_count << '\n';
+  std::cout << "\tsize: " << stats.bytes << " bytes (" << stats.rgba8_bytes
+            << " as RGBA8)\n";
+  // With trilinear filtering, a texture drawn at a quarter of its size reads
+  // from level 2 instead of streaming through the whole base level.
+  std::cout << "\tbytes touched at 1/4 size: "
+            << stats.texel_fetch_bytes_at_quarter_size << " instead of "
+            << stats.base_level_bytes << '\n';
+
+  const TextureCache::Stats& cache_stats = texture_cache_.GetStats();
+  std::cout << "\tcache: " << cache_stats.hits << " hits, "
+            << cache_stats.misses << " misses, " << cache_stats.content_hits
+            << " shared by content (" << cache_stats.bytes_saved
+            << " bytes saved)\n";
+  vulkan::SamplerCache::Stats sampler_stats = sampler_cache_->GetStats();
+  std::cout << "\tsamplers: " << sampler_stats.sampler_count << " ("
+            << sampler_stats.hits << " hits, " << sampler_stats.misses
+            << " misses)\n";
+}
 
+VkSampler RenderSystem::CreateSampler() {
   VkSamplerCreateInfo info{};
   info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
   info.magFilter = VK_FILTER_LINEAR;
@@ -1039,115 +1881,29 @@ VkSampler RenderSystem::CreateSampler() {
   info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
   info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
   info.anisotropyEnable = VK_TRUE;
-  info.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+  info.maxAnisotropy = physical_device_properties_.limits.maxSamplerAnisotropy;
   info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  info.minLod = 0.0f;
+  info.maxLod = VK_LOD_CLAMP_NONE;
   info.compareEnable = VK_FALSE;
   info.compareOp = VK_COMPARE_OP_ALWAYS;
 
-  VK_CHECK(vkCreateSampler(device_, &info, nullptr, &sampler));
-
-  return sampler;
+  return sampler_cache_->GetSampler(info);
 }
 
-VkImageView RenderSystem::GenerateImageView(VkImage image) {
+VkImageView RenderSystem::GenerateImageView(const vulkan::Image& image) {
   VkImageView image_view;
 
   VkImageViewCreateInfo image_view_info{};
   image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-  image_view_info.image = image;
+  image_view_info.image = image.image_;
   image_view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-  image_view_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+  image_view_info.format = image.GetFormat();
   image_view_info.subresourceRange.layerCount = 1;
-  image_view_info.subresourceRange.levelCount = 1;
+  image_view_info.subresourceRange.levelCount = image.GetMipLevels();
   image_view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 
   VK_CHECK(vkCreateImageView(device_, &image_view_info, nullptr, &image_view));
   return image_view;
 }
-
-VkCommandBuffer RenderSystem::BeginCommands() {
-  VkCommandBuffer command_buffer;
-  VkCommandBufferAllocateInfo buffer_info{};
-  buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  buffer_info.commandBufferCount = 1;
-  buffer_info.commandPool = command_pool_;
-  buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-
-  VK_CHECK(vkAllocateCommandBuffers(device_, &buffer_info, &command_buffer));
-
-  VkCommandBufferBeginInfo begin_info{};
-  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-  vkBeginCommandBuffer(command_buffer, &begin_info);
-  return command_buffer;
-}
-
-void RenderSystem::EndCommands(VkCommandBuffer command_buffer) {
-  vkEndCommandBuffer(command_buffer);
-
-  VkSubmitInfo submit_info{};
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &command_buffer;
-
-  VK_CHECK(vkQueueSubmit(queue_, 1, &submit_info, VK_NULL_HANDLE));
-  VK_CHECK(vkQueueWaitIdle(queue_));
-  vkFreeCommandBuffers(device_, command_pool_, 1, &command_buffer);
-}
-
-void RenderSystem::CopyBufferToImage(vulkan::Buffer& buffer,
-                                     vulkan::Image* image,
-                                     uint32_t width,
-                                     uint32_t height) {
-  VkCommandBuffer command_buffer = BeginCommands();
-  VkBufferImageCopy copy_info{};
-  copy_info.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  copy_info.imageSubresource.layerCount = 1;
-  copy_info.imageExtent.width = width;
-  copy_info.imageExtent.height = height;
-  copy_info.imageExtent.depth = 1;
-  vkCmdCopyBufferToImage(command_buffer, buffer.buffer_, image->image_,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_info);
-  EndCommands(command_buffer);
-}
-
-void RenderSystem::ChangeImageLayout(VkImage image,
-                                     VkImageLayout src_layout,
-                                     VkImageLayout dst_layout) {
-  VkCommandBuffer command_buffer = BeginCommands();
-  VkImageMemoryBarrier barrier{};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = image;
-  barrier.newLayout = dst_layout;
-  barrier.oldLayout = src_layout;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.levelCount = 1;
-  barrier.subresourceRange.layerCount = 1;
-
-  VkPipelineStageFlags src_stage;
-  VkPipelineStageFlags dst_stage;
-
-  if (src_layout == VK_IMAGE_LAYOUT_UNDEFINED &&
-      dst_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  } else if (src_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-             dst_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-  } else {
-    assert(false);
-  }
-
-  vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, nullptr, 0,
-                       nullptr, 1, &barrier);
-  EndCommands(command_buffer);
-}
 }  // namespace render
\ No newline at end of file
@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DEMO_TANGENTS_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DEMO_TANGENTS_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DEMO_TANGENTS_NEON
+#endif
+
+#include "render/TangentGenerator.hpp"
+
+namespace render {
+namespace {
+// Fewest triangles or vertices worth handing to a thread of their own.
+const size_t kMinBatchSize = 1 << 16;
+
+// Keeps divisions by lengths of degenerate vectors finite, which turns
+// their contributions into zeros.
+const float kTiny = 1e-30f;
+
+// A register's worth of floats, with the few operations the kernels need.
+// LoadColumns reads 4 floats at each of kWidth addresses and transposes them
+// so that columns[i] holds the ith float of every address, which turns
+// interleaved attributes into SoA registers without going through memory.
+#if defined(DEMO_TANGENTS_AVX2)
+struct Floats {
+  static constexpr size_t kWidth = 8;
+  __m256 v;
+
+  static Floats Load(const float* p) { return {_mm256_loadu_ps(p)}; }
+  static Floats Broadcast(float f) { return {_mm256_set1_ps(f)}; }
+  static void LoadColumns(const float* const* rows, Floats* columns) {
+    // Rows i and i + 4 share a register, transposed as two 4x4 blocks.
+    __m256 r[4];
+    for (int i = 0; i < 4; ++i) {
+      r[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(rows[i])),
+                                  _mm_loadu_ps(rows[i + 4]), 1);
+    }
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t2 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    columns[0] = {_mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0))};
+    columns[1] = {_mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2))};
+    columns[2] = {_mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0))};
+    columns[3] = {_mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2))};
+  }
+  void Store(float* p) const { _mm256_storeu_ps(p, v); }
+  Floats operator+(Floats b) const { return {_mm256_add_ps(v, b.v)}; }
+  Floats operator-(Floats b) const { return {_mm256_sub_ps(v, b.v)}; }
+  Floats operator*(Floats b) const { return {_mm256_mul_ps(v, b.v)}; }
+  Floats operator/(Floats b) const { return {_mm256_div_ps(v, b.v)}; }
+  friend Floats Max(Floats a, Floats b) { return {_mm256_max_ps(a.v, b.v)}; }
+  friend Floats Sqrt(Floats a) { return {_mm256_sqrt_ps(a.v)}; }
+};
+#elif defined(DEMO_TANGENTS_SSE2)
+struct Floats {
+  static constexpr size_t kWidth = 4;
+  __m128 v;
+
+  static Floats Load(const float* p) { return {_mm_loadu_ps(p)}; }
+  static Floats Broadcast(float f) { return {_mm_set1_ps(f)}; }
+  static void LoadColumns(const float* const* rows, Floats* columns) {
+    __m128 r0 = _mm_loadu_ps(rows[0]);
+    __m128 r1 = _mm_loadu_ps(rows[1]);
+    __m128 r2 = _mm_loadu_ps(rows[2]);
+    __m128 r3 = _mm_loadu_ps(rows[3]);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    columns[0] = {r0};
+    columns[1] = {r1};
+    columns[2] = {r2};
+    columns[3] = {r3};
+  }
+  void Store(float* p) const { _mm_storeu_ps(p, v); }
+  Floats operator+(Floats b) const { return {_mm_add_ps(v, b.v)}; }
+  Floats operator-(Floats b) const { return {_mm_sub_ps(v, b.v)}; }
+  Floats operator*(Floats b) const { return {_mm_mul_ps(v, b.v)}; }
+  Floats operator/(Floats b) const { return {_mm_div_ps(v, b.v)}; }
+  friend Floats Max(Floats a, Floats b) { return {_mm_max_ps(a.v, b.v)}; }
+  friend Floats Sqrt(Floats a) { return {_mm_sqrt_ps(a.v)}; }
+};
+#elif defined(DEMO_TANGENTS_NEON)
+struct Floats {
+  static constexpr size_t kWidth = 4;
+  float32x4_t v;
+
+  static Floats Load(const float* p) { return {vld1q_f32(p)}; }
+  static Floats Broadcast(float f) { return {vdupq_n_f32(f)}; }
+  static void LoadColumns(const float* const* rows, Floats* columns) {
+    float32x4x2_t r01 = vtrnq_f32(vld1q_f32(rows[0]), vld1q_f32(rows[1]));
+    float32x4x2_t r23 = vtrnq_f32(vld1q_f32(rows[2]), vld1q_f32(rows[3]));
+    columns[0] = {vcombine_f32(vget_low_f32(r01.val[0]),
+                               vget_low_f32(r23.val[0]))};
+    columns[1] = {vcombine_f32(vget_low_f32(r01.val[1]),
+                               vget_low_f32(r23.val[1]))};
+    columns[2] = {vcombine_f32(vget_high_f32(r01.val[0]),
+                               vget_high_f32(r23.val[0]))};
+    columns[3] = {vcombine_f32(vget_high_f32(r01.val[1]),
+                               vget_high_f32(r23.val[1]))};
+  }
+  void Store(float* p) const { vst1q_f32(p, v); }
+  Floats operator+(Floats b) const { return {vaddq_f32(v, b.v)}; }
+  Floats operator-(Floats b) const { return {vsubq_f32(v, b.v)}; }
+  Floats operator*(Floats b) const { return {vmulq_f32(v, b.v)}; }
+  // ARMv7 lacks vdivq_f32 and vsqrtq_f32, so these go through lanes.
+  Floats operator/(Floats b) const {
+    float lhs[4], rhs[4];
+    vst1q_f32(lhs, v);
+    vst1q_f32(rhs, b.v);
+    for (int i = 0; i < 4; ++i) {
+      lhs[i] /= rhs[i];
+    }
+    return {vld1q_f32(lhs)};
+  }
+  friend Floats Max(Floats a, Floats b) { return {vmaxq_f32(a.v, b.v)}; }
+  friend Floats Sqrt(Floats a) {
+    float lanes[4];
+    vst1q_f32(lanes, a.v);
+    for (float& lane : lanes) {
+      lane = std::sqrt(lane);
+    }
+    return {vld1q_f32(lanes)};
+  }
+};
+#else
+struct Floats {
+  static constexpr size_t kWidth = 4;
+  float v[4];
+
+  static Floats Load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+  static Floats Broadcast(float f) { return {{f, f, f, f}}; }
+  static void LoadColumns(const float* const* rows, Floats* columns) {
+    for (int i = 0; i < 4; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        columns[j].v[i] = rows[i][j];
+      }
+    }
+  }
+  void Store(float* p) const { std::copy(v, v + 4, p); }
+  template <typename Op>
+  Floats Apply(Floats b, Op op) const {
+    return {{op(v[0], b.v[0]), op(v[1], b.v[1]), op(v[2], b.v[2]),
+             op(v[3], b.v[3])}};
+  }
+  Floats operator+(Floats b) const { return Apply(b, std::plus<float>()); }
+  Floats operator-(Floats b) const { return Apply(b, std::minus<float>()); }
+  Floats operator*(Floats b) const {
+    return Apply(b, std::multiplies<float>());
+  }
+  Floats operator/(Floats b) const { return Apply(b, std::divides<float>()); }
+  friend Floats Max(Floats a, Floats b) {
+    return a.Apply(b, [](float x, float y) { return std::max(x, y); });
+  }
+  friend Floats Sqrt(Floats a) {
+    return a.Apply(a, [](float x, float) { return std::sqrt(x); });
+  }
+};
+#endif
+
+// Addresses of the vectors loaded into each lane.
+using Rows = const float* [Floats::kWidth];
+
+// Lanes of one vector component each, for scalar code to pick from.
+using Lanes = float[3][Floats::kWidth];
+
+struct Vector3 {
+  Floats x, y, z;
+
+  static Vector3 Load(const Rows& rows) {
+    Floats columns[4];
+    Floats::LoadColumns(rows, columns);
+    return {columns[0], columns[1], columns[2]};
+  }
+  static Vector3 Load(const std::vector<float>* streams, size_t offset) {
+    return {Floats::Load(&streams[0][offset]),
+            Floats::Load(&streams[1][offset]),
+            Floats::Load(&streams[2][offset])};
+  }
+  void Store(Lanes& lanes) const {
+    x.Store(lanes[0]);
+    y.Store(lanes[1]);
+    z.Store(lanes[2]);
+  }
+  void Store(std::vector<float>* streams, size_t offset) const {
+    x.Store(&streams[0][offset]);
+    y.Store(&streams[1][offset]);
+    z.Store(&streams[2][offset]);
+  }
+  Vector3 operator-(const Vector3& b) const {
+    return {x - b.x, y - b.y, z - b.z};
+  }
+  Vector3 operator*(Floats s) const { return {x * s, y * s, z * s}; }
+};
+
+Floats Dot(const Vector3& a, const Vector3& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+Vector3 Cross(const Vector3& a, const Vector3& b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+
+Floats Length(const Vector3& a) {
+  return Sqrt(Dot(a, a));
+}
+
+// Sums of the weighted tangents and bitangents of the triangles using a
+// vertex. Kept together so that scattering a corner touches one cache line.
+struct Accumulator {
+  glm::vec3 tangent;
+  glm::vec3 bitangent;
+};
+
+// LoadColumns reads 4 floats from both of these.
+static_assert(offsetof(Vertex, normal) == offsetof(Vertex, position) + 12 &&
+                  offsetof(Vertex, uv) + 16 <= sizeof(Vertex),
+              "Vertex layout doesn't allow loading attributes as 4 floats");
+
+// Splits [0, count) into one range per hardware thread, if large enough.
+// Ranges start on a register boundary, so that threads never store to the
+// same register's worth of a stream.
+void ParallelFor(size_t count,
+                 const std::function<void(size_t, size_t)>& process) {
+  size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+  size_t batch_count = std::max<size_t>(
+      1, std::min(thread_count, count / kMinBatchSize));
+  auto get_boundary = [&](size_t batch) {
+    return batch == batch_count ? count
+                                : count * batch / batch_count /
+                                      Floats::kWidth * Floats::kWidth;
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < batch_count; ++i) {
+    threads.emplace_back(process, get_boundary(i), get_boundary(i + 1));
+  }
+  process(0, get_boundary(1));
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Tangents and bitangents of the triangles in [begin, end), scaled by the
+// triangle areas, as streams of components. Their directions are the uv
+// gradients, which the sign of the uv determinant orients so that mirrored
+// triangles don't cancel out.
+void ComputeFaceVectors(Span<const uint32_t> indices,
+                        Span<const Vertex> vertices,
+                        size_t begin,
+                        size_t end,
+                        std::vector<float>* face_tangents,
+                        std::vector<float>* face_bitangents) {
+  const Floats tiny = Floats::Broadcast(kTiny);
+  const Floats zero = Floats::Broadcast(0.0f);
+  Rows positions[3], uvs[3];
+
+  for (size_t first = begin; first < end; first += Floats::kWidth) {
+    for (size_t lane = 0; lane < Floats::kWidth; ++lane) {
+      // Lanes past the end repeat the last triangle, and are discarded.
+      size_t triangle = std::min(first + lane, end - 1);
+      for (size_t corner = 0; corner < 3; ++corner) {
+        const Vertex& vertex = vertices[indices[triangle * 3 + corner]];
+        positions[corner][lane] = &vertex.position.x;
+        uvs[corner][lane] = &vertex.uv.x;
+      }
+    }
+    Vector3 p0 = Vector3::Load(positions[0]);
+    Vector3 dp1 = Vector3::Load(positions[1]) - p0;
+    Vector3 dp2 = Vector3::Load(positions[2]) - p0;
+    // x and y are u and v.
+    Vector3 uv0 = Vector3::Load(uvs[0]);
+    Vector3 uv1 = Vector3::Load(uvs[1]);
+    Vector3 uv2 = Vector3::Load(uvs[2]);
+    Floats du1 = uv1.x - uv0.x;
+    Floats dv1 = uv1.y - uv0.y;
+    Floats du2 = uv2.x - uv0.x;
+    Floats dv2 = uv2.y - uv0.y;
+
+    Vector3 tangent = dp1 * dv2 - dp2 * dv1;
+    Vector3 bitangent = dp2 * du1 - dp1 * du2;
+    // -1, 1, or 0 for triangles without a uv gradient.
+    Floats determinant = du1 * dv2 - du2 * dv1;
+    Floats sign = determinant / Max(Max(determinant, zero - determinant), tiny);
+    Floats area = Length(Cross(dp1, dp2)) * sign;
+    tangent = tangent * (area / Max(Length(tangent), tiny));
+    bitangent = bitangent * (area / Max(Length(bitangent), tiny));
+    tangent.Store(face_tangents, first);
+    bitangent.Store(face_bitangents, first);
+  }
+}
+
+// Any unit vector orthogonal to `normal`.
+glm::vec3 GetOrthogonal(const glm::vec3& normal) {
+  glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                              : glm::vec3(0.0f, 1.0f, 0.0f);
+  glm::vec3 tangent = glm::cross(normal, axis);
+  float length = glm::length(tangent);
+  return length > 0.0f ? tangent / length : axis;
+}
+
+// Gram-Schmidt of the accumulated tangents of the vertices in [begin, end)
+// against their normals, which OBJ files don't always normalize, and
+// handedness from the side of the accumulated bitangents.
+void OrthonormalizeTangents(Span<const Accumulator> accumulators,
+                            Span<Vertex> vertices,
+                            size_t begin,
+                            size_t end) {
+  const Floats tiny = Floats::Broadcast(kTiny);
+  Rows normals, tangents, bitangents;
+  Lanes axes;
+  float handedness[Floats::kWidth];
+
+  for (size_t first = begin; first < end; first += Floats::kWidth) {
+    const size_t count = std::min(Floats::kWidth, end - first);
+    for (size_t lane = 0; lane < Floats::kWidth; ++lane) {
+      size_t vertex = first + std::min(lane, count - 1);
+      normals[lane] = &vertices[vertex].normal.x;
+      tangents[lane] = &accumulators[vertex].tangent.x;
+      bitangents[lane] = &accumulators[vertex].bitangent.x;
+    }
+    Vector3 normal = Vector3::Load(normals);
+    normal = normal * (Floats::Broadcast(1.0f) / Max(Length(normal), tiny));
+    Vector3 tangent = Vector3::Load(tangents);
+    tangent = tangent - normal * Dot(normal, tangent);
+    // Degenerate tangents end up null.
+    tangent = tangent * (Floats::Broadcast(1.0f) / Max(Length(tangent), tiny));
+    tangent.Store(axes);
+    Dot(Cross(normal, tangent), Vector3::Load(bitangents))
+        .Store(handedness);
+
+    for (size_t lane = 0; lane < count; ++lane) {
+      Vertex& vertex = vertices[first + lane];
+      glm::vec3 axis(axes[0][lane], axes[1][lane], axes[2][lane]);
+      if (glm::dot(axis, axis) < 0.5f) {
+        axis = GetOrthogonal(glm::normalize(vertex.normal));
+      }
+      vertex.tangent =
+          glm::vec4(axis, handedness[lane] < 0.0f ? -1.0f : 1.0f);
+    }
+  }
+}
+}  // namespace
+
+void GenerateTangents(Span<const uint32_t> indices, Span<Vertex> vertices) {
+  const size_t triangle_count = indices.size() / 3;
+  // Streams are padded to a whole number of registers.
+  const size_t padded_count =
+      (triangle_count + Floats::kWidth - 1) / Floats::kWidth * Floats::kWidth;
+
+  std::vector<float> face_tangents[3];
+  std::vector<float> face_bitangents[3];
+  for (size_t i = 0; i < 3; ++i) {
+    face_tangents[i].resize(padded_count);
+    face_bitangents[i].resize(padded_count);
+  }
+  ParallelFor(triangle_count, [&](size_t begin, size_t end) {
+    ComputeFaceVectors(indices, vertices, begin, end, face_tangents,
+                       face_bitangents);
+  });
+
+  // Scattering to the corners is bound by memory accesses, and threads would
+  // contend over the vertices they share.
+  // With a spare one for LoadColumns to read past the last bitangent.
+  std::vector<Accumulator> accumulators(vertices.size() + 1,
+                                        {glm::vec3(0.0f), glm::vec3(0.0f)});
+  for (size_t triangle = 0; triangle < triangle_count; ++triangle) {
+    glm::vec3 tangent(face_tangents[0][triangle], face_tangents[1][triangle],
+                      face_tangents[2][triangle]);
+    glm::vec3 bitangent(face_bitangents[0][triangle],
+                        face_bitangents[1][triangle],
+                        face_bitangents[2][triangle]);
+    for (size_t corner = 0; corner < 3; ++corner) {
+      Accumulator& accumulator = accumulators[indices[triangle * 3 + corner]];
+      accumulator.tangent += tangent;
+      accumulator.bitangent += bitangent;
+    }
+  }
+
+  ParallelFor(vertices.size(), [&](size_t begin, size_t end) {
+    OrthonormalizeTangents(accumulators, vertices, begin, end);
+  });
+}
+}  // namespace render
@@ -0,0 +1,103 @@
+#include "render/TextureCache.hpp"
+
+#include <utility>
+
+namespace render {
+bool TextureCache::AddReference(ResourceId id) {
+  size_t& reference_count = reference_counts_[id];
+  if (reference_count++ > 0) {
+    ++stats_.hits;
+    return false;
+  }
+  return true;
+}
+
+bool TextureCache::RemoveReference(ResourceId id, Texture& texture) {
+  auto reference_it = reference_counts_.find(id);
+  assert(reference_it != reference_counts_.end());
+  if (--reference_it->second > 0) {
+    return false;
+  }
+  reference_counts_.erase(reference_it);
+
+  // Textures still loading are dropped when they arrive unreferenced.
+  auto hash_it = content_hashes_.find(id);
+  if (hash_it == content_hashes_.end()) {
+    return false;
+  }
+  auto entry_it = entries_.find(hash_it->second);
+  content_hashes_.erase(hash_it);
+  if (--entry_it->second.alias_count > 0) {
+    return false;
+  }
+  texture = std::move(entry_it->second.texture);
+  entries_.erase(entry_it);
+  return true;
+}
+
+bool TextureCache::IsReferenced(ResourceId id) const {
+  return reference_counts_.count(id) != 0;
+}
+
+bool TextureCache::Contains(ResourceId id) const {
+  return content_hashes_.count(id) != 0;
+}
+
+const Texture& TextureCache::Get(ResourceId id) const {
+  return entries_.at(content_hashes_.at(id)).texture;
+}
+
+bool TextureCache::AddAlias(ResourceId id, uint64_t content_hash) {
+  auto entry_it = entries_.find(content_hash);
+  if (entry_it == entries_.end()) {
+    return false;
+  }
+  assert(!Contains(id));
+  ++entry_it->second.alias_count;
+  content_hashes_[id] = content_hash;
+  ++stats_.content_hits;
+  stats_.bytes_saved += entry_it->second.size;
+  return true;
+}
+
+void TextureCache::Insert(ResourceId id,
+                          uint64_t content_hash,
+                          VkDeviceSize size,
+                          Texture texture) {
+  assert(!Contains(id) && entries_.count(content_hash) == 0);
+  entries_[content_hash] = Entry{std::move(texture), size, 1};
+  content_hashes_[id] = content_hash;
+  ++stats_.misses;
+}
+
+std::vector<uint64_t> TextureCache::GetResidentContents() const {
+  std::vector<uint64_t> content_hashes;
+  content_hashes.reserve(entries_.size());
+  for (const auto& entry : entries_) {
+    content_hashes.push_back(entry.first);
+  }
+  return content_hashes;
+}
+
+const Texture* TextureCache::FindContent(uint64_t content_hash) const {
+  auto entry_it = entries_.find(content_hash);
+  return entry_it != entries_.end() ? &entry_it->second.texture : nullptr;
+}
+
+Texture TextureCache::Replace(uint64_t content_hash, Texture texture) {
+  std::swap(entries_.at(content_hash).texture, texture);
+  return texture;
+}
+
+std::vector<Texture> TextureCache::Clear() {
+  std::vector<Texture> textures;
+  textures.reserve(entries_.size());
+  for (auto& entry : entries_) {
+    textures.push_back(std::move(entry.second.texture));
+  }
+  entries_.clear();
+  content_hashes_.clear();
+  reference_counts_.clear();
+  return textures;
+}
+}  // namespace render
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <iostream>
+
+#include "render/vulkan/Allocator.hpp"
+#include "render/vulkan/Memory.hpp"
+
+namespace render {
+namespace vulkan {
+Allocator::Allocator(VkPhysicalDevice physical_device,
+                     VkDevice device,
+                     VkDeviceSize block_size)
+    : physical_device_(physical_device),
+      device_(device),
+      block_size_(block_size) {
+  vkGetPhysicalDeviceMemoryProperties(physical_device_, &memory_properties_);
+}
+
+Allocator::~Allocator() {
+  for (const auto& block : blocks_) {
+    if (block->mapped != nullptr) {
+      vkUnmapMemory(device_, block->memory);
+    }
+    vkFreeMemory(device_, block->memory, nullptr);
+  }
+}
+
+VkDeviceSize Allocator::GetBlockSize(uint32_t memory_type) const {
+  // Don't let a single block hog a small heap (e.g. the 256 MiB
+  // host-visible device-local window found on most discrete GPUs).
+  uint32_t heap_index = memory_properties_.memoryTypes[memory_type].heapIndex;
+  VkDeviceSize heap_size = memory_properties_.memoryHeaps[heap_index].size;
+  return std::min(block_size_, heap_size / 8);
+}
+
+MemoryBlock* Allocator::CreateBlock(uint32_t memory_type,
+                                    ResourceKind kind,
+                                    VkDeviceSize size,
+                                    bool dedicated) {
+  VkDeviceMemory memory;
+  AllocateVulkanMemory(device_, size, memory_type, &memory);
+
+  uint8_t* mapped = nullptr;
+  if (memory_properties_.memoryTypes[memory_type].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    void* data;
+    VK_CHECK(vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, &data));
+    mapped = reinterpret_cast<uint8_t*>(data);
+  }
+
+  blocks_.push_back(std::make_unique<MemoryBlock>(MemoryBlock{
+      memory, memory_type, kind, dedicated, false, mapped,
+      RangeAllocator(size)}));
+  return blocks_.back().get();
+}
+
+void Allocator::DestroyBlock(MemoryBlock* block) {
+  if (block->mapped != nullptr) {
+    vkUnmapMemory(device_, block->memory);
+  }
+  vkFreeMemory(device_, block->memory, nullptr);
+  auto it = std::find_if(
+      blocks_.begin(), blocks_.end(),
+      [block](const auto& candidate) { return candidate.get() == block; });
+  blocks_.erase(it);
+}
+
+Allocation Allocator::Allocate(const VkMemoryRequirements& requirements,
+                               VkMemoryPropertyFlags properties,
+                               ResourceKind kind,
+                               bool create_block) {
+  uint32_t memory_type = FindMemoryType(
+      memory_properties_, requirements.memoryTypeBits, properties);
+  VkDeviceSize block_size = GetBlockSize(memory_type);
+
+  MemoryBlock* block = nullptr;
+  std::optional<RangeAllocator::Range> range;
+  if (requirements.size > block_size / 2) {
+    if (!create_block) {
+      return Allocation{};
+    }
+    // Large resources get a block of their own rather than wasting most of
+    // a shared one.
+    block = CreateBlock(memory_type, kind, requirements.size, true);
+    range = block->ranges.Allocate(requirements.size, 1);
+  } else {
+    for (const auto& candidate : blocks_) {
+      if (candidate->memory_type != memory_type || candidate->kind != kind ||
+          candidate->dedicated || candidate->draining ||
+          (!create_block && candidate->ranges.IsEmpty())) {
+        continue;
+      }
+      range = candidate->ranges.Allocate(requirements.size,
+                                         requirements.alignment);
+      if (range.has_value()) {
+        block = candidate.get();
+        break;
+      }
+    }
+    if (block == nullptr) {
+      if (!create_block) {
+        return Allocation{};
+      }
+      block = CreateBlock(memory_type, kind, block_size, false);
+      range =
+          block->ranges.Allocate(requirements.size, requirements.alignment);
+    }
+  }
+  assert(range.has_value());
+
+  Allocation allocation;
+  allocation.memory = block->memory;
+  allocation.offset = range->offset;
+  allocation.size = range->size;
+  allocation.mapped =
+      block->mapped != nullptr ? block->mapped + range->offset : nullptr;
+  allocation.block = block;
+  allocation.range = range.value();
+  return allocation;
+}
+
+void Allocator::Free(const Allocation& allocation) {
+  MemoryBlock* block = allocation.block;
+  if (block == nullptr) {
+    return;
+  }
+  block->ranges.Free(allocation.range);
+  if (!block->ranges.IsEmpty()) {
+    return;
+  }
+  block->draining = false;
+
+  // Keep one empty shared block per memory type and resource kind around so
+  // that load/unload cycles don't bounce off vkAllocateMemory.
+  bool keep = !block->dedicated &&
+              std::none_of(blocks_.begin(), blocks_.end(),
+                           [block](const auto& other) {
+                             return other.get() != block &&
+                                    !other->dedicated &&
+                                    other->memory_type == block->memory_type &&
+                                    other->kind == block->kind &&
+                                    other->ranges.IsEmpty();
+                           });
+  if (!keep) {
+    DestroyBlock(block);
+  }
+}
+
+bool Allocator::BeginDefragmentation(ResourceKind kind) {
+  MemoryBlock* selected = nullptr;
+  VkDeviceSize selected_used = 0;
+  for (const auto& block : blocks_) {
+    if (block->kind != kind || block->dedicated || block->ranges.IsEmpty()) {
+      continue;
+    }
+    RangeAllocator::Stats stats = block->ranges.GetStats();
+    if (stats.used > stats.size / 2 ||
+        (selected != nullptr && stats.used >= selected_used)) {
+      continue;
+    }
+    // Moving into the empty block kept around would only swap the two, and
+    // holes in the others may be too small for some of the resources: ask
+    // them for twice the room so that draining rarely gets stuck halfway.
+    VkDeviceSize room = 0;
+    for (const auto& other : blocks_) {
+      if (other != block && !other->dedicated && !other->ranges.IsEmpty() &&
+          other->memory_type == block->memory_type && other->kind == kind) {
+        room += other->ranges.GetSize() - other->ranges.GetStats().used;
+      }
+    }
+    if (room >= 2 * stats.used) {
+      selected = block.get();
+      selected_used = stats.used;
+    }
+  }
+  if (selected == nullptr) {
+    return false;
+  }
+  selected->draining = true;
+  return true;
+}
+
+void Allocator::EndDefragmentation() {
+  for (const auto& block : blocks_) {
+    block->draining = false;
+  }
+}
+
+Allocator::Stats Allocator::GetStats() const {
+  Stats stats{blocks_.size(), 0, 0, 0, 0, 0.0f};
+  VkDeviceSize free = 0;
+  VkDeviceSize largest_free_sum = 0;
+  for (const auto& block : blocks_) {
+    RangeAllocator::Stats block_stats = block->ranges.GetStats();
+    stats.allocation_count += block_stats.allocation_count;
+    stats.reserved += block_stats.size;
+    stats.used += block_stats.used;
+    stats.largest_free_range =
+        std::max(stats.largest_free_range, block_stats.largest_free_range);
+    free += block_stats.size - block_stats.used;
+    largest_free_sum += block_stats.largest_free_range;
+  }
+  if (free > 0) {
+    stats.fragmentation = 1.0f - static_cast<float>(largest_free_sum) /
+                                     static_cast<float>(free);
+  }
+  return stats;
+}
+
+void Allocator::PrintStats() const {
+  Stats stats = GetStats();
+  std::cout << "Device memory:\n";
+  std::cout << "\tblocks: " << stats.block_count << '\n';
+  std::cout << "\tallocations: " << stats.allocation_count << '\n';
+  std::cout << "\treserved: " << stats.reserved << " bytes\n";
+  std::cout << "\tused: " << stats.used << " bytes\n";
+  std::cout << "\toccupancy: "
+            << (stats.reserved > 0 ? 100.0f * static_cast<float>(stats.used) /
+                                         static_cast<float>(stats.reserved)
+                                   : 0.0f)
+            << "%\n";
+  std::cout << "\tlargest free range: " << stats.largest_free_range
+            << " bytes\n";
+  std::cout << "\tfragmentation: " << 100.0f * stats.fragmentation << "%\n";
+}
+}  // namespace vulkan
+}  // namespace render
@@ -2,16 +2,16 @@
 
 #include "base.hpp"
 #include "render/vulkan/Buffer.hpp"
-#include "render/vulkan/Memory.hpp"
 
 namespace render {
 namespace vulkan {
-Buffer::Buffer(VkPhysicalDevice physical_device,
-               VkDevice device,
+Buffer::Buffer(Allocator& allocator,
                VkBufferUsageFlags usage,
                VkMemoryPropertyFlags properties,
                VkDeviceSize size)
-    : size_(size), device_(device) {
+    : size_(size), allocator_(allocator) {
+  VkDevice device = allocator_.GetDevice();
+
   // Create vertex buffer:
 
   VkBufferCreateInfo info{};
@@ -22,24 +22,21 @@ Buffer::Buffer(VkPhysicalDevice physical_device,
 
   VK_CHECK(vkCreateBuffer(device, &info, nullptr, &buffer_));
 
-  // Allocate memory for buffer:
+  // Sub-allocate memory for buffer:
 
   VkMemoryRequirements memory_requirements;
   vkGetBufferMemoryRequirements(device, buffer_, &memory_requirements);
-  AllocateVulkanMemory(memory_requirements, physical_device, device, &memory_,
-                       properties);
+  allocation_ = allocator_.Allocate(memory_requirements, properties,
+                                    ResourceKind::kLinear);
 
   // Bind memory to buffer:
-  VK_CHECK(vkBindBufferMemory(device, buffer_, memory_, 0));
+  VK_CHECK(vkBindBufferMemory(device, buffer_, allocation_.memory,
+                              allocation_.offset));
 }
 
 Buffer::~Buffer() {
-  vkFreeMemory(device_, memory_, nullptr);
-  vkDestroyBuffer(device_, buffer_, nullptr);
-}
-
-void Buffer::Unmap() {
-  vkUnmapMemory(device_, memory_);
+  vkDestroyBuffer(allocator_.GetDevice(), buffer_, nullptr);
+  allocator_.Free(allocation_);
 }
 }  // namespace vulkan
 }  // namespace render
@@ -21,10 +21,62 @@ VkDescriptorPool DescriptorPoolCache::GetPool(
   return descriptor_pool;
 }
 
+VkDescriptorSet DescriptorPoolCache::AllocateFreeable(
+    VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorPoolSize>& set_sizes) {
+  // Sets all being alike, a pool has room as long as it has fewer than
+  // kFreeableSetsPerPool of them. Pools are never destroyed before the
+  // cache, the next allocations reuse the room sets freed.
+  size_t pool_index = 0;
+  while (pool_index < freeable_pools_.size() &&
+         freeable_pools_[pool_index].set_count == kFreeableSetsPerPool) {
+    ++pool_index;
+  }
+  if (pool_index == freeable_pools_.size()) {
+    std::vector<VkDescriptorPoolSize> sizes = set_sizes;
+    for (VkDescriptorPoolSize& size : sizes) {
+      size.descriptorCount *= kFreeableSetsPerPool;
+    }
+    VkDescriptorPoolCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    info.maxSets = kFreeableSetsPerPool;
+    info.poolSizeCount = static_cast<uint32_t>(sizes.size());
+    info.pPoolSizes = sizes.data();
+    FreeablePool pool{VK_NULL_HANDLE, 0};
+    VK_CHECK(vkCreateDescriptorPool(device_, &info, nullptr, &pool.pool));
+    freeable_pools_.push_back(pool);
+  }
+
+  FreeablePool& pool = freeable_pools_[pool_index];
+  VkDescriptorSetAllocateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  info.descriptorPool = pool.pool;
+  info.descriptorSetCount = 1;
+  info.pSetLayouts = &layout;
+  VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+  VK_CHECK(vkAllocateDescriptorSets(device_, &info, &descriptor_set));
+  ++pool.set_count;
+  freeable_sets_[descriptor_set] = pool_index;
+  return descriptor_set;
+}
+
+void DescriptorPoolCache::Free(VkDescriptorSet descriptor_set) {
+  auto it = freeable_sets_.find(descriptor_set);
+  assert(it != freeable_sets_.end());
+  FreeablePool& pool = freeable_pools_[it->second];
+  VK_CHECK(vkFreeDescriptorSets(device_, pool.pool, 1, &descriptor_set));
+  --pool.set_count;
+  freeable_sets_.erase(it);
+}
+
 DescriptorPoolCache::~DescriptorPoolCache() {
   for (auto pool : pools_) {
     vkDestroyDescriptorPool(device_, pool, nullptr);
   }
+  for (const FreeablePool& pool : freeable_pools_) {
+    vkDestroyDescriptorPool(device_, pool.pool, nullptr);
+  }
 }
 }  // namespace vulkan
 }  // namespace render
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#include "render/vulkan/Format.hpp"
+
+namespace render {
+namespace vulkan {
+bool GetFormatInfo(VkFormat format, FormatInfo& info) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      info = FormatInfo{1, 1, 4, false};
+      return true;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+      info = FormatInfo{4, 4, 8, true};
+      return true;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+      info = FormatInfo{4, 4, 16, true};
+      return true;
+    default:
+      return false;
+  }
+}
+
+const char* GetFormatName(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+      return "R8G8B8A8_UNORM";
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      return "R8G8B8A8_SRGB";
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+      return "BC1_RGB_UNORM";
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      return "BC1_RGB_SRGB";
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+      return "BC1_RGBA_UNORM";
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      return "BC1_RGBA_SRGB";
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+      return "BC3_UNORM";
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      return "BC3_SRGB";
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+      return "BC5_UNORM";
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+      return "BC7_UNORM";
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return "BC7_SRGB";
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+      return "ETC2_R8G8B8_UNORM";
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+      return "ETC2_R8G8B8_SRGB";
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+      return "ETC2_R8G8B8A8_UNORM";
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+      return "ETC2_R8G8B8A8_SRGB";
+    default:
+      return "unknown";
+  }
+}
+
+uint32_t GetMipSize(uint32_t size, uint32_t level) {
+  return std::max(size >> level, 1u);
+}
+
+VkDeviceSize GetLevelSize(const FormatInfo& info,
+                          uint32_t width,
+                          uint32_t height,
+                          uint32_t level) {
+  VkDeviceSize blocks_x =
+      (GetMipSize(width, level) + info.block_width - 1) / info.block_width;
+  VkDeviceSize blocks_y =
+      (GetMipSize(height, level) + info.block_height - 1) / info.block_height;
+  return blocks_x * blocks_y * info.block_size;
+}
+
+VkDeviceSize GetMipChainSize(const FormatInfo& info,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t level_count) {
+  VkDeviceSize size = 0;
+  for (uint32_t level = 0; level < level_count; ++level) {
+    size += GetLevelSize(info, width, height, level);
+  }
+  return size;
+}
+}  // namespace vulkan
+}  // namespace render
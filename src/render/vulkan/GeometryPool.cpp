@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+#include "render/vulkan/GeometryPool.hpp"
+
+namespace render {
+namespace vulkan {
+GeometryPool::GeometryPool(Allocator& allocator,
+                           UploadContext& upload_context,
+                           VkDeviceSize size)
+    : allocator_(allocator),
+      upload_context_(upload_context),
+      buffer_(std::make_unique<Buffer>(allocator,
+                                       kUsage,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       size)),
+      ranges_(size) {
+  assert(size > 0);
+}
+
+bool GeometryPool::TryAllocate(Slot& slot) {
+  // Vertex ranges are padded so that they can start on a multiple of the
+  // vertex size, which needn't be a power of two.
+  auto vertex_range = ranges_.Allocate(
+      slot.vertex_bytes + slot.vertex_size - 1, kVertexAlignment);
+  if (!vertex_range.has_value()) {
+    return false;
+  }
+  auto index_range = ranges_.Allocate(slot.index_bytes, slot.index_size);
+  if (!index_range.has_value()) {
+    ranges_.Free(vertex_range.value());
+    return false;
+  }
+  slot.vertex_range = vertex_range.value();
+  slot.index_range = index_range.value();
+  slot.vertex_base = (slot.vertex_range.offset + slot.vertex_size - 1) /
+                     slot.vertex_size * slot.vertex_size;
+  return true;
+}
+
+bool GeometryPool::Allocate(size_t vertex_count,
+                            size_t vertex_size,
+                            size_t index_count,
+                            size_t index_size,
+                            Allocation& allocation) {
+  assert(vertex_size > 0);
+  assert(index_size != 0 && (index_size & (index_size - 1)) == 0);
+  Slot slot{};
+  slot.vertex_bytes = static_cast<VkDeviceSize>(vertex_count * vertex_size);
+  slot.index_bytes = static_cast<VkDeviceSize>(index_count * index_size);
+  slot.vertex_size = static_cast<uint32_t>(vertex_size);
+  slot.index_size = static_cast<uint32_t>(index_size);
+  slot.live = true;
+
+  bool moved = false;
+  if (!TryAllocate(slot)) {
+    // Compact when that leaves a fifth of the buffer free, so that the next
+    // allocations don't compact again right away, and grow otherwise.
+    const VkDeviceSize needed = ranges_.GetStats().used + slot.vertex_bytes +
+                                slot.vertex_size + slot.index_bytes +
+                                slot.index_size;
+    VkDeviceSize size = ranges_.GetSize();
+    while (size < needed + needed / 4) {
+      size *= 2;
+    }
+    Rebuild(size);
+    moved = true;
+    while (!TryAllocate(slot)) {
+      Rebuild(ranges_.GetSize() * 2);
+    }
+  }
+
+  uint32_t slot_id;
+  if (!free_slots_.empty()) {
+    slot_id = free_slots_.back();
+    free_slots_.pop_back();
+    slots_[slot_id] = slot;
+  } else {
+    slot_id = static_cast<uint32_t>(slots_.size());
+    slots_.push_back(slot);
+  }
+  allocation.slot = slot_id;
+  Refresh(allocation);
+  return moved;
+}
+
+void GeometryPool::Free(const Allocation& allocation) {
+  Slot& slot = slots_[allocation.slot];
+  assert(slot.live);
+  ranges_.Free(slot.vertex_range);
+  ranges_.Free(slot.index_range);
+  // A pending move would overwrite whatever reuses the ranges.
+  slot.live = false;
+  slot.source = nullptr;
+  free_slots_.push_back(allocation.slot);
+}
+
+void GeometryPool::Refresh(Allocation& allocation) const {
+  const Slot& slot = slots_[allocation.slot];
+  allocation.vertex_offset =
+      static_cast<int32_t>(slot.vertex_base / slot.vertex_size);
+  allocation.first_index =
+      static_cast<uint32_t>(slot.index_range.offset / slot.index_size);
+}
+
+UploadTicket GeometryPool::UploadVertices(const Allocation& allocation,
+                                          const BufferWriter& write) {
+  const Slot& slot = slots_[allocation.slot];
+  return upload_context_.UploadBuffer(*buffer_, slot.vertex_bytes,
+                                      slot.vertex_size, write,
+                                      slot.vertex_base);
+}
+
+UploadTicket GeometryPool::UploadIndices(const Allocation& allocation,
+                                         const BufferWriter& write) {
+  const Slot& slot = slots_[allocation.slot];
+  return upload_context_.UploadBuffer(*buffer_, slot.index_bytes,
+                                      slot.index_size, write,
+                                      slot.index_range.offset);
+}
+
+void GeometryPool::Rebuild(VkDeviceSize size) {
+  // Allocations keep their order, so that meshes loaded together stay
+  // together.
+  std::vector<uint32_t> order;
+  VkDeviceSize needed = 0;
+  for (uint32_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i].live) {
+      order.push_back(i);
+      needed += slots_[i].vertex_range.size + kVertexAlignment +
+                slots_[i].index_range.size + slots_[i].index_size;
+    }
+  }
+  std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return slots_[a].vertex_range.offset < slots_[b].vertex_range.offset;
+  });
+  while (size < needed) {
+    size *= 2;
+  }
+
+  // Data that hasn't been moved out of an older buffer yet is copied from
+  // there directly.
+  retired_buffers_.push_back(std::move(buffer_));
+  const Buffer* old_buffer = retired_buffers_.back().get();
+  buffer_ = std::make_unique<Buffer>(allocator_, kUsage,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, size);
+  ranges_ = RangeAllocator(size);
+  for (uint32_t slot_id : order) {
+    Slot& slot = slots_[slot_id];
+    if (slot.source == nullptr) {
+      slot.source = old_buffer;
+      slot.source_vertex_base = slot.vertex_base;
+      slot.source_index_offset = slot.index_range.offset;
+    }
+    bool fits = TryAllocate(slot);
+    assert(fits);
+    (void)fits;
+  }
+  ++rebuild_count_;
+}
+
+bool GeometryPool::Compact() {
+  // A single free range is as compact as it gets.
+  if (GetStats().fragmentation <= 0.0f) {
+    return false;
+  }
+  Rebuild(ranges_.GetSize());
+  return true;
+}
+
+std::vector<std::unique_ptr<Buffer>> GeometryPool::RecordMoves(
+    VkCommandBuffer command_buffer) {
+  std::vector<std::unique_ptr<Buffer>> retired_buffers;
+  if (retired_buffers_.empty()) {
+    return retired_buffers;
+  }
+
+  // Uploads to the old places were acquired for vertex input, the copies
+  // read them as transfers.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  std::vector<VkBufferCopy> regions;
+  for (const auto& source : retired_buffers_) {
+    regions.clear();
+    for (Slot& slot : slots_) {
+      if (!slot.live || slot.source != source.get()) {
+        continue;
+      }
+      if (slot.vertex_bytes > 0) {
+        regions.push_back(VkBufferCopy{slot.source_vertex_base,
+                                       slot.vertex_base, slot.vertex_bytes});
+      }
+      if (slot.index_bytes > 0) {
+        regions.push_back(VkBufferCopy{slot.source_index_offset,
+                                       slot.index_range.offset,
+                                       slot.index_bytes});
+      }
+      slot.source = nullptr;
+    }
+    if (!regions.empty()) {
+      vkCmdCopyBuffer(command_buffer, source->buffer_, buffer_->buffer_,
+                      static_cast<uint32_t>(regions.size()), regions.data());
+    }
+  }
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+  retired_buffers.swap(retired_buffers_);
+  return retired_buffers;
+}
+
+GeometryPool::Stats GeometryPool::GetStats() const {
+  RangeAllocator::Stats range_stats = ranges_.GetStats();
+  Stats stats{range_stats.size,
+              range_stats.used,
+              range_stats.largest_free_range,
+              range_stats.allocation_count / 2,
+              rebuild_count_,
+              0.0f};
+  VkDeviceSize free = range_stats.size - range_stats.used;
+  if (free > 0) {
+    stats.fragmentation =
+        1.0f - static_cast<float>(range_stats.largest_free_range) /
+                   static_cast<float>(free);
+  }
+  return stats;
+}
+
+void GeometryPool::PrintStats() const {
+  Stats stats = GetStats();
+  std::cout << "Geometry pool:\n";
+  std::cout << "\tsize: " << stats.size << " bytes\n";
+  std::cout << "\tused: " << stats.used << " bytes\n";
+  std::cout << "\tmeshes: " << stats.allocation_count << '\n';
+  std::cout << "\tlargest free range: " << stats.largest_free_range
+            << " bytes\n";
+  std::cout << "\tfragmentation: " << 100.0f * stats.fragmentation << "%\n";
+  std::cout << "\trebuilds: " << stats.rebuild_count << '\n';
+}
+}  // namespace vulkan
+}  // namespace render
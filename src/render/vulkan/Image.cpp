@@ -1,41 +1,124 @@
+#include <algorithm>
+#include <vector>
+
 #include "render/vulkan/Image.hpp"
-#include "render/vulkan/Memory.hpp"
 
 namespace render {
 namespace vulkan {
-Image::Image(VkPhysicalDevice physical_device,
-             VkDevice device,
+Image::Image(Allocator& allocator,
              size_t width,
-             size_t height)
-    : physical_device_(physical_device), device_(device) {
+             size_t height,
+             uint32_t mip_levels,
+             VkFormat format)
+    : Image(allocator,
+            static_cast<uint32_t>(width),
+            static_cast<uint32_t>(height),
+            mip_levels,
+            format,
+            true) {}
+
+Image::Image(Allocator& allocator,
+             uint32_t width,
+             uint32_t height,
+             uint32_t mip_levels,
+             VkFormat format,
+             bool create_block)
+    : allocator_(allocator),
+      width_(width),
+      height_(height),
+      mip_levels_(mip_levels),
+      format_(format) {
+  VkDevice device = allocator_.GetDevice();
+
   VkImageCreateInfo image_info{};
   image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   image_info.imageType = VK_IMAGE_TYPE_2D;
-  image_info.extent.width = static_cast<uint32_t>(width);
-  image_info.extent.height = static_cast<uint32_t>(height);
+  image_info.extent.width = width_;
+  image_info.extent.height = height_;
   image_info.extent.depth = 1;
-  image_info.mipLevels = 1;
+  image_info.mipLevels = mip_levels_;
   image_info.arrayLayers = 1;
-  image_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+  image_info.format = format_;
   image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
   image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  image_info.usage =
-      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                     VK_IMAGE_USAGE_SAMPLED_BIT;
   image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   image_info.samples = VK_SAMPLE_COUNT_1_BIT;
 
-  VK_CHECK(vkCreateImage(device_, &image_info, nullptr, &image_));
+  VK_CHECK(vkCreateImage(device, &image_info, nullptr, &image_));
 
   VkMemoryRequirements memory_requirements;
   vkGetImageMemoryRequirements(device, image_, &memory_requirements);
-  AllocateVulkanMemory(memory_requirements, physical_device_, device_, &memory_,
-                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  VK_CHECK(vkBindImageMemory(device, image_, memory_, 0));
+  allocation_ = allocator_.Allocate(memory_requirements,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    ResourceKind::kOptimal, create_block);
+  if (allocation_.block != nullptr) {
+    VK_CHECK(vkBindImageMemory(device, image_, allocation_.memory,
+                               allocation_.offset));
+  }
 }
 
 Image::~Image() {
-  vkFreeMemory(device_, memory_, nullptr);
-  vkDestroyImage(device_, image_, nullptr);
+  vkDestroyImage(allocator_.GetDevice(), image_, nullptr);
+  allocator_.Free(allocation_);
+}
+
+std::unique_ptr<Image> Image::CreateInPlaceOf(const Image& image) {
+  std::unique_ptr<Image> moved(new Image(image.allocator_, image.width_,
+                                         image.height_, image.mip_levels_,
+                                         image.format_, false));
+  if (moved->allocation_.block == nullptr) {
+    return nullptr;
+  }
+  return moved;
+}
+
+void Image::RecordCopy(VkCommandBuffer command_buffer, const Image& dst) const {
+  VkImageMemoryBarrier barriers[2] = {};
+  for (VkImageMemoryBarrier& barrier : barriers) {
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = mip_levels_;
+    barrier.subresourceRange.layerCount = 1;
+  }
+  // Earlier frames only sampled this image, so waiting for them is enough.
+  barriers[0].image = image_;
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barriers[1].image = dst.image_;
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 2, barriers);
+
+  // Extents count texels, even for block-compressed formats whose smallest
+  // levels are narrower than a block.
+  std::vector<VkImageCopy> regions(mip_levels_);
+  for (uint32_t level = 0; level < mip_levels_; ++level) {
+    VkImageCopy& region = regions[level];
+    region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+    region.dstSubresource = region.srcSubresource;
+    region.extent = {std::max(1u, width_ >> level),
+                     std::max(1u, height_ >> level), 1};
+  }
+  vkCmdCopyImage(command_buffer, image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 dst.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 mip_levels_, regions.data());
+
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                       0, nullptr, 1, &barriers[1]);
 }
 }  // namespace vulkan
-}  // namespace render
\ No newline at end of file
+}  // namespace render
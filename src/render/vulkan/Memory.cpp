@@ -5,13 +5,10 @@
 
 namespace render {
 namespace vulkan {
-namespace {
-uint32_t FindMemoryType(VkPhysicalDevice physical_device,
-                        uint32_t type_filter,
-                        VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memory_properties;
-  vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
-
+uint32_t FindMemoryType(
+    const VkPhysicalDeviceMemoryProperties& memory_properties,
+    uint32_t type_filter,
+    VkMemoryPropertyFlags properties) {
   for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
     if (type_filter & (1 << i) &&
         (memory_properties.memoryTypes[i].propertyFlags & properties) ==
@@ -22,19 +19,16 @@ uint32_t FindMemoryType(VkPhysicalDevice physical_device,
   assert(false);
   return 0;
 }
-}  // namespace
 
-void AllocateVulkanMemory(const VkMemoryRequirements& memory_requirements,
-                          const VkPhysicalDevice& physical_device,
-                          const VkDevice& device,
-                          VkDeviceMemory* memory,
-                          VkMemoryPropertyFlags properties) {
+void AllocateVulkanMemory(VkDevice device,
+                          VkDeviceSize size,
+                          uint32_t memory_type,
+                          VkDeviceMemory* memory) {
   VkMemoryAllocateInfo alloc_info{};
   alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.allocationSize = memory_requirements.size;
-  alloc_info.memoryTypeIndex = FindMemoryType(
-      physical_device, memory_requirements.memoryTypeBits, properties);
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = memory_type;
   VK_CHECK(vkAllocateMemory(device, &alloc_info, nullptr, memory));
 }
 }  // namespace vulkan
-}  // namespace render
\ No newline at end of file
+}  // namespace render
@@ -0,0 +1,52 @@
+#include "base.hpp"
+
+#include "render/vulkan/SamplerCache.hpp"
+
+namespace render {
+namespace vulkan {
+namespace {
+// Compared field by field rather than with memcmp, which would also compare
+// whatever padding bytes the caller left uninitialized.
+bool IsSameState(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) {
+  return a.flags == b.flags && a.magFilter == b.magFilter &&
+         a.minFilter == b.minFilter && a.mipmapMode == b.mipmapMode &&
+         a.addressModeU == b.addressModeU &&
+         a.addressModeV == b.addressModeV &&
+         a.addressModeW == b.addressModeW && a.mipLodBias == b.mipLodBias &&
+         a.anisotropyEnable == b.anisotropyEnable &&
+         a.maxAnisotropy == b.maxAnisotropy &&
+         a.compareEnable == b.compareEnable && a.compareOp == b.compareOp &&
+         a.minLod == b.minLod && a.maxLod == b.maxLod &&
+         a.borderColor == b.borderColor &&
+         a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
+}  // namespace
+
+SamplerCache::SamplerCache(VkDevice device) : device_(device) {}
+
+SamplerCache::~SamplerCache() {
+  for (const auto& sampler : samplers_) {
+    vkDestroySampler(device_, sampler.second, nullptr);
+  }
+}
+
+VkSampler SamplerCache::GetSampler(const VkSamplerCreateInfo& info) {
+  assert(info.pNext == nullptr);
+  for (const auto& sampler : samplers_) {
+    if (IsSameState(sampler.first, info)) {
+      ++hits_;
+      return sampler.second;
+    }
+  }
+
+  VkSampler sampler;
+  VK_CHECK(vkCreateSampler(device_, &info, nullptr, &sampler));
+  samplers_.emplace_back(info, sampler);
+  return sampler;
+}
+
+SamplerCache::Stats SamplerCache::GetStats() const {
+  return Stats{samplers_.size(), hits_, samplers_.size()};
+}
+}  // namespace vulkan
+}  // namespace render
@@ -0,0 +1,28 @@
+#include <cassert>
+#include <cstring>
+
+#include "render/vulkan/UniformArena.hpp"
+
+namespace render {
+namespace vulkan {
+UniformArena::UniformArena(Allocator& allocator,
+                           VkDeviceSize capacity,
+                           VkDeviceSize alignment)
+    : buffer_(allocator,
+              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+              capacity),
+      data_(buffer_.Map<uint8_t>()),
+      capacity_(capacity),
+      alignment_(alignment) {}
+
+uint32_t UniformArena::Push(const void* data, size_t size) {
+  VkDeviceSize offset = (head_ + alignment_ - 1) & ~(alignment_ - 1);
+  assert(offset + size <= capacity_);
+  std::memcpy(data_ + offset, data, size);
+  head_ = offset + size;
+  return static_cast<uint32_t>(offset);
+}
+}  // namespace vulkan
+}  // namespace render
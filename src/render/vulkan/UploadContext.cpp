@@ -0,0 +1,594 @@
+#include <algorithm>
+#include <cstring>
+
+#include "render/vulkan/UploadContext.hpp"
+
+namespace render {
+namespace vulkan {
+namespace {
+VkImageMemoryBarrier CreateLayoutBarrier(VkImage image,
+                                         VkImageLayout src_layout,
+                                         VkImageLayout dst_layout,
+                                         uint32_t base_level,
+                                         uint32_t level_count) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.newLayout = dst_layout;
+  barrier.oldLayout = src_layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = base_level;
+  barrier.subresourceRange.levelCount = level_count;
+  barrier.subresourceRange.layerCount = 1;
+
+  if (src_layout == VK_IMAGE_LAYOUT_UNDEFINED &&
+      dst_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  } else if (src_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
+             dst_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  } else if (src_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
+             dst_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  } else if (src_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL &&
+             dst_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  } else if (src_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
+             dst_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+    // Ownership transfer only, ahead of mip generation.
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  } else {
+    assert(false);
+  }
+  return barrier;
+}
+
+VkPipelineStageFlags GetLayoutStage(VkImageLayout layout) {
+  switch (layout) {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+      return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+      return VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    default:
+      return VK_PIPELINE_STAGE_TRANSFER_BIT;
+  }
+}
+}  // namespace
+
+UploadContext::UploadContext(Allocator& allocator,
+                             VkQueue transfer_queue,
+                             uint32_t transfer_queue_family_index,
+                             VkQueue graphics_queue,
+                             uint32_t graphics_queue_family_index,
+                             VkDeviceSize staging_size)
+    : device_(allocator.GetDevice()),
+      transfer_queue_(transfer_queue),
+      transfer_queue_family_index_(transfer_queue_family_index),
+      graphics_queue_(graphics_queue),
+      graphics_queue_family_index_(graphics_queue_family_index),
+      staging_buffer_(allocator,
+                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      staging_size),
+      staging_data_(staging_buffer_.Map<uint8_t>()),
+      staging_size_(staging_size) {
+  command_pool_ = CreateCommandPool(transfer_queue_family_index_);
+  if (TransfersOwnership()) {
+    acquire_command_pool_ = CreateCommandPool(graphics_queue_family_index_);
+  }
+}
+
+UploadContext::~UploadContext() {
+  // Whatever is still being recorded is simply dropped along with the pool.
+  for (const auto& batch : submitted_batches_) {
+    vkWaitForFences(device_, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+  }
+  if (recording_) {
+    free_batches_.push_back(recording_batch_);
+  }
+  free_batches_.insert(free_batches_.end(), submitted_batches_.begin(),
+                       submitted_batches_.end());
+  for (const auto& batch : free_batches_) {
+    vkDestroyFence(device_, batch.fence, nullptr);
+    if (batch.semaphore != VK_NULL_HANDLE) {
+      vkDestroySemaphore(device_, batch.semaphore, nullptr);
+    }
+  }
+  vkDestroyCommandPool(device_, command_pool_, nullptr);
+  if (acquire_command_pool_ != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device_, acquire_command_pool_, nullptr);
+  }
+}
+
+VkCommandPool UploadContext::CreateCommandPool(uint32_t queue_family_index) {
+  VkCommandPool command_pool;
+
+  VkCommandPoolCreateInfo create_info{};
+  create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  create_info.queueFamilyIndex = queue_family_index;
+
+  VK_CHECK(vkCreateCommandPool(device_, &create_info, nullptr, &command_pool));
+  return command_pool;
+}
+
+VkCommandBuffer UploadContext::AllocateCommandBuffer(VkCommandPool pool) {
+  VkCommandBuffer command_buffer;
+
+  VkCommandBufferAllocateInfo buffer_info{};
+  buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  buffer_info.commandBufferCount = 1;
+  buffer_info.commandPool = pool;
+  buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+  VK_CHECK(vkAllocateCommandBuffers(device_, &buffer_info, &command_buffer));
+  return command_buffer;
+}
+
+VkCommandBuffer UploadContext::GetCommandBuffer() {
+  if (recording_) {
+    return recording_batch_.command_buffer;
+  }
+
+  if (free_batches_.empty()) {
+    Batch batch{};
+    batch.command_buffer = AllocateCommandBuffer(command_pool_);
+
+    VkFenceCreateInfo fence_info{};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK(vkCreateFence(device_, &fence_info, nullptr, &batch.fence));
+
+    if (TransfersOwnership()) {
+      batch.acquire_command_buffer =
+          AllocateCommandBuffer(acquire_command_pool_);
+
+      VkSemaphoreCreateInfo semaphore_info{};
+      semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      VK_CHECK(vkCreateSemaphore(device_, &semaphore_info, nullptr,
+                                 &batch.semaphore));
+    }
+
+    free_batches_.push_back(batch);
+  }
+
+  recording_batch_ = free_batches_.back();
+  free_batches_.pop_back();
+  recording_batch_.ticket = next_ticket_;
+  recording_ = true;
+
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK(vkBeginCommandBuffer(recording_batch_.command_buffer, &begin_info));
+  return recording_batch_.command_buffer;
+}
+
+uint8_t* UploadContext::Reserve(VkDeviceSize size,
+                                VkDeviceSize& staging_offset) {
+  assert(size <= staging_size_);
+  for (;;) {
+    if (ring_tail_ == ring_head_) {
+      // Nothing is in flight: restart at the beginning of the ring, which
+      // chunks as large as the whole ring need.
+      ring_head_ = (ring_head_ + staging_size_ - 1) / staging_size_ *
+                   staging_size_;
+      ring_tail_ = ring_head_;
+    }
+    uint64_t start =
+        (ring_head_ + kStagingAlignment - 1) & ~(kStagingAlignment - 1);
+    uint64_t physical = start % staging_size_;
+    if (physical + size > staging_size_) {
+      // Don't straddle the end of the ring.
+      start += staging_size_ - physical;
+      physical = 0;
+    }
+    if (start + size - ring_tail_ <= staging_size_) {
+      ring_head_ = start + size;
+      staging_offset = physical;
+      return staging_data_ + physical;
+    }
+
+    // The ring is full: get the batch being recorded in flight if it is the
+    // one holding the space, then wait for the oldest batch to retire.
+    if (submitted_batches_.empty()) {
+      Submit();
+    }
+    Retire(true);
+  }
+}
+
+void UploadContext::Retire(bool wait_for_oldest) {
+  if (wait_for_oldest && !submitted_batches_.empty()) {
+    VK_CHECK(vkWaitForFences(device_, 1, &submitted_batches_.front().fence,
+                             VK_TRUE, UINT64_MAX));
+  }
+  while (!submitted_batches_.empty()) {
+    Batch batch = submitted_batches_.front();
+    if (vkGetFenceStatus(device_, batch.fence) != VK_SUCCESS) {
+      break;
+    }
+    submitted_batches_.pop_front();
+    VK_CHECK(vkResetFences(device_, 1, &batch.fence));
+    VK_CHECK(vkResetCommandBuffer(batch.command_buffer, 0));
+    if (batch.acquire_command_buffer != VK_NULL_HANDLE) {
+      VK_CHECK(vkResetCommandBuffer(batch.acquire_command_buffer, 0));
+    }
+    ring_tail_ = batch.ring_end;
+    completed_ticket_ = batch.ticket;
+    free_batches_.push_back(batch);
+  }
+}
+
+void UploadContext::ChangeImageLayout(VkCommandBuffer command_buffer,
+                                      VkImage image,
+                                      VkImageLayout src_layout,
+                                      VkImageLayout dst_layout,
+                                      uint32_t base_level,
+                                      uint32_t level_count) {
+  VkImageMemoryBarrier barrier = CreateLayoutBarrier(
+      image, src_layout, dst_layout, base_level, level_count);
+  vkCmdPipelineBarrier(command_buffer, GetLayoutStage(src_layout),
+                       GetLayoutStage(dst_layout), 0, 0, nullptr, 0, nullptr,
+                       1, &barrier);
+}
+
+void UploadContext::GenerateMips(VkCommandBuffer command_buffer,
+                                 const MipGeneration& mips) {
+  // Each level is blitted from the previous one, which has to be switched to
+  // a transfer source first.
+  for (uint32_t level = mips.base_level; level + 1 < mips.level_count;
+       ++level) {
+    ChangeImageLayout(command_buffer, mips.image,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, level, 1);
+
+    VkImageBlit blit{};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.mipLevel = level;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[1].x =
+        static_cast<int32_t>(GetMipSize(mips.width, level));
+    blit.srcOffsets[1].y =
+        static_cast<int32_t>(GetMipSize(mips.height, level));
+    blit.srcOffsets[1].z = 1;
+    blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.dstSubresource.mipLevel = level + 1;
+    blit.dstSubresource.layerCount = 1;
+    blit.dstOffsets[1].x =
+        static_cast<int32_t>(GetMipSize(mips.width, level + 1));
+    blit.dstOffsets[1].y =
+        static_cast<int32_t>(GetMipSize(mips.height, level + 1));
+    blit.dstOffsets[1].z = 1;
+    vkCmdBlitImage(command_buffer, mips.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mips.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                   VK_FILTER_LINEAR);
+  }
+
+  // Uploaded levels above the base one and the last level are still transfer
+  // destinations, the levels in between are transfer sources.
+  VkImageMemoryBarrier barriers[3];
+  uint32_t barrier_count = 0;
+  if (mips.base_level > 0) {
+    barriers[barrier_count++] = CreateLayoutBarrier(
+        mips.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, mips.base_level);
+  }
+  barriers[barrier_count++] = CreateLayoutBarrier(
+      mips.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mips.base_level,
+      mips.level_count - 1 - mips.base_level);
+  barriers[barrier_count++] = CreateLayoutBarrier(
+      mips.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mips.level_count - 1, 1);
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, barrier_count, barriers);
+}
+
+void UploadContext::CopyToLevel(Image& image,
+                                const FormatInfo& format_info,
+                                uint32_t level,
+                                const RowWriter& write_rows) {
+  uint32_t width = GetMipSize(image.width_, level);
+  uint32_t height = GetMipSize(image.height_, level);
+  uint32_t block_rows =
+      (height + format_info.block_height - 1) / format_info.block_height;
+  VkDeviceSize row_size = GetLevelSize(format_info, width, 1, 0);
+  assert(row_size <= staging_size_);
+  uint32_t rows_per_chunk = static_cast<uint32_t>(
+      std::min<VkDeviceSize>(block_rows, staging_size_ / row_size));
+
+  // Levels bigger than the staging ring go through in bands of block rows.
+  for (uint32_t row = 0; row < block_rows; row += rows_per_chunk) {
+    uint32_t row_count = std::min(rows_per_chunk, block_rows - row);
+    VkDeviceSize chunk_size = row_size * row_count;
+    VkDeviceSize staging_offset;
+    uint8_t* dst = Reserve(chunk_size, staging_offset);
+    write_rows(dst, row, row_count);
+
+    uint32_t y = row * format_info.block_height;
+    VkBufferImageCopy copy_info{};
+    copy_info.bufferOffset = staging_offset;
+    copy_info.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy_info.imageSubresource.mipLevel = level;
+    copy_info.imageSubresource.layerCount = 1;
+    copy_info.imageOffset.y = static_cast<int32_t>(y);
+    copy_info.imageExtent.width = width;
+    copy_info.imageExtent.height =
+        std::min(row_count * format_info.block_height, height - y);
+    copy_info.imageExtent.depth = 1;
+    vkCmdCopyBufferToImage(GetCommandBuffer(), staging_buffer_.buffer_,
+                           image.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1, &copy_info);
+  }
+}
+
+UploadTicket UploadContext::UploadBuffer(Buffer& buffer,
+                                         const void* data,
+                                         VkDeviceSize size,
+                                         VkDeviceSize offset) {
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+  return UploadBuffer(
+      buffer, size, 1,
+      [&](uint8_t* dst, VkDeviceSize chunk_offset, VkDeviceSize chunk_size) {
+        std::memcpy(dst, src + chunk_offset, chunk_size);
+      },
+      offset);
+}
+
+UploadTicket UploadContext::UploadBuffer(Buffer& buffer,
+                                         VkDeviceSize size,
+                                         VkDeviceSize granularity,
+                                         const BufferWriter& write,
+                                         VkDeviceSize offset) {
+  assert(granularity > 0 && granularity <= staging_size_);
+  const VkDeviceSize max_chunk_size =
+      staging_size_ - staging_size_ % granularity;
+  const VkDeviceSize first_offset = offset;
+  for (VkDeviceSize written = 0; written < size;) {
+    VkDeviceSize chunk_size = std::min(size - written, max_chunk_size);
+    VkDeviceSize staging_offset;
+    uint8_t* dst = Reserve(chunk_size, staging_offset);
+    write(dst, written, chunk_size);
+
+    VkBufferCopy copy_info{};
+    copy_info.srcOffset = staging_offset;
+    copy_info.dstOffset = offset;
+    copy_info.size = chunk_size;
+    vkCmdCopyBuffer(GetCommandBuffer(), staging_buffer_.buffer_,
+                    buffer.buffer_, 1, &copy_info);
+
+    offset += chunk_size;
+    written += chunk_size;
+  }
+
+  if (TransfersOwnership() && offset > first_offset) {
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = kConsumerAccess;
+    barrier.srcQueueFamilyIndex = transfer_queue_family_index_;
+    barrier.dstQueueFamilyIndex = graphics_queue_family_index_;
+    barrier.buffer = buffer.buffer_;
+    barrier.offset = first_offset;
+    barrier.size = offset - first_offset;
+    pending_buffer_barriers_.push_back(barrier);
+  }
+  return recording_ ? recording_batch_.ticket : next_ticket_ - 1;
+}
+
+UploadTicket UploadContext::UploadImage(Image& image,
+                                        const void* pixels,
+                                        uint32_t level_count) {
+  FormatInfo format_info;
+  bool known_format = GetFormatInfo(image.format_, format_info);
+  assert(known_format);
+  (void)known_format;
+  std::vector<const uint8_t*> level_pixels(level_count);
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(pixels);
+  for (uint32_t level = 0; level < level_count; ++level) {
+    level_pixels[level] = src;
+    src += GetLevelSize(format_info, image.width_, image.height_, level);
+  }
+  return UploadImageLevels(
+      image, level_count,
+      [&](uint32_t level, uint8_t* dst, uint32_t first_row,
+          uint32_t row_count) {
+        VkDeviceSize row_size = GetLevelSize(
+            format_info, GetMipSize(image.width_, level), 1, 0);
+        std::memcpy(dst, level_pixels[level] + first_row * row_size,
+                    row_size * row_count);
+      });
+}
+
+UploadTicket UploadContext::UploadImage(Image& image,
+                                        const RowWriter& write_rows) {
+  return UploadImageLevels(
+      image, 1,
+      [&](uint32_t, uint8_t* dst, uint32_t first_row, uint32_t row_count) {
+        write_rows(dst, first_row, row_count);
+      });
+}
+
+UploadTicket UploadContext::UploadImageLevels(
+    Image& image,
+    uint32_t level_count,
+    const std::function<void(uint32_t, uint8_t*, uint32_t, uint32_t)>&
+        write_level) {
+  assert(level_count >= 1 && level_count <= image.mip_levels_);
+  FormatInfo format_info;
+  bool known_format = GetFormatInfo(image.format_, format_info);
+  assert(known_format);
+  (void)known_format;
+  ChangeImageLayout(GetCommandBuffer(), image.image_, VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, image.mip_levels_);
+
+  for (uint32_t level = 0; level < level_count; ++level) {
+    CopyToLevel(image, format_info, level,
+                [&](uint8_t* dst, uint32_t first_row, uint32_t row_count) {
+                  write_level(level, dst, first_row, row_count);
+                });
+  }
+
+  VkImageMemoryBarrier barrier;
+  if (level_count == image.mip_levels_) {
+    barrier = CreateLayoutBarrier(
+        image.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, image.mip_levels_);
+  } else {
+    // Blits need a graphics queue: generate the missing levels right away on
+    // a single queue, or after the acquire on the graphics queue.
+    MipGeneration mips{image.image_, image.width_, image.height_,
+                       level_count - 1, image.mip_levels_};
+    if (!TransfersOwnership()) {
+      GenerateMips(GetCommandBuffer(), mips);
+      return recording_batch_.ticket;
+    }
+    pending_mip_generations_.push_back(mips);
+    barrier = CreateLayoutBarrier(
+        image.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, image.mip_levels_);
+  }
+  if (TransfersOwnership()) {
+    barrier.srcQueueFamilyIndex = transfer_queue_family_index_;
+    barrier.dstQueueFamilyIndex = graphics_queue_family_index_;
+  }
+  pending_image_barriers_.push_back(barrier);
+  return recording_batch_.ticket;
+}
+
+UploadTicket UploadContext::Submit() {
+  if (!recording_) {
+    return next_ticket_ - 1;
+  }
+
+  VkCommandBuffer command_buffer = recording_batch_.command_buffer;
+  if (!TransfersOwnership()) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = kConsumerAccess;
+    vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, kConsumerStages, 0, 1,
+        &barrier, 0, nullptr,
+        static_cast<uint32_t>(pending_image_barriers_.size()),
+        pending_image_barriers_.data());
+    VK_CHECK(vkEndCommandBuffer(command_buffer));
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    VK_CHECK(vkQueueSubmit(transfer_queue_, 1, &submit_info,
+                           recording_batch_.fence));
+  } else {
+    SubmitOwnershipTransfer();
+  }
+  pending_buffer_barriers_.clear();
+  pending_image_barriers_.clear();
+  pending_mip_generations_.clear();
+
+  recording_batch_.ring_end = ring_head_;
+  submitted_batches_.push_back(recording_batch_);
+  recording_ = false;
+  return next_ticket_++;
+}
+
+void UploadContext::SubmitOwnershipTransfer() {
+  // The release half only needs the source access, the acquire half only the
+  // destination one. Layout transitions are declared identically on both
+  // sides and only happen once.
+  std::vector<VkBufferMemoryBarrier> buffer_barriers = pending_buffer_barriers_;
+  std::vector<VkImageMemoryBarrier> image_barriers = pending_image_barriers_;
+  for (auto& barrier : buffer_barriers) {
+    barrier.dstAccessMask = 0;
+  }
+  for (auto& barrier : image_barriers) {
+    barrier.dstAccessMask = 0;
+  }
+
+  VkCommandBuffer command_buffer = recording_batch_.command_buffer;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                       static_cast<uint32_t>(buffer_barriers.size()),
+                       buffer_barriers.data(),
+                       static_cast<uint32_t>(image_barriers.size()),
+                       image_barriers.data());
+  VK_CHECK(vkEndCommandBuffer(command_buffer));
+
+  VkSubmitInfo release_info{};
+  release_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  release_info.commandBufferCount = 1;
+  release_info.pCommandBuffers = &command_buffer;
+  release_info.signalSemaphoreCount = 1;
+  release_info.pSignalSemaphores = &recording_batch_.semaphore;
+  VK_CHECK(vkQueueSubmit(transfer_queue_, 1, &release_info, VK_NULL_HANDLE));
+
+  for (auto& barrier : pending_buffer_barriers_) {
+    barrier.srcAccessMask = 0;
+  }
+  for (auto& barrier : pending_image_barriers_) {
+    barrier.srcAccessMask = 0;
+  }
+
+  VkCommandBuffer acquire_command_buffer =
+      recording_batch_.acquire_command_buffer;
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK(vkBeginCommandBuffer(acquire_command_buffer, &begin_info));
+  vkCmdPipelineBarrier(
+      acquire_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      kConsumerStages | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+      static_cast<uint32_t>(pending_buffer_barriers_.size()),
+      pending_buffer_barriers_.data(),
+      static_cast<uint32_t>(pending_image_barriers_.size()),
+      pending_image_barriers_.data());
+  for (const auto& mips : pending_mip_generations_) {
+    GenerateMips(acquire_command_buffer, mips);
+  }
+  VK_CHECK(vkEndCommandBuffer(acquire_command_buffer));
+
+  // The batch only retires once the acquire has run on the graphics queue,
+  // which implies the transfer submission is done as well.
+  VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkSubmitInfo acquire_info{};
+  acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  acquire_info.waitSemaphoreCount = 1;
+  acquire_info.pWaitSemaphores = &recording_batch_.semaphore;
+  acquire_info.pWaitDstStageMask = &wait_stage;
+  acquire_info.commandBufferCount = 1;
+  acquire_info.pCommandBuffers = &acquire_command_buffer;
+  VK_CHECK(vkQueueSubmit(graphics_queue_, 1, &acquire_info,
+                         recording_batch_.fence));
+}
+
+bool UploadContext::IsComplete(UploadTicket ticket) {
+  if (recording_ && ticket >= recording_batch_.ticket) {
+    return false;
+  }
+  Retire(false);
+  return ticket <= completed_ticket_;
+}
+
+void UploadContext::Wait(UploadTicket ticket) {
+  if (recording_ && ticket >= recording_batch_.ticket) {
+    Submit();
+  }
+  while (completed_ticket_ < ticket && !submitted_batches_.empty()) {
+    Retire(true);
+  }
+}
+}  // namespace vulkan
+}  // namespace render
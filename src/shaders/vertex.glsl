@@ -4,8 +4,7 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec3 color;
 layout(location = 3) in vec2 uv;
-layout(location = 4) in vec3 tangent;
-layout(location = 5) in vec3 bitangent;
+layout(location = 4) in vec4 tangent;  // w: bitangent handedness
 
 layout(location = 0) out vec3 frag_color;
 layout(location = 1) out vec2 uv_out;
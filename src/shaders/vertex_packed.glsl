@@ -0,0 +1,50 @@
+#version 450
+
+// PackedVertex, see Vertex.hpp.
+layout(location = 0) in vec4 position;  // xyz within the mesh bounds, w = sign
+layout(location = 1) in vec2 normal;    // octahedral
+layout(location = 2) in vec2 tangent;   // octahedral
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 frag_color;
+layout(location = 1) out vec2 uv_out;
+
+layout (set = 0, binding = 0) uniform PassUniforms {
+  mat4 view_matrix;
+  mat4 projection_matrix;
+} pass_uniforms;
+
+layout (set = 0, binding = 1) uniform ObjectUniforms {
+  mat4 world_matrix;
+} object_uniforms;
+
+layout (push_constant) uniform MeshBounds {
+  vec4 minimum;
+  vec4 extent;
+} mesh_bounds;
+
+vec3 decode_octahedral(vec2 encoded) {
+  vec3 v = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  float fold = max(-v.z, 0.0);
+  v.x += v.x >= 0.0 ? -fold : fold;
+  v.y += v.y >= 0.0 ? -fold : fold;
+  return normalize(v);
+}
+
+void main() {
+  vec3 local_position = mesh_bounds.minimum.xyz
+    + mesh_bounds.extent.xyz * position.xyz;
+  // Not consumed by the fragment shader yet, like the tangent of the float
+  // vertex layout.
+  vec3 local_normal = decode_octahedral(normal);
+  vec3 local_tangent = decode_octahedral(tangent);
+  vec3 local_bitangent = cross(local_normal, local_tangent)
+    * (position.w * 2.0 - 1.0);
+
+  gl_Position = pass_uniforms.projection_matrix
+    * pass_uniforms.view_matrix
+    * object_uniforms.world_matrix
+    * vec4(local_position, 1.0);
+  frag_color = vec3(1.0);
+  uv_out = uv;
+}
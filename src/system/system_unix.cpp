@@ -1,8 +1,74 @@
+#include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+
+#include "system.hpp"
+
 size_t get_terminal_width() {
   winsize window_size;
   ioctl(STDOUT_FILENO, TIOCGWINSZ, &window_size);
   return window_size.ws_col;
-}
\ No newline at end of file
+}
+
+size_t get_peak_memory_usage() {
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return static_cast<size_t>(usage.ru_maxrss);
+#else
+  // In kilobytes.
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const std::string& path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(file_stat.st_size);
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = reinterpret_cast<const uint8_t*>(data);
+  size_ = size;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+void MappedFile::Evict(size_t offset, size_t size) const {
+  // Only whole pages inside the range, its edges may still be in use.
+  const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t begin = (offset + page_size - 1) / page_size * page_size;
+  size_t end = std::min(offset + size, size_) / page_size * page_size;
+  if (data_ != nullptr && begin < end) {
+    madvise(const_cast<uint8_t*>(data_ + begin), end - begin, MADV_DONTNEED);
+  }
+}
@@ -1,4 +1,8 @@
 #include <windows.h>
+#include <psapi.h>
+
+#include <algorithm>
+
 #include "system.hpp"
 
 size_t get_terminal_width() {
@@ -6,4 +10,74 @@ size_t get_terminal_width() {
   GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
   return static_cast<size_t>(csbi.srWindow.Right) -
          static_cast<size_t>(csbi.srWindow.Left) + 1;
-}
\ No newline at end of file
+}
+
+size_t get_peak_memory_usage() {
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                            sizeof(counters))) {
+    return 0;
+  }
+  return counters.PeakWorkingSetSize;
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const std::string& path) {
+  Close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return false;
+  }
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  file_ = file;
+  mapping_ = mapping;
+  data_ = reinterpret_cast<const uint8_t*>(data);
+  size_ = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+  }
+  file_ = nullptr;
+  mapping_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+void MappedFile::Evict(size_t offset, size_t size) const {
+  // Only whole pages inside the range, its edges may still be in use.
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  const size_t page_size = info.dwPageSize;
+  size_t begin = (offset + page_size - 1) / page_size * page_size;
+  size_t end = std::min(offset + size, size_) / page_size * page_size;
+  if (data_ != nullptr && begin < end) {
+    // Unlocking pages that aren't locked removes them from the working set.
+    VirtualUnlock(const_cast<uint8_t*>(data_ + begin), end - begin);
+  }
+}
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+#include "MockVulkan.hpp"
+#include "render/vulkan/Allocator.hpp"
+
+using render::vulkan::Allocation;
+using render::vulkan::Allocator;
+using render::vulkan::ResourceKind;
+
+namespace {
+const VkDeviceSize kBlockSize = 1 << 20;
+
+VkMemoryRequirements GetRequirements(VkDeviceSize size,
+                                     VkDeviceSize alignment) {
+  return VkMemoryRequirements{size, alignment, 0x3};
+}
+
+void TestSubAllocation() {
+  Allocator allocator(mock::GetPhysicalDevice(), mock::GetDevice(),
+                      kBlockSize);
+  const size_t calls = mock::GetMemoryStats().allocation_calls;
+  std::vector<Allocation> allocations;
+  for (int i = 0; i < 15; ++i) {
+    allocations.push_back(
+        allocator.Allocate(GetRequirements(60000, 256),
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                           ResourceKind::kLinear));
+  }
+  CHECK(mock::GetMemoryStats().allocation_calls == calls + 1);
+
+  std::sort(allocations.begin(), allocations.end(),
+            [](const Allocation& a, const Allocation& b) {
+              return a.offset < b.offset;
+            });
+  for (size_t i = 0; i < allocations.size(); ++i) {
+    CHECK(allocations[i].memory == allocations[0].memory);
+    CHECK(allocations[i].offset % 256 == 0);
+    CHECK(allocations[i].mapped == nullptr);
+    if (i > 0) {
+      CHECK(allocations[i - 1].offset + allocations[i - 1].size <=
+            allocations[i].offset);
+    }
+  }
+  Allocator::Stats stats = allocator.GetStats();
+  CHECK(stats.block_count == 1);
+  CHECK(stats.allocation_count == 15);
+  CHECK(stats.used == 15 * 60000);
+
+  for (const Allocation& allocation : allocations) {
+    allocator.Free(allocation);
+  }
+  CHECK(allocator.GetStats().allocation_count == 0);
+}
+
+void TestDedicatedBlocks() {
+  Allocator allocator(mock::GetPhysicalDevice(), mock::GetDevice(),
+                      kBlockSize);
+  Allocation large = allocator.Allocate(GetRequirements(kBlockSize, 4096),
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                        ResourceKind::kOptimal);
+  Allocation small = allocator.Allocate(GetRequirements(4096, 4096),
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                        ResourceKind::kOptimal);
+  CHECK(large.block->dedicated);
+  CHECK(large.offset == 0 && large.size == kBlockSize);
+  CHECK(!small.block->dedicated);
+  CHECK(large.memory != small.memory);
+
+  // Dedicated blocks are released with their resource.
+  const size_t live_allocations = mock::GetMemoryStats().live_allocations;
+  allocator.Free(large);
+  CHECK(mock::GetMemoryStats().live_allocations == live_allocations - 1);
+  allocator.Free(small);
+}
+
+void TestResourceKinds() {
+  Allocator allocator(mock::GetPhysicalDevice(), mock::GetDevice(),
+                      kBlockSize);
+  Allocation buffer = allocator.Allocate(GetRequirements(4096, 256),
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                         ResourceKind::kLinear);
+  Allocation image = allocator.Allocate(GetRequirements(4096, 256),
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                        ResourceKind::kOptimal);
+  CHECK(buffer.memory != image.memory);
+  CHECK(allocator.GetStats().block_count == 2);
+  allocator.Free(buffer);
+  allocator.Free(image);
+}
+
+void TestMappedMemory() {
+  Allocator allocator(mock::GetPhysicalDevice(), mock::GetDevice(),
+                      kBlockSize);
+  const VkMemoryPropertyFlags host_visible =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  Allocation a = allocator.Allocate(GetRequirements(1000, 64), host_visible,
+                                    ResourceKind::kLinear);
+  Allocation b = allocator.Allocate(GetRequirements(1000, 64), host_visible,
+                                    ResourceKind::kLinear);
+  if (!CHECK(a.mapped != nullptr && b.mapped != nullptr)) {
+    return;
+  }
+  // One mapping per block, each allocation pointing at its offset in it.
+  CHECK(a.mapped - a.offset == b.mapped - b.offset);
+  std::memset(a.mapped, 0xaa, a.size);
+  std::memset(b.mapped, 0x55, b.size);
+  CHECK(a.mapped[a.size - 1] == 0xaa && b.mapped[0] == 0x55);
+  allocator.Free(a);
+  allocator.Free(b);
+}
+
+void TestEmptyBlockRetention() {
+  Allocator allocator(mock::GetPhysicalDevice(), mock::GetDevice(),
+                      kBlockSize);
+  const size_t live_allocations = mock::GetMemoryStats().live_allocations;
+  std::vector<Allocation> allocations;
+  for (int i = 0; i < 12; ++i) {
+    allocations.push_back(
+        allocator.Allocate(GetRequirements(kBlockSize / 4, 256),
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                           ResourceKind::kLinear));
+  }
+  CHECK(allocator.GetStats().block_count == 3);
+
+  // A single empty block stays around for the next allocations.
+  for (const Allocation& allocation : allocations) {
+    allocator.Free(allocation);
+  }
+  Allocator::Stats stats = allocator.GetStats();
+  CHECK(stats.block_count == 1);
+  CHECK(stats.reserved == kBlockSize);
+  CHECK(mock::GetMemoryStats().live_allocations == live_allocations + 1);
+  const size_t calls = mock::GetMemoryStats().allocation_calls;
+  allocator.Free(allocator.Allocate(GetRequirements(kBlockSize / 4, 256),
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    ResourceKind::kLinear));
+  CHECK(mock::GetMemoryStats().allocation_calls == calls);
+}
+
+void TestFragmentationStats() {
+  Allocator allocator(mock::GetPhysicalDevice(), mock::GetDevice(),
+                      kBlockSize);
+  std::vector<Allocation> allocations;
+  for (int i = 0; i < 8; ++i) {
+    allocations.push_back(
+        allocator.Allocate(GetRequirements(kBlockSize / 8, 256),
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                           ResourceKind::kLinear));
+  }
+  CHECK(allocator.GetStats().fragmentation == 0.0f);
+
+  // Every other range freed: four holes of an eighth each.
+  for (size_t i = 0; i < allocations.size(); i += 2) {
+    allocator.Free(allocations[i]);
+  }
+  Allocator::Stats stats = allocator.GetStats();
+  CHECK(stats.used == kBlockSize / 2);
+  CHECK(stats.largest_free_range == kBlockSize / 8);
+  CHECK(stats.fragmentation == 0.75f);
+  for (size_t i = 1; i < allocations.size(); i += 2) {
+    allocator.Free(allocations[i]);
+  }
+}
+
+void PrintStats(const char* label, const Allocator::Stats& stats) {
+  std::cout << label << ": " << stats.block_count << " blocks, "
+            << stats.used << " of " << stats.reserved
+            << " bytes used, fragmentation " << stats.fragmentation << '\n';
+}
+
+// Loads and unloads images of mixed sizes until most blocks are sparse, then
+// drains them one at a time like RenderSystem::Defragment does, moving each
+// resource of the draining block into the holes of the others.
+void TestDefragmentation() {
+  Allocator allocator(mock::GetPhysicalDevice(), mock::GetDevice(),
+                      kBlockSize);
+  std::mt19937 rng(1);
+  auto allocate = [&allocator, &rng](bool create_block) {
+    VkDeviceSize size = 4096 * (1 + rng() % 32);
+    VkDeviceSize alignment = rng() % 2 ? 256 : 4096;
+    return allocator.Allocate(GetRequirements(size, alignment),
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              ResourceKind::kOptimal, create_block);
+  };
+  std::vector<Allocation> allocations;
+  for (int i = 0; i < 20000; ++i) {
+    if (allocations.size() < 100 || rng() % 2 == 0) {
+      allocations.push_back(allocate(true));
+    } else {
+      size_t index = rng() % allocations.size();
+      allocator.Free(allocations[index]);
+      allocations[index] = allocations.back();
+      allocations.pop_back();
+    }
+  }
+  // Unloading a level leaves every block sparse.
+  for (size_t i = 0; i < allocations.size();) {
+    if (rng() % 4 != 0) {
+      allocator.Free(allocations[i]);
+      allocations[i] = allocations.back();
+      allocations.pop_back();
+    } else {
+      ++i;
+    }
+  }
+  const Allocator::Stats before = allocator.GetStats();
+  PrintStats("before defragmentation", before);
+
+  const size_t calls = mock::GetMemoryStats().allocation_calls;
+  size_t pass_count = 0;
+  while (allocator.BeginDefragmentation(ResourceKind::kOptimal)) {
+    ++pass_count;
+    bool stuck = false;
+    for (Allocation& allocation : allocations) {
+      if (!Allocator::IsDraining(allocation)) {
+        continue;
+      }
+      // With the strictest alignment asked for, as the size doesn't say.
+      Allocation moved = allocator.Allocate(
+          GetRequirements(allocation.size, 4096),
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceKind::kOptimal, false);
+      if (moved.block == nullptr) {
+        stuck = true;
+        break;
+      }
+      CHECK(!Allocator::IsDraining(moved));
+      allocator.Free(allocation);
+      allocation = moved;
+    }
+    allocator.EndDefragmentation();
+    if (!CHECK(!stuck) || !CHECK(pass_count < before.block_count)) {
+      break;
+    }
+  }
+  const Allocator::Stats after = allocator.GetStats();
+  PrintStats("after defragmentation", after);
+  std::cout << '\t' << pass_count << " blocks drained\n";
+
+  // Resources only moved, into blocks that already existed.
+  CHECK(pass_count > 0);
+  CHECK(mock::GetMemoryStats().allocation_calls == calls);
+  CHECK(after.allocation_count == before.allocation_count);
+  CHECK(after.used == before.used);
+  CHECK(after.block_count < before.block_count);
+  CHECK(after.fragmentation <= before.fragmentation);
+  for (const Allocation& allocation : allocations) {
+    allocator.Free(allocation);
+  }
+  CHECK(allocator.GetStats().allocation_count == 0);
+}
+}  // namespace
+
+int main() {
+  TestSubAllocation();
+  TestDedicatedBlocks();
+  TestResourceKinds();
+  TestMappedMemory();
+  TestEmptyBlockRetention();
+  TestFragmentationStats();
+  TestDefragmentation();
+  CHECK(mock::GetMemoryStats().live_allocations == 0);
+  return test::GetResult();
+}
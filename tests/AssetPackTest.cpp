@@ -0,0 +1,146 @@
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Check.hpp"
+#include "render/AssetPack.hpp"
+
+using render::AssetPack;
+using render::AssetPackSource;
+using render::WriteAssetPack;
+
+namespace {
+std::string GetTemporaryPath(const std::string& name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+void WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+struct TestFile {
+  std::string name;
+  std::vector<uint8_t> data;
+};
+
+// Empty, tiny, compressible over several chunks, and incompressible files.
+std::vector<TestFile> MakeFiles() {
+  std::mt19937 rng(1);
+  std::vector<TestFile> files;
+  files.push_back(TestFile{"empty.bin", {}});
+  files.push_back(TestFile{"meshes/tiny.txt", {'v', ' ', '1', '\n'}});
+  TestFile text{"meshes/large.obj", {}};
+  while (text.data.size() < 700000) {
+    std::string line = "v " + std::to_string(rng() % 1000) + " 0.5 " +
+                       std::to_string(rng() % 100) + "\n";
+    text.data.insert(text.data.end(), line.begin(), line.end());
+  }
+  files.push_back(std::move(text));
+  TestFile noise{"textures/noise.ktx2", std::vector<uint8_t>(300000)};
+  for (uint8_t& byte : noise.data) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  files.push_back(std::move(noise));
+  files.push_back(TestFile{"last_empty.bin", {}});
+  return files;
+}
+
+void TestRoundTrip(bool compress) {
+  std::vector<TestFile> files = MakeFiles();
+  std::vector<AssetPackSource> sources;
+  for (size_t i = 0; i < files.size(); ++i) {
+    std::string path = GetTemporaryPath("asset_pack_test_" + std::to_string(i));
+    WriteFile(path, files[i].data);
+    sources.push_back(AssetPackSource{files[i].name, path});
+  }
+  const std::string pack_path = GetTemporaryPath("asset_pack_test.pack");
+  std::string error;
+  bool written = WriteAssetPack(pack_path, sources, compress, error);
+  for (const AssetPackSource& source : sources) {
+    std::filesystem::remove(source.path);
+  }
+  if (!CHECK(written)) {
+    std::cerr << '\t' << error << '\n';
+    return;
+  }
+  if (compress) {
+    CHECK(std::filesystem::file_size(pack_path) < 700000 + 300000);
+  }
+
+  ThreadPool thread_pool(2);
+  AssetPack pack;
+  if (!CHECK(pack.Open(pack_path))) {
+    return;
+  }
+  for (const TestFile& file : files) {
+    std::vector<uint8_t> storage;
+    Span<const uint8_t> data;
+    CHECK(pack.Contains(AssetPack::GetId(file.name)));
+    if (CHECK(pack.Read(AssetPack::GetId(file.name), thread_pool, storage,
+                        data))) {
+      CHECK(std::vector<uint8_t>(data.begin(), data.end()) == file.data);
+    }
+  }
+  std::vector<uint8_t> storage;
+  Span<const uint8_t> data;
+  CHECK(!pack.Contains(AssetPack::GetId("missing.bin")));
+  CHECK(!pack.Read(AssetPack::GetId("missing.bin"), thread_pool, storage,
+                   data));
+  std::filesystem::remove(pack_path);
+}
+
+void TestWriteErrors() {
+  const std::string path = GetTemporaryPath("asset_pack_test_source");
+  WriteFile(path, {1, 2, 3});
+  const std::string pack_path = GetTemporaryPath("asset_pack_test.pack");
+  std::string error;
+  CHECK(!WriteAssetPack(pack_path, {{"a", path}, {"a", path}}, false, error));
+  CHECK(!error.empty());
+  error.clear();
+  CHECK(!WriteAssetPack(pack_path, {{"a", path + ".missing"}}, false, error));
+  CHECK(!error.empty());
+  CHECK(!std::filesystem::exists(pack_path));
+  std::filesystem::remove(path);
+}
+
+void TestCorruptPacks() {
+  const std::string path = GetTemporaryPath("asset_pack_test_corrupt.pack");
+  AssetPack pack;
+  CHECK(!pack.Open(path));
+  WriteFile(path, std::vector<uint8_t>(16, 0));
+  CHECK(!pack.Open(path));
+
+  // A valid pack, then its header damaged.
+  const std::string source_path = GetTemporaryPath("asset_pack_test_source");
+  WriteFile(source_path, std::vector<uint8_t>(1000, 7));
+  std::string error;
+  CHECK(WriteAssetPack(path, {{"a", source_path}}, true, error));
+  std::filesystem::remove(source_path);
+  std::vector<uint8_t> contents(std::filesystem::file_size(path));
+  std::ifstream(path, std::ios::binary)
+      .read(reinterpret_cast<char*>(contents.data()), contents.size());
+  {
+    AssetPack valid_pack;
+    CHECK(valid_pack.Open(path));
+  }
+  for (size_t offset : {0, 8, 20}) {
+    std::vector<uint8_t> corrupt = contents;
+    corrupt[offset] ^= 0x80;
+    WriteFile(path, corrupt);
+    AssetPack corrupt_pack;
+    CHECK(!corrupt_pack.Open(path));
+  }
+  std::filesystem::remove(path);
+}
+}  // namespace
+
+int main() {
+  TestRoundTrip(false);
+  TestRoundTrip(true);
+  TestWriteErrors();
+  TestCorruptPacks();
+  return test::GetResult();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <iostream>
+
+namespace test {
+inline int& GetFailureCount() {
+  static int failure_count = 0;
+  return failure_count;
+}
+
+inline bool Check(bool condition,
+                  const char* expression,
+                  const char* file,
+                  int line) {
+  if (!condition) {
+    std::cerr << file << ':' << line << ": check failed: " << expression
+              << '\n';
+    ++GetFailureCount();
+  }
+  return condition;
+}
+
+// What main returns, for ctest to tell passing tests from failing ones.
+inline int GetResult() {
+  if (GetFailureCount() > 0) {
+    std::cerr << GetFailureCount() << " checks failed\n";
+    return 1;
+  }
+  return 0;
+}
+}  // namespace test
+
+// Reports a failed check and carries on, returning whether it passed so that
+// checks the rest of a test depends on can bail out.
+#define CHECK(condition) \
+  ::test::Check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,356 @@
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <locale>
+#include <string>
+#include <vector>
+
+#include "Check.hpp"
+#include "render/Glb.hpp"
+#include "render/Json.hpp"
+
+using render::GlbMesh;
+using render::JsonValue;
+using render::ParseGlb;
+using render::ParseJson;
+using render::SubMesh;
+using render::Vertex;
+
+namespace {
+template <typename T>
+void Append(std::vector<uint8_t>& bytes, const T& value) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(&value);
+  bytes.insert(bytes.end(), data, data + sizeof(value));
+}
+
+// Lays out a GLB file the way exporters do, padding the JSON chunk with
+// spaces so that the BIN chunk starts 4-byte aligned.
+std::vector<uint8_t> MakeGlb(std::string json, std::vector<uint8_t> bin) {
+  json.resize((json.size() + 3) & ~size_t{3}, ' ');
+  bin.resize((bin.size() + 3) & ~size_t{3}, 0);
+  std::vector<uint8_t> file;
+  Append(file, uint32_t{0x46546c67});
+  Append(file, uint32_t{2});
+  Append(file, static_cast<uint32_t>(12 + 8 + json.size() + 8 + bin.size()));
+  Append(file, static_cast<uint32_t>(json.size()));
+  Append(file, uint32_t{0x4e4f534a});
+  file.insert(file.end(), json.begin(), json.end());
+  Append(file, static_cast<uint32_t>(bin.size()));
+  Append(file, uint32_t{0x004e4942});
+  file.insert(file.end(), bin.begin(), bin.end());
+  return file;
+}
+
+bool Parse(const std::vector<uint8_t>& file,
+           GlbMesh& mesh,
+           std::string& error) {
+  return ParseGlb(Span<const uint8_t>(file.data(), file.size()), mesh, error);
+}
+
+bool IsInFile(const void* data, const std::vector<uint8_t>& file) {
+  const uint8_t* byte = static_cast<const uint8_t*>(data);
+  return byte >= file.data() && byte < file.data() + file.size();
+}
+
+Vertex MakeVertex(float seed) {
+  return Vertex{glm::vec3{seed, seed + 1.0f, seed + 2.0f},
+                glm::vec3{0.0f, 0.0f, 1.0f},
+                glm::vec3{seed / 8.0f, 0.5f, 0.25f},
+                glm::vec2{seed / 4.0f, 1.0f - seed / 4.0f},
+                glm::vec4{1.0f, 0.0f, 0.0f, -1.0f}};
+}
+
+bool Equals(const Vertex& a, const Vertex& b) {
+  return a.position == b.position && a.normal == b.normal &&
+         a.color == b.color && a.uv == b.uv && a.tangent == b.tangent;
+}
+
+bool Equals(const std::vector<SubMesh>& a, const std::vector<SubMesh>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].first_index != b[i].first_index ||
+        a[i].index_count != b[i].index_count ||
+        a[i].vertex_offset != b[i].vertex_offset ||
+        a[i].material_id != b[i].material_id) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Two primitives whose vertices are interleaved like Vertex, back to back,
+// followed by their 32-bit indices: the whole mesh is used in place.
+void TestInterleaved() {
+  std::vector<Vertex> vertices;
+  for (int i = 0; i < 6; ++i) {
+    vertices.push_back(MakeVertex(static_cast<float>(i)));
+  }
+  const uint32_t indices[] = {0, 1, 2, 2, 1, 0};
+  std::vector<uint8_t> bin(sizeof(Vertex) * vertices.size() +
+                           sizeof(indices));
+  std::memcpy(bin.data(), vertices.data(), sizeof(Vertex) * vertices.size());
+  std::memcpy(bin.data() + sizeof(Vertex) * vertices.size(), indices,
+              sizeof(indices));
+
+  // Accessors 0-4 and 5-9 are the attributes of each primitive, 10 and 11
+  // their indices.
+  std::string json =
+      R"({"asset":{"version":"2.0"},"buffers":[{"byteLength":384}],)"
+      R"("bufferViews":[)"
+      R"({"buffer":0,"byteOffset":0,"byteLength":180,"byteStride":60},)"
+      R"({"buffer":0,"byteOffset":180,"byteLength":180,"byteStride":60},)"
+      R"({"buffer":0,"byteOffset":360,"byteLength":24}],)"
+      R"("accessors":[)";
+  for (int view = 0; view < 2; ++view) {
+    const char* attributes[][3] = {{"0", "5126", "VEC3"},
+                                   {"12", "5126", "VEC3"},
+                                   {"24", "5126", "VEC3"},
+                                   {"36", "5126", "VEC2"},
+                                   {"44", "5126", "VEC4"}};
+    for (const auto& attribute : attributes) {
+      json += R"({"bufferView":)" + std::to_string(view) +
+              R"(,"byteOffset":)" + attribute[0] +
+              R"(,"componentType":)" + attribute[1] +
+              R"(,"count":3,"type":")" + attribute[2] + R"("},)";
+    }
+  }
+  json +=
+      R"({"bufferView":2,"componentType":5125,"count":3,"type":"SCALAR"},)"
+      R"({"bufferView":2,"byteOffset":12,"componentType":5125,"count":3,)"
+      R"("type":"SCALAR"}],)"
+      R"("materials":[{"name":"red"}],)"
+      R"("meshes":[{"primitives":[)"
+      R"({"attributes":{"POSITION":0,"NORMAL":1,"COLOR_0":2,)"
+      R"("TEXCOORD_0":3,"TANGENT":4},"indices":10,"material":0},)"
+      R"({"attributes":{"POSITION":5,"NORMAL":6,"COLOR_0":7,)"
+      R"("TEXCOORD_0":8,"TANGENT":9},"indices":11}]}]})";
+  std::vector<uint8_t> file = MakeGlb(json, bin);
+
+  GlbMesh mesh;
+  std::string error;
+  if (!CHECK(Parse(file, mesh, error)) || !CHECK(error.empty())) {
+    std::cerr << error << '\n';
+    return;
+  }
+  CHECK(IsInFile(mesh.vertices.data(), file));
+  CHECK(IsInFile(mesh.indices.data(), file));
+  CHECK(mesh.vertex_storage.empty());
+  CHECK(mesh.index_storage.empty());
+  CHECK(mesh.converted_size == 0);
+  if (CHECK(mesh.vertices.size() == vertices.size())) {
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      CHECK(Equals(mesh.vertices[i], vertices[i]));
+    }
+  }
+  CHECK(std::vector<uint32_t>(mesh.indices.begin(), mesh.indices.end()) ==
+        std::vector<uint32_t>(std::begin(indices), std::end(indices)));
+  CHECK(Equals(mesh.sub_meshes,
+               {SubMesh{0, 3, 0, std::hash<std::string>{}("red")},
+                SubMesh{3, 3, 3, render::kNoMaterial}}));
+}
+
+// A quad with separate float positions and normals, normalized 16-bit
+// texture coordinates and 16-bit indices, then a triangle with 32-bit
+// indices. Both are converted.
+void TestSeparate() {
+  const float positions[][3] = {{0.0f, 0.0f, 0.0f},
+                                {1.0f, 0.0f, 0.0f},
+                                {1.0f, 1.0f, 0.0f},
+                                {0.0f, 1.0f, 0.0f},
+                                {0.0f, 0.0f, 1.0f},
+                                {0.0f, 1.0f, 1.0f},
+                                {1.0f, 0.0f, 1.0f}};
+  const float normals[][3] = {{0.0f, 0.0f, 1.0f},
+                              {0.0f, 0.0f, 1.0f},
+                              {0.0f, 0.0f, 1.0f},
+                              {0.0f, 0.0f, 1.0f}};
+  // Top-left origin: v grows as y shrinks.
+  const uint16_t uvs[][2] = {{0, 65535}, {65535, 65535}, {65535, 0}, {0, 0}};
+  const uint16_t quad_indices[] = {0, 1, 2, 0, 2, 3};
+  const uint32_t triangle_indices[] = {0, 2, 1};
+  std::vector<uint8_t> bin;
+  Append(bin, positions);
+  Append(bin, normals);
+  Append(bin, uvs);
+  Append(bin, quad_indices);
+  Append(bin, triangle_indices);
+
+  // Positions 0-83, normals 84-131, uvs 132-147, indices 148-159 and
+  // 160-171.
+  const std::string json =
+      R"({"asset":{"version":"2.0"},"buffers":[{"byteLength":172}],)"
+      R"("bufferViews":[)"
+      R"({"buffer":0,"byteLength":84},)"
+      R"({"buffer":0,"byteOffset":84,"byteLength":48},)"
+      R"({"buffer":0,"byteOffset":132,"byteLength":16},)"
+      R"({"buffer":0,"byteOffset":148,"byteLength":12},)"
+      R"({"buffer":0,"byteOffset":160,"byteLength":12}],)"
+      R"("accessors":[)"
+      R"({"bufferView":0,"componentType":5126,"count":4,"type":"VEC3"},)"
+      R"({"bufferView":1,"componentType":5126,"count":4,"type":"VEC3"},)"
+      R"({"bufferView":2,"componentType":5123,"normalized":true,"count":4,)"
+      R"("type":"VEC2"},)"
+      R"({"bufferView":3,"componentType":5123,"count":6,"type":"SCALAR"},)"
+      R"({"bufferView":0,"byteOffset":48,"componentType":5126,"count":3,)"
+      R"("type":"VEC3"},)"
+      R"({"bufferView":4,"componentType":5125,"count":3,"type":"SCALAR"}],)"
+      R"("materials":[{"name":"floor"},{"name":"wall"}],)"
+      R"("meshes":[{"primitives":[)"
+      R"({"attributes":{"POSITION":0,"NORMAL":1,"TEXCOORD_0":2},)"
+      R"("indices":3,"material":0}]},)"
+      R"({"primitives":[)"
+      R"({"attributes":{"POSITION":4},"indices":5,"material":1}]}]})";
+  std::vector<uint8_t> file = MakeGlb(json, bin);
+
+  GlbMesh mesh;
+  std::string error;
+  if (!CHECK(Parse(file, mesh, error)) ||
+      !CHECK(mesh.vertices.size() == 7) || !CHECK(mesh.indices.size() == 9)) {
+    std::cerr << error << '\n';
+    return;
+  }
+  CHECK(mesh.vertices.data() == mesh.vertex_storage.data());
+  CHECK(mesh.indices.data() == mesh.index_storage.data());
+  CHECK(mesh.converted_size ==
+        7 * sizeof(Vertex) + 9 * sizeof(uint32_t));
+  CHECK(mesh.index_storage ==
+        (std::vector<uint32_t>{0, 1, 2, 0, 2, 3, 0, 2, 1}));
+  CHECK(Equals(mesh.sub_meshes,
+               {SubMesh{0, 6, 0, std::hash<std::string>{}("floor")},
+                SubMesh{6, 3, 4, std::hash<std::string>{}("wall")}}));
+
+  for (size_t i = 0; i < 7; ++i) {
+    const Vertex& vertex = mesh.vertices[i];
+    CHECK(vertex.position == glm::vec3(positions[i][0], positions[i][1],
+                                       positions[i][2]));
+    CHECK(vertex.color == glm::vec3(1.0f));
+    // Tangents are generated, along u.
+    CHECK(std::abs(vertex.tangent.w) == 1.0f);
+    if (i < 4) {
+      CHECK(vertex.normal == glm::vec3(0.0f, 0.0f, 1.0f));
+      CHECK(vertex.uv == glm::vec2(uvs[i][0] / 65535.0f, uvs[i][1] / 65535.0f));
+      CHECK(std::abs(vertex.tangent.x - 1.0f) < 1e-5f);
+    } else {
+      CHECK(vertex.normal == glm::vec3(0.0f));
+      CHECK(vertex.uv == glm::vec2(0.0f));
+    }
+  }
+}
+
+// A triangle with 16-bit indices, whose accessors can be broken one way at
+// a time.
+struct Triangle {
+  size_t position_count = 3;
+  size_t position_view_size = 36;
+  std::vector<uint16_t> indices = {0, 1, 2};
+
+  std::vector<uint8_t> MakeFile() const {
+    std::vector<uint8_t> bin(36);
+    const float positions[] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+    std::memcpy(bin.data(), positions, sizeof(positions));
+    for (uint16_t index : indices) {
+      Append(bin, index);
+    }
+    const std::string json =
+        R"({"asset":{"version":"2.0"},"buffers":[{"byteLength":)" +
+        std::to_string(bin.size()) +
+        R"(}],"bufferViews":[{"buffer":0,"byteLength":)" +
+        std::to_string(position_view_size) +
+        R"(},{"buffer":0,"byteOffset":36,"byteLength":)" +
+        std::to_string(indices.size() * 2) +
+        R"(}],"accessors":[{"bufferView":0,"componentType":5126,"count":)" +
+        std::to_string(position_count) +
+        R"(,"type":"VEC3"},{"bufferView":1,"componentType":5123,"count":)" +
+        std::to_string(indices.size()) +
+        R"(,"type":"SCALAR"}],"meshes":[{"primitives":[{"attributes":)"
+        R"({"POSITION":0},"indices":1}]}]})";
+    return MakeGlb(json, bin);
+  }
+};
+
+bool Fails(const std::vector<uint8_t>& file, const std::string& expected) {
+  GlbMesh mesh;
+  std::string error;
+  if (Parse(file, mesh, error) || error != expected) {
+    std::cerr << "expected \"" << expected << "\", got \"" << error << "\"\n";
+    return false;
+  }
+  return true;
+}
+
+void TestInvalidFiles() {
+  GlbMesh mesh;
+  std::string error;
+  Triangle triangle;
+  std::vector<uint8_t> file = triangle.MakeFile();
+  if (!CHECK(Parse(file, mesh, error))) {
+    std::cerr << error << '\n';
+    return;
+  }
+  CHECK(mesh.sub_meshes.size() == 1 && mesh.indices.size() == 3 &&
+        mesh.vertices.size() == 3);
+
+  std::vector<uint8_t> bad_magic = file;
+  bad_magic[0] = 'G';
+  CHECK(Fails(bad_magic, "not a GLB file"));
+  CHECK(Fails(std::vector<uint8_t>(file.begin(), file.begin() + 16),
+              "not a GLB file"));
+  std::vector<uint8_t> bad_version = file;
+  bad_version[4] = 1;
+  CHECK(Fails(bad_version, "unsupported glTF version"));
+
+  Triangle broken = triangle;
+  broken.position_count = 4;
+  CHECK(Fails(broken.MakeFile(), "accessor out of bounds"));
+  broken = triangle;
+  broken.position_view_size = 64;
+  CHECK(Fails(broken.MakeFile(), "invalid accessor"));
+  broken = triangle;
+  broken.indices = {0, 1, 3};
+  CHECK(Fails(broken.MakeFile(), "index out of range"));
+  broken.indices = {0, 1, 2, 0};
+  CHECK(Fails(broken.MakeFile(), "incomplete triangles"));
+  broken.indices = {};
+  CHECK(Fails(broken.MakeFile(), "incomplete triangles"));
+}
+
+// glTF numbers use '.' whatever the locale, which the C++ global locale may
+// not.
+struct CommaDecimalPoint : std::numpunct<char> {
+  char do_decimal_point() const override { return ','; }
+};
+
+void TestNumbersIgnoreLocale() {
+  const std::locale previous = std::locale::global(
+      std::locale(std::locale::classic(), new CommaDecimalPoint));
+  // Also the C locale, where one is installed.
+  const char* names[] = {"de_DE.UTF-8", "fr_FR.UTF-8", "de_DE", "fr_FR"};
+  for (const char* name : names) {
+    if (std::setlocale(LC_NUMERIC, name) != nullptr) {
+      break;
+    }
+  }
+  const std::string text = "[0.5, -1.25e2, 3]";
+  JsonValue json;
+  std::string error;
+  if (CHECK(ParseJson(text.data(), text.data() + text.size(), json, error))) {
+    CHECK(json[0].GetNumber(0.0) == 0.5);
+    CHECK(json[1].GetNumber(0.0) == -125.0);
+    CHECK(json[2].GetNumber(0.0) == 3.0);
+  }
+  std::setlocale(LC_NUMERIC, "C");
+  std::locale::global(previous);
+}
+}  // namespace
+
+int main() {
+  TestInterleaved();
+  TestSeparate();
+  TestInvalidFiles();
+  TestNumbersIgnoreLocale();
+  return test::GetResult();
+}
@@ -0,0 +1,157 @@
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Check.hpp"
+#include "render/Lz4.hpp"
+
+using render::GetLz4CompressBound;
+using render::Lz4Compress;
+using render::Lz4Decompress;
+
+namespace {
+std::vector<uint8_t> Compress(const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> compressed(GetLz4CompressBound(data.size()));
+  size_t size = Lz4Compress(data.data(), data.size(), compressed.data(),
+                            compressed.size());
+  compressed.resize(size);
+  return compressed;
+}
+
+bool Decompress(const std::vector<uint8_t>& compressed,
+                std::vector<uint8_t>& data,
+                size_t size) {
+  data.assign(size, 0);
+  return Lz4Decompress(compressed.data(), compressed.size(), data.data(),
+                       size);
+}
+
+// Returns the compressed size, 0 when the round trip failed.
+size_t TestRoundTrip(const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> compressed = Compress(data);
+  std::vector<uint8_t> decompressed;
+  if (!CHECK(!compressed.empty()) ||
+      !CHECK(compressed.size() <= GetLz4CompressBound(data.size())) ||
+      !CHECK(Decompress(compressed, decompressed, data.size())) ||
+      !CHECK(decompressed == data)) {
+    return 0;
+  }
+  return compressed.size();
+}
+
+std::vector<uint8_t> GetRandomBytes(std::mt19937& rng, size_t size) {
+  std::vector<uint8_t> bytes(size);
+  for (uint8_t& byte : bytes) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  return bytes;
+}
+
+void TestSmallInputs() {
+  // Below the 12 bytes a match needs to fit, everything is a literal.
+  std::mt19937 rng(1);
+  for (size_t size = 0; size <= 16; ++size) {
+    std::vector<uint8_t> zeros(size, 0);
+    size_t compressed_size = TestRoundTrip(zeros);
+    if (size < 12) {
+      CHECK(compressed_size == 1 + size);
+    }
+    TestRoundTrip(GetRandomBytes(rng, size));
+  }
+}
+
+void TestIncompressible() {
+  std::mt19937 rng(2);
+  for (size_t size : {255, 256, 270, 65536, 300000}) {
+    std::vector<uint8_t> data = GetRandomBytes(rng, size);
+    size_t compressed_size = TestRoundTrip(data);
+    CHECK(compressed_size > size);
+  }
+}
+
+void TestRuns() {
+  // A match one or a few bytes behind overlaps the bytes it produces, and
+  // long ones need several length bytes.
+  std::vector<uint8_t> run(100000, 'a');
+  size_t compressed_size = TestRoundTrip(run);
+  CHECK(compressed_size > 0 && compressed_size < 500);
+
+  std::vector<uint8_t> pattern;
+  for (size_t i = 0; i < 100000; ++i) {
+    pattern.push_back(static_cast<uint8_t>("abc"[i % 3]));
+  }
+  compressed_size = TestRoundTrip(pattern);
+  CHECK(compressed_size > 0 && compressed_size < 500);
+
+  // Text with repeats at every distance up to the 64 KiB window, and past
+  // it.
+  std::mt19937 rng(3);
+  std::vector<uint8_t> text;
+  const std::string kWords[] = {"vertex ", "index ", "texture ", "mesh ",
+                                "\n", "material ", "0.125 "};
+  while (text.size() < 400000) {
+    const std::string& word = kWords[rng() % 7];
+    text.insert(text.end(), word.begin(), word.end());
+    if (rng() % 50 == 0) {
+      std::vector<uint8_t> noise = GetRandomBytes(rng, rng() % 40);
+      text.insert(text.end(), noise.begin(), noise.end());
+    }
+  }
+  compressed_size = TestRoundTrip(text);
+  CHECK(compressed_size > 0 && compressed_size < text.size() / 2);
+}
+
+void TestCapacity() {
+  std::vector<uint8_t> run(1000, 'a');
+  std::vector<uint8_t> compressed = Compress(run);
+  std::vector<uint8_t> dst(compressed.size());
+  CHECK(Lz4Compress(run.data(), run.size(), dst.data(), dst.size()) ==
+        compressed.size());
+  CHECK(Lz4Compress(run.data(), run.size(), dst.data(), dst.size() - 1) == 0);
+}
+
+void TestCorruptInput() {
+  std::mt19937 rng(4);
+  std::vector<uint8_t> data(5000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(rng() % 4 == 0 ? rng() : i / 16);
+  }
+  std::vector<uint8_t> compressed = Compress(data);
+  std::vector<uint8_t> decompressed;
+
+  // Every truncation fails, as do wrong sizes.
+  for (size_t size = 0; size < compressed.size(); ++size) {
+    std::vector<uint8_t> truncated(compressed.begin(),
+                                   compressed.begin() + size);
+    CHECK(!Decompress(truncated, decompressed, data.size()));
+  }
+  CHECK(!Decompress(compressed, decompressed, data.size() - 1));
+  CHECK(!Decompress(compressed, decompressed, data.size() + 1));
+
+  // Offsets before the start of the output, or of 0.
+  CHECK(!Decompress({0x00, 0x01, 0x00}, decompressed, 4));
+  CHECK(!Decompress({0x10, 'a', 0x02, 0x00, 0x00}, decompressed, 5));
+  CHECK(!Decompress({0x10, 'a', 0x00, 0x00, 0x00}, decompressed, 5));
+  // Lengths running past the end of the input.
+  CHECK(!Decompress({0xf0, 0xff}, decompressed, 300));
+  CHECK(!Decompress({0x50, 'a', 'b'}, decompressed, 5));
+
+  // Flipped bytes may decode to something else, but never out of bounds,
+  // which ASan would catch.
+  for (int i = 0; i < 2000; ++i) {
+    std::vector<uint8_t> corrupt = compressed;
+    corrupt[rng() % corrupt.size()] ^= static_cast<uint8_t>(1 + rng() % 255);
+    Decompress(corrupt, decompressed, data.size());
+  }
+}
+}  // namespace
+
+int main() {
+  TestSmallInputs();
+  TestIncompressible();
+  TestRuns();
+  TestCapacity();
+  TestCorruptInput();
+  return test::GetResult();
+}
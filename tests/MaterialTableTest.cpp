@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Check.hpp"
+#include "render/MaterialTable.hpp"
+
+using render::MaterialTable;
+using render::Texture;
+using render::TextureCache;
+
+// Textures here never hold an image, the destructor is only there for
+// std::unique_ptr to link.
+namespace render {
+namespace vulkan {
+Image::~Image() {}
+}  // namespace vulkan
+}  // namespace render
+
+namespace {
+// Textures are told apart by their view, the content hash being the id.
+VkImageView GetView(ResourceId id) {
+  return reinterpret_cast<VkImageView>(static_cast<uintptr_t>(id));
+}
+
+void MakeResident(TextureCache& texture_cache,
+                  const std::vector<ResourceId>& ids) {
+  for (ResourceId id : ids) {
+    texture_cache.Insert(id, id, 1, Texture(nullptr, GetView(id), nullptr));
+  }
+}
+
+std::vector<VkImageView> GetViews(const std::vector<Texture>& textures) {
+  std::vector<VkImageView> views;
+  for (const Texture& texture : textures) {
+    views.push_back(std::get<1>(texture));
+  }
+  std::sort(views.begin(), views.end());
+  return views;
+}
+
+void TestReload() {
+  TextureCache texture_cache;
+  MaterialTable material_table(texture_cache);
+  const ResourceId kMaterial = 100;
+  std::vector<ResourceId> first_referenced_ids;
+  std::vector<Texture> released;
+  material_table.Load(kMaterial, {1, 2}, first_referenced_ids, released);
+  CHECK((first_referenced_ids == std::vector<ResourceId>{1, 2}));
+  MakeResident(texture_cache, {1, 2});
+  CHECK(material_table.BindComplete(released) ==
+        std::vector<ResourceId>{kMaterial});
+  CHECK(released.empty());
+
+  // Loaded again twice while resident: the first reload is replaced before
+  // its textures arrive, the resident textures stay until the second one's
+  // are there.
+  first_referenced_ids.clear();
+  material_table.Load(kMaterial, {2, 3}, first_referenced_ids, released);
+  CHECK(first_referenced_ids == std::vector<ResourceId>{3});
+  first_referenced_ids.clear();
+  material_table.Load(kMaterial, {3, 4}, first_referenced_ids, released);
+  CHECK(first_referenced_ids == std::vector<ResourceId>{4});
+  CHECK(released.empty());
+  CHECK(material_table.IsPending(kMaterial));
+  CHECK(material_table.BindComplete(released).empty());
+  CHECK(texture_cache.IsReferenced(1) && texture_cache.IsReferenced(2));
+
+  MakeResident(texture_cache, {3, 4});
+  CHECK(material_table.BindComplete(released) ==
+        std::vector<ResourceId>{kMaterial});
+  CHECK(!material_table.IsPending(kMaterial));
+  CHECK((material_table.GetResident().at(kMaterial) ==
+         std::vector<ResourceId>{3, 4}));
+  CHECK((GetViews(released) == std::vector<VkImageView>{GetView(1),
+                                                         GetView(2)}));
+  CHECK(!texture_cache.IsReferenced(1) && !texture_cache.Contains(1));
+  CHECK(!texture_cache.IsReferenced(2) && !texture_cache.Contains(2));
+
+  released.clear();
+  CHECK(material_table.Unload(kMaterial, released));
+  CHECK((GetViews(released) == std::vector<VkImageView>{GetView(3),
+                                                         GetView(4)}));
+  CHECK(!texture_cache.IsReferenced(3) && !texture_cache.IsReferenced(4));
+  CHECK(material_table.GetResident().empty());
+}
+
+void TestReloadWhilePending() {
+  TextureCache texture_cache;
+  MaterialTable material_table(texture_cache);
+  std::vector<ResourceId> first_referenced_ids;
+  std::vector<Texture> released;
+  material_table.Load(100, {1}, first_referenced_ids, released);
+  material_table.Load(100, {2}, first_referenced_ids, released);
+  material_table.Load(100, {2}, first_referenced_ids, released);
+  CHECK((first_referenced_ids == std::vector<ResourceId>{1, 2}));
+  CHECK(!texture_cache.IsReferenced(1));
+
+  // The same texture stays referenced for as long as a material uses it.
+  material_table.Load(200, {2}, first_referenced_ids, released);
+  CHECK(!material_table.Unload(100, released));
+  CHECK(texture_cache.IsReferenced(2));
+  CHECK(!material_table.Unload(200, released));
+  CHECK(!texture_cache.IsReferenced(2));
+  CHECK(released.empty());
+}
+
+void TestDropFailed() {
+  TextureCache texture_cache;
+  MaterialTable material_table(texture_cache);
+  std::vector<ResourceId> first_referenced_ids;
+  std::vector<Texture> released;
+  material_table.Load(100, {1, 2}, first_referenced_ids, released);
+  material_table.Load(200, {1, 3}, first_referenced_ids, released);
+  MakeResident(texture_cache, {1});
+  std::vector<ResourceId> dropped = material_table.DropFailed({2}, released);
+  CHECK(dropped == std::vector<ResourceId>{100});
+  CHECK(!material_table.IsPending(100) && material_table.IsPending(200));
+  CHECK(!texture_cache.IsReferenced(2));
+  CHECK(texture_cache.IsReferenced(1) && released.empty());
+
+  // Loading it again retries the texture.
+  first_referenced_ids.clear();
+  material_table.Load(100, {1, 2}, first_referenced_ids, released);
+  CHECK(first_referenced_ids == std::vector<ResourceId>{2});
+
+  material_table.Unload(100, released);
+  material_table.Unload(200, released);
+  CHECK((GetViews(released) == std::vector<VkImageView>{GetView(1)}));
+}
+}  // namespace
+
+int main() {
+  TestReload();
+  TestReloadWhilePending();
+  TestDropFailed();
+  return test::GetResult();
+}
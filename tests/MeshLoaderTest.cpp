@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/packing.hpp>
+
+#include "Check.hpp"
+#include "render/MeshLoader.hpp"
+#include "render/VertexWelder.hpp"
+
+using render::MeshBounds;
+using render::MeshLoader;
+using render::PackedVertex;
+using render::SubMesh;
+using render::Vertex;
+using render::VertexWelder;
+
+namespace {
+std::string WriteTemporaryFile(const char* name, const std::string& contents) {
+  std::string path = (std::filesystem::temp_directory_path() / name).string();
+  std::ofstream file(path, std::ios::binary);
+  file << contents;
+  return path;
+}
+
+bool IsFinite(const Vertex& vertex) {
+  const float values[] = {vertex.position.x, vertex.position.y,
+                          vertex.position.z, vertex.normal.x,
+                          vertex.normal.y,   vertex.normal.z,
+                          vertex.uv.x,       vertex.uv.y,
+                          vertex.tangent.x,  vertex.tangent.y,
+                          vertex.tangent.z,  vertex.tangent.w};
+  for (float value : values) {
+    if (!std::isfinite(value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TestWelder() {
+  // Starts at the smallest table to go through a few growths.
+  VertexWelder welder(0);
+  const int kCount = 1000;
+  for (int i = 0; i < kCount; ++i) {
+    auto id = welder.Insert(tinyobj::index_t{i, i % 7 - 1, -1});
+    if (!CHECK(id.second) || !CHECK(id.first == static_cast<uint32_t>(i))) {
+      return;
+    }
+  }
+  for (int i = 0; i < kCount; ++i) {
+    auto id = welder.Insert(tinyobj::index_t{i, i % 7 - 1, -1});
+    if (!CHECK(!id.second) || !CHECK(id.first == static_cast<uint32_t>(i))) {
+      return;
+    }
+  }
+  // Triples differing in any one index are distinct vertices.
+  CHECK(welder.Insert(tinyobj::index_t{0, 0, -1}).second);
+  CHECK(welder.Insert(tinyobj::index_t{0, -1, 0}).second);
+}
+
+// Faces without normals, texture coordinates or either get null ones, which
+// used to be read from before the start of the attribute arrays.
+void TestMissingAttributes(size_t import_budget) {
+  const std::string path = WriteTemporaryFile(
+      "mesh_loader_test.obj",
+      "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n"
+      "vt 0.25 0.5\nvt 1 0\nvt 0 1\n"
+      "vn 0 0 1\n"
+      "g positions_only\nf 1 2 3\n"
+      "g no_normals\nf 1/1 2/2 3/3\n"
+      "g no_uvs\nf 2//1 4//1 3//1\n"
+      "g mixed\nf 1 2/2 3//1 4/3/1\n");
+  MeshLoader loader(import_budget);
+  std::vector<uint32_t> indices;
+  std::vector<Vertex> vertices;
+  std::vector<SubMesh> sub_meshes;
+  bool loaded = loader.Load(path, indices, vertices, sub_meshes);
+  std::filesystem::remove(path);
+  if (!CHECK(loaded) || !CHECK(sub_meshes.size() == 4) ||
+      !CHECK(indices.size() == 15)) {
+    return;
+  }
+  for (uint32_t index : indices) {
+    if (!CHECK(index < vertices.size()) || !CHECK(IsFinite(vertices[index]))) {
+      return;
+    }
+  }
+
+  const glm::vec3 kNoNormal(0.0f);
+  // v is flipped on load.
+  const glm::vec2 kNoUv(0.0f, 1.0f);
+  for (uint32_t i = 0; i < 3; ++i) {
+    const Vertex& vertex = vertices[indices[sub_meshes[0].first_index + i]];
+    CHECK(vertex.normal == kNoNormal);
+    CHECK(vertex.uv == kNoUv);
+  }
+  const Vertex& uv_only = vertices[indices[sub_meshes[1].first_index]];
+  CHECK(uv_only.normal == kNoNormal);
+  CHECK(uv_only.uv == glm::vec2(0.25f, 0.5f));
+  const Vertex& normal_only = vertices[indices[sub_meshes[2].first_index]];
+  CHECK(normal_only.normal == glm::vec3(0.0f, 0.0f, 1.0f));
+  CHECK(normal_only.uv == kNoUv);
+  // The quad is fanned from its first corner.
+  const uint32_t* mixed = &indices[sub_meshes[3].first_index];
+  CHECK(vertices[mixed[0]].normal == kNoNormal);
+  CHECK(vertices[mixed[0]].uv == kNoUv);
+  CHECK(vertices[mixed[1]].uv == glm::vec2(1.0f, 1.0f));
+  CHECK(vertices[mixed[2]].normal == glm::vec3(0.0f, 0.0f, 1.0f));
+  CHECK(vertices[mixed[5]].uv == glm::vec2(0.0f, 0.0f));
+}
+
+// Corners with the same triple share a vertex, but only within a group.
+void TestWelding() {
+  const std::string path = WriteTemporaryFile(
+      "mesh_loader_weld_test.obj",
+      "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\nvt 0 0\nvn 0 0 1\n"
+      "f 1/1/1 2/1/1 3/1/1\nf 2/1/1 4/1/1 3/1/1\nf 1//1 2//1 3//1\n"
+      "g second\nf 1/1/1 2/1/1 3/1/1\n");
+  MeshLoader loader;
+  std::vector<uint32_t> indices;
+  std::vector<Vertex> vertices;
+  std::vector<SubMesh> sub_meshes;
+  bool loaded = loader.Load(path, indices, vertices, sub_meshes);
+  std::filesystem::remove(path);
+  if (!CHECK(loaded) || !CHECK(indices.size() == 12)) {
+    return;
+  }
+  // 4 welded corners, 3 more without uvs, then the second group's own 3.
+  CHECK(vertices.size() == 10);
+  const std::vector<uint32_t> expected = {0, 1, 2, 1, 3, 2,
+                                          4, 5, 6, 7, 8, 9};
+  CHECK(indices == expected);
+}
+
+// Decodes like vertex_packed.glsl does.
+glm::vec3 DecodeOctahedral(uint32_t packed) {
+  glm::vec2 encoded = glm::unpackSnorm2x16(packed);
+  glm::vec3 v(encoded.x, encoded.y,
+              1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+  float fold = std::max(-v.z, 0.0f);
+  v.x += v.x >= 0.0f ? -fold : fold;
+  v.y += v.y >= 0.0f ? -fold : fold;
+  return glm::normalize(v);
+}
+
+double GetAngle(const glm::vec3& a, const glm::vec3& b) {
+  double cross_x = double{a.y} * b.z - double{a.z} * b.y;
+  double cross_y = double{a.z} * b.x - double{a.x} * b.z;
+  double cross_z = double{a.x} * b.y - double{a.y} * b.x;
+  double dot = double{a.x} * b.x + double{a.y} * b.y + double{a.z} * b.z;
+  return std::atan2(
+      std::sqrt(cross_x * cross_x + cross_y * cross_y + cross_z * cross_z),
+      dot);
+}
+
+glm::vec3 GetRandomDirection(std::mt19937& rng) {
+  std::normal_distribution<float> distribution;
+  glm::vec3 v;
+  do {
+    v = glm::vec3(distribution(rng), distribution(rng), distribution(rng));
+  } while (glm::length(v) < 1e-3f);
+  return glm::normalize(v);
+}
+
+// Quantization error of PackedVertex against its documented layout, on
+// random vertices plus the directions where octahedral folding is most
+// likely to go wrong: axes, octant edges and the equator.
+void TestPack() {
+  std::mt19937 rng(7);
+  std::vector<glm::vec3> directions = {
+      {1, 0, 0},  {-1, 0, 0}, {0, 1, 0},   {0, -1, 0},  {0, 0, 1},
+      {0, 0, -1}, {1, 1, 0},  {-1, 1, 0},  {1, -1, 0},  {-1, -1, 0},
+      {1, 0, -1}, {0, 1, -1}, {-1, 0, -1}, {0, -1, -1}, {1, 1, -1},
+      {1, 1, 1},  {-1, -1, -1}};
+  for (glm::vec3& direction : directions) {
+    direction = glm::normalize(direction);
+  }
+  while (directions.size() < 100000) {
+    directions.push_back(GetRandomDirection(rng));
+  }
+  std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+  std::uniform_real_distribution<float> texcoord(-4.0f, 4.0f);
+  std::vector<Vertex> vertices;
+  for (size_t i = 0; i < directions.size(); ++i) {
+    const glm::vec3& normal = directions[i];
+    // Any direction orthogonal to the normal.
+    glm::vec3 tangent = glm::normalize(glm::cross(
+        normal, std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                          : glm::vec3(0.0f, 1.0f, 0.0f)));
+    vertices.push_back(Vertex{
+        glm::vec3(coordinate(rng), 0.01f * coordinate(rng), coordinate(rng)),
+        normal, glm::vec3(1.0f),
+        glm::vec2(texcoord(rng), texcoord(rng)),
+        glm::vec4(tangent, i % 2 ? 1.0f : -1.0f)});
+  }
+
+  MeshLoader loader;
+  std::vector<PackedVertex> packed;
+  MeshBounds bounds = loader.Pack(vertices, packed);
+  if (!CHECK(packed.size() == vertices.size())) {
+    return;
+  }
+
+  // Positions are rounded to the nearest of 65536 steps across the bounds,
+  // so they are off by half a step at most, plus float rounding.
+  glm::vec3 max_position_error(0.0f);
+  glm::vec3 position_bound;
+  for (int axis = 0; axis < 3; ++axis) {
+    position_bound[axis] =
+        0.5f * bounds.extent[axis] / 65535.0f +
+        4.0f * FLT_EPSILON *
+            (std::abs(bounds.min[axis]) + bounds.extent[axis]);
+  }
+  // A snorm16 pair is off by half a step, 0.5 / 32767, per component. On
+  // the octahedron that moves the point by at most sqrt(0.5^2 + 0.5^2 + 1^2)
+  // steps, the third component taking both errors, and normalizing scales
+  // that by at most sqrt(3), the octahedron being no closer to the origin
+  // than 1 / sqrt(3): about 6.5e-5 radians, or 0.0037 degrees.
+  const double kMaxAngle = std::sqrt(1.5) * std::sqrt(3.0) / 32767.0;
+  double max_normal_angle = 0.0;
+  double max_tangent_angle = 0.0;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    const Vertex& vertex = vertices[i];
+    const PackedVertex& packed_vertex = packed[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      float decoded = bounds.min[axis] +
+                      bounds.extent[axis] *
+                          (packed_vertex.position[axis] / 65535.0f);
+      max_position_error[axis] =
+          std::max(max_position_error[axis],
+                   std::abs(decoded - vertex.position[axis]));
+    }
+    max_normal_angle = std::max(
+        max_normal_angle,
+        GetAngle(DecodeOctahedral(packed_vertex.normal), vertex.normal));
+    max_tangent_angle = std::max(
+        max_tangent_angle, GetAngle(DecodeOctahedral(packed_vertex.tangent),
+                                    glm::vec3(vertex.tangent)));
+    CHECK((packed_vertex.position[3] == 65535) == (vertex.tangent.w > 0.0f));
+    // Half floats keep 11 significant bits, and subnormal ones are 2^-24
+    // apart.
+    glm::vec2 uv = glm::unpackHalf2x16(packed_vertex.uv);
+    for (int axis = 0; axis < 2; ++axis) {
+      CHECK(std::abs(uv[axis] - vertex.uv[axis]) <=
+            std::max(std::ldexp(std::abs(vertex.uv[axis]), -11),
+                     std::ldexp(1.0f, -25)));
+    }
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    CHECK(max_position_error[axis] <= position_bound[axis]);
+  }
+  CHECK(max_normal_angle <= kMaxAngle);
+  CHECK(max_tangent_angle <= kMaxAngle);
+  std::cout << "position error: " << max_position_error.x << ", "
+            << max_position_error.y << ", " << max_position_error.z
+            << " (bound " << position_bound.x << ", " << position_bound.y
+            << ", " << position_bound.z << ")\n";
+  std::cout << "normal error: " << max_normal_angle
+            << " rad, tangent error: " << max_tangent_angle << " rad (bound "
+            << kMaxAngle << ")\n";
+}
+
+// Null and non-finite vectors encode +z, flat axes quantize to 0.
+void TestPackDegenerate() {
+  const float kNaN = std::nanf("");
+  std::vector<Vertex> vertices = {
+      Vertex{glm::vec3(1.0f, 2.0f, 3.0f), glm::vec3(0.0f), glm::vec3(1.0f),
+             glm::vec2(0.0f), glm::vec4(kNaN, 0.0f, 0.0f, 1.0f)},
+      Vertex{glm::vec3(1.0f, 2.0f, 5.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+             glm::vec3(1.0f), glm::vec2(0.0f),
+             glm::vec4(1.0f, 0.0f, 0.0f, 1.0f)}};
+  MeshLoader loader;
+  std::vector<PackedVertex> packed;
+  MeshBounds bounds = loader.Pack(vertices, packed);
+  CHECK(bounds.extent.x == 0.0f && bounds.extent.y == 0.0f);
+  CHECK(bounds.extent.z == 2.0f);
+  CHECK(packed[0].position[0] == 0 && packed[1].position[1] == 0);
+  CHECK(packed[0].position[2] == 0 && packed[1].position[2] == 65535);
+  const glm::vec3 kZ(0.0f, 0.0f, 1.0f);
+  CHECK(DecodeOctahedral(packed[0].normal) == kZ);
+  CHECK(DecodeOctahedral(packed[0].tangent) == kZ);
+  CHECK(DecodeOctahedral(packed[1].normal) == kZ);
+}
+}  // namespace
+
+int main() {
+  TestWelder();
+  TestMissingAttributes(0);
+  TestMissingAttributes(64 << 20);
+  TestWelding();
+  TestPack();
+  TestPackDegenerate();
+  return test::GetResult();
+}
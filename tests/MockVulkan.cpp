@@ -0,0 +1,96 @@
+#include <cstring>
+#include <memory>
+
+#include "MockVulkan.hpp"
+
+namespace mock {
+namespace {
+struct DeviceMemory {
+  VkDeviceSize size;
+  uint32_t memory_type;
+  std::unique_ptr<uint8_t[]> data;
+};
+
+// Dispatchable handles only need to be distinct.
+int physical_device_tag = 0;
+int device_tag = 0;
+MemoryStats memory_stats = {};
+}  // namespace
+
+VkPhysicalDevice GetPhysicalDevice() {
+  return reinterpret_cast<VkPhysicalDevice>(&physical_device_tag);
+}
+
+VkDevice GetDevice() {
+  return reinterpret_cast<VkDevice>(&device_tag);
+}
+
+const MemoryStats& GetMemoryStats() {
+  return memory_stats;
+}
+}  // namespace mock
+
+// Non-dispatchable handles are pointers on 64-bit targets and integers on
+// 32-bit ones, a C-style cast converts from either.
+#define MOCK_HANDLE(type, pointer) ((type)(uintptr_t)(pointer))
+#define MOCK_MEMORY(handle) ((mock::DeviceMemory*)(uintptr_t)(handle))
+
+extern "C" {
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice,
+                                    VkPhysicalDeviceMemoryProperties* p) {
+  std::memset(p, 0, sizeof(*p));
+  p->memoryTypeCount = 2;
+  p->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  p->memoryTypes[0].heapIndex = 0;
+  p->memoryTypes[1].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  p->memoryTypes[1].heapIndex = 1;
+  p->memoryHeapCount = 2;
+  p->memoryHeaps[0].size = mock::kHeapSize;
+  p->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+  p->memoryHeaps[1].size = mock::kHeapSize;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateMemory(VkDevice,
+                 const VkMemoryAllocateInfo* info,
+                 const VkAllocationCallbacks*,
+                 VkDeviceMemory* memory) {
+  auto* device_memory = new mock::DeviceMemory{
+      info->allocationSize, info->memoryTypeIndex, nullptr};
+  *memory = MOCK_HANDLE(VkDeviceMemory, device_memory);
+  ++mock::memory_stats.allocation_calls;
+  ++mock::memory_stats.live_allocations;
+  mock::memory_stats.live_bytes += info->allocationSize;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice,
+                                        VkDeviceMemory memory,
+                                        const VkAllocationCallbacks*) {
+  mock::DeviceMemory* device_memory = MOCK_MEMORY(memory);
+  --mock::memory_stats.live_allocations;
+  mock::memory_stats.live_bytes -= device_memory->size;
+  delete device_memory;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice,
+                                           VkDeviceMemory memory,
+                                           VkDeviceSize offset,
+                                           VkDeviceSize,
+                                           VkMemoryMapFlags,
+                                           void** data) {
+  mock::DeviceMemory* device_memory = MOCK_MEMORY(memory);
+  if (device_memory->memory_type != 1) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  if (device_memory->data == nullptr) {
+    device_memory->data.reset(new uint8_t[device_memory->size]);
+  }
+  *data = device_memory->data.get() + offset;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory) {}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+
+// Stands in for the driver's device memory entry points, for tests and
+// benchmarks of the allocators. Memory type 0 is device-local and type 1
+// host-visible, both in heaps of kHeapSize bytes. Only host-visible memory is
+// backed, and only once mapped.
+namespace mock {
+constexpr VkDeviceSize kHeapSize = 8ull << 30;
+
+struct MemoryStats {
+  size_t allocation_calls;  ///< vkAllocateMemory calls since the start
+  size_t live_allocations;
+  VkDeviceSize live_bytes;
+};
+
+VkPhysicalDevice GetPhysicalDevice();
+VkDevice GetDevice();
+const MemoryStats& GetMemoryStats();
+}  // namespace mock
@@ -0,0 +1,245 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Check.hpp"
+// The demo only uses tinyobj's types, its parser is built here as the
+// reference ParseObj must match. ObjParser.hpp includes tiny_obj_loader.h.
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "render/ObjParser.hpp"
+
+using render::ObjGroup;
+using render::ParseObj;
+
+namespace {
+std::string GetTemporaryPath(const char* name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+void WriteFile(const std::string& path, const std::string& contents) {
+  std::ofstream file(path, std::ios::binary);
+  file << contents;
+}
+
+// Random coordinates written the many ways exporters write them.
+std::string FormatReal(std::mt19937& rng) {
+  static const char* kFormats[] = {"%.6f", "%g", "%.9e", "%+.3f", "%.17g",
+                                   "%.2E", "%.0f", "%.12f"};
+  std::uniform_real_distribution<double> distribution(-1000.0, 1000.0);
+  double value = distribution(rng) * std::pow(10.0, rng() % 7 - 3.0);
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), kFormats[rng() % 8], value);
+  return buffer;
+}
+
+// One of i, i/j, i//k or i/j/k, the same for the whole face, with relative
+// indices now and then.
+std::string FormatCorner(std::mt19937& rng,
+                         int form,
+                         int vertex_count,
+                         int normal_count,
+                         int texcoord_count) {
+  auto index = [&rng](int count) {
+    int i = static_cast<int>(rng() % count);
+    return std::to_string(rng() % 4 == 0 ? i - count : i + 1);
+  };
+  std::string corner = index(vertex_count);
+  if (form == 1 || form == 3) {
+    corner += "/" + index(texcoord_count);
+  }
+  if (form == 2) {
+    corner += "/";
+  }
+  if (form >= 2) {
+    corner += "/" + index(normal_count);
+  }
+  return corner;
+}
+
+// Writes a file of `line_count` lines mixing every statement ParseObj
+// handles with comments, blank lines, stray spaces and "\r\n" endings.
+// `triangle_materials` gets the material of each triangle once fanned.
+std::string GenerateObj(uint32_t seed,
+                        size_t line_count,
+                        std::vector<std::string>& triangle_materials) {
+  std::mt19937 rng(seed);
+  std::string obj = "# generated\nmtllib missing.mtl\n";
+  int vertex_count = 0;
+  int normal_count = 0;
+  int texcoord_count = 0;
+  std::string material;
+  triangle_materials.clear();
+  for (size_t line = 0; line < line_count; ++line) {
+    std::string statement;
+    unsigned int kind = rng() % 100;
+    if (kind < 30 || vertex_count < 3) {
+      statement = "v " + FormatReal(rng) + " " + FormatReal(rng) + " " +
+                  FormatReal(rng);
+      ++vertex_count;
+    } else if (kind < 40 || normal_count == 0) {
+      statement = "vn " + FormatReal(rng) + "  " + FormatReal(rng) + " " +
+                  FormatReal(rng);
+      ++normal_count;
+    } else if (kind < 50 || texcoord_count == 0) {
+      statement = "vt " + FormatReal(rng) + "\t" + FormatReal(rng);
+      ++texcoord_count;
+    } else if (kind < 90) {
+      int form = static_cast<int>(rng() % 4);
+      int corner_count = 3 + static_cast<int>(rng() % 4);
+      statement = "f";
+      for (int corner = 0; corner < corner_count; ++corner) {
+        statement += " " + FormatCorner(rng, form, vertex_count, normal_count,
+                                        texcoord_count);
+      }
+      triangle_materials.insert(triangle_materials.end(), corner_count - 2,
+                                material);
+    } else if (kind < 93) {
+      statement = rng() % 2 ? "g group" + std::to_string(line)
+                            : "o object" + std::to_string(line);
+    } else if (kind < 96) {
+      material = "material" + std::to_string(rng() % 5);
+      statement = "usemtl " + material;
+    } else if (kind < 98) {
+      statement = "# comment f 1 2 3";
+    } else {
+      statement = "s off";
+    }
+    if (rng() % 10 == 0) {
+      statement = "  " + statement;
+    }
+    obj += statement + (rng() % 5 == 0 ? "\r\n" : "\n");
+  }
+  return obj;
+}
+
+bool IsSameReal(tinyobj::real_t a, tinyobj::real_t b) {
+  return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+bool IsSameIndex(const tinyobj::index_t& a, const tinyobj::index_t& b) {
+  return a.vertex_index == b.vertex_index &&
+         a.normal_index == b.normal_index &&
+         a.texcoord_index == b.texcoord_index;
+}
+
+template <typename T, typename Compare>
+bool IsSame(const std::vector<T>& a,
+            const std::vector<T>& b,
+            Compare compare) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (!compare(a[i], b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Large enough, with about 30 bytes a line, to be split into several chunks
+// on machines with several hardware threads.
+void TestMatchesTinyObj(uint32_t seed, size_t line_count) {
+  std::vector<std::string> triangle_materials;
+  const std::string path = GetTemporaryPath("obj_parser_test.obj");
+  WriteFile(path, GenerateObj(seed, line_count, triangle_materials));
+
+  tinyobj::attrib_t expected_attributes;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string expected_error;
+  CHECK(tinyobj::LoadObj(&expected_attributes, &shapes, &materials,
+                         &expected_error, path.c_str(), nullptr, true));
+  std::vector<tinyobj::index_t> expected_indices;
+  std::vector<size_t> shape_offsets;
+  for (const tinyobj::shape_t& shape : shapes) {
+    shape_offsets.push_back(expected_indices.size());
+    expected_indices.insert(expected_indices.end(),
+                            shape.mesh.indices.begin(),
+                            shape.mesh.indices.end());
+  }
+
+  tinyobj::attrib_t attributes;
+  std::vector<tinyobj::index_t> indices;
+  std::vector<ObjGroup> groups;
+  std::string error;
+  if (!CHECK(ParseObj(path, attributes, indices, groups, error))) {
+    std::printf("\t%s\n", error.c_str());
+    return;
+  }
+  CHECK(IsSame(attributes.vertices, expected_attributes.vertices,
+               IsSameReal));
+  CHECK(IsSame(attributes.normals, expected_attributes.normals, IsSameReal));
+  CHECK(IsSame(attributes.texcoords, expected_attributes.texcoords,
+               IsSameReal));
+  CHECK(IsSame(indices, expected_indices, IsSameIndex));
+
+  // Groups tile the indices, carry the material of their faces, and start
+  // wherever a shape does.
+  std::set<size_t> group_offsets;
+  size_t index_offset = 0;
+  for (const ObjGroup& group : groups) {
+    if (!CHECK(group.index_offset == index_offset) ||
+        !CHECK(group.index_count > 0 && group.index_count % 3 == 0)) {
+      return;
+    }
+    for (size_t i = group.index_offset;
+         i < group.index_offset + group.index_count; i += 3) {
+      if (!CHECK(triangle_materials[i / 3] == group.material)) {
+        return;
+      }
+    }
+    group_offsets.insert(group.index_offset);
+    index_offset += group.index_count;
+  }
+  CHECK(index_offset == indices.size());
+  for (size_t offset : shape_offsets) {
+    CHECK(group_offsets.count(offset) == 1);
+  }
+  std::filesystem::remove(path);
+}
+
+// Parses `obj` from a file, leaving the error, if any, in `error`.
+bool ParseText(const std::string& obj, std::string& error) {
+  const std::string path = GetTemporaryPath("obj_parser_text_test.obj");
+  WriteFile(path, obj);
+  tinyobj::attrib_t attributes;
+  std::vector<tinyobj::index_t> indices;
+  std::vector<ObjGroup> groups;
+  bool result = ParseObj(path, attributes, indices, groups, error);
+  std::filesystem::remove(path);
+  return result;
+}
+
+void TestIndexRange() {
+  const std::string kTriangle =
+      "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n";
+  std::string error;
+  CHECK(ParseText(kTriangle + "f 1/1/1 2/1/1 -1/-1/-1\n", error));
+  // Faces may refer to attributes defined after them, like in tinyobj.
+  CHECK(ParseText("v 0 0 0\nv 1 0 0\nf 1 2 3\nv 0 1 0\n", error));
+
+  const char* kOutOfRange[] = {"f 1 2 4\n", "f 1 2 -4\n", "f 1/2 2/1 3/1\n",
+                               "f 1//1 2//2 3//1\n", "f 1 2 3/1/2\n"};
+  for (const char* face : kOutOfRange) {
+    error.clear();
+    CHECK(!ParseText(kTriangle + face, error));
+    CHECK(!error.empty());
+  }
+}
+}  // namespace
+
+int main() {
+  TestMatchesTinyObj(1, 1000);
+  TestMatchesTinyObj(2, 200000);
+  TestMatchesTinyObj(3, 1000000);
+
+  TestIndexRange();
+  return test::GetResult();
+}
@@ -0,0 +1,198 @@
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+#include "render/RangeAllocator.hpp"
+
+using render::RangeAllocator;
+
+namespace {
+void TestSplit() {
+  RangeAllocator allocator(1024);
+  auto a = allocator.Allocate(100, 1);
+  auto b = allocator.Allocate(200, 1);
+  auto c = allocator.Allocate(300, 1);
+  if (!CHECK(a && b && c)) {
+    return;
+  }
+  CHECK(a->offset == 0 && a->size == 100);
+  CHECK(b->offset == 100 && b->size == 200);
+  CHECK(c->offset == 300 && c->size == 300);
+
+  RangeAllocator::Stats stats = allocator.GetStats();
+  CHECK(stats.used == 600);
+  CHECK(stats.allocation_count == 3);
+  CHECK(stats.free_range_count == 1);
+  CHECK(stats.largest_free_range == 424);
+}
+
+void TestCoalesce() {
+  RangeAllocator allocator(1024);
+  auto a = allocator.Allocate(100, 1);
+  auto b = allocator.Allocate(200, 1);
+  auto c = allocator.Allocate(300, 1);
+  if (!CHECK(a && b && c)) {
+    return;
+  }
+
+  // Nothing to merge with, then with the previous range only, then with
+  // both neighbours.
+  allocator.Free(b.value());
+  CHECK(allocator.GetStats().free_range_count == 2);
+  allocator.Free(a.value());
+  CHECK(allocator.GetStats().free_range_count == 2);
+  CHECK(allocator.GetStats().largest_free_range == 424);
+  allocator.Free(c.value());
+  RangeAllocator::Stats stats = allocator.GetStats();
+  CHECK(stats.free_range_count == 1);
+  CHECK(stats.largest_free_range == 1024);
+  CHECK(allocator.IsEmpty());
+
+  // With the next range only.
+  a = allocator.Allocate(512, 1);
+  b = allocator.Allocate(256, 1);
+  if (!CHECK(a && b)) {
+    return;
+  }
+  allocator.Free(b.value());
+  stats = allocator.GetStats();
+  CHECK(stats.free_range_count == 1);
+  CHECK(stats.largest_free_range == 512);
+
+  allocator.Free(a.value());
+  auto whole = allocator.Allocate(1024, 1);
+  CHECK(whole && whole->offset == 0);
+}
+
+void TestAlignmentPadding() {
+  RangeAllocator allocator(4096);
+  auto unaligned = allocator.Allocate(3, 1);
+  auto aligned = allocator.Allocate(16, 256);
+  if (!CHECK(unaligned && aligned)) {
+    return;
+  }
+  CHECK(aligned->offset == 256);
+  CHECK(aligned->size == 16);
+  // The padding is given back rather than added to the allocation.
+  RangeAllocator::Stats stats = allocator.GetStats();
+  CHECK(stats.used == 19);
+  CHECK(stats.free_range_count == 2);
+
+  auto in_padding = allocator.Allocate(200, 1);
+  CHECK(in_padding && in_padding->offset == 3);
+
+  allocator.Free(aligned.value());
+  allocator.Free(in_padding.value());
+  allocator.Free(unaligned.value());
+  stats = allocator.GetStats();
+  CHECK(stats.free_range_count == 1);
+  CHECK(stats.largest_free_range == 4096);
+}
+
+void TestBucketFallback() {
+  // Requests are rounded up to the next bucket, which no free range reaches
+  // here: only scanning the request's own bucket finds the exact fit.
+  RangeAllocator exact(100);
+  auto range = exact.Allocate(100, 1);
+  CHECK(range && range->offset == 0 && range->size == 100);
+  CHECK(!exact.Allocate(1, 1));
+
+  RangeAllocator too_small(100);
+  CHECK(!too_small.Allocate(101, 1));
+
+  // The scan accounts for alignment padding.
+  RangeAllocator padded(104);
+  auto head = padded.Allocate(1, 1);
+  auto aligned = padded.Allocate(100, 2);
+  CHECK(head && aligned && aligned->offset == 2);
+  CHECK(!padded.Allocate(4, 1));
+}
+
+void TestExhaustion() {
+  const uint64_t kSize = 1 << 20;
+  const uint64_t kPage = 4096;
+  RangeAllocator allocator(kSize);
+  std::vector<RangeAllocator::Range> ranges;
+  while (auto range = allocator.Allocate(kPage, kPage)) {
+    ranges.push_back(range.value());
+  }
+  CHECK(ranges.size() == kSize / kPage);
+  RangeAllocator::Stats stats = allocator.GetStats();
+  CHECK(stats.used == kSize);
+  CHECK(stats.free_range_count == 0);
+  CHECK(stats.largest_free_range == 0);
+  CHECK(!allocator.Allocate(1, 1));
+
+  allocator.Free(ranges[ranges.size() / 2]);
+  auto reused = allocator.Allocate(kPage, kPage);
+  CHECK(reused && reused->offset == ranges[ranges.size() / 2].offset);
+  CHECK(!allocator.Allocate(1, 1));
+}
+
+// Random allocations and releases, checked against a map of the live ranges.
+void TestRandomChurn() {
+  const uint64_t kSize = 16 << 20;
+  RangeAllocator allocator(kSize);
+  std::map<uint64_t, RangeAllocator::Range> live;  // by offset
+  uint64_t used = 0;
+  std::mt19937 rng(1);
+
+  for (int step = 0; step < 200000; ++step) {
+    if (live.empty() || rng() % 100 < 55) {
+      uint64_t size = 1 + rng() % 8192;
+      uint64_t alignment = uint64_t{1} << (rng() % 9);
+      auto range = allocator.Allocate(size, alignment);
+      if (!range) {
+        continue;
+      }
+      if (!CHECK(range->offset % alignment == 0) ||
+          !CHECK(range->size == size) ||
+          !CHECK(range->offset + range->size <= kSize)) {
+        return;
+      }
+      auto next = live.lower_bound(range->offset);
+      if (next != live.end() &&
+          !CHECK(range->offset + range->size <= next->first)) {
+        return;
+      }
+      if (next != live.begin() &&
+          !CHECK(std::prev(next)->second.offset +
+                     std::prev(next)->second.size <=
+                 range->offset)) {
+        return;
+      }
+      live[range->offset] = range.value();
+      used += size;
+    } else {
+      auto it = std::next(live.begin(), rng() % live.size());
+      allocator.Free(it->second);
+      used -= it->second.size;
+      live.erase(it);
+    }
+    if (step % 1000 == 0 && !CHECK(allocator.GetStats().used == used)) {
+      return;
+    }
+  }
+
+  for (const auto& entry : live) {
+    allocator.Free(entry.second);
+  }
+  RangeAllocator::Stats stats = allocator.GetStats();
+  CHECK(allocator.IsEmpty());
+  CHECK(stats.used == 0);
+  CHECK(stats.free_range_count == 1);
+  CHECK(stats.largest_free_range == kSize);
+}
+}  // namespace
+
+int main() {
+  TestSplit();
+  TestCoalesce();
+  TestAlignmentPadding();
+  TestBucketFallback();
+  TestExhaustion();
+  TestRandomChurn();
+  return test::GetResult();
+}